@@ -0,0 +1,225 @@
+/* Benchmark malloc and free of blocks passed between threads.
+   Copyright (C) 2021 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+#include <errno.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+
+#include "bench-timing.h"
+#include "json-lib.h"
+
+/* Each producer thread allocates blocks and hands them to its consumer
+   thread, which frees them.  The free thus always happens on a thread
+   other than the one which allocated the block, while the producer keeps
+   allocating from the same arena.  Block sizes are above the tcache and
+   fastbin range so that every free needs the owning arena.
+
+   Besides the throughput, the longest malloc and free calls are
+   reported.  A malloc call which finds chunks queued by the consumers
+   releases all of them while it holds the arena lock, so the longest
+   malloc bounds how long the lock is held for that; the longest free
+   shows how long a consumer waited for the lock.  When run with
+   GLIBC_TUNABLES=glibc.malloc.stats=1, the number of arena lock
+   acquisitions which found the lock busy is reported as well.  */
+
+#define NUM_ITERS		1000000
+#define RING_SIZE		1024
+#define MIN_ALLOCATION_SIZE	1100
+#define MAX_ALLOCATION_SIZE	4096
+
+struct pair
+{
+  /* Single-producer single-consumer ring of blocks to free.  */
+  void *ring[RING_SIZE];
+  _Atomic size_t head;
+  _Atomic size_t tail;
+  timing_t elapsed;
+  timing_t max_malloc;
+  timing_t free_time;
+  timing_t max_free;
+};
+
+static void *
+producer_thread (void *arg)
+{
+  struct pair *p = arg;
+  unsigned int state = 88;
+  timing_t start, stop, op_start, op_stop, op_time;
+
+  TIMING_NOW (start);
+  for (size_t i = 0; i < NUM_ITERS; i++)
+    {
+      size_t size = MIN_ALLOCATION_SIZE
+		    + rand_r (&state) % (MAX_ALLOCATION_SIZE
+					 - MIN_ALLOCATION_SIZE);
+      TIMING_NOW (op_start);
+      void *block = malloc (size);
+      TIMING_NOW (op_stop);
+      TIMING_DIFF (op_time, op_start, op_stop);
+      if (op_time > p->max_malloc)
+	p->max_malloc = op_time;
+
+      size_t head = atomic_load_explicit (&p->head, memory_order_relaxed);
+      while (head - atomic_load_explicit (&p->tail, memory_order_acquire)
+	     == RING_SIZE)
+	sched_yield ();
+      p->ring[head % RING_SIZE] = block;
+      atomic_store_explicit (&p->head, head + 1, memory_order_release);
+    }
+  TIMING_NOW (stop);
+
+  TIMING_DIFF (p->elapsed, start, stop);
+  return NULL;
+}
+
+static void *
+consumer_thread (void *arg)
+{
+  struct pair *p = arg;
+  timing_t op_start, op_stop, op_time;
+
+  for (size_t i = 0; i < NUM_ITERS; i++)
+    {
+      size_t tail = atomic_load_explicit (&p->tail, memory_order_relaxed);
+      while (atomic_load_explicit (&p->head, memory_order_acquire) == tail)
+	sched_yield ();
+      TIMING_NOW (op_start);
+      free (p->ring[tail % RING_SIZE]);
+      TIMING_NOW (op_stop);
+      TIMING_DIFF (op_time, op_start, op_stop);
+      TIMING_ACCUM (p->free_time, op_time);
+      if (op_time > p->max_free)
+	p->max_free = op_time;
+      atomic_store_explicit (&p->tail, tail + 1, memory_order_release);
+    }
+
+  return NULL;
+}
+
+static void
+usage (const char *name)
+{
+  fprintf (stderr, "%s: <num_pairs>\n", name);
+  exit (1);
+}
+
+int
+main (int argc, char **argv)
+{
+  size_t num_pairs = 1;
+  json_ctx_t json_ctx;
+
+  if (argc == 2)
+    {
+      long ret;
+
+      errno = 0;
+      ret = strtol (argv[1], NULL, 10);
+
+      if (errno || ret <= 0)
+	usage (argv[0]);
+
+      num_pairs = ret;
+    }
+  else if (argc != 1)
+    usage (argv[0]);
+
+  struct pair *pairs = calloc (num_pairs, sizeof (*pairs));
+  pthread_t *threads = calloc (2 * num_pairs, sizeof (*threads));
+  if (pairs == NULL || threads == NULL)
+    {
+      perror ("calloc");
+      return 1;
+    }
+
+  for (size_t i = 0; i < num_pairs; i++)
+    {
+      pthread_create (&threads[2 * i], NULL, consumer_thread, &pairs[i]);
+      pthread_create (&threads[2 * i + 1], NULL, producer_thread, &pairs[i]);
+    }
+
+  timing_t elapsed = 0, max_malloc = 0, free_time = 0, max_free = 0;
+  for (size_t i = 0; i < num_pairs; i++)
+    {
+      pthread_join (threads[2 * i], NULL);
+      pthread_join (threads[2 * i + 1], NULL);
+      TIMING_ACCUM (elapsed, pairs[i].elapsed);
+      TIMING_ACCUM (free_time, pairs[i].free_time);
+      if (pairs[i].max_malloc > max_malloc)
+	max_malloc = pairs[i].max_malloc;
+      if (pairs[i].max_free > max_free)
+	max_free = pairs[i].max_free;
+    }
+
+  struct malloc_global_stats stats;
+  bool have_stats = malloc_stats_query (MALLOC_STATS_VERSION, &stats,
+					NULL, 0) >= 0;
+
+  struct rusage usage;
+  getrusage (RUSAGE_SELF, &usage);
+
+  double d_total_s = elapsed;
+  double d_total_i = (double) NUM_ITERS * num_pairs;
+
+  json_init (&json_ctx, 0, stdout);
+
+  json_document_begin (&json_ctx);
+
+  json_attr_string (&json_ctx, "timing_type", TIMING_TYPE);
+
+  json_attr_object_begin (&json_ctx, "functions");
+
+  json_attr_object_begin (&json_ctx, "malloc");
+
+  json_attr_object_begin (&json_ctx, "remote_free");
+
+  json_attr_double (&json_ctx, "duration", d_total_s);
+  json_attr_double (&json_ctx, "iterations", d_total_i);
+  json_attr_double (&json_ctx, "time_per_iteration", d_total_s / d_total_i);
+  json_attr_double (&json_ctx, "max_rss", usage.ru_maxrss);
+  json_attr_double (&json_ctx, "max_malloc_time", max_malloc);
+  json_attr_double (&json_ctx, "free_time_per_iteration",
+		    (double) free_time / d_total_i);
+  json_attr_double (&json_ctx, "max_free_time", max_free);
+  if (have_stats)
+    json_attr_double (&json_ctx, "lock_contended", stats.nlock_contended);
+
+  json_attr_double (&json_ctx, "pairs", num_pairs);
+  json_attr_double (&json_ctx, "min_size", MIN_ALLOCATION_SIZE);
+  json_attr_double (&json_ctx, "max_size", MAX_ALLOCATION_SIZE);
+
+  json_attr_object_end (&json_ctx);
+
+  json_attr_object_end (&json_ctx);
+
+  json_attr_object_end (&json_ctx);
+
+  json_document_end (&json_ctx);
+
+  free (threads);
+  free (pairs);
+
+  return 0;
+}
@@ -0,0 +1,493 @@
+/* Replay a recorded malloc workload.
+   Copyright (C) 2021 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+/* The input is a binary mtrace file, recorded by running the workload
+   with LD_PRELOAD=libc_malloc_debug.so, MALLOC_TRACE=<file> and
+   MALLOC_TRACE_FORMAT=binary, from its call to mtrace on.  Every thread
+   of the traced program is replayed by a thread of its own, in the order
+   recorded.  A thread freeing or resizing a block allocated by another
+   thread waits until that allocation has been replayed, so the
+   cross-thread interleaving of the trace is preserved without
+   serializing the threads otherwise.
+
+   The trace is converted to per-thread operation lists before the clock
+   starts; all of the benchmark's own data lives in anonymous mappings
+   so that it does not disturb the heap being measured.  */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+
+#include "bench-timing.h"
+#include "json-lib.h"
+
+/* Must match the format written by malloc/mtrace-impl.c.  */
+#define TRACE_MAGIC "\177MTRACEB"
+#define TRACE_VERSION 2
+
+struct trace_header
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t record_size;
+};
+
+struct trace_record
+{
+  uint64_t timestamp;
+  uint64_t ptr;
+  uint64_t size;
+  uint64_t caller;
+  uint32_t tid;
+  uint32_t op;
+  uint64_t align;
+};
+
+#define MAX_THREADS 1024
+
+enum op_type
+{
+  OP_MALLOC,
+  OP_MEMALIGN,
+  OP_REALLOC,
+  OP_FREE
+};
+
+/* Slot 0 means no block.  Every allocation in the trace gets a slot of
+   its own, which holds the replayed pointer while the block is live.  */
+struct replay_op
+{
+  uint32_t type;
+  uint32_t old_slot;
+  uint32_t new_slot;
+  uint64_t align;
+  uint64_t size;
+};
+
+struct replay_thread
+{
+  uint32_t tid;
+  size_t nops;
+  struct replay_op *ops;
+  pthread_t thread;
+  timing_t start;
+  timing_t stop;
+};
+
+static struct replay_thread threads[MAX_THREADS];
+static size_t nthreads;
+static void **slots;
+static size_t nslots;
+static size_t pagesize;
+static pthread_barrier_t start_barrier;
+
+/* Marks a slot whose allocation failed during the replay.  */
+#define FAILED_BLOCK ((void *) 1)
+
+static void *
+xmmap (size_t size)
+{
+  void *p = mmap (NULL, size, PROT_READ | PROT_WRITE,
+		  MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (p == MAP_FAILED)
+    {
+      perror ("mmap");
+      exit (1);
+    }
+  return p;
+}
+
+/* Sort by timestamp.  CALLER has been overwritten with the position of
+   the record in the file, which keeps records with equal timestamps in
+   their original order.  */
+static int
+record_cmp (const void *a, const void *b)
+{
+  const struct trace_record *ra = a, *rb = b;
+
+  if (ra->timestamp != rb->timestamp)
+    return ra->timestamp < rb->timestamp ? -1 : 1;
+  return ra->caller < rb->caller ? -1 : ra->caller > rb->caller;
+}
+
+static struct replay_thread *
+find_thread (uint32_t tid)
+{
+  static struct replay_thread *last;
+
+  if (last != NULL && last->tid == tid)
+    return last;
+  for (size_t i = 0; i < nthreads; i++)
+    if (threads[i].tid == tid)
+      return last = &threads[i];
+  if (nthreads == MAX_THREADS)
+    {
+      fprintf (stderr, "too many threads in trace\n");
+      exit (1);
+    }
+  last = &threads[nthreads++];
+  last->tid = tid;
+  return last;
+}
+
+/* Map traced addresses of live blocks to slots.  */
+static uint32_t *hash_heads;
+static uint32_t *slot_next;
+static uint64_t *slot_addr;
+static uint64_t *slot_size;
+static size_t hash_mask;
+
+static size_t
+hash_addr (uint64_t addr)
+{
+  return (addr >> 4) * UINT64_C (0x9e3779b97f4a7c15) >> 32 & hash_mask;
+}
+
+static void
+hash_insert (uint64_t addr, uint32_t slot)
+{
+  size_t h = hash_addr (addr);
+
+  slot_addr[slot] = addr;
+  slot_next[slot] = hash_heads[h];
+  hash_heads[h] = slot;
+}
+
+/* Remove ADDR and return its slot, or 0 if it is not live (it was
+   allocated before tracing started).  */
+static uint32_t
+hash_remove (uint64_t addr)
+{
+  uint32_t *p = &hash_heads[hash_addr (addr)];
+
+  for (; *p != 0; p = &slot_next[*p])
+    if (slot_addr[*p] == addr)
+      {
+	uint32_t slot = *p;
+	*p = slot_next[slot];
+	return slot;
+      }
+  return 0;
+}
+
+static size_t peak_live_bytes;
+static size_t total_ops;
+
+static void
+load_trace (const char *name)
+{
+  int fd = open (name, O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat (fd, &st) != 0)
+    {
+      perror (name);
+      exit (1);
+    }
+
+  struct trace_header header;
+  if (read (fd, &header, sizeof (header)) != sizeof (header)
+      || memcmp (header.magic, TRACE_MAGIC, sizeof (header.magic)) != 0)
+    {
+      fprintf (stderr, "%s: not a binary mtrace file\n", name);
+      exit (1);
+    }
+  if (header.version != TRACE_VERSION
+      || header.record_size != sizeof (struct trace_record))
+    {
+      fprintf (stderr, "%s: unsupported binary mtrace version %u\n", name,
+	       header.version);
+      exit (1);
+    }
+
+  /* A private mapping, so the records can be sorted in place.  */
+  size_t nrecords = (st.st_size - sizeof (header)) / header.record_size;
+  char *map = mmap (NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+		    fd, 0);
+  if (map == MAP_FAILED)
+    {
+      perror ("mmap");
+      exit (1);
+    }
+  close (fd);
+  struct trace_record *recs = (struct trace_record *) (map + sizeof (header));
+
+  for (size_t i = 0; i < nrecords; i++)
+    recs[i].caller = i;
+  qsort (recs, nrecords, sizeof (*recs), record_cmp);
+
+  /* First pass: count the operations of each thread.  */
+  for (size_t i = 0; i < nrecords; i++)
+    find_thread (recs[i].tid)->nops++;
+  for (size_t i = 0; i < nthreads; i++)
+    {
+      threads[i].ops = xmmap (threads[i].nops * sizeof (struct replay_op));
+      threads[i].nops = 0;
+    }
+
+  size_t nbuckets = 1;
+  while (nbuckets < nrecords)
+    nbuckets <<= 1;
+  hash_mask = nbuckets - 1;
+  hash_heads = xmmap (nbuckets * sizeof (uint32_t));
+  slot_next = xmmap ((nrecords + 1) * sizeof (uint32_t));
+  slot_addr = xmmap ((nrecords + 1) * sizeof (uint64_t));
+  slot_size = xmmap ((nrecords + 1) * sizeof (uint64_t));
+  nslots = 1;
+
+  size_t live = 0;
+  for (size_t i = 0; i < nrecords; i++)
+    {
+      const struct trace_record *r = &recs[i];
+      struct replay_thread *t = find_thread (r->tid);
+      struct replay_op *op = &t->ops[t->nops];
+
+      /* A '>' completes the operation started by the preceding '<'.  */
+      if (r->op != '>')
+	memset (op, 0, sizeof (*op));
+      switch (r->op)
+	{
+	case '+':
+	  if (r->ptr == 0)
+	    continue;
+	  op->type = r->align != 0 ? OP_MEMALIGN : OP_MALLOC;
+	  op->align = r->align;
+	  break;
+	case '-':
+	  op->type = OP_FREE;
+	  op->old_slot = hash_remove (r->ptr);
+	  if (op->old_slot == 0)
+	    continue;
+	  live -= slot_size[op->old_slot];
+	  t->nops++;
+	  continue;
+	case '<':
+	  /* Always followed by the matching '>' of the same thread.  */
+	  op->type = OP_REALLOC;
+	  op->old_slot = hash_remove (r->ptr);
+	  if (op->old_slot != 0)
+	    live -= slot_size[op->old_slot];
+	  continue;
+	case '>':
+	  if (op->type != OP_REALLOC)
+	    continue;
+	  break;
+	default:
+	  /* Failed reallocations do not change the heap.  */
+	  continue;
+	}
+
+      op->new_slot = nslots++;
+      op->size = r->size;
+      slot_size[op->new_slot] = r->size;
+      hash_insert (r->ptr, op->new_slot);
+      live += r->size;
+      if (live > peak_live_bytes)
+	peak_live_bytes = live;
+      t->nops++;
+    }
+
+  for (size_t i = 0; i < nthreads; i++)
+    total_ops += threads[i].nops;
+
+  munmap (map, st.st_size);
+  munmap (hash_heads, nbuckets * sizeof (uint32_t));
+  munmap (slot_next, (nrecords + 1) * sizeof (uint32_t));
+  munmap (slot_addr, (nrecords + 1) * sizeof (uint64_t));
+  munmap (slot_size, (nrecords + 1) * sizeof (uint64_t));
+
+  slots = xmmap (nslots * sizeof (void *));
+}
+
+/* Wait until the block in SLOT has been allocated by its thread.  */
+static void *
+take_block (uint32_t slot)
+{
+  void *p;
+
+  for (int spins = 0;
+       (p = __atomic_load_n (&slots[slot], __ATOMIC_ACQUIRE)) == NULL;
+       spins++)
+    if (spins > 100)
+      sched_yield ();
+  slots[slot] = NULL;
+  return p == FAILED_BLOCK ? NULL : p;
+}
+
+/* Write to every page of a new block so that the resident set reflects
+   the memory the allocator handed out.  */
+static void
+touch_block (char *p, size_t size)
+{
+  for (size_t off = 0; off < size; off += pagesize)
+    p[off] = 1;
+}
+
+static void *
+replay_thread (void *closure)
+{
+  struct replay_thread *t = closure;
+
+  pthread_barrier_wait (&start_barrier);
+  TIMING_NOW (t->start);
+
+  for (size_t i = 0; i < t->nops; i++)
+    {
+      const struct replay_op *op = &t->ops[i];
+      void *old = op->old_slot != 0 ? take_block (op->old_slot) : NULL;
+      void *p;
+
+      switch (op->type)
+	{
+	case OP_FREE:
+	  free (old);
+	  continue;
+	case OP_MALLOC:
+	  p = malloc (op->size);
+	  break;
+	case OP_MEMALIGN:
+	  p = memalign (op->align, op->size);
+	  break;
+	default:
+	  p = realloc (old, op->size);
+	  break;
+	}
+      if (p != NULL)
+	touch_block (p, op->size);
+      else
+	p = FAILED_BLOCK;
+      __atomic_store_n (&slots[op->new_slot], p, __ATOMIC_RELEASE);
+    }
+
+  TIMING_NOW (t->stop);
+  return NULL;
+}
+
+static void
+usage (const char *name)
+{
+  fprintf (stderr, "%s: <trace file>\n", name);
+  exit (1);
+}
+
+int
+main (int argc, char **argv)
+{
+  if (argc != 2)
+    usage (argv[0]);
+
+  pagesize = sysconf (_SC_PAGESIZE);
+  load_trace (argv[1]);
+
+  struct rusage usage_before, usage_after;
+
+  pthread_barrier_init (&start_barrier, NULL, nthreads + 1);
+  for (size_t i = 0; i < nthreads; i++)
+    {
+      int err = pthread_create (&threads[i].thread, NULL, replay_thread,
+				&threads[i]);
+      if (err != 0)
+	{
+	  errno = err;
+	  perror ("pthread_create");
+	  exit (1);
+	}
+    }
+
+  getrusage (RUSAGE_SELF, &usage_before);
+  pthread_barrier_wait (&start_barrier);
+  for (size_t i = 0; i < nthreads; i++)
+    pthread_join (threads[i].thread, NULL);
+  getrusage (RUSAGE_SELF, &usage_after);
+
+  /* The replay runs from the first thread starting to the last one
+     finishing; THREAD_TIME is the sum of the time of every thread.  */
+  timing_t start = threads[0].start, stop = threads[0].stop;
+  timing_t elapsed, thread_time = 0;
+  for (size_t i = 0; i < nthreads; i++)
+    {
+      TIMING_DIFF (elapsed, threads[i].start, threads[i].stop);
+      thread_time += elapsed;
+      if (threads[i].start < start)
+	start = threads[i].start;
+      if (threads[i].stop > stop)
+	stop = threads[i].stop;
+    }
+  TIMING_DIFF (elapsed, start, stop);
+
+  /* The heap as the workload left it, before the blocks still live at
+     the end of the trace are released.  */
+  struct mallinfo2 mi = mallinfo2 ();
+  size_t heap_size = mi.arena + mi.hblkhd;
+  size_t heap_in_use = mi.uordblks + mi.hblkhd;
+
+  for (size_t i = 1; i < nslots; i++)
+    if (slots[i] != FAILED_BLOCK)
+      free (slots[i]);
+
+  json_ctx_t json_ctx;
+
+  json_init (&json_ctx, 0, stdout);
+
+  json_document_begin (&json_ctx);
+
+  json_attr_string (&json_ctx, "timing_type", TIMING_TYPE);
+
+  json_attr_object_begin (&json_ctx, "functions");
+
+  json_attr_object_begin (&json_ctx, "malloc");
+
+  json_attr_object_begin (&json_ctx, "");
+  json_attr_string (&json_ctx, "trace", argv[1]);
+  json_attr_double (&json_ctx, "threads", nthreads);
+  json_attr_double (&json_ctx, "operations", total_ops);
+  json_attr_double (&json_ctx, "duration", elapsed);
+  json_attr_double (&json_ctx, "time_per_op",
+		    total_ops != 0 ? (double) elapsed / total_ops : 0);
+
+  json_attr_double (&json_ctx, "thread_time", thread_time);
+
+  json_attr_double (&json_ctx, "max_rss", usage_after.ru_maxrss);
+  json_attr_double (&json_ctx, "max_rss_growth",
+		    usage_after.ru_maxrss - usage_before.ru_maxrss);
+  json_attr_double (&json_ctx, "peak_live_bytes", peak_live_bytes);
+  json_attr_double (&json_ctx, "heap_size", heap_size);
+  json_attr_double (&json_ctx, "heap_in_use", heap_in_use);
+  json_attr_double (&json_ctx, "fragmentation",
+		    heap_size != 0
+		    ? 1.0 - (double) heap_in_use / heap_size : 0);
+
+  json_attr_object_end (&json_ctx);
+
+  json_attr_object_end (&json_ctx);
+
+  json_attr_object_end (&json_ctx);
+
+  json_document_end (&json_ctx);
+
+  return 0;
+}
@@ -17,6 +17,7 @@
    <https://www.gnu.org/licenses/>.  */
 
 #include <errno.h>
+#include <malloc.h>
 #include <math.h>
 #include <pthread.h>
 #include <signal.h>
@@ -145,10 +146,94 @@ malloc_benchmark_loop (void **ptr_arr)
   return iters;
 }
 
+/* Size of the bursts of same-sized allocations below, and the largest
+   block size used for them.  The sizes stay within the default tcache
+   range so that the loop measures how tcache misses and overflows are
+   served by the arenas.  */
+#define BURST_SIZE		64
+#define MAX_BURST_BLOCK_SIZE	1024
+
+/* Allocate a burst of blocks of one size, then free all of them, the way
+   object pools are warmed up and torn down.  */
+static size_t
+malloc_burst_loop (void **ptr_arr)
+{
+  unsigned int block_state = 0;
+  size_t iters = 0;
+
+  while (!timeout)
+    {
+      unsigned int next_block = (get_random_block_size (&block_state)
+				 % MAX_BURST_BLOCK_SIZE);
+
+      for (size_t i = 0; i < BURST_SIZE; i++)
+	ptr_arr[i] = malloc (next_block);
+
+      for (size_t i = 0; i < BURST_SIZE; i++)
+	free (ptr_arr[i]);
+
+      iters += BURST_SIZE;
+    }
+
+  return iters;
+}
+
+/* Size limits of the three classes of blocks of the mixed workload below,
+   which are served from the fastbins, the small bins, and the large bins
+   or the top chunk, and the number of small blocks in a burst.  */
+#define MIXED_SMALL_SIZE	128
+#define MIXED_MEDIUM_SIZE	1000
+#define MIXED_LARGE_SIZE	32768
+#define MIXED_BURST_SIZE	16
+
+/* Replace a random block of the working set, whose first half holds
+   medium blocks and whose second half holds large ones, then allocate and
+   free a burst of small blocks.  The bursts overflow the tcache, so the
+   small allocations go to the fastbins of an arena while other threads
+   allocate and free larger blocks in it, which is what happens when the
+   number of arenas is capped.  */
+static size_t
+malloc_mixed_loop (void **ptr_arr)
+{
+  unsigned int offset_state = 0, block_state = 0;
+  size_t iters = 0;
+  void *burst[MIXED_BURST_SIZE];
+
+  while (!timeout)
+    {
+      unsigned int next_idx = get_random_offset (&offset_state);
+      unsigned int r = get_random_block_size (&block_state);
+      unsigned int next_block;
+
+      if (next_idx < WORKING_SET_SIZE / 2)
+	next_block = (MIXED_SMALL_SIZE
+		      + r % (MIXED_MEDIUM_SIZE - MIXED_SMALL_SIZE));
+      else
+	next_block = (MIXED_MEDIUM_SIZE
+		      + r * 64 % (MIXED_LARGE_SIZE - MIXED_MEDIUM_SIZE));
+
+      free (ptr_arr[next_idx]);
+      ptr_arr[next_idx] = malloc (next_block);
+
+      unsigned int small_block = 16 + r % (MIXED_SMALL_SIZE - 16);
+      for (size_t i = 0; i < MIXED_BURST_SIZE; i++)
+	burst[i] = malloc (small_block);
+      for (size_t i = 0; i < MIXED_BURST_SIZE; i++)
+	free (burst[i]);
+
+      iters += 1 + MIXED_BURST_SIZE;
+    }
+
+  return iters;
+}
+
+typedef size_t (*benchmark_loop_t) (void **);
+
 struct thread_args
 {
   size_t iters;
   void **working_set;
+  benchmark_loop_t loop;
   timing_t elapsed;
 };
 
@@ -161,7 +246,7 @@ benchmark_thread (void *arg)
   timing_t start, stop;
 
   TIMING_NOW (start);
-  iters = malloc_benchmark_loop (thread_set);
+  iters = args->loop (thread_set);
   TIMING_NOW (stop);
 
   TIMING_DIFF (args->elapsed, start, stop);
@@ -171,7 +256,7 @@ benchmark_thread (void *arg)
 }
 
 static timing_t
-do_benchmark (size_t num_threads, size_t *iters)
+do_benchmark (benchmark_loop_t loop, size_t num_threads, size_t *iters)
 {
   timing_t elapsed = 0;
 
@@ -183,7 +268,7 @@ do_benchmark (size_t num_threads, size_t *iters)
       memset (working_set, 0, sizeof (working_set));
 
       TIMING_NOW (start);
-      *iters = malloc_benchmark_loop (working_set);
+      *iters = loop (working_set);
       TIMING_NOW (stop);
 
       TIMING_DIFF (elapsed, start, stop);
@@ -201,6 +286,7 @@ do_benchmark (size_t num_threads, size_t *iters)
       for (size_t i = 0; i < num_threads; i++)
 	{
 	  args[i].working_set = working_set[i];
+	  args[i].loop = loop;
 	  pthread_create(&threads[i], NULL, benchmark_thread, &args[i]);
 	}
 
@@ -216,7 +302,7 @@ do_benchmark (size_t num_threads, size_t *iters)
 
 static void usage(const char *name)
 {
-  fprintf (stderr, "%s: <num_threads>\n", name);
+  fprintf (stderr, "%s: <num_threads> [<arena_max>]\n", name);
   exit (1);
 }
 
@@ -224,14 +310,14 @@ int
 main (int argc, char **argv)
 {
   timing_t cur;
-  size_t iters = 0, num_threads = 1;
+  size_t iters = 0, num_threads = 1, arena_max = 0;
   json_ctx_t json_ctx;
   double d_total_s, d_total_i;
   struct sigaction act;
 
   if (argc == 1)
     num_threads = 1;
-  else if (argc == 2)
+  else if (argc == 2 || argc == 3)
     {
       long ret;
 
@@ -242,6 +328,15 @@ main (int argc, char **argv)
 	usage(argv[0]);
 
       num_threads = ret;
+
+      /* Cap the number of arenas, to measure contention within them.  */
+      if (argc == 3)
+	{
+	  ret = strtol (argv[2], NULL, 10);
+	  if (errno || ret <= 0 || mallopt (M_ARENA_MAX, ret) == 0)
+	    usage (argv[0]);
+	  arena_max = ret;
+	}
     }
   else
     usage(argv[0]);
@@ -267,7 +362,7 @@ main (int argc, char **argv)
 
   alarm (BENCHMARK_DURATION);
 
-  cur = do_benchmark (num_threads, &iters);
+  cur = do_benchmark (malloc_benchmark_loop, num_threads, &iters);
 
   struct rusage usage;
   getrusage(RUSAGE_SELF, &usage);
@@ -281,12 +376,59 @@ main (int argc, char **argv)
   json_attr_double (&json_ctx, "max_rss", usage.ru_maxrss);
 
   json_attr_double (&json_ctx, "threads", num_threads);
+  json_attr_double (&json_ctx, "arena_max", arena_max);
   json_attr_double (&json_ctx, "min_size", MIN_ALLOCATION_SIZE);
   json_attr_double (&json_ctx, "max_size", MAX_ALLOCATION_SIZE);
   json_attr_double (&json_ctx, "random_seed", RAND_SEED);
 
   json_attr_object_end (&json_ctx);
 
+  /* Same-size bursts, which are dominated by the cost of moving chunks
+     between the thread cache and the arenas.  */
+  json_attr_object_begin (&json_ctx, "burst");
+
+  timeout = false;
+  alarm (BENCHMARK_DURATION);
+
+  cur = do_benchmark (malloc_burst_loop, num_threads, &iters);
+
+  d_total_s = cur;
+  d_total_i = iters;
+
+  json_attr_double (&json_ctx, "duration", d_total_s);
+  json_attr_double (&json_ctx, "iterations", d_total_i);
+  json_attr_double (&json_ctx, "time_per_iteration", d_total_s / d_total_i);
+
+  json_attr_double (&json_ctx, "threads", num_threads);
+  json_attr_double (&json_ctx, "burst_size", BURST_SIZE);
+  json_attr_double (&json_ctx, "max_size", MAX_BURST_BLOCK_SIZE);
+
+  json_attr_object_end (&json_ctx);
+
+  /* Small, medium and large blocks allocated together.  */
+  json_attr_object_begin (&json_ctx, "mixed");
+
+  timeout = false;
+  alarm (BENCHMARK_DURATION);
+
+  cur = do_benchmark (malloc_mixed_loop, num_threads, &iters);
+
+  d_total_s = cur;
+  d_total_i = iters;
+
+  json_attr_double (&json_ctx, "duration", d_total_s);
+  json_attr_double (&json_ctx, "iterations", d_total_i);
+  json_attr_double (&json_ctx, "time_per_iteration", d_total_s / d_total_i);
+
+  json_attr_double (&json_ctx, "threads", num_threads);
+  json_attr_double (&json_ctx, "arena_max", arena_max);
+  json_attr_double (&json_ctx, "small_size", MIXED_SMALL_SIZE);
+  json_attr_double (&json_ctx, "medium_size", MIXED_MEDIUM_SIZE);
+  json_attr_double (&json_ctx, "large_size", MIXED_LARGE_SIZE);
+  json_attr_double (&json_ctx, "burst_size", MIXED_BURST_SIZE);
+
+  json_attr_object_end (&json_ctx);
+
   json_attr_object_end (&json_ctx);
 
   json_attr_object_end (&json_ctx);
@@ -411,6 +411,237 @@ test_consumer_producer (long iters, int filler)
   return cur;
 }
 
+/* Mutex or rwlock kind and number of threads used by the contended
+   tests.  test_barrier uses the number of threads too.  */
+static int contended_kind;
+static int contended_threads;
+static pthread_barrier_t contended_barrier;
+
+typedef struct Contended_Params {
+  long iters;
+  int filler;
+  void (*body) (long iters, int filler);
+} Contended_Params;
+
+static void *
+contended_thread (void *v)
+{
+  Contended_Params *p = (Contended_Params *) v;
+
+  pthread_barrier_wait (&contended_barrier);
+  p->body (p->iters, p->filler);
+
+  return NULL;
+}
+
+/* Run BODY with ITERS and FILLER in NTHREADS threads.  Unlike the other
+   tests this measures throughput: the time runs from the moment all
+   threads are released until the last one has finished.  */
+static timing_t
+run_contended (int nthreads, void (*body) (long, int), long iters,
+	       int filler)
+{
+  timing_t start, stop, cur;
+  pthread_t helper_ids[nthreads];
+  Contended_Params p;
+
+  p.iters = iters;
+  p.filler = filler;
+  p.body = body;
+
+  pthread_barrier_init (&contended_barrier, NULL, nthreads + 1);
+  for (int i = 0; i < nthreads; i++)
+    pthread_create (&helper_ids[i], NULL, contended_thread, &p);
+
+  TIMING_NOW (start);
+  pthread_barrier_wait (&contended_barrier);
+  for (int i = 0; i < nthreads; i++)
+    pthread_join (helper_ids[i], NULL);
+  TIMING_NOW (stop);
+  TIMING_DIFF (cur, start, stop);
+
+  pthread_barrier_destroy (&contended_barrier);
+  return cur;
+}
+
+static void
+mutex_contended_body (long iters, int filler)
+{
+  for (long j = iters; j >= 0; --j)
+    {
+      pthread_mutex_lock (&m);
+      FILLER_GOES_HERE;
+      pthread_mutex_unlock (&m);
+    }
+}
+
+/* CONTENDED_THREADS threads share ITERS lock/unlock pairs of a mutex of
+   kind CONTENDED_KIND.  */
+static timing_t
+test_mutex_contended (long iters, int filler)
+{
+  timing_t cur;
+  pthread_mutexattr_t attr;
+
+  pthread_mutexattr_init (&attr);
+  pthread_mutexattr_settype (&attr, contended_kind);
+  pthread_mutex_init (&m, &attr);
+  pthread_mutexattr_destroy (&attr);
+
+  cur = run_contended (contended_threads, mutex_contended_body,
+		       iters / contended_threads, filler);
+
+  pthread_mutex_destroy (&m);
+  return cur;
+}
+
+/* Run BODY in CONTENDED_THREADS threads, which share ITERS lock/unlock
+   pairs of an rwlock of kind CONTENDED_KIND.  */
+static timing_t
+run_rwlock_contended (void (*body) (long, int), long iters, int filler)
+{
+  timing_t cur;
+  pthread_rwlockattr_t attr;
+
+  pthread_rwlockattr_init (&attr);
+  pthread_rwlockattr_setkind_np (&attr, contended_kind);
+  pthread_rwlock_init (&rw, &attr);
+  pthread_rwlockattr_destroy (&attr);
+
+  cur = run_contended (contended_threads, body, iters / contended_threads,
+		       filler);
+
+  pthread_rwlock_destroy (&rw);
+  return cur;
+}
+
+static void
+rwlock_read_contended_body (long iters, int filler)
+{
+  for (long j = iters; j >= 0; --j)
+    {
+      pthread_rwlock_rdlock (&rw);
+      FILLER_GOES_HERE;
+      pthread_rwlock_unlock (&rw);
+    }
+}
+
+/* Like test_mutex_contended, but the threads only take read locks.  */
+static timing_t
+test_rwlock_read_contended (long iters, int filler)
+{
+  return run_rwlock_contended (rwlock_read_contended_body, iters, filler);
+}
+
+static void
+rwlock_write_contended_body (long iters, int filler)
+{
+  for (long j = iters; j >= 0; --j)
+    {
+      pthread_rwlock_wrlock (&rw);
+      FILLER_GOES_HERE;
+      pthread_rwlock_unlock (&rw);
+    }
+}
+
+/* Like test_mutex_contended, but the threads take write locks.  */
+static timing_t
+test_rwlock_write_contended (long iters, int filler)
+{
+  return run_rwlock_contended (rwlock_write_contended_body, iters, filler);
+}
+
+static sem_t ping_sem, pong_sem;
+
+static void *
+test_sem_pingpong_helper (void *v)
+{
+  Producer_Params *p = (Producer_Params *) v;
+  long iters = p->iters;
+  int filler = p->filler;
+
+  for (long j = iters; j >= 0; --j)
+    {
+      sem_wait (&ping_sem);
+      FILLER_GOES_HERE;
+      sem_post (&pong_sem);
+    }
+
+  return NULL;
+}
+
+/* Two threads hand a token back and forth through two semaphores, so
+   every sem_wait has to wait for the other thread.  With
+   GLIBC_TUNABLES=glibc.pthread.wait_spin_count=0 the waits block right
+   away, which shows the effect of spinning on short hand-overs.  This
+   also applies to the condvar, consumer_producer and contended rwlock
+   tests.  */
+static timing_t
+test_sem_pingpong (long iters, int filler)
+{
+  timing_t start, stop, cur;
+  pthread_t helper_id;
+  Producer_Params p;
+
+  p.iters = iters;
+  p.filler = filler;
+
+  sem_init (&ping_sem, 0, 0);
+  sem_init (&pong_sem, 0, 0);
+  pthread_create (&helper_id, NULL, test_sem_pingpong_helper, &p);
+
+  TIMING_NOW (start);
+  for (long j = iters; j >= 0; --j)
+    {
+      sem_post (&ping_sem);
+      sem_wait (&pong_sem);
+      FILLER_GOES_HERE;
+    }
+  TIMING_NOW (stop);
+  TIMING_DIFF (cur, start, stop);
+
+  pthread_join (helper_id, NULL);
+  sem_destroy (&ping_sem);
+  sem_destroy (&pong_sem);
+  return cur;
+}
+
+/* Whether test_barrier uses a process-shared barrier.  */
+static int barrier_pshared;
+static pthread_barrier_t b;
+
+static void
+barrier_body (long iters, int filler)
+{
+  for (long j = iters; j >= 0; --j)
+    {
+      FILLER_GOES_HERE;
+      pthread_barrier_wait (&b);
+    }
+}
+
+/* CONTENDED_THREADS threads go through ITERS rounds of a barrier, which
+   is process-shared if BARRIER_PSHARED.  The time is per round, not per
+   thread.  */
+static timing_t
+test_barrier (long iters, int filler)
+{
+  timing_t cur;
+  pthread_barrierattr_t attr;
+
+  pthread_barrierattr_init (&attr);
+  pthread_barrierattr_setpshared (&attr, barrier_pshared
+				  ? PTHREAD_PROCESS_SHARED
+				  : PTHREAD_PROCESS_PRIVATE);
+  pthread_barrier_init (&b, &attr, contended_threads);
+  pthread_barrierattr_destroy (&attr);
+
+  cur = run_contended (contended_threads, barrier_body, iters, filler);
+
+  pthread_barrier_destroy (&b);
+  return cur;
+}
+
 /* Number of runs we use for computing mean and standard deviation.
    We actually do two additional runs and discard the outliers.  */
 #define RUN_COUNT 10
@@ -541,6 +772,86 @@ do_bench (void)
   BENCH (sem_trywait);
   BENCH (condvar);
   BENCH (consumer_producer);
+  BENCH (sem_pingpong);
+
+  static const struct
+  {
+    const char *name;
+    int kind;
+  } contended_kinds[] =
+    {
+      { "mutex_normal", PTHREAD_MUTEX_NORMAL },
+      { "mutex_adaptive", PTHREAD_MUTEX_ADAPTIVE_NP },
+      { "mutex_queued", PTHREAD_MUTEX_QUEUED_NP },
+    };
+
+  for (int i = 0; i < sizeof (contended_kinds) / sizeof (contended_kinds[0]);
+       i++)
+    for (int threads = 32; threads <= 128; threads *= 2)
+      {
+	char name[64];
+	snprintf (name, sizeof name, "%s_contended_%d",
+		  contended_kinds[i].name, threads);
+	contended_kind = contended_kinds[i].kind;
+	contended_threads = threads;
+	rv += do_bench_1 (name, test_mutex_contended, &json_ctx);
+      }
+
+  static const struct
+  {
+    const char *name;
+    int kind;
+  } rwlock_kinds[] =
+    {
+      { "rwlock_read_reader", PTHREAD_RWLOCK_PREFER_READER_NP },
+      { "rwlock_read_distributed", PTHREAD_RWLOCK_DISTRIBUTED_READERS_NP },
+    };
+
+  for (int i = 0; i < sizeof (rwlock_kinds) / sizeof (rwlock_kinds[0]); i++)
+    for (int threads = 8; threads <= 128; threads *= 4)
+      {
+	char name[64];
+	snprintf (name, sizeof name, "%s_contended_%d",
+		  rwlock_kinds[i].name, threads);
+	contended_kind = rwlock_kinds[i].kind;
+	contended_threads = threads;
+	rv += do_bench_1 (name, test_rwlock_read_contended, &json_ctx);
+      }
+
+  static const struct
+  {
+    const char *name;
+    int kind;
+  } rwlock_write_kinds[] =
+    {
+      { "rwlock_write_reader", PTHREAD_RWLOCK_PREFER_READER_NP },
+      { "rwlock_write_writer",
+	PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP },
+    };
+
+  for (int i = 0;
+       i < sizeof (rwlock_write_kinds) / sizeof (rwlock_write_kinds[0]); i++)
+    for (int threads = 2; threads <= 32; threads *= 4)
+      {
+	char name[64];
+	snprintf (name, sizeof name, "%s_contended_%d",
+		  rwlock_write_kinds[i].name, threads);
+	contended_kind = rwlock_write_kinds[i].kind;
+	contended_threads = threads;
+	rv += do_bench_1 (name, test_rwlock_write_contended, &json_ctx);
+      }
+
+  /* Process-shared barriers never use the wake-up tree, so they serve as
+     the baseline for private ones.  */
+  for (barrier_pshared = 0; barrier_pshared <= 1; barrier_pshared++)
+    for (int threads = 8; threads <= 128; threads *= 4)
+      {
+	char name[64];
+	snprintf (name, sizeof name, "barrier_%s_%d",
+		  barrier_pshared ? "shared" : "private", threads);
+	contended_threads = threads;
+	rv += do_bench_1 (name, test_barrier, &json_ctx);
+      }
 
   json_attr_object_end (&json_ctx);
 
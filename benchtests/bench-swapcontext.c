@@ -0,0 +1,96 @@
+/* Measure the cost of switching user contexts.
+   Copyright (C) 2021 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+#define TEST_MAIN
+#define TEST_NAME "swapcontext"
+
+#include <errno.h>
+#include <stdio.h>
+#include <ucontext.h>
+#include "bench-timing.h"
+
+#undef INNER_LOOP_ITERS
+#define INNER_LOOP_ITERS 1048576
+
+static ucontext_t main_uc;
+static ucontext_t fiber_uc;
+static char fiber_stack[64 * 1024];
+
+/* The function the context switches are made with, swapcontext or
+   swapcontext_nosig.  */
+static int (*swap) (ucontext_t *, const ucontext_t *);
+
+/* Switch back to the main context every time it switches here.  */
+static void
+fiber (void)
+{
+  while (1)
+    swap (&fiber_uc, &main_uc);
+}
+
+/* Measure ITERS round trips between the main context and the fiber,
+   which are two context switches each.  */
+static void
+bench_swap (const char *name, int (*fn) (ucontext_t *, const ucontext_t *),
+	    size_t iters)
+{
+  timing_t start, stop, cur;
+
+  swap = fn;
+  printf ("%-18s:", name);
+  TIMING_NOW (start);
+  for (size_t i = 0; i < iters; ++i)
+    swap (&main_uc, &fiber_uc);
+  TIMING_NOW (stop);
+
+  TIMING_DIFF (cur, start, stop);
+  TIMING_PRINT_MEAN ((double) cur, (double) (2 * iters));
+  putchar ('\n');
+}
+
+int
+do_bench (void)
+{
+  if (getcontext (&fiber_uc) != 0)
+    {
+      printf ("getcontext failed: %m\n");
+      return 1;
+    }
+  fiber_uc.uc_stack.ss_sp = fiber_stack;
+  fiber_uc.uc_stack.ss_size = sizeof (fiber_stack);
+  fiber_uc.uc_link = NULL;
+  makecontext (&fiber_uc, fiber, 0);
+
+  /* Start the fiber, so that the loops below resume it where it
+     switches back.  */
+  swap = swapcontext;
+  swap (&main_uc, &fiber_uc);
+
+  bench_swap ("swapcontext", swapcontext, INNER_LOOP_ITERS / 16);
+
+  if (swapcontext_nosig (&main_uc, &fiber_uc) != 0 && errno == ENOSYS)
+    puts ("swapcontext_nosig : not supported");
+  else
+    bench_swap ("swapcontext_nosig", swapcontext_nosig, INNER_LOOP_ITERS);
+
+  return 0;
+}
+
+#define TEST_FUNCTION do_bench ()
+
+#include "../test-skeleton.c"
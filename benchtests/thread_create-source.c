@@ -18,6 +18,7 @@
    License along with the GNU C Library; if not, see
    <https://www.gnu.org/licenses/>.  */
 
+#include <stdint.h>
 #include <stdio.h>
 #include <unistd.h>
 #include <support/xthread.h>
@@ -36,8 +37,21 @@ thread_dummy (void *arg)
   return NULL;
 }
 
+/* Write to the number of stack pages given by ARG, as a thread that does
+   some actual work would.  */
+static void *
+thread_touch (void *arg)
+{
+  size_t size = (uintptr_t) arg * pgsize;
+  volatile char buf[size];
+  for (size_t i = 0; i < size; i += pgsize)
+    buf[i] = 0;
+  return NULL;
+}
+
 static void
-thread_create (int nthreads, size_t stacksize, size_t guardsize)
+thread_create (int nthreads, size_t stacksize, size_t guardsize,
+	       size_t touch)
 {
   pthread_attr_t attr;
   xpthread_attr_init (&attr);
@@ -51,7 +65,8 @@ thread_create (int nthreads, size_t stacksize, size_t guardsize)
   pthread_t ts[nthreads];
 
   for (int i = 0; i < nthreads; i++)
-    ts[i] = xpthread_create (&attr, thread_dummy, NULL);
+    ts[i] = xpthread_create (&attr, touch == 0 ? thread_dummy : thread_touch,
+			     (void *) (uintptr_t) touch);
 
   for (int i = 0; i < nthreads; i++)
     xpthread_join (ts[i]);
@@ -31,6 +31,8 @@
 #include <fcntl.h>
 #include <ldsodefs.h>
 #include <array_length.h>
+#include <malloc-machine.h>
+#include <signal.h>
 
 #define TUNABLES_INTERNAL 1
 #include "dl-tunables.h"
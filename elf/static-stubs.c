@@ -44,3 +44,26 @@ __gcc_personality_v0 (int version __attribute__ ((unused)),
 {
   abort ();
 }
+
+/* malloc calls backtrace to record the callers of sampled allocations
+   if glibc.malloc.profile_interval is set.  These programs get no stack
+   traces.  */
+
+_Unwind_Reason_Code
+_Unwind_Backtrace (_Unwind_Trace_Fn trace __attribute__ ((unused)),
+		   void *trace_argument __attribute__ ((unused)))
+{
+  return _URC_END_OF_STACK;
+}
+
+_Unwind_Ptr
+_Unwind_GetIP (struct _Unwind_Context *context __attribute__ ((unused)))
+{
+  abort ();
+}
+
+_Unwind_Word
+_Unwind_GetCFA (struct _Unwind_Context *context __attribute__ ((unused)))
+{
+  abort ();
+}
@@ -56,10 +56,11 @@ typedef struct _heap_info
   size_t size;   /* Current size in bytes. */
   size_t mprotect_size; /* Size in bytes that has been mprotected
                            PROT_READ|PROT_WRITE.  */
+  size_t pagesize; /* Page size used when mapping this heap.  */
   /* Make sure the following data is properly aligned, particularly
      that sizeof (heap_info) + 2 * SIZE_SZ is a multiple of
      MALLOC_ALIGNMENT. */
-  char pad[-6 * SIZE_SZ & MALLOC_ALIGN_MASK];
+  char pad[-7 * SIZE_SZ & MALLOC_ALIGN_MASK];
 } heap_info;
 
 /* Get a compile-time error if the heap_info padding is not correct
@@ -72,6 +73,13 @@ extern int sanity_check_heap_info_alignment[(sizeof (heap_info)
 
 static __thread mstate thread_arena attribute_tls_model_ie;
 
+#if IS_IN (libc)
+/* CPU the calling thread ran on when it last checked the node of its
+   arena, used only if numa_nnodes is set.  The node itself is cached in
+   the numa_node member of thread_arena.  See arena_get_numa.  */
+static __thread int thread_numa_cpu attribute_tls_model_ie = -1;
+#endif
+
 /* Arena free list.  free_list_lock synchronizes access to the
    free_list variable below, and the next_free and attached_threads
    members of struct malloc_state objects.  No other locks must be
@@ -100,6 +108,35 @@ __libc_lock_define_initialized (static, list_lock);
 /* Already initialized? */
 static bool __malloc_initialized = false;
 
+/* Arenas indexed by CPU number, used instead of thread_arena when
+   glibc.malloc.arena_percpu is set.  The array is allocated once in
+   ptmalloc_init and never freed; its slots are filled lazily under
+   percpu_lock and are never cleared.  Slot 0 is the main arena.
+   percpu_lock is acquired before list_lock, which new_arena takes
+   while it is held, and no other malloc lock may be held when it is
+   acquired.  */
+#if IS_IN (libc)
+static mstate *percpu_arenas;
+static size_t percpu_narenas;
+#endif
+__libc_lock_define_initialized (static, percpu_lock);
+
+/* Number of NUMA nodes if glibc.malloc.arena_numa is set and the
+   system has more than one node, 0 otherwise.  When set, arenas are
+   tagged with the node of the thread which created them, the heaps of
+   an arena prefer its node, and threads select arenas of the node they
+   run on.  */
+static int numa_nnodes;
+
+/* NUMA node of each of the first numa_ncpus CPUs, or -1 if it is not
+   known.  Filled in ptmalloc_init if numa_nnodes is set, so that the
+   node can be derived from the CPU number malloc_getcpu reads from the
+   rseq area instead of asking the kernel.  */
+#if IS_IN (libc)
+static short *numa_cpu_nodes;
+static int numa_ncpus;
+#endif
+
 /**************************************************************************/
 
 
@@ -112,13 +149,20 @@ static bool __malloc_initialized = false;
    in the new arena. */
 
 #define arena_get(ptr, size) do { \
-      ptr = thread_arena;						      \
-      arena_lock (ptr, size);						      \
+      if (__glibc_unlikely (percpu_arenas != NULL))			      \
+        ptr = arena_get_percpu (size);					      \
+      else if (__glibc_unlikely (numa_nnodes != 0))			      \
+        ptr = arena_get_numa (size);					      \
+      else								      \
+        {								      \
+          ptr = thread_arena;						      \
+          arena_lock (ptr, size);					      \
+        }								      \
   } while (0)
 
 #define arena_lock(ptr, size) do {					      \
       if (ptr)								      \
-        __libc_lock_lock (ptr->mutex);					      \
+        arena_lock_stats (ptr);						      \
       else								      \
         ptr = arena_get2 ((size), NULL);				      \
   } while (0)
@@ -150,11 +194,14 @@ __malloc_fork_lock_parent (void)
   /* We do not acquire free_list_lock here because we completely
      reconstruct free_list in __malloc_fork_unlock_child.  */
 
+  __libc_lock_lock (percpu_lock);
   __libc_lock_lock (list_lock);
+  __libc_lock_lock (stats_lock);
 
   for (mstate ar_ptr = &main_arena;; )
     {
       __libc_lock_lock (ar_ptr->mutex);
+      __libc_lock_lock (ar_ptr->fastbin_lock);
       ar_ptr = ar_ptr->next;
       if (ar_ptr == &main_arena)
         break;
@@ -169,12 +216,15 @@ __malloc_fork_unlock_parent (void)
 
   for (mstate ar_ptr = &main_arena;; )
     {
+      __libc_lock_unlock (ar_ptr->fastbin_lock);
       __libc_lock_unlock (ar_ptr->mutex);
       ar_ptr = ar_ptr->next;
       if (ar_ptr == &main_arena)
         break;
     }
+  __libc_lock_unlock (stats_lock);
   __libc_lock_unlock (list_lock);
+  __libc_lock_unlock (percpu_lock);
 }
 
 void
@@ -192,6 +242,7 @@ __malloc_fork_unlock_child (void)
   for (mstate ar_ptr = &main_arena;; )
     {
       __libc_lock_init (ar_ptr->mutex);
+      __libc_lock_init (ar_ptr->fastbin_lock);
       if (ar_ptr != thread_arena)
         {
 	  /* This arena is no longer attached to any thread.  */
@@ -205,6 +256,9 @@ __malloc_fork_unlock_child (void)
     }
 
   __libc_lock_init (list_lock);
+  __libc_lock_init (percpu_lock);
+  __libc_lock_init (stats_lock);
+  profile_fork_child ();
 }
 
 #if HAVE_TUNABLES
@@ -224,12 +278,23 @@ TUNABLE_CALLBACK_FNDECL (set_perturb_byte, int32_t)
 TUNABLE_CALLBACK_FNDECL (set_trim_threshold, size_t)
 TUNABLE_CALLBACK_FNDECL (set_arena_max, size_t)
 TUNABLE_CALLBACK_FNDECL (set_arena_test, size_t)
+TUNABLE_CALLBACK_FNDECL (set_arena_percpu, int32_t)
+TUNABLE_CALLBACK_FNDECL (set_arena_numa, int32_t)
 #if USE_TCACHE
 TUNABLE_CALLBACK_FNDECL (set_tcache_max, size_t)
 TUNABLE_CALLBACK_FNDECL (set_tcache_count, size_t)
 TUNABLE_CALLBACK_FNDECL (set_tcache_unsorted_limit, size_t)
+TUNABLE_CALLBACK_FNDECL (set_tcache_batch, size_t)
 #endif
 TUNABLE_CALLBACK_FNDECL (set_mxfast, size_t)
+TUNABLE_CALLBACK_FNDECL (set_hugetlb, int32_t)
+TUNABLE_CALLBACK_FNDECL (set_trim_budget, size_t)
+TUNABLE_CALLBACK_FNDECL (set_stats, int32_t)
+TUNABLE_CALLBACK_FNDECL (set_profile_interval, size_t)
+TUNABLE_CALLBACK_FNDECL (set_profile_signal, int32_t)
+TUNABLE_CALLBACK_FNDECL (set_check_free_size, int32_t)
+TUNABLE_CALLBACK_FNDECL (set_mmap_cache_size, size_t)
+TUNABLE_CALLBACK_FNDECL (set_mmap_cache_age, size_t)
 #else
 /* Initialization routine. */
 #include <string.h>
@@ -276,6 +341,69 @@ libc_hidden_proto (_dl_open_hook);
 static void tcache_key_initialize (void);
 #endif
 
+#if IS_IN (libc)
+/* Allocate the per-CPU arena table.  On failure, or if the CPU count
+   is unknown, malloc keeps using per-thread arena selection.  */
+static void
+percpu_arenas_init (void)
+{
+  int n = __get_nprocs_conf ();
+  if (n < 1)
+    return;
+
+  size_t size = ALIGN_UP (n * sizeof (mstate), GLRO (dl_pagesize));
+  mstate *table = (mstate *) MMAP (0, size, PROT_READ | PROT_WRITE, 0);
+  if (table == MAP_FAILED)
+    return;
+
+  table[0] = &main_arena;
+  percpu_narenas = n;
+  percpu_arenas = table;
+}
+#endif
+
+#if IS_IN (libc)
+/* Allocate and fill numa_cpu_nodes.  On failure malloc_getnode is used
+   for every lookup.  */
+static void
+numa_cpu_nodes_init (void)
+{
+  int n = __get_nprocs_conf ();
+  if (n < 1)
+    return;
+
+  size_t size = ALIGN_UP (n * sizeof (short), GLRO (dl_pagesize));
+  short *table = (short *) MMAP (0, size, PROT_READ | PROT_WRITE, 0);
+  if (table == MAP_FAILED)
+    return;
+
+  for (int i = 0; i < n; i++)
+    table[i] = -1;
+  malloc_cpu_nodes (table, n, numa_nnodes);
+  numa_ncpus = n;
+  numa_cpu_nodes = table;
+}
+
+/* Return the NUMA node of CPU, which the calling thread runs on, or -1
+   if it cannot be determined.  */
+static int
+arena_cpu_node (int cpu)
+{
+  if (numa_cpu_nodes != NULL && cpu >= 0 && cpu < numa_ncpus
+      && numa_cpu_nodes[cpu] >= 0)
+    return numa_cpu_nodes[cpu];
+  return malloc_getnode ();
+}
+
+/* Return the NUMA node of the CPU the calling thread runs on, or -1 if
+   it cannot be determined.  */
+static int
+arena_getnode (void)
+{
+  return arena_cpu_node (malloc_getcpu ());
+}
+#endif
+
 static void
 ptmalloc_init (void)
 {
@@ -323,13 +451,27 @@ ptmalloc_init (void)
   TUNABLE_GET (mmap_max, int32_t, TUNABLE_CALLBACK (set_mmaps_max));
   TUNABLE_GET (arena_max, size_t, TUNABLE_CALLBACK (set_arena_max));
   TUNABLE_GET (arena_test, size_t, TUNABLE_CALLBACK (set_arena_test));
+  TUNABLE_GET (arena_percpu, int32_t, TUNABLE_CALLBACK (set_arena_percpu));
+  TUNABLE_GET (arena_numa, int32_t, TUNABLE_CALLBACK (set_arena_numa));
 # if USE_TCACHE
   TUNABLE_GET (tcache_max, size_t, TUNABLE_CALLBACK (set_tcache_max));
   TUNABLE_GET (tcache_count, size_t, TUNABLE_CALLBACK (set_tcache_count));
   TUNABLE_GET (tcache_unsorted_limit, size_t,
 	       TUNABLE_CALLBACK (set_tcache_unsorted_limit));
+  TUNABLE_GET (tcache_batch, size_t, TUNABLE_CALLBACK (set_tcache_batch));
 # endif
   TUNABLE_GET (mxfast, size_t, TUNABLE_CALLBACK (set_mxfast));
+  TUNABLE_GET (hugetlb, int32_t, TUNABLE_CALLBACK (set_hugetlb));
+  TUNABLE_GET (trim_budget, size_t, TUNABLE_CALLBACK (set_trim_budget));
+  TUNABLE_GET (stats, int32_t, TUNABLE_CALLBACK (set_stats));
+  TUNABLE_GET (profile_interval, size_t,
+	       TUNABLE_CALLBACK (set_profile_interval));
+  TUNABLE_GET (profile_signal, int32_t, TUNABLE_CALLBACK (set_profile_signal));
+  TUNABLE_GET (check_free_size, int32_t,
+	       TUNABLE_CALLBACK (set_check_free_size));
+  TUNABLE_GET (mmap_cache_size, size_t,
+	       TUNABLE_CALLBACK (set_mmap_cache_size));
+  TUNABLE_GET (mmap_cache_age, size_t, TUNABLE_CALLBACK (set_mmap_cache_age));
 #else
   if (__glibc_likely (_environ != NULL))
     {
@@ -389,6 +531,26 @@ ptmalloc_init (void)
         }
     }
 #endif
+
+#if IS_IN (libc)
+  if (mp_.arena_percpu)
+    percpu_arenas_init ();
+
+  /* On a single node there is nothing to group, so keep the default
+     arena selection.  */
+  if (mp_.arena_numa)
+    {
+      int nodes = malloc_numa_nodes ();
+      if (nodes > 1)
+	{
+	  numa_nnodes = nodes;
+	  numa_cpu_nodes_init ();
+	  main_arena.numa_node = arena_getnode ();
+	}
+    }
+#endif
+
+  profile_init ();
 }
 
 /* Managing heaps and arenas (for concurrent threads) */
@@ -437,13 +599,44 @@ dump_heap (heap_info *heap)
    multiple threads, but only one will succeed.  */
 static char *aligned_heap_area;
 
-/* Create a new heap.  size is automatically rounded up to a multiple
-   of the page size. */
+/* Heaps mapped with explicit huge pages are reserved with
+   MAP_NORESERVE like other heaps, so that only the part of a heap which
+   is accessible takes pages from the hugetlbfs pool.  Fault in the SIZE
+   bytes at P of such a heap when they are made accessible, so that an
+   exhausted pool makes the heap fail to grow instead of raising SIGBUS
+   on first use.  Without MADV_POPULATE_WRITE this cannot be checked,
+   and the caller has to use regular pages.  PAGESIZE is the page size
+   of the heap.  */
+static bool
+heap_populate (char *p, size_t size, size_t pagesize)
+{
+  if (pagesize == GLRO (dl_pagesize))
+    return true;
+#ifdef MADV_POPULATE_WRITE
+  return __madvise (p, size, MADV_POPULATE_WRITE) == 0;
+#else
+  return false;
+#endif
+}
+
+/* Return how much of a heap to make accessible for the first SIZE
+   bytes of it to be usable.  With transparent huge pages, whole huge
+   pages are made accessible, so that the kernel can back them with
+   huge pages from the start.  */
+static size_t
+heap_protect_size (size_t size)
+{
+  return MIN (ALIGN_UP (size, trim_pagesize ()), HEAP_MAX_SIZE);
+}
+
+/* Create a new heap mapped with pages of PAGESIZE bytes and the
+   additional mmap flags MMAP_FLAGS.  size is automatically rounded up
+   to a multiple of the page size. */
 
 static heap_info *
-new_heap (size_t size, size_t top_pad)
+alloc_new_heap (size_t size, size_t top_pad, size_t pagesize,
+		int mmap_flags)
 {
-  size_t pagesize = GLRO (dl_pagesize);
   char *p1, *p2;
   unsigned long ul;
   heap_info *h;
@@ -461,12 +654,13 @@ new_heap (size_t size, size_t top_pad)
   /* A memory region aligned to a multiple of HEAP_MAX_SIZE is needed.
      No swap space needs to be reserved for the following large
      mapping (on Linux, this is the case for all non-writable mappings
-     anyway). */
+     anyway).  */
+  int flags = mmap_flags | MAP_NORESERVE;
   p2 = MAP_FAILED;
   if (aligned_heap_area)
     {
       p2 = (char *) MMAP (aligned_heap_area, HEAP_MAX_SIZE, PROT_NONE,
-                          MAP_NORESERVE);
+                          flags);
       aligned_heap_area = NULL;
       if (p2 != MAP_FAILED && ((unsigned long) p2 & (HEAP_MAX_SIZE - 1)))
         {
@@ -476,7 +670,8 @@ new_heap (size_t size, size_t top_pad)
     }
   if (p2 == MAP_FAILED)
     {
-      p1 = (char *) MMAP (0, HEAP_MAX_SIZE << 1, PROT_NONE, MAP_NORESERVE);
+      p1 = (char *) MMAP (0, HEAP_MAX_SIZE << 1, PROT_NONE,
+			  flags);
       if (p1 != MAP_FAILED)
         {
           p2 = (char *) (((unsigned long) p1 + (HEAP_MAX_SIZE - 1))
@@ -492,7 +687,8 @@ new_heap (size_t size, size_t top_pad)
         {
           /* Try to take the chance that an allocation of only HEAP_MAX_SIZE
              is already aligned. */
-          p2 = (char *) MMAP (0, HEAP_MAX_SIZE, PROT_NONE, MAP_NORESERVE);
+          p2 = (char *) MMAP (0, HEAP_MAX_SIZE, PROT_NONE,
+			      flags);
           if (p2 == MAP_FAILED)
             return 0;
 
@@ -503,25 +699,48 @@ new_heap (size_t size, size_t top_pad)
             }
         }
     }
-  if (__mprotect (p2, size, mtag_mmap_flags | PROT_READ | PROT_WRITE) != 0)
+  size_t prot_size = heap_protect_size (size);
+  if (__mprotect (p2, prot_size, mtag_mmap_flags | PROT_READ | PROT_WRITE) != 0
+      || !heap_populate (p2, prot_size, pagesize))
     {
       __munmap (p2, HEAP_MAX_SIZE);
       return 0;
     }
+  if (mmap_flags == 0)
+    madvise_thp (p2, prot_size);
   h = (heap_info *) p2;
   h->size = size;
-  h->mprotect_size = size;
+  h->mprotect_size = prot_size;
+  h->pagesize = pagesize;
   LIBC_PROBE (memory_heap_new, 2, h, h->size);
   return h;
 }
 
+/* Create a new heap, using explicit huge pages if the glibc.malloc.hugetlb
+   tunable asks for them and regular pages otherwise.  */
+
+static heap_info *
+new_heap (size_t size, size_t top_pad)
+{
+#if HAVE_TUNABLES
+  if (__glibc_unlikely (mp_.hp_pagesize != 0))
+    {
+      heap_info *h = alloc_new_heap (size, top_pad, mp_.hp_pagesize,
+				     mp_.hp_flags);
+      if (h != NULL)
+	return h;
+    }
+#endif
+  return alloc_new_heap (size, top_pad, GLRO (dl_pagesize), 0);
+}
+
 /* Grow a heap.  size is automatically rounded up to a
    multiple of the page size. */
 
 static int
 grow_heap (heap_info *h, long diff)
 {
-  size_t pagesize = GLRO (dl_pagesize);
+  size_t pagesize = h->pagesize;
   long new_size;
 
   diff = ALIGN_UP (diff, pagesize);
@@ -531,12 +750,22 @@ grow_heap (heap_info *h, long diff)
 
   if ((unsigned long) new_size > h->mprotect_size)
     {
+      size_t prot_size = heap_protect_size (new_size);
       if (__mprotect ((char *) h + h->mprotect_size,
-                      (unsigned long) new_size - h->mprotect_size,
+                      prot_size - h->mprotect_size,
                       mtag_mmap_flags | PROT_READ | PROT_WRITE) != 0)
         return -2;
+      if (!heap_populate ((char *) h + h->mprotect_size,
+			  prot_size - h->mprotect_size, pagesize))
+	{
+	  __mprotect ((char *) h + h->mprotect_size,
+		      prot_size - h->mprotect_size, PROT_NONE);
+	  return -2;
+	}
 
-      h->mprotect_size = new_size;
+      madvise_thp ((char *) h + h->mprotect_size,
+		   prot_size - h->mprotect_size);
+      h->mprotect_size = prot_size;
     }
 
   h->size = new_size;
@@ -587,7 +816,7 @@ static int
 heap_trim (heap_info *heap, size_t pad)
 {
   mstate ar_ptr = heap->ar_ptr;
-  unsigned long pagesz = GLRO (dl_pagesize);
+  unsigned long pagesz = heap->pagesize;
   mchunkptr top_chunk = top (ar_ptr), p;
   heap_info *prev_heap;
   long new_size, top_size, top_area, extra, prev_size, misalign;
@@ -638,8 +867,10 @@ heap_trim (heap_info *heap, size_t pad)
   if (top_area < 0 || (size_t) top_area <= pad)
     return 0;
 
-  /* Release in pagesize units and round down to the nearest page.  */
-  extra = ALIGN_DOWN(top_area - pad, pagesz);
+  /* Release in pagesize units and round down to the nearest page.  Use
+     the transparent huge page size if it is larger, so that trimming
+     does not split a huge page.  */
+  extra = ALIGN_DOWN(top_area - pad, MAX (pagesz, trim_pagesize ()));
   if (extra == 0)
     return 0;
 
@@ -655,6 +886,29 @@ heap_trim (heap_info *heap, size_t pad)
   return 1;
 }
 
+/* Prefer the NUMA node of arena AV for the pages of heap H.  The whole
+   HEAP_MAX_SIZE reservation is covered, so the policy also applies to
+   the pages grow_heap makes accessible later.  */
+static void
+heap_bind_node (heap_info *h, mstate av)
+{
+  if (numa_nnodes != 0 && av->numa_node >= 0)
+    malloc_bind_node (h, HEAP_MAX_SIZE, av->numa_node);
+}
+
+/* Prefer the NUMA node of the main arena for the pages of [P, P + SIZE),
+   which sysmalloc has just added to it.  */
+static void
+main_arena_bind_node (char *p, size_t size)
+{
+  if (numa_nnodes != 0 && main_arena.numa_node >= 0)
+    {
+      char *start = PTR_ALIGN_UP (p, GLRO (dl_pagesize));
+      if (start < p + size)
+	malloc_bind_node (start, p + size - start, main_arena.numa_node);
+    }
+}
+
 /* Create a new arena with initial size "size".  */
 
 #if IS_IN (libc)
@@ -674,8 +928,11 @@ detach_arena (mstate replaced_arena)
     }
 }
 
+/* Create a new arena with initial size "size" and add it to the global
+   list.  The arena is returned unlocked, with attached_threads set to
+   one, and not yet installed as thread_arena.  */
 static mstate
-_int_new_arena (size_t size)
+new_arena (size_t size)
 {
   mstate a;
   heap_info *h;
@@ -683,19 +940,22 @@ _int_new_arena (size_t size)
   unsigned long misalign;
 
   h = new_heap (size + (sizeof (*h) + sizeof (*a) + MALLOC_ALIGNMENT),
-                mp_.top_pad);
+                heap_top_pad ());
   if (!h)
     {
       /* Maybe size is too large to fit in a single heap.  So, just try
          to create a minimally-sized arena and let _int_malloc() attempt
          to deal with the large request via mmap_chunk().  */
-      h = new_heap (sizeof (*h) + sizeof (*a) + MALLOC_ALIGNMENT, mp_.top_pad);
+      h = new_heap (sizeof (*h) + sizeof (*a) + MALLOC_ALIGNMENT,
+		    heap_top_pad ());
       if (!h)
         return 0;
     }
   a = h->ar_ptr = (mstate) (h + 1);
   malloc_init_state (a);
   a->attached_threads = 1;
+  a->numa_node = numa_nnodes != 0 ? arena_getnode () : -1;
+  heap_bind_node (h, a);
   /*a->next = NULL;*/
   a->system_mem = a->max_system_mem = h->size;
 
@@ -708,9 +968,8 @@ _int_new_arena (size_t size)
   set_head (top (a), (((char *) h + h->size) - ptr) | PREV_INUSE);
 
   LIBC_PROBE (memory_arena_new, 2, a, size);
-  mstate replaced_arena = thread_arena;
-  thread_arena = a;
   __libc_lock_init (a->mutex);
+  __libc_lock_init (a->fastbin_lock);
 
   __libc_lock_lock (list_lock);
 
@@ -724,6 +983,19 @@ _int_new_arena (size_t size)
 
   __libc_lock_unlock (list_lock);
 
+  return a;
+}
+
+static mstate
+_int_new_arena (size_t size)
+{
+  mstate a = new_arena (size);
+  if (a == NULL)
+    return NULL;
+
+  mstate replaced_arena = thread_arena;
+  thread_arena = a;
+
   __libc_lock_lock (free_list_lock);
   detach_arena (replaced_arena);
   __libc_lock_unlock (free_list_lock);
@@ -744,19 +1016,27 @@ _int_new_arena (size_t size)
 }
 
 
-/* Remove an arena from free_list.  */
+/* Remove an arena from free_list.  If NODE is not negative, only an
+   arena of that NUMA node is taken.  */
 static mstate
-get_free_list (void)
+get_free_list (int node)
 {
   mstate replaced_arena = thread_arena;
   mstate result = free_list;
   if (result != NULL)
     {
       __libc_lock_lock (free_list_lock);
+      mstate *previous = &free_list;
       result = free_list;
+      if (node >= 0)
+	while (result != NULL && result->numa_node != node)
+	  {
+	    previous = &result->next_free;
+	    result = result->next_free;
+	  }
       if (result != NULL)
 	{
-	  free_list = result->next_free;
+	  *previous = result->next_free;
 
 	  /* The arena will be attached to this thread.  */
 	  assert (result->attached_threads == 0);
@@ -799,9 +1079,10 @@ remove_from_free_list (mstate arena)
 
 /* Lock and return an arena that can be reused for memory allocation.
    Avoid AVOID_ARENA as we have already failed to allocate memory in
-   it and it is currently locked.  */
+   it and it is currently locked.  If NODE is not negative, uncontended
+   arenas of that NUMA node are preferred.  */
 static mstate
-reused_arena (mstate avoid_arena)
+reused_arena (mstate avoid_arena, int node)
 {
   mstate result;
   /* FIXME: Access to next_to_use suffers from data races.  */
@@ -812,6 +1093,17 @@ reused_arena (mstate avoid_arena)
   /* Iterate over all arenas (including those linked from
      free_list).  */
   result = next_to_use;
+  if (node >= 0)
+    do
+      {
+	if (result->numa_node == node && !__libc_lock_trylock (result->mutex))
+	  goto out;
+
+	/* FIXME: This is a data race, see _int_new_arena.  */
+	result = result->next;
+      }
+    while (result != next_to_use);
+
   do
     {
       if (!__libc_lock_trylock (result->mutex))
@@ -868,7 +1160,14 @@ arena_get2 (size_t size, mstate avoid_arena)
 
   static size_t narenas_limit;
 
-  a = get_free_list ();
+  int node = -1;
+  if (numa_nnodes != 0)
+    {
+      thread_numa_cpu = malloc_getcpu ();
+      node = arena_cpu_node (thread_numa_cpu);
+    }
+
+  a = get_free_list (node);
   if (a == NULL)
     {
       /* Nothing immediately available, so generate a new arena.  */
@@ -906,11 +1205,106 @@ arena_get2 (size_t size, mstate avoid_arena)
             catomic_decrement (&narenas);
         }
       else
-        a = reused_arena (avoid_arena);
+        {
+          /* Prefer a free arena of another node over sharing one.  */
+          if (node >= 0)
+            a = get_free_list (-1);
+          if (a == NULL)
+            a = reused_arena (avoid_arena, node);
+        }
     }
   return a;
 }
 
+/* Lock and return the arena of the calling thread, used instead of
+   arena_get if numa_nnodes is set.  As long as the thread stays on the
+   CPU it ran on when it last checked, the node cached in its arena is
+   taken to be current.  Only after a move to another CPU is the node of
+   that CPU looked up; if it differs from the node of the arena, select
+   an arena of the new node with arena_get2.  */
+static mstate
+arena_get_numa (size_t size)
+{
+  mstate a = thread_arena;
+  if (a != NULL)
+    {
+      int cpu = malloc_getcpu ();
+      if (__glibc_unlikely (cpu != thread_numa_cpu))
+	{
+	  thread_numa_cpu = cpu;
+	  int node = arena_cpu_node (cpu);
+	  if (node >= 0 && a->numa_node != node)
+	    {
+	      LIBC_PROBE (memory_arena_numa_move, 3, a, a->numa_node, node);
+	      return arena_get2 (size, NULL);
+	    }
+	}
+    }
+  arena_lock (a, size);
+  return a;
+}
+
+/* Lock and return the arena of the CPU the calling thread runs on,
+   creating it on first use.  The per-CPU arenas stay attached for the
+   lifetime of the process, so thread_arena and the free list are not
+   involved.  If the CPU cannot be determined or the arena cannot be
+   created, fall back to the regular per-thread selection.  */
+static mstate
+arena_get_percpu (size_t size)
+{
+  mstate a;
+  int cpu = malloc_getcpu ();
+
+  if (__glibc_unlikely (cpu < 0 || (size_t) cpu >= percpu_narenas))
+    {
+      a = thread_arena;
+      arena_lock (a, size);
+      return a;
+    }
+
+  a = atomic_load_acquire (&percpu_arenas[cpu]);
+  if (__glibc_likely (a != NULL))
+    {
+      arena_lock_stats (a);
+      return a;
+    }
+
+  __libc_lock_lock (percpu_lock);
+  a = percpu_arenas[cpu];
+  if (a == NULL)
+    {
+      a = new_arena (size);
+      if (a != NULL)
+	{
+	  catomic_increment (&narenas);
+	  LIBC_PROBE (memory_arena_percpu_new, 2, a, cpu);
+	  atomic_store_release (&percpu_arenas[cpu], a);
+	}
+    }
+  __libc_lock_unlock (percpu_lock);
+
+  if (a == NULL)
+    return arena_get2 (size, NULL);
+
+  __libc_lock_lock (a->mutex);
+  return a;
+}
+
+/* Return the arena of the CPU the calling thread runs on without
+   locking it, or NULL if per-CPU arenas are not used or that arena does
+   not exist yet.  */
+static mstate
+arena_percpu_current (void)
+{
+  if (percpu_arenas == NULL)
+    return NULL;
+
+  int cpu = malloc_getcpu ();
+  if (__glibc_unlikely (cpu < 0 || (size_t) cpu >= percpu_narenas))
+    return NULL;
+  return atomic_load_acquire (&percpu_arenas[cpu]);
+}
+
 /* If we don't have the main arena, then maybe the failure is due to running
    out of mmapped areas, so we can try allocating on the main arena.
    Otherwise, it is likely that sbrk() has failed and there is still a chance
@@ -935,6 +1329,12 @@ arena_get_retry (mstate ar_ptr, size_t bytes)
 }
 #endif
 
+void
+__malloc_arena_thread_init (void)
+{
+  profile_thread_init ();
+}
+
 void
 __malloc_arena_thread_freeres (void)
 {
@@ -77,6 +77,11 @@ __malloc_debug_disable (enum malloc_debug_hooks flag)
 #include "mtrace.c"
 #include "malloc-check.c"
 
+/* The glibc.malloc.hugetlb tunable callback of the malloc copy above
+   calls these.  malloc-hugepages.os is built for libc, where they are
+   hidden, so build them once more here.  */
+#include <malloc-hugepages.c>
+
 #if SHLIB_COMPAT (libc_malloc_debug, GLIBC_2_0, GLIBC_2_24)
 extern void (*__malloc_initialize_hook) (void);
 compat_symbol_reference (libc, __malloc_initialize_hook,
@@ -213,6 +218,47 @@ __debug_free (void *mem)
 }
 strong_alias (__debug_free, free)
 
+/* The size is of no use to the debugging hooks, which have their own
+   means of finding the size of a block.  */
+static void
+__debug_free_sized (void *mem, size_t size)
+{
+  __debug_free (mem);
+}
+strong_alias (__debug_free_sized, free_sized)
+
+static void
+__debug_free_aligned_sized (void *mem, size_t alignment, size_t size)
+{
+  __debug_free (mem);
+}
+strong_alias (__debug_free_aligned_sized, free_aligned_sized)
+
+/* Batches are handled block by block, so that every block goes through
+   the debugging hooks.  */
+static size_t
+__debug_malloc_batch (size_t bytes, size_t n, void **ptrs)
+{
+  size_t i;
+
+  for (i = 0; i < n; i++)
+    {
+      ptrs[i] = __debug_malloc (bytes);
+      if (ptrs[i] == NULL)
+	break;
+    }
+  return i;
+}
+strong_alias (__debug_malloc_batch, malloc_batch)
+
+static void
+__debug_free_batch (void **ptrs, size_t n)
+{
+  for (size_t i = 0; i < n; i++)
+    __debug_free (ptrs[i]);
+}
+strong_alias (__debug_free_batch, free_batch)
+
 static void *
 __debug_realloc (void *oldmem, size_t bytes)
 {
@@ -288,7 +334,7 @@ _debug_mid_memalign (size_t alignment, size_t bytes, const void *address)
   if (__is_malloc_debug_enabled (MALLOC_MCHECK_HOOK) && victim != NULL)
     victim = memalign_mcheck_after (victim, alignment, orig_bytes);
   if (__is_malloc_debug_enabled (MALLOC_MTRACE_HOOK))
-    memalign_mtrace_after (victim, orig_bytes, address);
+    memalign_mtrace_after (victim, alignment, orig_bytes, address);
 
   return victim;
 }
@@ -643,10 +689,15 @@ compat_symbol (libc_malloc_debug, malloc_set_state, malloc_set_state,
 compat_symbol (libc_malloc_debug, aligned_alloc, aligned_alloc, GLIBC_2_16);
 compat_symbol (libc_malloc_debug, calloc, calloc, GLIBC_2_0);
 compat_symbol (libc_malloc_debug, free, free, GLIBC_2_0);
+compat_symbol (libc_malloc_debug, free_aligned_sized, free_aligned_sized,
+	       GLIBC_2_35);
+compat_symbol (libc_malloc_debug, free_batch, free_batch, GLIBC_2_35);
+compat_symbol (libc_malloc_debug, free_sized, free_sized, GLIBC_2_35);
 compat_symbol (libc_malloc_debug, mallinfo2, mallinfo2, GLIBC_2_33);
 compat_symbol (libc_malloc_debug, mallinfo, mallinfo, GLIBC_2_0);
 compat_symbol (libc_malloc_debug, malloc_info, malloc_info, GLIBC_2_10);
 compat_symbol (libc_malloc_debug, malloc, malloc, GLIBC_2_0);
+compat_symbol (libc_malloc_debug, malloc_batch, malloc_batch, GLIBC_2_35);
 compat_symbol (libc_malloc_debug, malloc_stats, malloc_stats, GLIBC_2_0);
 compat_symbol (libc_malloc_debug, malloc_trim, malloc_trim, GLIBC_2_0);
 compat_symbol (libc_malloc_debug, malloc_usable_size, malloc_usable_size,
@@ -0,0 +1,463 @@
+/* Sampling heap profiler for malloc.
+   Copyright (C) 2021 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+/* If the glibc.malloc.profile_interval tunable is set and the
+   MALLOC_PROFILE environment variable names an output file prefix,
+   about one allocation in every mp_.profile_interval bytes allocated is
+   sampled.  Each thread counts down the bytes it allocates, so that
+   allocations which are not sampled only pay for a subtraction.  The
+   call stack of a sampled allocation is recorded in a hash table, from
+   which it is removed again when the allocation is freed.  A block
+   which realloc resizes stays sampled if it was sampled, and is
+   counted like a new allocation otherwise.
+
+   The sampled live allocations are written out in the heap profile
+   format of gperftools, which pprof reads, when the process exits and
+   whenever it receives the signal set with the
+   glibc.malloc.profile_signal tunable.  Each profile goes to a new file
+   named PREFIX.PID.SEQUENCE.heap.  */
+
+#include <_itoa.h>
+#include <dso_handle.h>
+#include <execinfo.h>
+#include <fcntl.h>
+#include <not-cancel.h>
+#include <random-bits.h>
+#include <signal.h>
+
+/* Maximum number of frames recorded per sample.  */
+#define PROFILE_MAX_DEPTH 32
+
+/* Number of buckets of the hash table of sampled allocations.  */
+#define PROFILE_NBUCKETS (1 << 16)
+
+/* Size of the blocks the table entries are carved from.  */
+#define PROFILE_ENTRY_BLOCK (64 * 1024)
+
+struct profile_entry
+{
+  struct profile_entry *next;
+  void *ptr;
+  size_t size;
+  int depth;
+  void *stack[PROFILE_MAX_DEPTH];
+};
+
+/* The hash table of sampled allocations, or NULL if the profiler is not
+   enabled.  free reads the bucket heads without taking profile_lock, so
+   that it only locks if the bucket of the freed pointer is in use.  */
+static struct profile_entry **profile_table;
+
+/* The prefix of the profile file names.  */
+static const char *profile_prefix;
+
+/* Unused table entries, the number of allocations sampled so far and
+   their total size, and the number of profiles written.  Protected by
+   profile_lock, which also protects the table.  */
+static struct profile_entry *profile_unused;
+static size_t profile_total_count;
+static size_t profile_total_bytes;
+static unsigned int profile_seq;
+__libc_lock_define_initialized (static, profile_lock);
+
+/* Nonzero once the profile is scheduled to be written at exit.  */
+static int profile_atexit_registered;
+
+/* Bytes the current thread allocates before its next sample.  Seeded
+   by profile_thread_init when the thread starts.  */
+static __thread size_t profile_countdown;
+
+/* Set while the current thread takes a sample, so that the memory
+   allocated by backtrace is not sampled in turn.  */
+static __thread bool profile_busy;
+
+static inline size_t
+profile_hash (void *p)
+{
+  uintptr_t h = (uintptr_t) p / MALLOC_ALIGNMENT;
+  h ^= h >> 16;
+  h *= 0x45d9f3b;
+  h ^= h >> 16;
+  return h & (PROFILE_NBUCKETS - 1);
+}
+
+/* Return the number of bytes to allocate before the next sample.  The
+   distance is randomized around the interval, so that allocation
+   patterns with a fixed period are not sampled in lockstep.  */
+static size_t
+profile_next_countdown (void)
+{
+  size_t interval = mp_.profile_interval;
+  return interval / 2 + random_bits () % interval + 1;
+}
+
+/* Return an unused table entry, or NULL if none could be allocated.
+   Called with profile_lock held.  */
+static struct profile_entry *
+profile_entry_get (void)
+{
+  if (profile_unused == NULL)
+    {
+      char *block = __mmap (NULL, PROFILE_ENTRY_BLOCK, PROT_READ | PROT_WRITE,
+			    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (block == MAP_FAILED)
+	return NULL;
+      for (size_t i = 0;
+	   i + sizeof (struct profile_entry) <= PROFILE_ENTRY_BLOCK;
+	   i += sizeof (struct profile_entry))
+	{
+	  struct profile_entry *e = (struct profile_entry *) (block + i);
+	  e->next = profile_unused;
+	  profile_unused = e;
+	}
+    }
+
+  struct profile_entry *e = profile_unused;
+  profile_unused = e->next;
+  return e;
+}
+
+/* Buffered output to the profile file, using only async-signal-safe
+   functions.  */
+struct profile_writer
+{
+  int fd;
+  size_t len;
+  char buf[1024];
+};
+
+static void
+profile_flush (struct profile_writer *w)
+{
+  char *p = w->buf;
+  while (w->len > 0)
+    {
+      ssize_t n = __write_nocancel (w->fd, p, w->len);
+      if (n <= 0)
+	break;
+      p += n;
+      w->len -= n;
+    }
+  w->len = 0;
+}
+
+static void
+profile_puts (struct profile_writer *w, const char *s)
+{
+  for (; *s != '\0'; s++)
+    {
+      if (w->len == sizeof (w->buf))
+	profile_flush (w);
+      w->buf[w->len++] = *s;
+    }
+}
+
+static void
+profile_putnum (struct profile_writer *w, uintptr_t value, unsigned int base)
+{
+  char buf[3 * sizeof (uintptr_t) + 3];
+  char *end = buf + sizeof (buf) - 1;
+  *end = '\0';
+  char *s = _itoa_word (value, end, base, 0);
+  if (base == 16)
+    {
+      *--s = 'x';
+      *--s = '0';
+    }
+  profile_puts (w, s);
+}
+
+/* Append the contents of the file NAME.  */
+static void
+profile_copy_file (struct profile_writer *w, const char *name)
+{
+  int fd = __open_nocancel (name, O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return;
+
+  profile_flush (w);
+  ssize_t n;
+  while ((n = __read_nocancel (fd, w->buf, sizeof (w->buf))) > 0)
+    {
+      w->len = n;
+      profile_flush (w);
+    }
+  __close_nocancel_nostatus (fd);
+}
+
+/* Write the sampled live allocations to a new profile file.  If
+   FROM_SIGNAL, this is called from a signal handler, and the profile is
+   skipped if the table is being updated.  */
+static void
+profile_dump (bool from_signal)
+{
+  if (from_signal)
+    {
+      if (__libc_lock_trylock (profile_lock) != 0)
+	return;
+    }
+  else
+    __libc_lock_lock (profile_lock);
+
+  struct profile_writer w;
+  w.fd = -1;
+  w.len = 0;
+  profile_puts (&w, profile_prefix);
+  profile_puts (&w, ".");
+  profile_putnum (&w, __getpid (), 10);
+  profile_puts (&w, ".");
+  profile_putnum (&w, profile_seq++, 10);
+  profile_puts (&w, ".heap");
+  w.buf[w.len] = '\0';
+
+  w.fd = __open_nocancel (w.buf, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+			  0644);
+  w.len = 0;
+  if (w.fd < 0)
+    {
+      __libc_lock_unlock (profile_lock);
+      return;
+    }
+
+  size_t count = 0;
+  size_t bytes = 0;
+  for (size_t i = 0; i < PROFILE_NBUCKETS; i++)
+    for (struct profile_entry *e = profile_table[i]; e != NULL; e = e->next)
+      {
+	count++;
+	bytes += e->size;
+      }
+
+  profile_puts (&w, "heap profile: ");
+  profile_putnum (&w, count, 10);
+  profile_puts (&w, ": ");
+  profile_putnum (&w, bytes, 10);
+  profile_puts (&w, " [");
+  profile_putnum (&w, profile_total_count, 10);
+  profile_puts (&w, ": ");
+  profile_putnum (&w, profile_total_bytes, 10);
+  profile_puts (&w, "] @ heap_v2/");
+  profile_putnum (&w, mp_.profile_interval, 10);
+  profile_puts (&w, "\n");
+
+  for (size_t i = 0; i < PROFILE_NBUCKETS; i++)
+    for (struct profile_entry *e = profile_table[i]; e != NULL; e = e->next)
+      {
+	profile_puts (&w, "1: ");
+	profile_putnum (&w, e->size, 10);
+	profile_puts (&w, " [1: ");
+	profile_putnum (&w, e->size, 10);
+	profile_puts (&w, "] @");
+	for (int j = 0; j < e->depth; j++)
+	  {
+	    profile_puts (&w, " ");
+	    profile_putnum (&w, (uintptr_t) e->stack[j], 16);
+	  }
+	profile_puts (&w, "\n");
+      }
+
+  __libc_lock_unlock (profile_lock);
+
+  /* pprof needs the mappings to symbolize the addresses.  */
+  profile_puts (&w, "\nMAPPED_LIBRARIES:\n");
+  profile_copy_file (&w, "/proc/self/maps");
+  profile_flush (&w);
+  __close_nocancel_nostatus (w.fd);
+}
+
+static void
+profile_at_exit (void *closure)
+{
+  profile_dump (false);
+}
+
+static void
+profile_signal_handler (int sig)
+{
+  int err = errno;
+  profile_dump (true);
+  __set_errno (err);
+}
+
+/* Record the allocation MEM of BYTES bytes in the table.  */
+static void __attribute_noinline__
+profile_record (void *mem, size_t bytes)
+{
+  if (profile_busy)
+    return;
+  profile_busy = true;
+
+  /* Do not record the frame of this function.  */
+  void *stack[PROFILE_MAX_DEPTH + 1];
+  int depth = __backtrace (stack, PROFILE_MAX_DEPTH + 1) - 1;
+
+  __libc_lock_lock (profile_lock);
+  struct profile_entry *e = profile_entry_get ();
+  if (e != NULL)
+    {
+      e->ptr = mem;
+      e->size = bytes;
+      e->depth = depth > 0 ? depth : 0;
+      if (e->depth > 0)
+	memcpy (e->stack, stack + 1, e->depth * sizeof (void *));
+
+      size_t h = profile_hash (mem);
+      e->next = profile_table[h];
+      atomic_store_relaxed (&profile_table[h], e);
+    }
+  profile_total_count++;
+  profile_total_bytes += bytes;
+  __libc_lock_unlock (profile_lock);
+
+  if (atomic_exchange_relaxed (&profile_atexit_registered, 1) == 0)
+    __cxa_atexit (profile_at_exit, NULL, __dso_handle);
+
+  profile_busy = false;
+}
+
+/* Restart the countdown of the thread, and record the allocation MEM
+   of BYTES bytes.  */
+static void __attribute_noinline__
+profile_sample (void *mem, size_t bytes)
+{
+  profile_countdown = profile_next_countdown ();
+  profile_record (mem, bytes);
+}
+
+/* Count the allocation MEM of BYTES bytes, and sample it if the
+   countdown of the thread has run out.  */
+static __always_inline void
+profile_malloc (void *mem, size_t bytes)
+{
+  if (__glibc_likely (profile_table == NULL) || mem == NULL)
+    return;
+
+  if (__glibc_likely (bytes < profile_countdown))
+    profile_countdown -= bytes;
+  else
+    profile_sample (mem, bytes);
+}
+
+/* Remove the allocation MEM from bucket H of the table, and return
+   whether it was there.  */
+static bool __attribute_noinline__
+profile_forget (void *mem, size_t h)
+{
+  bool found = false;
+
+  __libc_lock_lock (profile_lock);
+  struct profile_entry **pe = &profile_table[h];
+  for (struct profile_entry *e = *pe; e != NULL; pe = &e->next, e = e->next)
+    if (e->ptr == mem)
+      {
+	atomic_store_relaxed (pe, e->next);
+	e->next = profile_unused;
+	profile_unused = e;
+	found = true;
+	break;
+      }
+  __libc_lock_unlock (profile_lock);
+
+  return found;
+}
+
+/* Forget the allocation MEM, which is about to be freed or resized, if
+   it was sampled.  Return whether it was.  */
+static __always_inline bool
+profile_free (void *mem)
+{
+  if (__glibc_likely (profile_table == NULL))
+    return false;
+
+  size_t h = profile_hash (mem);
+  if (atomic_load_relaxed (&profile_table[h]) != NULL)
+    return profile_forget (mem, h);
+  return false;
+}
+
+/* Account for the block MEM of BYTES bytes which realloc returns for a
+   block which was sampled if SAMPLED.  If COUNTED, MEM comes from
+   malloc, which has counted it already.  */
+static __always_inline void
+profile_realloc (void *mem, size_t bytes, bool sampled, bool counted)
+{
+  if (__glibc_likely (profile_table == NULL) || mem == NULL)
+    return;
+
+  if (sampled)
+    {
+      /* Do not record MEM twice if malloc sampled it.  */
+      if (counted)
+	profile_free (mem);
+      profile_record (mem, bytes);
+    }
+  else if (!counted)
+    profile_malloc (mem, bytes);
+}
+
+/* Enable the profiler if it is configured.  Called from ptmalloc_init
+   after the tunables have been read.  */
+static void
+profile_init (void)
+{
+  if (mp_.profile_interval == 0)
+    return;
+
+  profile_prefix = __libc_secure_getenv ("MALLOC_PROFILE");
+  /* The file names are built in the buffer of struct profile_writer.  */
+  if (profile_prefix == NULL || *profile_prefix == '\0'
+      || strlen (profile_prefix) > 512)
+    return;
+
+  void *table = __mmap (NULL, PROFILE_NBUCKETS * sizeof (*profile_table),
+			PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+			-1, 0);
+  if (table == MAP_FAILED)
+    return;
+
+  /* Leave the signal alone if the application has taken it already.  */
+  struct sigaction sa;
+  if (mp_.profile_signal != 0
+      && __sigaction (mp_.profile_signal, NULL, &sa) == 0
+      && sa.sa_handler == SIG_DFL)
+    {
+      memset (&sa, 0, sizeof (sa));
+      sa.sa_handler = profile_signal_handler;
+      sa.sa_flags = SA_RESTART;
+      __sigaction (mp_.profile_signal, &sa, NULL);
+    }
+
+  profile_table = table;
+  profile_countdown = profile_next_countdown ();
+}
+
+/* Start the countdown of a new thread.  Threads which already run when
+   the profiler is enabled sample their first allocation instead.  */
+static void
+profile_thread_init (void)
+{
+  if (profile_table != NULL)
+    profile_countdown = profile_next_countdown ();
+}
+
+/* Called in the child after fork.  */
+static void
+profile_fork_child (void)
+{
+  __libc_lock_init (profile_lock);
+}
@@ -243,6 +243,9 @@
 /* For memory tagging.  */
 #include <libc-mtag.h>
 
+/* For huge page support.  */
+#include <malloc-hugepages.h>
+
 #include <malloc/malloc-internal.h>
 
 /* For SINGLE_THREAD_P.  */
@@ -254,6 +257,9 @@
 #include <random-bits.h>
 #include <sys/random.h>
 
+/* For the age of cached mmapped chunks.  */
+#include <time.h>
+
 /*
   Debugging:
 
@@ -624,6 +630,29 @@ libc_hidden_proto (__libc_malloc)
 void     __libc_free(void*);
 libc_hidden_proto (__libc_free)
 
+/*
+  free_sized(void* p, size_t n);
+  free_aligned_sized(void* p, size_t alignment, size_t n);
+  Like free, for a block obtained by requesting n bytes from malloc,
+  calloc or realloc, or from aligned_alloc with the given alignment.
+  The size is used to select the tcache bin without waiting for the
+  chunk header.  Passing any other size is undefined; it is diagnosed
+  only if the glibc.malloc.check_free_size tunable is set.
+*/
+void     __libc_free_sized(void*, size_t);
+void     __libc_free_aligned_sized(void*, size_t, size_t);
+
+/*
+  malloc_batch(size_t n, size_t count, void** ptrs);
+  free_batch(void** ptrs, size_t count);
+  malloc_batch allocates count blocks of n bytes each and stores them in
+  ptrs, returning how many it could allocate.  free_batch frees the
+  count blocks in ptrs, skipping null pointers.  Both take the lock of
+  an arena once for the whole batch instead of once per block.
+*/
+size_t   __libc_malloc_batch(size_t, size_t, void**);
+void     __libc_free_batch(void**, size_t);
+
 /*
   calloc(size_t n_elements, size_t element_size);
   Returns a pointer to n_elements * element_size bytes, with all locations
@@ -1105,7 +1134,19 @@ typedef struct malloc_chunk* mchunkptr;
 /* Internal routines.  */
 
 static void*  _int_malloc(mstate, size_t);
+#if IS_IN (libc)
+static void*  _int_malloc_fastbin(mstate, size_t);
+static size_t _int_malloc_batch(mstate, size_t, size_t, void **);
+#endif
+static void     remote_free_push(mstate, mchunkptr);
+static INTERNAL_SIZE_T remote_free_drain(mstate);
 static void     _int_free(mstate, mchunkptr, int);
+static void     _int_free_chunk(mstate, mchunkptr, INTERNAL_SIZE_T, int);
+static INTERNAL_SIZE_T _int_free_merge_chunk(mstate, mchunkptr,
+					     INTERNAL_SIZE_T);
+static void     _int_free_maybe_consolidate(mstate, INTERNAL_SIZE_T);
+static void     trim_slice(mstate);
+static void     trim_forget(mstate, mchunkptr);
 static void*  _int_realloc(mstate, mchunkptr, INTERNAL_SIZE_T,
 			   INTERNAL_SIZE_T);
 static void*  _int_memalign(mstate, size_t, size_t);
@@ -1633,6 +1674,8 @@ unlink_chunk (mstate av, mchunkptr p)
   if (__builtin_expect (fd->bk != p || bk->fd != p, 0))
     malloc_printerr ("corrupted double-linked list");
 
+  trim_forget (av, p);
+
   fd->bk = bk;
   bk->fd = fd;
   if (!in_smallbin_range (chunksize_nomask (p)) && p->fd_nextsize != NULL)
@@ -1661,6 +1704,14 @@ unlink_chunk (mstate av, mchunkptr p)
     }
 }
 
+/* Incremental trimming marks the free chunks whose pages it has
+   released in the word following their bin links, so that it does not
+   release them again; see trim_slice.  The mark is cleared whenever a
+   chunk outside the small bin range is placed in the unsorted bin, and
+   the chunk keeps it while it is sorted into its bin.  */
+#define trim_mark(p) \
+  (*(size_t *) ((char *) (p) + sizeof (struct malloc_chunk)))
+
 /*
    Unsorted chunks
 
@@ -1841,6 +1892,17 @@ struct malloc_state
   /* Fastbins */
   mfastbinptr fastbinsY[NFASTBINS];
 
+  /* Serializes the removal of chunks from the fastbins, which frees
+     push onto without any lock, so that malloc_fastbin can take a chunk
+     from them without the arena lock.  A thread which needs both locks
+     must acquire the arena lock first.  */
+  __libc_lock_define (, fastbin_lock);
+
+  /* Chunks freed by threads which found the arena locked.  This is a
+     lock-free stack pushed to without the lock and emptied by the lock
+     holder, see remote_free_push and remote_free_drain.  */
+  mchunkptr remote_frees;
+
   /* Base of the topmost chunk -- not otherwise kept in a bin */
   mchunkptr top;
 
@@ -1868,6 +1930,23 @@ struct malloc_state
   /* Memory allocated from the system in this arena.  */
   INTERNAL_SIZE_T system_mem;
   INTERNAL_SIZE_T max_system_mem;
+
+  /* Bytes freed into this arena since the last slice of incremental
+     trimming, the bin the next slice starts from, and the chunk in that
+     bin it resumes at, or NULL to start at the end of the bin.  See
+     trim_slice.  */
+  INTERNAL_SIZE_T trim_pending;
+  int trim_bin;
+  mchunkptr trim_cursor;
+
+  /* Freed mmapped chunks kept for reuse, most recently freed first, and
+     the total size of their mappings.  See mmap_cache_put.  */
+  mchunkptr mmap_cache;
+  INTERNAL_SIZE_T mmap_cache_size;
+
+  /* NUMA node the heaps of this arena are placed on, or -1.  Only
+     meaningful if glibc.malloc.arena_numa is in effect.  */
+  int numa_node;
 };
 
 struct malloc_par
@@ -1878,6 +1957,27 @@ struct malloc_par
   INTERNAL_SIZE_T mmap_threshold;
   INTERNAL_SIZE_T arena_test;
   INTERNAL_SIZE_T arena_max;
+  /* Nonzero if arenas are selected per CPU rather than per thread.  */
+  int arena_percpu;
+  /* Nonzero if arenas are grouped by NUMA node.  */
+  int arena_numa;
+  /* Bytes released per slice of incremental trimming, 0 if disabled.  */
+  size_t trim_budget;
+  /* Nonzero if per-thread statistics are collected.  */
+  int stats;
+  /* Average number of bytes allocated between two samples of the heap
+     profiler, 0 if it is disabled, and the signal which makes it write
+     a profile.  */
+  size_t profile_interval;
+  int profile_signal;
+  /* Nonzero if free_sized and free_aligned_sized check the size they
+     are passed against the chunk header.  */
+  int check_free_size;
+  /* Bytes of freed mmapped chunks cached per arena, 0 if the cache is
+     disabled, and the time in milliseconds after which an unused cached
+     chunk is unmapped, 0 for no limit.  */
+  size_t mmap_cache_max;
+  size_t mmap_cache_age;
 
   /* Memory map support */
   int n_mmaps;
@@ -1895,6 +1995,18 @@ struct malloc_par
   /* First address handed out by MORECORE/sbrk.  */
   char *sbrk_base;
 
+#if HAVE_TUNABLES
+  /* Transparent huge page size, if glibc.malloc.hugetlb is 1 and the
+     kernel uses transparent huge pages, else 0.  THP_MADVISE says
+     whether new memory has to be advised with MADV_HUGEPAGE for it.  */
+  INTERNAL_SIZE_T thp_pagesize;
+  bool thp_madvise;
+  /* Size of the explicit huge pages and the extra mmap flags to use for
+     mmapped chunks and heaps, or 0 to use regular pages.  */
+  INTERNAL_SIZE_T hp_pagesize;
+  int hp_flags;
+#endif
+
 #if USE_TCACHE
   /* Maximum number of buckets to use.  */
   size_t tcache_bins;
@@ -1904,6 +2016,9 @@ struct malloc_par
   /* Maximum number of chunks to remove from the unsorted list, which
      aren't used to prefill the cache.  */
   size_t tcache_unsorted_limit;
+  /* Maximum number of chunks moved between a tcache bin and an arena
+     per acquisition of the arena lock.  */
+  size_t tcache_batch;
 #endif
 };
 
@@ -1916,6 +2031,7 @@ struct malloc_par
 static struct malloc_state main_arena =
 {
   .mutex = _LIBC_LOCK_INITIALIZER,
+  .fastbin_lock = _LIBC_LOCK_INITIALIZER,
   .next = &main_arena,
   .attached_threads = 1
 };
@@ -1928,6 +2044,7 @@ static struct malloc_par mp_ =
   .n_mmaps_max = DEFAULT_MMAP_MAX,
   .mmap_threshold = DEFAULT_MMAP_THRESHOLD,
   .trim_threshold = DEFAULT_TRIM_THRESHOLD,
+  .mmap_cache_age = DEFAULT_MMAP_CACHE_AGE,
 #define NARENAS_FROM_NCORES(n) ((n) * (sizeof (long) == 4 ? 2 : 8))
   .arena_test = NARENAS_FROM_NCORES (1)
 #if USE_TCACHE
@@ -1935,7 +2052,8 @@ static struct malloc_par mp_ =
   .tcache_count = TCACHE_FILL_COUNT,
   .tcache_bins = TCACHE_MAX_BINS,
   .tcache_max_bytes = tidx2usize (TCACHE_MAX_BINS-1),
-  .tcache_unsorted_limit = 0 /* No limit.  */
+  .tcache_unsorted_limit = 0, /* No limit.  */
+  .tcache_batch = TCACHE_FILL_COUNT
 #endif
 };
 
@@ -1970,6 +2088,53 @@ malloc_init_state (mstate av)
   av->top = initial_top (av);
 }
 
+/* Ask the kernel to back the region at P of SIZE bytes with
+   transparent huge pages, if this was requested through the
+   glibc.malloc.hugetlb tunable.  */
+static inline void
+madvise_thp (void *p, INTERNAL_SIZE_T size)
+{
+#if HAVE_TUNABLES && defined MADV_HUGEPAGE
+  /* Regions smaller than a huge page cannot benefit.  */
+  if (!mp_.thp_madvise || size < mp_.thp_pagesize)
+    return;
+
+  /* madvise requires a page-aligned start address.  */
+  void *q = PTR_ALIGN_DOWN (p, GLRO (dl_pagesize));
+  size += (char *) p - (char *) q;
+
+  __madvise (q, size, MADV_HUGEPAGE);
+#endif
+}
+
+/* Return the unit in which memory is released to the system from the
+   top of the main arena.  With transparent huge pages, trimming in
+   smaller units would split a huge page on every trim.  */
+static inline size_t
+trim_pagesize (void)
+{
+#if HAVE_TUNABLES
+  if (mp_.thp_pagesize != 0)
+    return mp_.thp_pagesize;
+#endif
+  return GLRO (dl_pagesize);
+}
+
+/* Return the padding to add to a request when the heap grows, rounded
+   up to the huge page size in use, so that the new end of the heap
+   does not split a huge page.  */
+static inline size_t
+heap_top_pad (void)
+{
+#if HAVE_TUNABLES
+  if (mp_.hp_pagesize != 0)
+    return ALIGN_UP (mp_.top_pad, mp_.hp_pagesize);
+  if (mp_.thp_pagesize != 0)
+    return ALIGN_UP (mp_.top_pad, mp_.thp_pagesize);
+#endif
+  return mp_.top_pad;
+}
+
 /*
    Other internal utilities operating on mstates
  */
@@ -2003,10 +2168,214 @@ free_perturb (char *p, size_t n)
     memset (p, perturb_byte, n);
 }
 
+/* ------------------------- Statistics ------------------------------- */
+
+/* If the glibc.malloc.stats tunable is set, each thread counts its
+   allocations and some allocator events in a block allocated along with
+   its tcache.  The blocks of all threads are linked on stats_list, and
+   malloc_stats_query sums them up.  Only the owning thread writes to a
+   block, so the counters are updated with plain relaxed loads and
+   stores rather than atomic read-modify-write operations.
+
+   A thread starts counting once its tcache is set up, which happens on
+   its first call to one of the allocation functions.  The allocation
+   of the block itself is not counted, nor are the allocations of a
+   thread whose tcache could not be allocated or which is exiting.  */
+
+/* One size class for each small bin, and one for larger chunks.  */
+#define NSTATS_CLASSES (NSMALLBINS + 1)
+
+struct malloc_class_counters
+{
+  size_t nmalloc;
+  size_t nfree;
+  size_t ntcache;
+};
+
+struct malloc_thread_stats
+{
+  struct malloc_thread_stats *next;
+  struct malloc_thread_stats *prev;
+  size_t nrealloc;
+  size_t nlock_contended;
+  size_t nmmap;
+  size_t nmunmap;
+  size_t nmmap_cached;
+  size_t nmmap_reused;
+  size_t sbrk_bytes;
+  struct malloc_class_counters classes[NSTATS_CLASSES];
+};
+
+static __thread struct malloc_thread_stats *thread_stats;
+
+/* Counters of the running threads, and the sum of the counters of the
+   threads which have exited.  Both are protected by stats_lock.  */
+static struct malloc_thread_stats *stats_list;
+static struct malloc_thread_stats stats_retired;
+__libc_lock_define_initialized (static, stats_lock);
+
+static __always_inline int
+stats_class (INTERNAL_SIZE_T size)
+{
+  return in_smallbin_range (size) ? smallbin_index (size) : NSMALLBINS;
+}
+
+static __always_inline void
+stats_add (size_t *counter, size_t n)
+{
+  atomic_store_relaxed (counter, atomic_load_relaxed (counter) + n);
+}
+
+/* Add N to the FIELD counter of the current thread.  */
+#define thread_stats_add(field, n) do {					      \
+      struct malloc_thread_stats *__s = thread_stats;			      \
+      if (__glibc_unlikely (__s != NULL))				      \
+	stats_add (&__s->field, n);					      \
+  } while (0)
+
+/* Count the allocation MEM, which was served from the tcache if
+   TCACHE_HIT.  */
+static __always_inline void
+stats_count_malloc (void *mem, bool tcache_hit)
+{
+  struct malloc_thread_stats *s = thread_stats;
+  if (__glibc_likely (s == NULL) || mem == NULL)
+    return;
+
+  struct malloc_class_counters *c
+    = &s->classes[stats_class (chunksize (mem2chunk (mem)))];
+  stats_add (&c->nmalloc, 1);
+  if (tcache_hit)
+    stats_add (&c->ntcache, 1);
+}
+
+static __always_inline void
+stats_count_free (INTERNAL_SIZE_T size)
+{
+  struct malloc_thread_stats *s = thread_stats;
+  if (__glibc_likely (s == NULL))
+    return;
+
+  stats_add (&s->classes[stats_class (size)].nfree, 1);
+}
+
+/* Lock the arena AV, counting the acquisitions which have to wait for
+   another thread.  */
+static __always_inline void
+arena_lock_stats (mstate av)
+{
+  struct malloc_thread_stats *s = thread_stats;
+  if (__glibc_unlikely (s != NULL))
+    {
+      if (__libc_lock_trylock (av->mutex) == 0)
+	return;
+      stats_add (&s->nlock_contended, 1);
+    }
+  __libc_lock_lock (av->mutex);
+}
+
+/* Add the counters in FROM to those in TO.  */
+static void
+stats_accumulate (struct malloc_thread_stats *to,
+		  struct malloc_thread_stats *from)
+{
+  to->nrealloc += atomic_load_relaxed (&from->nrealloc);
+  to->nlock_contended += atomic_load_relaxed (&from->nlock_contended);
+  to->nmmap += atomic_load_relaxed (&from->nmmap);
+  to->nmunmap += atomic_load_relaxed (&from->nmunmap);
+  to->nmmap_cached += atomic_load_relaxed (&from->nmmap_cached);
+  to->nmmap_reused += atomic_load_relaxed (&from->nmmap_reused);
+  to->sbrk_bytes += atomic_load_relaxed (&from->sbrk_bytes);
+  for (int i = 0; i < NSTATS_CLASSES; i++)
+    {
+      to->classes[i].nmalloc += atomic_load_relaxed (&from->classes[i].nmalloc);
+      to->classes[i].nfree += atomic_load_relaxed (&from->classes[i].nfree);
+      to->classes[i].ntcache += atomic_load_relaxed (&from->classes[i].ntcache);
+    }
+}
+
+#if USE_TCACHE
+/* Start collecting the statistics of the current thread in S, which
+   follows its tcache.  */
+static void
+stats_register (struct malloc_thread_stats *s)
+{
+  memset (s, 0, sizeof (*s));
+
+  __libc_lock_lock (stats_lock);
+  s->next = stats_list;
+  if (stats_list != NULL)
+    stats_list->prev = s;
+  stats_list = s;
+  __libc_lock_unlock (stats_lock);
+
+  thread_stats = s;
+}
+
+/* Stop collecting the statistics of the current thread, and keep its
+   counters in stats_retired.  */
+static void
+stats_unregister (void)
+{
+  struct malloc_thread_stats *s = thread_stats;
+  if (s == NULL)
+    return;
+  thread_stats = NULL;
+
+  __libc_lock_lock (stats_lock);
+  stats_accumulate (&stats_retired, s);
+  if (s->prev != NULL)
+    s->prev->next = s->next;
+  else
+    stats_list = s->next;
+  if (s->next != NULL)
+    s->next->prev = s->prev;
+  __libc_lock_unlock (stats_lock);
+}
+#endif
+
+/* Store the sum of the counters of all threads in SUM.  */
+static void
+stats_collect (struct malloc_thread_stats *sum)
+{
+  memset (sum, 0, sizeof (*sum));
+
+  __libc_lock_lock (stats_lock);
+  stats_accumulate (sum, &stats_retired);
+  for (struct malloc_thread_stats *s = stats_list; s != NULL; s = s->next)
+    stats_accumulate (sum, s);
+  __libc_lock_unlock (stats_lock);
+}
+
+/* Return the largest request size in the size class with index I.  */
+static size_t
+stats_class_size (int i)
+{
+  if (i == NSMALLBINS)
+    return SIZE_MAX;
+  return (i - SMALLBIN_CORRECTION) * SMALLBIN_WIDTH - SIZE_SZ;
+}
+
 
 
 #include <stap-probe.h>
 
+/* ----------------------- Heap profiling ----------------------------- */
+#if IS_IN (libc)
+#include "malloc-profile.c"
+#else
+# define profile_malloc(mem, bytes)
+# define profile_realloc(mem, bytes, sampled, counted) ((void) (sampled))
+static __always_inline bool
+profile_free (void *mem)
+{
+  return false;
+}
+# define profile_init()
+# define profile_thread_init()
+# define profile_fork_child()
+#endif
+
 /* ------------------- Support for multiple arenas -------------------- */
 #include "arena.c"
 
@@ -2263,6 +2632,7 @@ do_check_malloc_state (mstate av)
 
   max_fast_bin = fastbin_index (get_max_fast ());
 
+  __libc_lock_lock (av->fastbin_lock);
   for (i = 0; i < NFASTBINS; ++i)
     {
       p = fastbin (av, i);
@@ -2295,6 +2665,7 @@ do_check_malloc_state (mstate av)
 	  p = REVEAL_PTR (p->fd);
         }
     }
+  __libc_lock_unlock (av->fastbin_lock);
 
   /* check normal bins */
   for (i = 1; i < NBINS; ++i)
@@ -2373,8 +2744,350 @@ do_check_malloc_state (mstate av)
 #endif
 
 
+/* ------------------- Cache of freed mmapped chunks ------------------- */
+
+#if IS_IN (libc)
+/* Set when sysmalloc hands out a cached chunk, which unlike a fresh
+   mapping is not known to be zeroed, and cleared by calloc.  */
+static __thread bool mmap_cache_hit;
+
+/* If the glibc.malloc.mmap_cache_size tunable is set, a freed chunk
+   which was allocated with mmap is not unmapped right away but kept in
+   the arena of the freeing thread, or the arena of its CPU if
+   glibc.malloc.arena_percpu is set, as long as the mappings cached there
+   stay within that many bytes.  When sysmalloc would map a new chunk, it
+   reuses a cached one of similar size instead, or resizes one with
+   mremap, which saves the system calls and the page faults on the pages
+   which are still mapped.  Cached chunks which have not been reused for
+   glibc.malloc.mmap_cache_age milliseconds are unmapped when the cache
+   of their arena is next used, and also by frees which take the lock of
+   that arena, so that they do not stay mapped while the arena is only
+   used for smaller chunks.  malloc_trim unmaps all of them.  An arena
+   which is not used at all keeps its cached chunks.
+
+   A cached chunk keeps its header.  The list link and the time at which
+   it was freed are stored in its user data.  The list is protected by
+   the arena lock.  Cached chunks are not counted in mp_.n_mmaps and
+   mp_.mmapped_mem.  */
+
+struct mmap_cache_entry
+{
+  mchunkptr next;
+  uint64_t freed;
+};
+
+static __always_inline struct mmap_cache_entry *
+mmap_cache_entry (mchunkptr p)
+{
+  return (struct mmap_cache_entry *) chunk2mem (p);
+}
+
+/* Return the size of the mapping of the mmapped chunk P.  */
+static __always_inline size_t
+mmap_cache_total (mchunkptr p)
+{
+  return prev_size (p) + chunksize (p);
+}
+
+/* Return the current time in milliseconds.  The coarse clock is good
+   enough for ages of that order and cheap enough to read on free.  */
+static uint64_t
+mmap_cache_now (void)
+{
+  struct __timespec64 ts;
+  __clock_gettime64 (CLOCK_MONOTONIC_COARSE, &ts);
+  return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* Unlink the chunks from the cache of AV, whose lock the caller holds,
+   which were freed more than mp_.mmap_cache_age milliseconds before NOW,
+   and those beyond the most recently freed KEEP bytes.  Return the list
+   of unlinked chunks.  */
+static mchunkptr
+mmap_cache_trim (mstate av, uint64_t now, size_t keep)
+{
+  mchunkptr *link = &av->mmap_cache;
+  size_t kept = 0;
+
+  /* The list is sorted by the time the chunks were freed.  */
+  for (mchunkptr p = *link; p != NULL; p = *link)
+    {
+      struct mmap_cache_entry *e = mmap_cache_entry (p);
+      if ((mp_.mmap_cache_age != 0 && now - e->freed > mp_.mmap_cache_age)
+	  || kept + mmap_cache_total (p) > keep)
+	break;
+      kept += mmap_cache_total (p);
+      link = &e->next;
+    }
+
+  mchunkptr stale = *link;
+  *link = NULL;
+  av->mmap_cache_size = kept;
+  return stale;
+}
+
+/* Unmap the chunks on the list P returned by mmap_cache_trim.  */
+static void
+mmap_cache_release (mchunkptr p)
+{
+  while (p != NULL)
+    {
+      mchunkptr next = mmap_cache_entry (p)->next;
+      thread_stats_add (nmunmap, 1);
+      __munmap ((char *) p - prev_size (p), mmap_cache_total (p));
+      p = next;
+    }
+}
+
+/* Keep the mmapped chunk P, which is being freed, in the cache of the
+   arena the current thread allocates from.  Return false if it has to
+   be unmapped instead.  The caller must not hold an arena lock.  */
+static bool
+mmap_cache_put (mchunkptr p)
+{
+  size_t pagesize = GLRO (dl_pagesize);
+  size_t total = mmap_cache_total (p);
+  mstate av = arena_percpu_current ();
+  if (av == NULL)
+    av = thread_arena;
+
+  /* This also rejects all chunks if the cache is disabled.  The tags of
+     a cached chunk would have to be reset when it is reused.  */
+  if (total > mp_.mmap_cache_max || av == NULL || mtag_enabled)
+    return false;
+#if HAVE_TUNABLES
+  /* Chunks which may have been mapped with huge pages cannot be resized
+     with mremap, and must not be handed out for requests which should
+     get regular pages.  */
+  if (mp_.hp_pagesize > 0 && chunksize (p) >= mp_.hp_pagesize)
+    return false;
+#endif
+
+  /* The same checks as in munmap_chunk, since the chunk is going to be
+     reused.  */
+  uintptr_t mem = (uintptr_t) chunk2mem (p);
+  uintptr_t block = (uintptr_t) p - prev_size (p);
+  if (__glibc_unlikely ((block | total) & (pagesize - 1)) != 0
+      || __glibc_unlikely (!powerof2 (mem & (pagesize - 1))))
+    malloc_printerr ("munmap_chunk(): invalid pointer");
+
+  __libc_lock_lock (av->mutex);
+  uint64_t now = mmap_cache_now ();
+  mchunkptr stale = mmap_cache_trim (av, now, mp_.mmap_cache_max - total);
+  struct mmap_cache_entry *e = mmap_cache_entry (p);
+  e->next = av->mmap_cache;
+  e->freed = now;
+  av->mmap_cache = p;
+  av->mmap_cache_size += total;
+  __libc_lock_unlock (av->mutex);
+
+  atomic_decrement (&mp_.n_mmaps);
+  atomic_add (&mp_.mmapped_mem, -total);
+  thread_stats_add (nmmap_cached, 1);
+  LIBC_PROBE (memory_mmap_cache_put, 2, p, total);
+
+  mmap_cache_release (stale);
+  return true;
+}
+
+/* Take a chunk for a request of NB bytes from the cache of AV, whose
+   lock the caller holds.  Return its user pointer, or NULL if the cache
+   is empty or the chunk could not be resized.  */
+static void *
+mmap_cache_get (mstate av, INTERNAL_SIZE_T nb)
+{
+  if (av->mmap_cache == NULL)
+    return NULL;
+#if HAVE_TUNABLES
+  if (mp_.hp_pagesize > 0 && nb >= mp_.hp_pagesize)
+    return NULL;
+#endif
+
+  mmap_cache_release (mmap_cache_trim (av, mmap_cache_now (),
+				       mp_.mmap_cache_max));
+
+  /* Use the smallest cached chunk which is large enough, but no more
+     than twice as large as needed.  As in sysmalloc_mmap, a mmapped
+     chunk has SIZE_SZ bytes of overhead beyond a normal chunk.  */
+  mchunkptr *best = NULL;
+  for (mchunkptr *link = &av->mmap_cache; *link != NULL;
+       link = &mmap_cache_entry (*link)->next)
+    {
+      INTERNAL_SIZE_T size = chunksize (*link);
+      if (size >= nb + SIZE_SZ && size / 2 <= nb
+	  && (best == NULL || size < chunksize (*best)))
+	best = link;
+    }
+
+  mchunkptr p;
+  size_t total;
+  if (best != NULL)
+    {
+      p = *best;
+      total = mmap_cache_total (p);
+      *best = mmap_cache_entry (p)->next;
+      av->mmap_cache_size -= total;
+    }
+  else
+    {
+#if HAVE_MREMAP
+      /* Resize the most recently freed chunk, whose pages are the most
+	 likely to be still resident.  */
+      p = av->mmap_cache;
+      INTERNAL_SIZE_T offset = prev_size (p);
+      size_t old_total = mmap_cache_total (p);
+      mchunkptr next = mmap_cache_entry (p)->next;
+      total = ALIGN_UP (nb + offset + SIZE_SZ, GLRO (dl_pagesize));
+      char *cp = (char *) __mremap ((char *) p - offset, old_total, total,
+				    MREMAP_MAYMOVE);
+      if (cp == MAP_FAILED)
+	return NULL;
+
+      av->mmap_cache = next;
+      av->mmap_cache_size -= old_total;
+      p = (mchunkptr) (cp + offset);
+      set_head (p, (total - offset) | IS_MMAPPED);
+#else
+      return NULL;
+#endif
+    }
+
+  int new = atomic_exchange_and_add (&mp_.n_mmaps, 1) + 1;
+  atomic_max (&mp_.max_n_mmaps, new);
+
+  unsigned long sum;
+  sum = atomic_exchange_and_add (&mp_.mmapped_mem, total) + total;
+  atomic_max (&mp_.max_mmapped_mem, sum);
+  thread_stats_add (nmmap_reused, 1);
+  LIBC_PROBE (memory_mmap_cache_get, 2, p, total);
+
+  mmap_cache_hit = true;
+  check_chunk (av, p);
+  return chunk2mem (p);
+}
+
+/* Unmap the chunks in the cache of AV, whose lock the caller holds,
+   which have not been reused for mp_.mmap_cache_age milliseconds.  */
+static void
+mmap_cache_expire (mstate av)
+{
+  if (av->mmap_cache == NULL || mp_.mmap_cache_age == 0)
+    return;
+  mmap_cache_release (mmap_cache_trim (av, mmap_cache_now (),
+				       mp_.mmap_cache_max));
+}
+
+/* Unmap all cached chunks of AV.  Return 1 if there were any.  */
+static int
+mmap_cache_flush (mstate av)
+{
+  __libc_lock_lock (av->mutex);
+  mchunkptr stale = av->mmap_cache;
+  av->mmap_cache = NULL;
+  av->mmap_cache_size = 0;
+  __libc_lock_unlock (av->mutex);
+
+  mmap_cache_release (stale);
+  return stale != NULL;
+}
+#else
+# define mmap_cache_put(p) false
+# define mmap_cache_get(av, nb) NULL
+# define mmap_cache_expire(av)
+#endif
+
 /* ----------- Routines dealing with system allocation -------------- */
 
+/*
+   Map a new chunk of at least NB bytes directly with mmap, using pages of
+   PAGESIZE bytes and the additional mmap flags EXTRA_FLAGS.  Return the
+   user pointer, or MAP_FAILED if the mapping could not be created.
+ */
+
+static void *
+sysmalloc_mmap (INTERNAL_SIZE_T nb, size_t pagesize, int extra_flags, mstate av)
+{
+  long int size;
+  INTERNAL_SIZE_T front_misalign;
+  long int correction;
+  mchunkptr p;
+
+  /*
+    Round up size to nearest page.  For mmapped chunks, the overhead is one
+    SIZE_SZ unit larger than for normal chunks, because there is no
+    following chunk whose prev_size field could be used.
+
+    See the front_misalign handling below, for glibc there is no need for
+    further alignments unless we have have high alignment.
+   */
+  if (MALLOC_ALIGNMENT == CHUNK_HDR_SZ)
+    size = ALIGN_UP (nb + SIZE_SZ, pagesize);
+  else
+    size = ALIGN_UP (nb + SIZE_SZ + MALLOC_ALIGN_MASK, pagesize);
+
+  /* Don't try if size wraps around 0.  */
+  if ((unsigned long) (size) <= (unsigned long) (nb))
+    return MAP_FAILED;
+
+  char *mm = (char *) MMAP (0, size,
+			    mtag_mmap_flags | PROT_READ | PROT_WRITE,
+			    extra_flags);
+  if (mm == MAP_FAILED)
+    return mm;
+
+  /* Explicit huge pages need no further advice.  */
+  if (extra_flags == 0)
+    madvise_thp (mm, size);
+
+  /*
+     The offset to the start of the mmapped region is stored
+     in the prev_size field of the chunk. This allows us to adjust
+     returned start address to meet alignment requirements here
+     and in memalign(), and still be able to compute proper
+     address argument for later munmap in free() and realloc().
+   */
+
+  if (MALLOC_ALIGNMENT == CHUNK_HDR_SZ)
+    {
+      /* For glibc, chunk2mem increases the address by
+	 CHUNK_HDR_SZ and MALLOC_ALIGN_MASK is
+	 CHUNK_HDR_SZ-1.  Each mmap'ed area is page
+	 aligned and therefore definitely
+	 MALLOC_ALIGN_MASK-aligned.  */
+      assert (((INTERNAL_SIZE_T) chunk2mem (mm) & MALLOC_ALIGN_MASK) == 0);
+      front_misalign = 0;
+    }
+  else
+    front_misalign = (INTERNAL_SIZE_T) chunk2mem (mm) & MALLOC_ALIGN_MASK;
+  if (front_misalign > 0)
+    {
+      correction = MALLOC_ALIGNMENT - front_misalign;
+      p = (mchunkptr) (mm + correction);
+      set_prev_size (p, correction);
+      set_head (p, (size - correction) | IS_MMAPPED);
+    }
+  else
+    {
+      p = (mchunkptr) mm;
+      set_prev_size (p, 0);
+      set_head (p, size | IS_MMAPPED);
+    }
+
+  /* update statistics */
+
+  int new = atomic_exchange_and_add (&mp_.n_mmaps, 1) + 1;
+  atomic_max (&mp_.max_n_mmaps, new);
+
+  unsigned long sum;
+  sum = atomic_exchange_and_add (&mp_.mmapped_mem, size) + size;
+  atomic_max (&mp_.max_mmapped_mem, sum);
+  thread_stats_add (nmmap, 1);
+
+  check_chunk (av, p);
+
+  return chunk2mem (p);
+}
+
 /*
    sysmalloc handles malloc cases requiring more memory from the system.
    On entry, it is assumed that av->top does not have enough
@@ -2422,83 +3135,35 @@ sysmalloc (INTERNAL_SIZE_T nb, mstate av)
       char *mm;           /* return value from mmap call*/
 
     try_mmap:
-      /*
-         Round up size to nearest page.  For mmapped chunks, the overhead
-         is one SIZE_SZ unit larger than for normal chunks, because there
-         is no following chunk whose prev_size field could be used.
+      if (av != NULL)
+	{
+	  mm = mmap_cache_get (av, nb);
+	  if (mm != NULL)
+	    return mm;
+	}
 
-         See the front_misalign handling below, for glibc there is no
-         need for further alignments unless we have have high alignment.
-       */
-      if (MALLOC_ALIGNMENT == CHUNK_HDR_SZ)
-        size = ALIGN_UP (nb + SIZE_SZ, pagesize);
-      else
-        size = ALIGN_UP (nb + SIZE_SZ + MALLOC_ALIGN_MASK, pagesize);
+#if HAVE_TUNABLES
+      /* Use explicit huge pages for requests of at least one such page
+         if glibc.malloc.hugetlb asks for them, falling back to regular
+         pages if the huge page pool is exhausted.  */
+      if (mp_.hp_pagesize > 0 && nb >= mp_.hp_pagesize)
+	{
+	  mm = sysmalloc_mmap (nb, mp_.hp_pagesize, mp_.hp_flags, av);
+	  if (mm != MAP_FAILED)
+	    return mm;
+	}
+#endif
+      mm = sysmalloc_mmap (nb, pagesize, 0, av);
+      if (mm != MAP_FAILED)
+	return mm;
       tried_mmap = true;
+    }
 
-      /* Don't try if size wraps around 0 */
-      if ((unsigned long) (size) > (unsigned long) (nb))
-        {
-          mm = (char *) (MMAP (0, size,
-			       mtag_mmap_flags | PROT_READ | PROT_WRITE, 0));
-
-          if (mm != MAP_FAILED)
-            {
-              /*
-                 The offset to the start of the mmapped region is stored
-                 in the prev_size field of the chunk. This allows us to adjust
-                 returned start address to meet alignment requirements here
-                 and in memalign(), and still be able to compute proper
-                 address argument for later munmap in free() and realloc().
-               */
-
-              if (MALLOC_ALIGNMENT == CHUNK_HDR_SZ)
-                {
-                  /* For glibc, chunk2mem increases the address by
-                     CHUNK_HDR_SZ and MALLOC_ALIGN_MASK is
-                     CHUNK_HDR_SZ-1.  Each mmap'ed area is page
-                     aligned and therefore definitely
-                     MALLOC_ALIGN_MASK-aligned.  */
-                  assert (((INTERNAL_SIZE_T) chunk2mem (mm) & MALLOC_ALIGN_MASK) == 0);
-                  front_misalign = 0;
-                }
-              else
-                front_misalign = (INTERNAL_SIZE_T) chunk2mem (mm) & MALLOC_ALIGN_MASK;
-              if (front_misalign > 0)
-                {
-                  correction = MALLOC_ALIGNMENT - front_misalign;
-                  p = (mchunkptr) (mm + correction);
-		  set_prev_size (p, correction);
-                  set_head (p, (size - correction) | IS_MMAPPED);
-                }
-              else
-                {
-                  p = (mchunkptr) mm;
-		  set_prev_size (p, 0);
-                  set_head (p, size | IS_MMAPPED);
-                }
-
-              /* update statistics */
+  /* There are no usable arenas and mmap also failed.  */
+  if (av == NULL)
+    return 0;
 
-              int new = atomic_exchange_and_add (&mp_.n_mmaps, 1) + 1;
-              atomic_max (&mp_.max_n_mmaps, new);
-
-              unsigned long sum;
-              sum = atomic_exchange_and_add (&mp_.mmapped_mem, size) + size;
-              atomic_max (&mp_.max_mmapped_mem, sum);
-
-              check_chunk (av, p);
-
-              return chunk2mem (p);
-            }
-        }
-    }
-
-  /* There are no usable arenas and mmap also failed.  */
-  if (av == NULL)
-    return 0;
-
-  /* Record incoming configuration of top */
+  /* Record incoming configuration of top */
 
   old_top = av->top;
   old_size = chunksize (old_top);
@@ -2535,9 +3200,10 @@ sysmalloc (INTERNAL_SIZE_T nb, mstate av)
           set_head (old_top, (((char *) old_heap + old_heap->size) - (char *) old_top)
                     | PREV_INUSE);
         }
-      else if ((heap = new_heap (nb + (MINSIZE + sizeof (*heap)), mp_.top_pad)))
+      else if ((heap = new_heap (nb + (MINSIZE + sizeof (*heap)), heap_top_pad ())))
         {
           /* Use a newly allocated heap.  */
+          heap_bind_node (heap, av);
           heap->ar_ptr = av;
           heap->prev = old_heap;
           av->system_mem += heap->size;
@@ -2575,7 +3241,7 @@ sysmalloc (INTERNAL_SIZE_T nb, mstate av)
 
 
     { /* Request enough space for nb + pad + overhead */
-      size = nb + mp_.top_pad + MINSIZE;
+      size = nb + heap_top_pad () + MINSIZE;
 
       /*
          If contiguous, we can subtract out existing space that we hope to
@@ -2594,7 +3260,20 @@ sysmalloc (INTERNAL_SIZE_T nb, mstate av)
          previous calls. Otherwise, we correct to page-align below.
        */
 
-      size = ALIGN_UP (size, pagesize);
+#if HAVE_TUNABLES
+      /* With transparent huge pages, end the heap on a huge page
+         boundary so that the last huge page is not left partial.  */
+      if (__glibc_unlikely (mp_.thp_pagesize != 0))
+	{
+	  uintptr_t cur = (uintptr_t) MORECORE (0);
+	  if (cur != (uintptr_t) MORECORE_FAILURE)
+	    size = ALIGN_UP (cur + size, mp_.thp_pagesize) - cur;
+	  else
+	    size = ALIGN_UP (size, pagesize);
+	}
+      else
+#endif
+	size = ALIGN_UP (size, pagesize);
 
       /*
          Don't try to call MORECORE if argument is so big as to appear
@@ -2605,6 +3284,12 @@ sysmalloc (INTERNAL_SIZE_T nb, mstate av)
       if (size > 0)
         {
           brk = (char *) (MORECORE (size));
+	  if (brk != (char *) (MORECORE_FAILURE))
+	    {
+	      madvise_thp (brk, size);
+	      main_arena_bind_node (brk, size);
+	      thread_stats_add (sbrk_bytes, size);
+	    }
           LIBC_PROBE (memory_sbrk_more, 2, brk, size);
         }
 
@@ -2636,6 +3321,9 @@ sysmalloc (INTERNAL_SIZE_T nb, mstate av)
 
               if (mbrk != MAP_FAILED)
                 {
+                  madvise_thp (mbrk, size);
+                  main_arena_bind_node (mbrk, size);
+
                   /* We do not need, and cannot use, another sbrk call to find end */
                   brk = mbrk;
                   snd_brk = brk + size;
@@ -2874,7 +3562,10 @@ systrim (size_t pad, mstate av)
   size_t pagesize;
   long top_area;
 
-  pagesize = GLRO (dl_pagesize);
+  /* Chunks queued by other threads may border the top chunk.  */
+  remote_free_drain (av);
+
+  pagesize = trim_pagesize ();
   top_size = chunksize (av->top);
 
   top_area = top_size - MINSIZE - 1;
@@ -2948,6 +3639,7 @@ munmap_chunk (mchunkptr p)
 
   atomic_decrement (&mp_.n_mmaps);
   atomic_add (&mp_.mmapped_mem, -total_size);
+  thread_stats_add (nmunmap, 1);
 
   /* If munmap failed the process virtual memory address space is in a
      bad shape.  Just leave the block hanging around, the process will
@@ -3084,6 +3776,149 @@ tcache_get (size_t tc_idx)
   return (void *) e;
 }
 
+/* Remove the first chunk of the tcache bin TC_IDX whose user pointer is
+   aligned to ALIGNMENT, which must be a power of two, and return that
+   pointer, or NULL if the bin holds no such chunk.  */
+static __always_inline void *
+tcache_get_aligned (size_t tc_idx, size_t alignment)
+{
+  tcache_entry *prev = NULL;
+  tcache_entry *e = tcache->entries[tc_idx];
+
+  for (size_t n = tcache->counts[tc_idx]; e != NULL; e = REVEAL_PTR (e->next))
+    {
+      if (__glibc_unlikely (!aligned_OK (e)))
+	malloc_printerr ("malloc(): unaligned tcache chunk detected");
+      if (((uintptr_t) e & (alignment - 1)) == 0)
+	break;
+      if (--n == 0)
+	return NULL;
+      prev = e;
+    }
+  if (e == NULL)
+    return NULL;
+
+  tcache_entry *next = REVEAL_PTR (e->next);
+  if (prev == NULL)
+    tcache->entries[tc_idx] = next;
+  else
+    prev->next = PROTECT_PTR (&prev->next, next);
+  --(tcache->counts[tc_idx]);
+  e->key = 0;
+  return (void *) e;
+}
+
+/* E is being freed and carries the tcache key; abort if it really is in
+   the tcache bin TC_IDX already.  */
+static __attribute_noinline__ void
+tcache_double_free_verify (tcache_entry *e, size_t tc_idx)
+{
+  tcache_entry *tmp;
+  size_t cnt = 0;
+  LIBC_PROBE (memory_tcache_double_free, 2, e, tc_idx);
+  for (tmp = tcache->entries[tc_idx];
+       tmp;
+       tmp = REVEAL_PTR (tmp->next), ++cnt)
+    {
+      if (cnt >= mp_.tcache_count)
+	malloc_printerr ("free(): too many chunks detected in tcache");
+      if (__glibc_unlikely (!aligned_OK (tmp)))
+	malloc_printerr ("free(): unaligned chunk detected in tcache 2");
+      if (tmp == e)
+	malloc_printerr ("free(): double free detected in tcache 2");
+      /* If we get here, it was a coincidence.  We've wasted a
+	 few cycles, but don't abort.  */
+    }
+}
+
+/* Move further chunks for tcache bin TC_IDX out of arena AV, whose lock
+   the caller holds after a tcache miss for a request of BYTES bytes.
+   Up to mp_.tcache_batch - 1 chunks are taken, so that one lock
+   acquisition serves a whole batch of allocations.  Chunks are only
+   carved while the top chunk can supply them without growing the
+   heap.  */
+static void
+tcache_refill (mstate av, size_t bytes, size_t tc_idx)
+{
+  if (tcache == NULL || tc_idx >= mp_.tcache_bins
+      || mp_.tcache_batch <= 1)
+    return;
+
+  INTERNAL_SIZE_T nb = request2size (bytes);
+  for (size_t n = mp_.tcache_batch - 1;
+       n > 0 && tcache->counts[tc_idx] < mp_.tcache_count; --n)
+    {
+      if ((unsigned long) chunksize (av->top)
+	  < (unsigned long) (nb + MINSIZE))
+	break;
+
+      void *mem = _int_malloc (av, bytes);
+      if (mem == NULL)
+	break;
+      mchunkptr p = mem2chunk (mem);
+      assert (!chunk_is_mmapped (p));
+      tcache_put (p, tc_idx);
+    }
+}
+
+/* Return chunk P, which did not fit into the full tcache bin TC_IDX,
+   to its arena together with the least recently cached chunks of that
+   bin, up to mp_.tcache_batch chunks in total.  Runs of chunks owned
+   by the same arena are released under a single acquisition of its
+   lock.  The caller must not hold any arena lock.  */
+static void
+tcache_flush (mchunkptr p, size_t tc_idx)
+{
+  size_t nflush = MIN (mp_.tcache_batch - 1, tcache->counts[tc_idx]);
+  size_t keep = tcache->counts[tc_idx] - nflush;
+  tcache_entry *rest;
+
+  /* Detach the tail of the bin, which holds the coldest chunks.  */
+  if (keep == 0)
+    {
+      rest = tcache->entries[tc_idx];
+      tcache->entries[tc_idx] = NULL;
+    }
+  else
+    {
+      tcache_entry *last = tcache->entries[tc_idx];
+      for (size_t i = 1; i < keep; ++i)
+	{
+	  last = REVEAL_PTR (last->next);
+	  if (__glibc_unlikely (!aligned_OK (last)))
+	    malloc_printerr ("free(): unaligned chunk detected in tcache 3");
+	}
+      rest = REVEAL_PTR (last->next);
+      last->next = PROTECT_PTR (&last->next, NULL);
+    }
+  tcache->counts[tc_idx] = keep;
+
+  mstate locked = arena_for_chunk (p);
+  arena_lock_stats (locked);
+  _int_free_chunk (locked, p, chunksize (p), 1);
+
+  while (rest != NULL)
+    {
+      if (__glibc_unlikely (!aligned_OK (rest)))
+	malloc_printerr ("free(): unaligned chunk detected in tcache 3");
+      tcache_entry *e = rest;
+      rest = REVEAL_PTR (e->next);
+      e->key = 0;
+
+      mchunkptr c = mem2chunk (e);
+      mstate av = arena_for_chunk (c);
+      if (av != locked)
+	{
+	  __libc_lock_unlock (locked->mutex);
+	  locked = av;
+	  arena_lock_stats (locked);
+	}
+      _int_free_chunk (av, c, chunksize (c), 1);
+    }
+
+  __libc_lock_unlock (locked->mutex);
+}
+
 static void
 tcache_thread_shutdown (void)
 {
@@ -3095,6 +3930,9 @@ tcache_thread_shutdown (void)
   if (!tcache)
     return;
 
+  /* The statistics block is freed along with the tcache.  */
+  stats_unregister ();
+
   /* Disable the tcache and prevent it from being reinitialized.  */
   tcache = NULL;
 
@@ -3121,7 +3959,9 @@ tcache_init(void)
 {
   mstate ar_ptr;
   void *victim = 0;
-  const size_t bytes = sizeof (tcache_perthread_struct);
+  /* The statistics of the thread are kept right after its tcache.  */
+  const size_t bytes = sizeof (tcache_perthread_struct)
+		       + (mp_.stats ? sizeof (struct malloc_thread_stats) : 0);
 
   if (tcache_shutting_down)
     return;
@@ -3147,6 +3987,8 @@ tcache_init(void)
     {
       tcache = (tcache_perthread_struct *) victim;
       memset (tcache, 0, sizeof (tcache_perthread_struct));
+      if (mp_.stats)
+	stats_register ((struct malloc_thread_stats *) (tcache + 1));
     }
 
 }
@@ -3166,6 +4008,23 @@ tcache_thread_shutdown (void)
 
 #endif /* !USE_TCACHE  */
 
+/* Sanity checks on chunk P of SIZE bytes, which is being freed.  */
+static __always_inline void
+int_free_check (mchunkptr p, INTERNAL_SIZE_T size)
+{
+  /* Little security check which won't hurt performance: the
+     allocator never wrapps around at the end of the address space.
+     Therefore we can exclude some size values which might appear
+     here by accident or by "design" from some intruder.  */
+  if (__builtin_expect ((uintptr_t) p > (uintptr_t) -size, 0)
+      || __builtin_expect (misaligned_chunk (p), 0))
+    malloc_printerr ("free(): invalid pointer");
+  /* We know that each chunk is at least MINSIZE bytes in size or a
+     multiple of MALLOC_ALIGNMENT.  */
+  if (__glibc_unlikely (size < MINSIZE || !aligned_OK (size)))
+    malloc_printerr ("free(): invalid size");
+}
+
 #if IS_IN (libc)
 void *
 __libc_malloc (size_t bytes)
@@ -3195,8 +4054,10 @@ __libc_malloc (size_t bytes)
       && tcache
       && tcache->counts[tc_idx] > 0)
     {
-      victim = tcache_get (tc_idx);
-      return tag_new_usable (victim);
+      victim = tag_new_usable (tcache_get (tc_idx));
+      stats_count_malloc (victim, true);
+      profile_malloc (victim, bytes);
+      return victim;
     }
   DIAG_POP_NEEDS_COMMENT;
 #endif
@@ -3206,6 +4067,18 @@ __libc_malloc (size_t bytes)
       victim = tag_new_usable (_int_malloc (&main_arena, bytes));
       assert (!victim || chunk_is_mmapped (mem2chunk (victim)) ||
 	      &main_arena == arena_for_chunk (mem2chunk (victim)));
+      stats_count_malloc (victim, false);
+      profile_malloc (victim, bytes);
+      return victim;
+    }
+
+  /* Try the fastbins before waiting for the arena lock.  */
+  victim = _int_malloc_fastbin (thread_arena, bytes);
+  if (victim != NULL)
+    {
+      victim = tag_new_usable (victim);
+      stats_count_malloc (victim, false);
+      profile_malloc (victim, bytes);
       return victim;
     }
 
@@ -3221,6 +4094,13 @@ __libc_malloc (size_t bytes)
       victim = _int_malloc (ar_ptr, bytes);
     }
 
+#if USE_TCACHE
+  /* We hold the arena lock anyway, so top up the tcache bin for this
+     size class instead of locking again on the next miss.  */
+  if (victim != NULL && ar_ptr != NULL)
+    tcache_refill (ar_ptr, bytes, tc_idx);
+#endif
+
   if (ar_ptr != NULL)
     __libc_lock_unlock (ar_ptr->mutex);
 
@@ -3228,6 +4108,8 @@ __libc_malloc (size_t bytes)
 
   assert (!victim || chunk_is_mmapped (mem2chunk (victim)) ||
           ar_ptr == arena_for_chunk (mem2chunk (victim)));
+  stats_count_malloc (victim, false);
+  profile_malloc (victim, bytes);
   return victim;
 }
 libc_hidden_def (__libc_malloc)
@@ -3250,6 +4132,9 @@ __libc_free (void *mem)
 
   p = mem2chunk (mem);
 
+  stats_count_free (chunksize (p));
+  profile_free (mem);
+
   if (chunk_is_mmapped (p))                       /* release mmapped memory. */
     {
       /* See if the dynamic brk/mmap threshold needs adjusting.
@@ -3263,7 +4148,8 @@ __libc_free (void *mem)
           LIBC_PROBE (memory_mallopt_free_dyn_thresholds, 2,
                       mp_.mmap_threshold, mp_.trim_threshold);
         }
-      munmap_chunk (p);
+      if (!mmap_cache_put (p))
+	munmap_chunk (p);
     }
   else
     {
@@ -3280,6 +4166,229 @@ __libc_free (void *mem)
 }
 libc_hidden_def (__libc_free)
 
+/* Abort unless chunk P can have been returned for a request of SIZE
+   bytes.  Chunks in the heap are never more than MINSIZE bytes larger
+   than the padded request, because a smaller remainder is not split
+   off; mmapped chunks are rounded up to whole pages.  */
+static void
+check_free_size (mchunkptr p, size_t size)
+{
+  size_t nb;
+
+  if (!checked_request2size (size, &nb))
+    malloc_printerr ("free_sized(): invalid size");
+  if (chunk_is_mmapped (p))
+    {
+      if (memsize (p) < size)
+	malloc_printerr ("free_sized(): invalid size");
+    }
+  else if (chunksize (p) < nb || chunksize (p) - nb > MINSIZE)
+    malloc_printerr ("free_sized(): invalid size");
+}
+
+void
+__libc_free_sized (void *mem, size_t size)
+{
+#if USE_TCACHE
+  size_t nb;
+
+  /* The tcache bin is computed from SIZE, so the chunk header is not
+     read unless the glibc.malloc.check_free_size tunable asks for the
+     checks which need it.  A chunk may be up to MINSIZE bytes larger
+     than the bin size, which is harmless: it only has to be large enough
+     for the requests served from the bin.  So is a small chunk which had
+     to be allocated with mmap: it stays marked as such, and free unmaps
+     it once it has been handed out again.  */
+  if (mem != NULL && !mtag_enabled && checked_request2size (size, &nb))
+    {
+      mchunkptr p = mem2chunk (mem);
+      size_t tc_idx = csize2tidx (nb);
+
+      if (tcache != NULL && tc_idx < mp_.tcache_bins
+	  && tcache->counts[tc_idx] < mp_.tcache_count)
+	{
+	  if (__glibc_unlikely (misaligned_chunk (p)))
+	    malloc_printerr ("free(): invalid pointer");
+	  if (__glibc_unlikely (mp_.check_free_size))
+	    {
+	      if (__glibc_unlikely (chunksize (p) > -(uintptr_t) p))
+		malloc_printerr ("free(): invalid pointer");
+	      check_free_size (p, size);
+	    }
+
+	  tcache_entry *e = (tcache_entry *) mem;
+	  if (__glibc_unlikely (e->key == tcache_key))
+	    tcache_double_free_verify (e, tc_idx);
+
+	  stats_count_free (nb);
+	  profile_free (mem);
+	  tcache_put (p, tc_idx);
+	  return;
+	}
+    }
+#endif
+
+  if (__glibc_unlikely (mp_.check_free_size) && mem != NULL)
+    check_free_size (mem2chunk (mem), size);
+  __libc_free (mem);
+}
+
+void
+__libc_free_aligned_sized (void *mem, size_t alignment, size_t size)
+{
+  /* Chunks returned by aligned_alloc follow the same size rules as all
+     others, so only the alignment needs checking here.  */
+  if (__glibc_unlikely (mp_.check_free_size) && mem != NULL
+      && powerof2 (alignment)
+      && ((uintptr_t) mem & (alignment - 1)) != 0)
+    malloc_printerr ("free_aligned_sized(): invalid pointer");
+  __libc_free_sized (mem, size);
+}
+
+size_t
+__libc_malloc_batch (size_t bytes, size_t n, void **ptrs)
+{
+  mstate ar_ptr;
+  size_t nb;
+  size_t i = 0;
+
+  if (!__malloc_initialized)
+    ptmalloc_init ();
+
+  if (!checked_request2size (bytes, &nb))
+    {
+      __set_errno (ENOMEM);
+      return 0;
+    }
+
+#if USE_TCACHE
+  size_t tc_idx = csize2tidx (nb);
+
+  MAYBE_INIT_TCACHE ();
+
+  /* Drain the tcache bin first.  */
+  if (tc_idx < mp_.tcache_bins && tcache != NULL)
+    while (i < n && tcache->counts[tc_idx] > 0)
+      {
+	void *victim = tag_new_usable (tcache_get (tc_idx));
+	stats_count_malloc (victim, true);
+	profile_malloc (victim, bytes);
+	ptrs[i++] = victim;
+      }
+#endif
+
+  /* Blocks that are mmapped one by one gain nothing from a batch.  */
+  size_t first = i;
+  if (i < n && nb < mp_.mmap_threshold)
+    {
+      if (SINGLE_THREAD_P)
+	i += _int_malloc_batch (&main_arena, bytes, n - i, ptrs + i);
+      else
+	{
+	  arena_get (ar_ptr, bytes);
+	  if (ar_ptr != NULL)
+	    {
+	      i += _int_malloc_batch (ar_ptr, bytes, n - i, ptrs + i);
+#if USE_TCACHE
+	      if (i == n)
+		tcache_refill (ar_ptr, bytes, tc_idx);
+#endif
+	      __libc_lock_unlock (ar_ptr->mutex);
+	    }
+	}
+    }
+
+  for (size_t j = first; j < i; j++)
+    {
+      ptrs[j] = tag_new_usable (ptrs[j]);
+      stats_count_malloc (ptrs[j], false);
+      profile_malloc (ptrs[j], bytes);
+    }
+
+  /* malloc can retry in another arena or fall back to mmap.  */
+  for (; i < n; i++)
+    {
+      ptrs[i] = __libc_malloc (bytes);
+      if (ptrs[i] == NULL)
+	break;
+    }
+
+  return i;
+}
+
+void
+__libc_free_batch (void **ptrs, size_t n)
+{
+  mstate locked = NULL;
+  int err = errno;
+
+  MAYBE_INIT_TCACHE ();
+
+  for (size_t i = 0; i < n; i++)
+    {
+      void *mem = ptrs[i];
+      if (mem == NULL)
+	continue;
+
+      mchunkptr p = mem2chunk (mem);
+      if (chunk_is_mmapped (p))
+	{
+	  /* Releasing an mmapped chunk does not involve its arena, but
+	     free may lock the arena of this thread to cache the chunk,
+	     and munmap should not be called with an arena locked.  */
+	  if (locked != NULL)
+	    {
+	      __libc_lock_unlock (locked->mutex);
+	      locked = NULL;
+	    }
+	  __libc_free (mem);
+	  continue;
+	}
+
+      if (__glibc_unlikely (mtag_enabled))
+	*(volatile char *) mem;
+
+      INTERNAL_SIZE_T size = chunksize (p);
+      stats_count_free (size);
+      profile_free (mem);
+      (void) tag_region (chunk2mem (p), memsize (p));
+
+      mstate av = arena_for_chunk (p);
+      int_free_check (p, size);
+      check_inuse_chunk (av, p);
+
+#if USE_TCACHE
+      /* Fill the tcache bin first; the rest goes back to the arena.  */
+      size_t tc_idx = csize2tidx (size);
+      if (tcache != NULL && tc_idx < mp_.tcache_bins
+	  && tcache->counts[tc_idx] < mp_.tcache_count)
+	{
+	  tcache_entry *e = (tcache_entry *) mem;
+	  if (__glibc_unlikely (e->key == tcache_key))
+	    tcache_double_free_verify (e, tc_idx);
+	  tcache_put (p, tc_idx);
+	  continue;
+	}
+#endif
+
+      /* Blocks from one pool are usually in the same arena, so the lock
+	 is kept until a block from another arena comes along.  */
+      if (av != locked)
+	{
+	  if (locked != NULL)
+	    __libc_lock_unlock (locked->mutex);
+	  locked = av;
+	  arena_lock_stats (locked);
+	}
+      _int_free_chunk (av, p, size, 1);
+    }
+
+  if (locked != NULL)
+    __libc_lock_unlock (locked->mutex);
+
+  __set_errno (err);
+}
+
 void *
 __libc_realloc (void *oldmem, size_t bytes)
 {
@@ -3312,13 +4421,12 @@ __libc_realloc (void *oldmem, size_t bytes)
   /* its size */
   const INTERNAL_SIZE_T oldsize = chunksize (oldp);
 
+  MAYBE_INIT_TCACHE ();
+
   if (chunk_is_mmapped (oldp))
     ar_ptr = NULL;
   else
-    {
-      MAYBE_INIT_TCACHE ();
-      ar_ptr = arena_for_chunk (oldp);
-    }
+    ar_ptr = arena_for_chunk (oldp);
 
   /* Little security check which won't hurt performance: the allocator
      never wrapps around at the end of the address space.  Therefore
@@ -3334,6 +4442,11 @@ __libc_realloc (void *oldmem, size_t bytes)
       return NULL;
     }
 
+  thread_stats_add (nrealloc, 1);
+
+  /* The block may move, so stop tracking it under its old address.  */
+  bool sampled = profile_free (oldmem);
+
   if (chunk_is_mmapped (oldp))
     {
       void *newmem;
@@ -3348,12 +4461,17 @@ __libc_realloc (void *oldmem, size_t bytes)
 	     reused.  There's a performance hit for both us and the
 	     caller for doing this, so we might want to
 	     reconsider.  */
-	  return tag_new_usable (newmem);
+	  newmem = tag_new_usable (newmem);
+	  profile_realloc (newmem, bytes, sampled, false);
+	  return newmem;
 	}
 #endif
       /* Note the extra SIZE_SZ overhead. */
       if (oldsize - SIZE_SZ >= nb)
-        return oldmem;                         /* do nothing */
+	{
+	  profile_realloc (oldmem, bytes, sampled, false);
+	  return oldmem;                         /* do nothing */
+	}
 
       /* Must alloc, copy, free. */
       newmem = __libc_malloc (bytes);
@@ -3361,7 +4479,9 @@ __libc_realloc (void *oldmem, size_t bytes)
         return 0;              /* propagate failure */
 
       memcpy (newmem, oldmem, oldsize - CHUNK_HDR_SZ);
-      munmap_chunk (oldp);
+      if (!mmap_cache_put (oldp))
+	munmap_chunk (oldp);
+      profile_realloc (newmem, bytes, sampled, true);
       return newmem;
     }
 
@@ -3371,6 +4491,7 @@ __libc_realloc (void *oldmem, size_t bytes)
       assert (!newp || chunk_is_mmapped (mem2chunk (newp)) ||
 	      ar_ptr == arena_for_chunk (mem2chunk (newp)));
 
+      profile_realloc (newp, bytes, sampled, false);
       return newp;
     }
 
@@ -3394,7 +4515,10 @@ __libc_realloc (void *oldmem, size_t bytes)
 	  (void) tag_region (chunk2mem (oldp), sz);
           _int_free (ar_ptr, oldp, 0);
         }
+      profile_realloc (newp, bytes, sampled, true);
     }
+  else
+    profile_realloc (newp, bytes, sampled, false);
 
   return newp;
 }
@@ -3442,12 +4566,45 @@ _mid_memalign (size_t alignment, size_t bytes, void *address)
       alignment = a;
     }
 
+#if USE_TCACHE
+  /* Chunks are only MALLOC_ALIGNMENT aligned, but for moderate
+     alignments a cached chunk of the right size often happens to be
+     aligned well enough, and can be handed out without the arena.  Its
+     size is that of the request, as for any other chunk.  */
+  size_t tbytes;
+  if (!checked_request2size (bytes, &tbytes))
+    {
+      __set_errno (ENOMEM);
+      return NULL;
+    }
+  size_t tc_idx = csize2tidx (tbytes);
+
+  MAYBE_INIT_TCACHE ();
+
+  if (tc_idx < mp_.tcache_bins
+      && tcache != NULL
+      && tcache->counts[tc_idx] > 0)
+    {
+      p = tcache_get_aligned (tc_idx, alignment);
+      if (p != NULL)
+	{
+	  p = tag_new_usable (p);
+	  stats_count_malloc (p, true);
+	  profile_malloc (p, bytes);
+	  return p;
+	}
+    }
+#endif
+
   if (SINGLE_THREAD_P)
     {
       p = _int_memalign (&main_arena, alignment, bytes);
       assert (!p || chunk_is_mmapped (mem2chunk (p)) ||
 	      &main_arena == arena_for_chunk (mem2chunk (p)));
-      return tag_new_usable (p);
+      p = tag_new_usable (p);
+      stats_count_malloc (p, false);
+      profile_malloc (p, bytes);
+      return p;
     }
 
   arena_get (ar_ptr, bytes + alignment + MINSIZE);
@@ -3465,7 +4622,10 @@ _mid_memalign (size_t alignment, size_t bytes, void *address)
 
   assert (!p || chunk_is_mmapped (mem2chunk (p)) ||
           ar_ptr == arena_for_chunk (mem2chunk (p)));
-  return tag_new_usable (p);
+  p = tag_new_usable (p);
+  stats_count_malloc (p, false);
+  profile_malloc (p, bytes);
+  return p;
 }
 /* For ISO C11.  */
 weak_alias (__libc_memalign, aligned_alloc)
@@ -3561,6 +4721,7 @@ __libc_calloc (size_t n, size_t elem_size)
       oldtop = 0;
       oldtopsize = 0;
     }
+  mmap_cache_hit = false;
   mem = _int_malloc (av, sz);
 
   assert (!mem || chunk_is_mmapped (mem2chunk (mem)) ||
@@ -3583,20 +4744,28 @@ __libc_calloc (size_t n, size_t elem_size)
   if (mem == 0)
     return 0;
 
+  stats_count_malloc (mem, false);
+
   mchunkptr p = mem2chunk (mem);
 
   /* If we are using memory tagging, then we need to set the tags
      regardless of MORECORE_CLEARS, so we zero the whole block while
      doing so.  */
   if (__glibc_unlikely (mtag_enabled))
-    return tag_new_zero_region (mem, memsize (p));
+    {
+      mem = tag_new_zero_region (mem, memsize (p));
+      profile_malloc (mem, sz);
+      return mem;
+    }
+
+  profile_malloc (mem, sz);
 
   INTERNAL_SIZE_T csz = chunksize (p);
 
   /* Two optional cases in which clearing not necessary */
   if (chunk_is_mmapped (p))
     {
-      if (__builtin_expect (perturb_byte, 0))
+      if (__builtin_expect (perturb_byte, 0) || mmap_cache_hit)
         return memset (mem, 0, sz);
 
       return mem;
@@ -3651,6 +4820,117 @@ __libc_calloc (size_t n, size_t elem_size)
    ------------------------------ malloc ------------------------------
  */
 
+/* Pop the first chunk off the fastbin FB.  Concurrent frees may push
+   onto the bin, but removals must be serialized by av->fastbin_lock, as
+   otherwise a chunk which is removed and pushed again between reading
+   its link and the compare-and-exchange would corrupt the bin.  */
+#define REMOVE_FB(fb, victim, pp)			\
+  do							\
+    {							\
+      victim = pp;					\
+      if (victim == NULL)				\
+	break;						\
+      pp = REVEAL_PTR (victim->fd);                                     \
+      if (__glibc_unlikely (pp != NULL && misaligned_chunk (pp)))       \
+	malloc_printerr ("malloc(): unaligned fastbin chunk detected"); \
+    }							\
+  while ((pp = catomic_compare_and_exchange_val_acq (fb, pp, victim)) \
+	 != victim);					\
+
+/* Remove a chunk for a request of NB bytes, which must be in the fastbin
+   range, from its fastbin in AV, and move further chunks of that size
+   into the tcache.  Return the chunk, or NULL if the bin is empty.  The
+   caller need not hold the arena lock.  */
+static mchunkptr
+fastbin_take (mstate av, INTERNAL_SIZE_T nb)
+{
+  unsigned int idx = fastbin_index (nb);
+  mfastbinptr *fb = &fastbin (av, idx);
+  mchunkptr victim, pp;
+
+  if (atomic_load_relaxed (fb) == NULL)
+    return NULL;
+
+  bool locked = !SINGLE_THREAD_P;
+  if (locked)
+    __libc_lock_lock (av->fastbin_lock);
+
+  victim = *fb;
+  if (victim != NULL)
+    {
+      if (__glibc_unlikely (misaligned_chunk (victim)))
+	malloc_printerr ("malloc(): unaligned fastbin chunk detected 2");
+
+      if (!locked)
+	*fb = REVEAL_PTR (victim->fd);
+      else
+	REMOVE_FB (fb, pp, victim);
+      if (__glibc_likely (victim != NULL))
+	{
+	  size_t victim_idx = fastbin_index (chunksize (victim));
+	  if (__builtin_expect (victim_idx != idx, 0))
+	    malloc_printerr ("malloc(): memory corruption (fast)");
+	  check_remalloced_chunk (av, victim, nb);
+#if USE_TCACHE
+	  /* While we're here, if we see other chunks of the same size,
+	     stash them in the tcache.  */
+	  size_t tc_idx = csize2tidx (nb);
+	  if (tcache && tc_idx < mp_.tcache_bins)
+	    {
+	      mchunkptr tc_victim;
+
+	      /* While bin not empty and tcache not full, copy chunks.  */
+	      while (tcache->counts[tc_idx] < mp_.tcache_count
+		     && (tc_victim = *fb) != NULL)
+		{
+		  if (__glibc_unlikely (misaligned_chunk (tc_victim)))
+		    malloc_printerr ("malloc(): unaligned fastbin chunk detected 3");
+		  if (!locked)
+		    *fb = REVEAL_PTR (tc_victim->fd);
+		  else
+		    {
+		      REMOVE_FB (fb, pp, tc_victim);
+		      if (__glibc_unlikely (tc_victim == NULL))
+			break;
+		    }
+		  tcache_put (tc_victim, tc_idx);
+		}
+	    }
+#endif
+	}
+    }
+
+  if (locked)
+    __libc_lock_unlock (av->fastbin_lock);
+  return victim;
+}
+
+#if IS_IN (libc)
+/* Serve a request of BYTES bytes from the fastbins of the arena of the
+   current thread without taking the arena lock, so that small requests
+   do not wait for threads which allocate or free larger blocks in the
+   same arena.  Return NULL if the request is not in the fastbin range
+   or its bin is empty, in which case the caller falls back to
+   _int_malloc.  */
+static void *
+_int_malloc_fastbin (mstate av, size_t bytes)
+{
+  INTERNAL_SIZE_T nb;
+
+  if (av == NULL || !checked_request2size (bytes, &nb)
+      || (unsigned long) (nb) > (unsigned long) (get_max_fast ()))
+    return NULL;
+
+  mchunkptr victim = fastbin_take (av, nb);
+  if (victim == NULL)
+    return NULL;
+
+  void *p = chunk2mem (victim);
+  alloc_perturb (p, bytes);
+  return p;
+}
+#endif
+
 static void *
 _int_malloc (mstate av, size_t bytes)
 {
@@ -3701,77 +4981,23 @@ _int_malloc (mstate av, size_t bytes)
       return p;
     }
 
+  /* Take back the chunks other threads freed while we held the lock.  */
+  remote_free_drain (av);
+
   /*
      If the size qualifies as a fastbin, first check corresponding bin.
      This code is safe to execute even if av is not yet initialized, so we
      can try it without checking, which saves some time on this fast path.
    */
 
-#define REMOVE_FB(fb, victim, pp)			\
-  do							\
-    {							\
-      victim = pp;					\
-      if (victim == NULL)				\
-	break;						\
-      pp = REVEAL_PTR (victim->fd);                                     \
-      if (__glibc_unlikely (pp != NULL && misaligned_chunk (pp)))       \
-	malloc_printerr ("malloc(): unaligned fastbin chunk detected"); \
-    }							\
-  while ((pp = catomic_compare_and_exchange_val_acq (fb, pp, victim)) \
-	 != victim);					\
-
   if ((unsigned long) (nb) <= (unsigned long) (get_max_fast ()))
     {
-      idx = fastbin_index (nb);
-      mfastbinptr *fb = &fastbin (av, idx);
-      mchunkptr pp;
-      victim = *fb;
-
+      victim = fastbin_take (av, nb);
       if (victim != NULL)
 	{
-	  if (__glibc_unlikely (misaligned_chunk (victim)))
-	    malloc_printerr ("malloc(): unaligned fastbin chunk detected 2");
-
-	  if (SINGLE_THREAD_P)
-	    *fb = REVEAL_PTR (victim->fd);
-	  else
-	    REMOVE_FB (fb, pp, victim);
-	  if (__glibc_likely (victim != NULL))
-	    {
-	      size_t victim_idx = fastbin_index (chunksize (victim));
-	      if (__builtin_expect (victim_idx != idx, 0))
-		malloc_printerr ("malloc(): memory corruption (fast)");
-	      check_remalloced_chunk (av, victim, nb);
-#if USE_TCACHE
-	      /* While we're here, if we see other chunks of the same size,
-		 stash them in the tcache.  */
-	      size_t tc_idx = csize2tidx (nb);
-	      if (tcache && tc_idx < mp_.tcache_bins)
-		{
-		  mchunkptr tc_victim;
-
-		  /* While bin not empty and tcache not full, copy chunks.  */
-		  while (tcache->counts[tc_idx] < mp_.tcache_count
-			 && (tc_victim = *fb) != NULL)
-		    {
-		      if (__glibc_unlikely (misaligned_chunk (tc_victim)))
-			malloc_printerr ("malloc(): unaligned fastbin chunk detected 3");
-		      if (SINGLE_THREAD_P)
-			*fb = REVEAL_PTR (tc_victim->fd);
-		      else
-			{
-			  REMOVE_FB (fb, pp, tc_victim);
-			  if (__glibc_unlikely (tc_victim == NULL))
-			    break;
-			}
-		      tcache_put (tc_victim, tc_idx);
-		    }
-		}
-#endif
-	      void *p = chunk2mem (victim);
-	      alloc_perturb (p, bytes);
-	      return p;
-	    }
+	  void *p = chunk2mem (victim);
+	  alloc_perturb (p, bytes);
+	  return p;
 	}
     }
 
@@ -3915,10 +5141,12 @@ _int_malloc (mstate av, size_t bytes)
               unsorted_chunks (av)->bk = unsorted_chunks (av)->fd = remainder;
               av->last_remainder = remainder;
               remainder->bk = remainder->fd = unsorted_chunks (av);
+              trim_forget (av, victim);
               if (!in_smallbin_range (remainder_size))
                 {
                   remainder->fd_nextsize = NULL;
                   remainder->bk_nextsize = NULL;
+                  trim_mark (remainder) = 0;
                 }
 
               set_head (victim, nb | PREV_INUSE |
@@ -3937,6 +5165,7 @@ _int_malloc (mstate av, size_t bytes)
             malloc_printerr ("malloc(): corrupted unsorted chunks 3");
           unsorted_chunks (av)->bk = bck;
           bck->fd = unsorted_chunks (av);
+          trim_forget (av, victim);
 
           /* Take now instead of binning if exact fit */
 
@@ -4114,6 +5343,7 @@ _int_malloc (mstate av, size_t bytes)
                     {
                       remainder->fd_nextsize = NULL;
                       remainder->bk_nextsize = NULL;
+                      trim_mark (remainder) = 0;
                     }
                   set_head (victim, nb | PREV_INUSE |
                             (av != &main_arena ? NON_MAIN_ARENA : 0));
@@ -4222,6 +5452,7 @@ _int_malloc (mstate av, size_t bytes)
                     {
                       remainder->fd_nextsize = NULL;
                       remainder->bk_nextsize = NULL;
+                      trim_mark (remainder) = 0;
                     }
                   set_head (victim, nb | PREV_INUSE |
                             (av != &main_arena ? NON_MAIN_ARENA : 0));
@@ -4297,6 +5528,55 @@ _int_malloc (mstate av, size_t bytes)
     }
 }
 
+#if IS_IN (libc)
+/* Allocate up to N chunks for requests of BYTES bytes each from arena
+   AV, whose lock the caller holds, and store them in PTRS.  Once a
+   request has been served from the top chunk, the bins are known to
+   hold nothing suitable, so further chunks are split off the top chunk
+   in a single pass.  Return the number of chunks allocated.  */
+static size_t
+_int_malloc_batch (mstate av, size_t bytes, size_t n, void **ptrs)
+{
+  INTERNAL_SIZE_T nb = request2size (bytes);
+  size_t i = 0;
+
+  while (i < n)
+    {
+      void *mem = _int_malloc (av, bytes);
+      if (mem == NULL)
+	break;
+      ptrs[i++] = mem;
+
+      mchunkptr p = mem2chunk (mem);
+      if (chunk_is_mmapped (p) || chunk_at_offset (p, nb) != av->top)
+	continue;
+
+      mchunkptr top = av->top;
+      INTERNAL_SIZE_T size = chunksize (top);
+      if ((unsigned long) (size) < (unsigned long) (nb + MINSIZE))
+	continue;
+
+      size_t run = MIN (n - i, (size - MINSIZE) / nb);
+      av->top = chunk_at_offset (top, run * nb);
+      set_head (av->top, (size - run * nb) | PREV_INUSE);
+      for (size_t j = 0; j < run; j++)
+	{
+	  mchunkptr victim = chunk_at_offset (top, j * nb);
+	  set_head (victim, nb | PREV_INUSE |
+		    (av != &main_arena ? NON_MAIN_ARENA : 0));
+	  ptrs[i + j] = chunk2mem (victim);
+	  alloc_perturb (ptrs[i + j], bytes);
+	}
+      /* Only check once every chunk of the run has its header.  */
+      for (size_t j = 0; j < run; j++)
+	check_malloced_chunk (av, mem2chunk (ptrs[i + j]), nb);
+      i += run;
+    }
+
+  return i;
+}
+#endif
+
 /*
    ------------------------------ free ------------------------------
  */
@@ -4305,27 +5585,10 @@ static void
 _int_free (mstate av, mchunkptr p, int have_lock)
 {
   INTERNAL_SIZE_T size;        /* its size */
-  mfastbinptr *fb;             /* associated fastbin */
-  mchunkptr nextchunk;         /* next contiguous chunk */
-  INTERNAL_SIZE_T nextsize;    /* its size */
-  int nextinuse;               /* true if nextchunk is used */
-  INTERNAL_SIZE_T prevsize;    /* size of previous contiguous chunk */
-  mchunkptr bck;               /* misc temp for linking */
-  mchunkptr fwd;               /* misc temp for linking */
 
   size = chunksize (p);
 
-  /* Little security check which won't hurt performance: the
-     allocator never wrapps around at the end of the address space.
-     Therefore we can exclude some size values which might appear
-     here by accident or by "design" from some intruder.  */
-  if (__builtin_expect ((uintptr_t) p > (uintptr_t) -size, 0)
-      || __builtin_expect (misaligned_chunk (p), 0))
-    malloc_printerr ("free(): invalid pointer");
-  /* We know that each chunk is at least MINSIZE bytes in size or a
-     multiple of MALLOC_ALIGNMENT.  */
-  if (__glibc_unlikely (size < MINSIZE || !aligned_OK (size)))
-    malloc_printerr ("free(): invalid size");
+  int_free_check (p, size);
 
   check_inuse_chunk(av, p);
 
@@ -4342,34 +5605,36 @@ _int_free (mstate av, mchunkptr p, int have_lock)
 	   2^<size_t> chance), so verify it's not an unlikely
 	   coincidence before aborting.  */
 	if (__glibc_unlikely (e->key == tcache_key))
-	  {
-	    tcache_entry *tmp;
-	    size_t cnt = 0;
-	    LIBC_PROBE (memory_tcache_double_free, 2, e, tc_idx);
-	    for (tmp = tcache->entries[tc_idx];
-		 tmp;
-		 tmp = REVEAL_PTR (tmp->next), ++cnt)
-	      {
-		if (cnt >= mp_.tcache_count)
-		  malloc_printerr ("free(): too many chunks detected in tcache");
-		if (__glibc_unlikely (!aligned_OK (tmp)))
-		  malloc_printerr ("free(): unaligned chunk detected in tcache 2");
-		if (tmp == e)
-		  malloc_printerr ("free(): double free detected in tcache 2");
-		/* If we get here, it was a coincidence.  We've wasted a
-		   few cycles, but don't abort.  */
-	      }
-	  }
+	  tcache_double_free_verify (e, tc_idx);
 
 	if (tcache->counts[tc_idx] < mp_.tcache_count)
 	  {
 	    tcache_put (p, tc_idx);
 	    return;
 	  }
+
+	/* The bin is full.  Instead of taking the arena lock for this
+	   chunk alone, hand back a batch of cached chunks with it.  */
+	if (!have_lock && !SINGLE_THREAD_P && mp_.tcache_batch > 1)
+	  {
+	    tcache_flush (p, tc_idx);
+	    return;
+	  }
       }
   }
 #endif
 
+  _int_free_chunk (av, p, size, have_lock);
+}
+
+/* Release chunk P of SIZE bytes to arena AV without going through the
+   per-thread cache.  HAVE_LOCK says whether the caller holds the arena
+   lock.  */
+static void
+_int_free_chunk (mstate av, mchunkptr p, INTERNAL_SIZE_T size, int have_lock)
+{
+  mfastbinptr *fb;             /* associated fastbin */
+
   /*
     If eligible, place chunk on a fastbin so it can be found
     and used quickly in malloc.
@@ -4457,133 +5722,234 @@ _int_free (mstate av, mchunkptr p, int have_lock)
     if (SINGLE_THREAD_P)
       have_lock = true;
 
-    if (!have_lock)
-      __libc_lock_lock (av->mutex);
-
-    nextchunk = chunk_at_offset(p, size);
-
-    /* Lightweight tests: check whether the block is already the
-       top block.  */
-    if (__glibc_unlikely (p == av->top))
-      malloc_printerr ("double free or corruption (top)");
-    /* Or whether the next chunk is beyond the boundaries of the arena.  */
-    if (__builtin_expect (contiguous (av)
-			  && (char *) nextchunk
-			  >= ((char *) av->top + chunksize(av->top)), 0))
-	malloc_printerr ("double free or corruption (out)");
-    /* Or whether the block is actually not marked used.  */
-    if (__glibc_unlikely (!prev_inuse(nextchunk)))
-      malloc_printerr ("double free or corruption (!prev)");
-
-    nextsize = chunksize(nextchunk);
-    if (__builtin_expect (chunksize_nomask (nextchunk) <= CHUNK_HDR_SZ, 0)
-	|| __builtin_expect (nextsize >= av->system_mem, 0))
-      malloc_printerr ("free(): invalid next size (normal)");
+    /* If another thread holds the arena lock, typically the thread
+       allocating from it, do not wait for it.  Queue the chunk instead;
+       it is released by whoever holds the lock next.  */
+    if (!have_lock && __libc_lock_trylock (av->mutex) != 0)
+      {
+	thread_stats_add (nlock_contended, 1);
+	remote_free_push (av, p);
+	return;
+      }
 
-    free_perturb (chunk2mem(p), size - CHUNK_HDR_SZ);
+    size = _int_free_merge_chunk (av, p, size);
 
-    /* consolidate backward */
-    if (!prev_inuse(p)) {
-      prevsize = prev_size (p);
-      size += prevsize;
-      p = chunk_at_offset(p, -((long) prevsize));
-      if (__glibc_unlikely (chunksize(p) != prevsize))
-        malloc_printerr ("corrupted size vs. prev_size while consolidating");
-      unlink_chunk (av, p);
-    }
+    /* Release the chunks queued by threads which found the lock busy,
+       so that they are taken into account for trimming.  */
+    INTERNAL_SIZE_T drained = remote_free_drain (av);
+    if (drained > size)
+      size = drained;
 
-    if (nextchunk != av->top) {
-      /* get and clear inuse bit */
-      nextinuse = inuse_bit_at_offset(nextchunk, nextsize);
+    _int_free_maybe_consolidate (av, size);
 
-      /* consolidate forward */
-      if (!nextinuse) {
-	unlink_chunk (av, nextchunk);
-	size += nextsize;
-      } else
-	clear_inuse_bit_at_offset(nextchunk, 0);
+    if (!have_lock)
+      __libc_lock_unlock (av->mutex);
+  }
+  /*
+    If the chunk was allocated via mmap, release via munmap().
+  */
 
-      /*
-	Place the chunk in unsorted chunk list. Chunks are
-	not placed into regular bins until after they have
-	been given one chance to be used in malloc.
-      */
+  else {
+    munmap_chunk (p);
+  }
+}
 
-      bck = unsorted_chunks(av);
-      fwd = bck->fd;
-      if (__glibc_unlikely (fwd->bk != bck))
-	malloc_printerr ("free(): corrupted unsorted chunks");
-      p->fd = fwd;
-      p->bk = bck;
-      if (!in_smallbin_range(size))
-	{
-	  p->fd_nextsize = NULL;
-	  p->bk_nextsize = NULL;
-	}
-      bck->fd = p;
-      fwd->bk = p;
+/* Mark chunk P of SIZE bytes as free and coalesce it with its free
+   neighbours, placing the result in the unsorted bin or merging it
+   into the top chunk.  The caller holds the arena lock.  Return the
+   size of the coalesced chunk.  */
+static INTERNAL_SIZE_T
+_int_free_merge_chunk (mstate av, mchunkptr p, INTERNAL_SIZE_T size)
+{
+  mchunkptr nextchunk;         /* next contiguous chunk */
+  INTERNAL_SIZE_T nextsize;    /* its size */
+  int nextinuse;               /* true if nextchunk is used */
+  INTERNAL_SIZE_T prevsize;    /* size of previous contiguous chunk */
+  mchunkptr bck;               /* misc temp for linking */
+  mchunkptr fwd;               /* misc temp for linking */
 
-      set_head(p, size | PREV_INUSE);
-      set_foot(p, size);
+  nextchunk = chunk_at_offset(p, size);
+
+  /* Lightweight tests: check whether the block is already the
+     top block.  */
+  if (__glibc_unlikely (p == av->top))
+    malloc_printerr ("double free or corruption (top)");
+  /* Or whether the next chunk is beyond the boundaries of the arena.  */
+  if (__builtin_expect (contiguous (av)
+			&& (char *) nextchunk
+			>= ((char *) av->top + chunksize(av->top)), 0))
+    malloc_printerr ("double free or corruption (out)");
+  /* Or whether the block is actually not marked used.  */
+  if (__glibc_unlikely (!prev_inuse(nextchunk)))
+    malloc_printerr ("double free or corruption (!prev)");
+
+  nextsize = chunksize(nextchunk);
+  if (__builtin_expect (chunksize_nomask (nextchunk) <= CHUNK_HDR_SZ, 0)
+      || __builtin_expect (nextsize >= av->system_mem, 0))
+    malloc_printerr ("free(): invalid next size (normal)");
 
-      check_free_chunk(av, p);
-    }
+  free_perturb (chunk2mem(p), size - CHUNK_HDR_SZ);
 
-    /*
-      If the chunk borders the current high end of memory,
-      consolidate into top
-    */
+  av->trim_pending += size;
+
+  /* consolidate backward */
+  if (!prev_inuse(p)) {
+    prevsize = prev_size (p);
+    size += prevsize;
+    p = chunk_at_offset(p, -((long) prevsize));
+    if (__glibc_unlikely (chunksize(p) != prevsize))
+      malloc_printerr ("corrupted size vs. prev_size while consolidating");
+    unlink_chunk (av, p);
+  }
 
-    else {
+  if (nextchunk != av->top) {
+    /* get and clear inuse bit */
+    nextinuse = inuse_bit_at_offset(nextchunk, nextsize);
+
+    /* consolidate forward */
+    if (!nextinuse) {
+      unlink_chunk (av, nextchunk);
       size += nextsize;
-      set_head(p, size | PREV_INUSE);
-      av->top = p;
-      check_chunk(av, p);
-    }
+    } else
+      clear_inuse_bit_at_offset(nextchunk, 0);
 
     /*
-      If freeing a large space, consolidate possibly-surrounding
-      chunks. Then, if the total unused topmost memory exceeds trim
-      threshold, ask malloc_trim to reduce top.
-
-      Unless max_fast is 0, we don't know if there are fastbins
-      bordering top, so we cannot tell for sure whether threshold
-      has been reached unless fastbins are consolidated.  But we
-      don't want to consolidate on each free.  As a compromise,
-      consolidation is performed if FASTBIN_CONSOLIDATION_THRESHOLD
-      is reached.
+      Place the chunk in unsorted chunk list. Chunks are
+      not placed into regular bins until after they have
+      been given one chance to be used in malloc.
     */
 
-    if ((unsigned long)(size) >= FASTBIN_CONSOLIDATION_THRESHOLD) {
-      if (atomic_load_relaxed (&av->have_fastchunks))
-	malloc_consolidate(av);
-
-      if (av == &main_arena) {
-#ifndef MORECORE_CANNOT_TRIM
-	if ((unsigned long)(chunksize(av->top)) >=
-	    (unsigned long)(mp_.trim_threshold))
-	  systrim(mp_.top_pad, av);
-#endif
-      } else {
-	/* Always try heap_trim(), even if the top chunk is not
-	   large, because the corresponding heap might go away.  */
-	heap_info *heap = heap_for_ptr(top(av));
-
-	assert(heap->ar_ptr == av);
-	heap_trim(heap, mp_.top_pad);
+    bck = unsorted_chunks(av);
+    fwd = bck->fd;
+    if (__glibc_unlikely (fwd->bk != bck))
+      malloc_printerr ("free(): corrupted unsorted chunks");
+    p->fd = fwd;
+    p->bk = bck;
+    if (!in_smallbin_range(size))
+      {
+	p->fd_nextsize = NULL;
+	p->bk_nextsize = NULL;
+	trim_mark (p) = 0;
       }
-    }
+    bck->fd = p;
+    fwd->bk = p;
 
-    if (!have_lock)
-      __libc_lock_unlock (av->mutex);
+    set_head(p, size | PREV_INUSE);
+    set_foot(p, size);
+
+    check_free_chunk(av, p);
   }
+
   /*
-    If the chunk was allocated via mmap, release via munmap().
+    If the chunk borders the current high end of memory,
+    consolidate into top
   */
 
   else {
-    munmap_chunk (p);
+    size += nextsize;
+    set_head(p, size | PREV_INUSE);
+    av->top = p;
+    check_chunk(av, p);
+  }
+
+  return size;
+}
+
+/* After a chunk of SIZE bytes (including the free neighbours it was
+   coalesced with) was freed to AV, consolidate the fastbins and give
+   memory back to the system if enough has accumulated.  The caller
+   holds the arena lock.  */
+static void
+_int_free_maybe_consolidate (mstate av, INTERNAL_SIZE_T size)
+{
+  /*
+    If freeing a large space, consolidate possibly-surrounding
+    chunks. Then, if the total unused topmost memory exceeds trim
+    threshold, ask malloc_trim to reduce top.
+
+    Unless max_fast is 0, we don't know if there are fastbins
+    bordering top, so we cannot tell for sure whether threshold
+    has been reached unless fastbins are consolidated.  But we
+    don't want to consolidate on each free.  As a compromise,
+    consolidation is performed if FASTBIN_CONSOLIDATION_THRESHOLD
+    is reached.
+  */
+
+  if ((unsigned long)(size) >= FASTBIN_CONSOLIDATION_THRESHOLD) {
+    if (atomic_load_relaxed (&av->have_fastchunks))
+      malloc_consolidate(av);
+
+    if (av == &main_arena) {
+#ifndef MORECORE_CANNOT_TRIM
+      if ((unsigned long)(chunksize(av->top)) >=
+	  (unsigned long)(mp_.trim_threshold))
+	systrim(heap_top_pad (), av);
+#endif
+    } else {
+      /* Always try heap_trim(), even if the top chunk is not
+	 large, because the corresponding heap might go away.  */
+      heap_info *heap = heap_for_ptr(top(av));
+
+      assert(heap->ar_ptr == av);
+      heap_trim(heap, heap_top_pad ());
+    }
   }
+
+  if (mp_.trim_budget != 0 && av->trim_pending >= mp_.trim_budget)
+    trim_slice (av);
+
+  mmap_cache_expire (av);
+}
+
+/*
+  ------------------------- remote frees -------------------------
+
+  A thread which frees a chunk that cannot go to the tcache or a fastbin
+  needs the lock of the arena owning the chunk.  If that lock is busy,
+  usually because the arena's own thread is allocating from it, the
+  chunk is pushed onto the arena's remote_frees stack instead, and the
+  next lock holder releases all queued chunks at once: at the start of
+  _int_malloc, in every free which gets to the arena lock, and before
+  malloc_consolidate and systrim look at the free chunks.  Queued chunks
+  are still marked in use, so they cannot be coalesced or handed out
+  before they are drained.
+*/
+
+static void
+remote_free_push (mstate av, mchunkptr p)
+{
+  mchunkptr old = atomic_load_relaxed (&av->remote_frees);
+  do
+    p->fd = PROTECT_PTR (&p->fd, old);
+  while (!atomic_compare_exchange_weak_release (&av->remote_frees, &old, p));
+}
+
+/* Release all chunks queued on AV by remote_free_push.  The caller
+   holds the arena lock.  The chunks are only coalesced, so that this
+   can be called from malloc_consolidate and systrim; return the size
+   of the largest resulting free chunk, for the caller to decide
+   whether to trim.  */
+static INTERNAL_SIZE_T
+remote_free_drain (mstate av)
+{
+  if (atomic_load_relaxed (&av->remote_frees) == NULL)
+    return 0;
+
+  mchunkptr p = atomic_exchange_acquire (&av->remote_frees, NULL);
+  INTERNAL_SIZE_T largest = 0;
+
+  while (p != NULL)
+    {
+      if (__glibc_unlikely (misaligned_chunk (p)))
+	malloc_printerr ("free(): unaligned remote chunk detected");
+      mchunkptr next = REVEAL_PTR (p->fd);
+      check_inuse_chunk (av, p);
+      INTERNAL_SIZE_T size = _int_free_merge_chunk (av, p, chunksize (p));
+      if (size > largest)
+	largest = size;
+      p = next;
+    }
+  return largest;
 }
 
 /*
@@ -4612,6 +5978,9 @@ static void malloc_consolidate(mstate av)
   INTERNAL_SIZE_T prevsize;
   int             nextinuse;
 
+  /* Chunks queued by other threads may border fastbin chunks.  */
+  remote_free_drain (av);
+
   atomic_store_relaxed (&av->have_fastchunks, false);
 
   unsorted_bin = unsorted_chunks(av);
@@ -4627,7 +5996,10 @@ static void malloc_consolidate(mstate av)
   maxfb = &fastbin (av, NFASTBINS - 1);
   fb = &fastbin (av, 0);
   do {
+    /* Emptying the bin is a removal too, see REMOVE_FB.  */
+    __libc_lock_lock (av->fastbin_lock);
     p = atomic_exchange_acq (fb, NULL);
+    __libc_lock_unlock (av->fastbin_lock);
     if (p != 0) {
       do {
 	{
@@ -4673,6 +6045,7 @@ static void malloc_consolidate(mstate av)
 	  if (!in_smallbin_range (size)) {
 	    p->fd_nextsize = NULL;
 	    p->bk_nextsize = NULL;
+	    trim_mark (p) = 0;
 	  }
 
 	  set_head(p, size | PREV_INUSE);
@@ -4919,6 +6292,45 @@ _int_memalign (mstate av, size_t alignment, size_t bytes)
    ------------------------------ malloc_trim ------------------------------
  */
 
+/* Release the unused whole pages of the free chunk P with ADVICE, but
+   not more than LIMIT bytes of them.  Return the number of bytes
+   released, or -1 if madvise failed.  */
+static ssize_t
+release_free_pages (mchunkptr p, size_t limit, int advice)
+{
+  const size_t psm1 = GLRO (dl_pagesize) - 1;
+  INTERNAL_SIZE_T size = chunksize (p);
+
+  if (size <= psm1 + sizeof (struct malloc_chunk) + sizeof (size_t))
+    return 0;
+
+  /* See whether the chunk contains at least one unused page.  The bin
+     links and the trim mark stay in place.  */
+  char *paligned_mem = (char *) (((uintptr_t) p
+				  + sizeof (struct malloc_chunk)
+				  + sizeof (size_t)
+				  + psm1) & ~psm1);
+
+  assert ((char *) chunk2mem (p) + 2 * CHUNK_HDR_SZ <= paligned_mem);
+  assert ((char *) p + size > paligned_mem);
+
+  /* This is the size we could potentially free.  */
+  size -= paligned_mem - (char *) p;
+  size = MIN (size, limit) & ~psm1;
+
+  if (size == 0)
+    return 0;
+
+#if MALLOC_DEBUG
+  /* When debugging we simulate destroying the memory content.  */
+  memset (paligned_mem, 0x89, size);
+#endif
+  if (__madvise (paligned_mem, size, advice) != 0)
+    return -1;
+
+  return size;
+}
+
 static int
 mtrim (mstate av, size_t pad)
 {
@@ -4927,7 +6339,6 @@ mtrim (mstate av, size_t pad)
 
   const size_t ps = GLRO (dl_pagesize);
   int psindex = bin_index (ps);
-  const size_t psm1 = ps - 1;
 
   int result = 0;
   for (int i = 1; i < NBINS; ++i)
@@ -4936,36 +6347,15 @@ mtrim (mstate av, size_t pad)
         mbinptr bin = bin_at (av, i);
 
         for (mchunkptr p = last (bin); p != bin; p = p->bk)
-          {
-            INTERNAL_SIZE_T size = chunksize (p);
-
-            if (size > psm1 + sizeof (struct malloc_chunk))
-              {
-                /* See whether the chunk contains at least one unused page.  */
-                char *paligned_mem = (char *) (((uintptr_t) p
-                                                + sizeof (struct malloc_chunk)
-                                                + psm1) & ~psm1);
-
-                assert ((char *) chunk2mem (p) + 2 * CHUNK_HDR_SZ
-			<= paligned_mem);
-                assert ((char *) p + size > paligned_mem);
-
-                /* This is the size we could potentially free.  */
-                size -= paligned_mem - (char *) p;
-
-                if (size > psm1)
-                  {
-#if MALLOC_DEBUG
-                    /* When debugging we simulate destroying the memory
-                       content.  */
-                    memset (paligned_mem, 0x89, size & ~psm1);
-#endif
-                    __madvise (paligned_mem, size & ~psm1, MADV_DONTNEED);
-
-                    result = 1;
-                  }
-              }
-          }
+	  {
+	    if (in_smallbin_range (chunksize (p)))
+	      continue;
+	    ssize_t r = release_free_pages (p, SIZE_MAX, MADV_DONTNEED);
+	    if (r >= 0)
+	      trim_mark (p) = 1;
+	    if (r > 0)
+	      result = 1;
+	  }
       }
 
 #ifndef MORECORE_CANNOT_TRIM
@@ -4976,6 +6366,101 @@ mtrim (mstate av, size_t pad)
 #endif
 }
 
+/* Advice used for incremental trimming.  MADV_FREE is cheaper than
+   MADV_DONTNEED, both now and when the memory is reused, but older
+   kernels reject it.  Accessed with relaxed atomics, since slices run
+   in different arenas concurrently.  */
+#ifdef MADV_FREE
+static int trim_advice = MADV_FREE;
+#else
+static int trim_advice = MADV_DONTNEED;
+#endif
+
+/* Maximum number of free chunks a slice of incremental trimming looks
+   at, so that bins full of chunks which have been released already do
+   not hold up free.  */
+#define TRIM_SLICE_VISITS 64
+
+/* Forget the free chunk P of AV, whose lock the caller holds, as the
+   place where the next slice of incremental trimming resumes, because
+   P is being taken off its bin.  */
+static __always_inline void
+trim_forget (mstate av, mchunkptr p)
+{
+  if (__glibc_unlikely (av->trim_cursor == p))
+    av->trim_cursor = NULL;
+}
+
+/* Release up to mp_.trim_budget bytes of the free memory of AV.  This
+   is the incremental counterpart of mtrim, called with the arena lock
+   held from free once mp_.trim_budget bytes have been freed into AV.
+   Each call looks at no more than TRIM_SLICE_VISITS chunks and resumes
+   at the chunk after the last one it looked at, so that repeated calls
+   cycle through all bins which can hold whole pages.  Chunks whose
+   pages have been released are marked, and skipped until they are
+   allocated or coalesced.  */
+static void
+trim_slice (mstate av)
+{
+  const size_t ps = GLRO (dl_pagesize);
+  const size_t budget = MAX (mp_.trim_budget, ps);
+  int psindex = bin_index (ps);
+  int i = av->trim_bin;
+  mchunkptr p = av->trim_cursor;
+  size_t released = 0;
+  int visits = 0;
+
+  av->trim_pending = 0;
+
+  for (int n = 0; n < NBINS - psindex + 1; ++n)
+    {
+      if (i != 1 && (i < psindex || i >= NBINS))
+	i = 1;
+
+      mbinptr bin = bin_at (av, i);
+      if (p == NULL)
+	p = last (bin);
+      for (; p != bin; p = p->bk)
+	{
+	  size_t limit = budget - released;
+	  if (limit < ps || visits == TRIM_SLICE_VISITS)
+	    break;
+	  ++visits;
+
+	  /* The unsorted bin also holds small chunks, which are too
+	     small for a mark and have no whole pages anyway.  */
+	  if (in_smallbin_range (chunksize (p)) || trim_mark (p) != 0)
+	    continue;
+
+	  int advice = atomic_load_relaxed (&trim_advice);
+	  ssize_t r = release_free_pages (p, limit, advice);
+	  if (__glibc_unlikely (r < 0) && advice != MADV_DONTNEED)
+	    {
+	      /* The kernel does not support MADV_FREE.  */
+	      atomic_store_relaxed (&trim_advice, MADV_DONTNEED);
+	      r = release_free_pages (p, limit, MADV_DONTNEED);
+	    }
+	  if (r < 0)
+	    continue;
+
+	  released += r;
+	  /* If the limit was reached, the chunk may have more pages,
+	     which the next slice releases.  */
+	  if ((size_t) r < (limit & ~(ps - 1)))
+	    trim_mark (p) = 1;
+	}
+
+      if (p != bin)
+	break;
+      p = NULL;
+      i = i == 1 ? psindex : i + 1;
+    }
+
+  av->trim_bin = i;
+  av->trim_cursor = p;
+  LIBC_PROBE (memory_trim_slice, 3, av, released, i);
+}
+
 
 int
 __malloc_trim (size_t s)
@@ -4991,6 +6476,9 @@ __malloc_trim (size_t s)
       __libc_lock_lock (ar_ptr->mutex);
       result |= mtrim (ar_ptr, s);
       __libc_lock_unlock (ar_ptr->mutex);
+#if IS_IN (libc)
+      result |= mmap_cache_flush (ar_ptr);
+#endif
 
       ar_ptr = ar_ptr->next;
     }
@@ -5060,6 +6548,7 @@ int_mallinfo (mstate av, struct mallinfo2 *m)
   nfastblocks = 0;
   fastavail = 0;
 
+  __libc_lock_lock (av->fastbin_lock);
   for (i = 0; i < NFASTBINS; ++i)
     {
       for (p = fastbin (av, i);
@@ -5073,6 +6562,7 @@ int_mallinfo (mstate av, struct mallinfo2 *m)
           fastavail += chunksize (p);
         }
     }
+  __libc_lock_unlock (av->fastbin_lock);
 
   avail += fastavail;
 
@@ -5275,6 +6765,78 @@ do_set_arena_max (size_t value)
   return 1;
 }
 
+static __always_inline int
+do_set_arena_percpu (int32_t value)
+{
+  LIBC_PROBE (memory_tunable_arena_percpu, 2, value, mp_.arena_percpu);
+  mp_.arena_percpu = value;
+  return 1;
+}
+
+static __always_inline int
+do_set_arena_numa (int32_t value)
+{
+  LIBC_PROBE (memory_tunable_arena_numa, 2, value, mp_.arena_numa);
+  mp_.arena_numa = value;
+  return 1;
+}
+
+static __always_inline int
+do_set_trim_budget (size_t value)
+{
+  LIBC_PROBE (memory_tunable_trim_budget, 2, value, mp_.trim_budget);
+  mp_.trim_budget = value;
+  return 1;
+}
+
+static __always_inline int
+do_set_stats (int32_t value)
+{
+  LIBC_PROBE (memory_tunable_stats, 2, value, mp_.stats);
+  mp_.stats = value;
+  return 1;
+}
+
+static __always_inline int
+do_set_profile_interval (size_t value)
+{
+  LIBC_PROBE (memory_tunable_profile_interval, 2, value,
+	      mp_.profile_interval);
+  mp_.profile_interval = value;
+  return 1;
+}
+
+static __always_inline int
+do_set_profile_signal (int32_t value)
+{
+  LIBC_PROBE (memory_tunable_profile_signal, 2, value, mp_.profile_signal);
+  mp_.profile_signal = value;
+  return 1;
+}
+
+static __always_inline int
+do_set_check_free_size (int32_t value)
+{
+  mp_.check_free_size = value;
+  return 1;
+}
+
+static __always_inline int
+do_set_mmap_cache_size (size_t value)
+{
+  LIBC_PROBE (memory_tunable_mmap_cache_size, 2, value, mp_.mmap_cache_max);
+  mp_.mmap_cache_max = value;
+  return 1;
+}
+
+static __always_inline int
+do_set_mmap_cache_age (size_t value)
+{
+  LIBC_PROBE (memory_tunable_mmap_cache_age, 2, value, mp_.mmap_cache_age);
+  mp_.mmap_cache_age = value;
+  return 1;
+}
+
 #if USE_TCACHE
 static __always_inline int
 do_set_tcache_max (size_t value)
@@ -5308,6 +6870,18 @@ do_set_tcache_unsorted_limit (size_t value)
   mp_.tcache_unsorted_limit = value;
   return 1;
 }
+
+static __always_inline int
+do_set_tcache_batch (size_t value)
+{
+  if (value <= MAX_TCACHE_COUNT)
+    {
+      LIBC_PROBE (memory_tunable_tcache_batch, 2, value, mp_.tcache_batch);
+      mp_.tcache_batch = value;
+      return 1;
+    }
+  return 0;
+}
 #endif
 
 static inline int
@@ -5323,6 +6897,29 @@ do_set_mxfast (size_t value)
   return 0;
 }
 
+#if HAVE_TUNABLES
+static __always_inline int
+do_set_hugetlb (int32_t value)
+{
+  LIBC_PROBE (memory_tunable_hugetlb, 1, value);
+  if (value == 1)
+    {
+      /* Align the heaps to huge pages if the kernel uses them, but only
+	 advise it to in madvise mode, since it uses them for all
+	 anonymous memory in always mode.  */
+      enum malloc_thp_mode_t mode = __malloc_thp_mode ();
+      if (mode == malloc_thp_mode_madvise || mode == malloc_thp_mode_always)
+	{
+	  mp_.thp_pagesize = __malloc_default_thp_pagesize ();
+	  mp_.thp_madvise = mode == malloc_thp_mode_madvise;
+	}
+    }
+  else if (value == 2)
+    __malloc_hugepage_config (&mp_.hp_pagesize, &mp_.hp_flags);
+  return 1;
+}
+#endif
+
 int
 __libc_mallopt (int param_number, int value)
 {
@@ -5629,6 +7226,7 @@ __malloc_info (int options, FILE *fp)
       avail = chunksize (ar_ptr->top);
       nblocks = 1;  /* Top always exists.  */
 
+      __libc_lock_lock (ar_ptr->fastbin_lock);
       for (size_t i = 0; i < NFASTBINS; ++i)
 	{
 	  mchunkptr p = fastbin (ar_ptr, i);
@@ -5657,6 +7255,7 @@ __malloc_info (int options, FILE *fp)
 
 	  sizes[i].total = sizes[i].count * sizes[i].to;
 	}
+      __libc_lock_unlock (ar_ptr->fastbin_lock);
 
 
       mbinptr bin;
@@ -5758,11 +7357,39 @@ __malloc_info (int options, FILE *fp)
 	  total_aspace_mprotect += ar_ptr->system_mem;
 	}
 
+      if (numa_nnodes != 0)
+	fprintf (fp, "<numa node=\"%d\"/>\n", ar_ptr->numa_node);
+
       fputs ("</heap>\n", fp);
       ar_ptr = ar_ptr->next;
     }
   while (ar_ptr != &main_arena);
 
+  if (mp_.stats)
+    {
+      struct malloc_thread_stats sum;
+      stats_collect (&sum);
+
+      fputs ("<stats>\n", fp);
+      for (int i = smallbin_index (MINSIZE); i < NSTATS_CLASSES; ++i)
+	if (sum.classes[i].nmalloc != 0 || sum.classes[i].nfree != 0)
+	  fprintf (fp, "\
+  <class size=\"%zu\" malloc=\"%zu\" free=\"%zu\" tcache=\"%zu\"/>\n",
+		   stats_class_size (i), sum.classes[i].nmalloc,
+		   sum.classes[i].nfree, sum.classes[i].ntcache);
+      fprintf (fp,
+	       "<count type=\"realloc\" count=\"%zu\"/>\n"
+	       "<count type=\"lock-contended\" count=\"%zu\"/>\n"
+	       "<count type=\"mmap\" count=\"%zu\"/>\n"
+	       "<count type=\"munmap\" count=\"%zu\"/>\n"
+	       "<count type=\"mmap-cached\" count=\"%zu\"/>\n"
+	       "<count type=\"mmap-reused\" count=\"%zu\"/>\n"
+	       "<system type=\"sbrk\" size=\"%zu\"/>\n"
+	       "</stats>\n",
+	       sum.nrealloc, sum.nlock_contended, sum.nmmap, sum.nmunmap,
+	       sum.nmmap_cached, sum.nmmap_reused, sum.sbrk_bytes);
+    }
+
   fprintf (fp,
 	   "<total type=\"fast\" count=\"%zu\" size=\"%zu\"/>\n"
 	   "<total type=\"rest\" count=\"%zu\" size=\"%zu\"/>\n"
@@ -5779,11 +7406,72 @@ __malloc_info (int options, FILE *fp)
 
   return 0;
 }
+
+int
+__malloc_stats_query (int version, struct malloc_global_stats *totals,
+		      struct malloc_size_class_stats *classes, size_t nclasses)
+{
+  if (version != MALLOC_STATS_VERSION)
+    {
+      __set_errno (EINVAL);
+      return -1;
+    }
+
+  if (!__malloc_initialized)
+    ptmalloc_init ();
+
+  if (!mp_.stats)
+    {
+      __set_errno (ENOTSUP);
+      return -1;
+    }
+
+  struct malloc_thread_stats sum;
+  stats_collect (&sum);
+
+  /* Chunks smaller than MINSIZE do not exist, so the classes below it
+     are not reported.  */
+  int first = smallbin_index (MINSIZE);
+  struct malloc_global_stats g =
+    {
+      .nrealloc = sum.nrealloc,
+      .nlock_contended = sum.nlock_contended,
+      .nmmap = sum.nmmap,
+      .nmunmap = sum.nmunmap,
+      .nmmap_cached = sum.nmmap_cached,
+      .nmmap_reused = sum.nmmap_reused,
+      .sbrk_bytes = sum.sbrk_bytes
+    };
+  for (int i = first; i < NSTATS_CLASSES; ++i)
+    {
+      if ((size_t) (i - first) < nclasses && classes != NULL)
+	{
+	  classes[i - first] = (struct malloc_size_class_stats) { 0 };
+	  classes[i - first].size = stats_class_size (i);
+	  classes[i - first].nmalloc = sum.classes[i].nmalloc;
+	  classes[i - first].nfree = sum.classes[i].nfree;
+	  classes[i - first].ntcache = sum.classes[i].ntcache;
+	}
+      g.nmalloc += sum.classes[i].nmalloc;
+      g.nfree += sum.classes[i].nfree;
+      g.ntcache += sum.classes[i].ntcache;
+    }
+
+  if (totals != NULL)
+    *totals = g;
+
+  return NSTATS_CLASSES - first;
+}
 #if IS_IN (libc)
 weak_alias (__malloc_info, malloc_info)
+weak_alias (__malloc_stats_query, malloc_stats_query)
 
 strong_alias (__libc_calloc, __calloc) weak_alias (__libc_calloc, calloc)
 strong_alias (__libc_free, __free) strong_alias (__libc_free, free)
+weak_alias (__libc_free_sized, free_sized)
+weak_alias (__libc_free_aligned_sized, free_aligned_sized)
+weak_alias (__libc_malloc_batch, malloc_batch)
+weak_alias (__libc_free_batch, free_batch)
 strong_alias (__libc_malloc, __malloc) strong_alias (__libc_malloc, malloc)
 strong_alias (__libc_memalign, __memalign)
 weak_alias (__libc_memalign, memalign)
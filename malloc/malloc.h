@@ -62,6 +62,15 @@ extern void *reallocarray (void *__ptr, size_t __nmemb, size_t __size)
 /* Free a block allocated by `malloc', `realloc' or `calloc'.  */
 extern void free (void *__ptr) __THROW;
 
+/* Allocate __N blocks of __SIZE bytes each and store them in __PTRS.
+   Return the number of blocks allocated, which is less than __N only if
+   memory ran out.  */
+extern size_t malloc_batch (size_t __size, size_t __n, void **__ptrs)
+  __THROW __nonnull ((3)) __wur;
+
+/* Free the __N blocks in __PTRS, skipping null pointers.  */
+extern void free_batch (void **__ptrs, size_t __n) __THROW __nonnull ((1));
+
 /* Allocate SIZE bytes allocated to ALIGNMENT bytes.  */
 extern void *memalign (size_t __alignment, size_t __size)
   __THROW __attribute_malloc__ __attribute_alloc_size__ ((2)) __wur
@@ -156,5 +165,46 @@ extern void malloc_stats (void) __THROW;
 /* Output information about state of allocator to stream FP.  */
 extern int malloc_info (int __options, FILE *__fp) __THROW;
 
+/* Counters for the allocations of one size class.  */
+struct malloc_size_class_stats
+{
+  size_t size;     /* largest request size in this class */
+  size_t nmalloc;  /* number of allocations */
+  size_t nfree;    /* number of deallocations */
+  size_t ntcache;  /* allocations served from the thread cache */
+  size_t __reserved[4];
+};
+
+/* Process-wide allocator counters.  */
+struct malloc_global_stats
+{
+  size_t nmalloc;          /* number of allocations */
+  size_t nfree;            /* number of deallocations */
+  size_t nrealloc;         /* number of reallocations */
+  size_t ntcache;          /* allocations served from the thread cache */
+  size_t nlock_contended;  /* arena lock acquisitions which had to wait */
+  size_t nmmap;            /* chunks allocated with mmap */
+  size_t nmunmap;          /* chunks released with munmap */
+  size_t nmmap_cached;     /* mmapped chunks kept in the cache when freed */
+  size_t nmmap_reused;     /* mmapped chunks reused from the cache */
+  size_t sbrk_bytes;       /* growth of the main heap with sbrk */
+  size_t __reserved[6];
+};
+
+/* Layout of the structures above.  The reserved members leave room for
+   counters added later, which are only filled in for callers passing
+   the version which introduced them.  */
+#define MALLOC_STATS_VERSION 1
+
+/* Store the counters collected when the glibc.malloc.stats tunable is
+   enabled in *__TOTALS, and those of the first __NCLASSES size classes
+   in __CLASSES.  Either pointer may be null.  __VERSION must be
+   MALLOC_STATS_VERSION.  Return the number of size classes, or -1 if
+   the counters are not collected or __VERSION is not supported.  */
+extern int malloc_stats_query (int __version,
+			       struct malloc_global_stats *__totals,
+			       struct malloc_size_class_stats *__classes,
+			       size_t __nclasses) __THROW;
+
 __END_DECLS
 #endif /* malloc.h */
@@ -26,14 +26,229 @@
 #include <string.h>
 #include <stdlib.h>
 #include <inttypes.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
 
+#include <atomic.h>
 #include <libc-internal.h>
 #include <dso_handle.h>
+#include <register-atfork.h>
 
 #include <kernel-features.h>
 
 static FILE *mallstream;
 static const char mallenv[] = "MALLOC_TRACE";
+static const char mallformatenv[] = "MALLOC_TRACE_FORMAT";
+
+/* Binary trace mode, selected with MALLOC_TRACE_FORMAT=binary.  Instead
+   of formatting every event under the stream lock, each thread appends
+   fixed-size records to a private buffer and writes the buffer to the
+   trace file in one go once it is full.  Records from different threads
+   are therefore not in chronological order in the file; the mtrace
+   script sorts them by timestamp when converting them back to text.  */
+
+#define MTRACE_BINARY_MAGIC "\177MTRACEB"
+/* Version 2 added the align member to struct mtrace_binary_record.  */
+#define MTRACE_BINARY_VERSION 2
+
+struct mtrace_binary_header
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t record_size;
+};
+
+struct mtrace_binary_record
+{
+  uint64_t timestamp;		/* CLOCK_MONOTONIC, in nanoseconds.  */
+  uint64_t ptr;
+  uint64_t size;
+  uint64_t caller;		/* Zero if not known.  */
+  uint32_t tid;
+  uint32_t op;			/* One of '+', '-', '<', '>' or '!'.  */
+  uint64_t align;		/* Alignment passed to memalign, else zero.  */
+};
+
+#define MTRACE_BUFFER_RECORDS 1024
+
+struct mtrace_buffer
+{
+  /* All buffers ever allocated, newest first.  Buffers are never
+     unmapped; the buffer of an exited thread is reused by the next
+     thread that starts tracing.  */
+  struct mtrace_buffer *next;
+  int in_use;
+  pid_t tid;
+  unsigned int used;
+  struct mtrace_binary_record records[MTRACE_BUFFER_RECORDS];
+};
+
+static int mtrace_fd = -1;
+static struct mtrace_buffer *mtrace_buffers;
+static __thread struct mtrace_buffer *mtrace_thread_buffer;
+static pthread_key_t mtrace_key;
+
+static void
+mtrace_flush (struct mtrace_buffer *buf)
+{
+  const char *p = (const char *) buf->records;
+  size_t len = buf->used * sizeof (struct mtrace_binary_record);
+
+  buf->used = 0;
+  /* The file is opened with O_APPEND, so a complete buffer written by
+     one thread is never interleaved with records of another one.  */
+  while (len > 0)
+    {
+      ssize_t n = write (mtrace_fd, p, len);
+      if (n <= 0)
+	break;
+      p += n;
+      len -= n;
+    }
+}
+
+static void
+mtrace_flush_all (void)
+{
+  for (struct mtrace_buffer *buf = atomic_load_acquire (&mtrace_buffers);
+       buf != NULL; buf = buf->next)
+    mtrace_flush (buf);
+}
+
+/* Thread exit handler, registered as the mtrace_key destructor.  */
+static void
+mtrace_thread_exit (void *arg)
+{
+  struct mtrace_buffer *buf = arg;
+
+  mtrace_flush (buf);
+  mtrace_thread_buffer = NULL;
+  atomic_store_release (&buf->in_use, 0);
+}
+
+static void
+mtrace_fork_child (void)
+{
+  /* Records still buffered belong to the parent, which will write them
+     itself, and the buffers of the other threads are free again.  */
+  for (struct mtrace_buffer *buf = mtrace_buffers; buf != NULL;
+       buf = buf->next)
+    {
+      buf->used = 0;
+      if (buf != mtrace_thread_buffer)
+	buf->in_use = 0;
+    }
+  if (mtrace_thread_buffer != NULL)
+    mtrace_thread_buffer->tid = gettid ();
+}
+
+static struct mtrace_buffer *
+mtrace_get_buffer (void)
+{
+  struct mtrace_buffer *buf = mtrace_thread_buffer;
+  if (__glibc_likely (buf != NULL))
+    return buf;
+
+  for (buf = atomic_load_acquire (&mtrace_buffers); buf != NULL;
+       buf = buf->next)
+    {
+      int expected = 0;
+      if (atomic_load_relaxed (&buf->in_use) == 0
+	  && atomic_compare_exchange_weak_acquire (&buf->in_use, &expected, 1))
+	break;
+    }
+
+  if (buf == NULL)
+    {
+      buf = mmap (NULL, sizeof (*buf), PROT_READ | PROT_WRITE,
+		  MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (buf == MAP_FAILED)
+	return NULL;
+      buf->in_use = 1;
+      struct mtrace_buffer *head = atomic_load_relaxed (&mtrace_buffers);
+      do
+	buf->next = head;
+      while (!atomic_compare_exchange_weak_release (&mtrace_buffers, &head,
+						    buf));
+    }
+
+  buf->tid = gettid ();
+  buf->used = 0;
+  /* Set the TLS pointer first: pthread_setspecific may itself allocate
+     and thus record an event.  */
+  mtrace_thread_buffer = buf;
+  pthread_setspecific (mtrace_key, buf);
+  return buf;
+}
+
+static void
+mtrace_record (int op, const void *ptr, size_t size, size_t align,
+	       const void *caller)
+{
+  struct mtrace_buffer *buf = mtrace_get_buffer ();
+  if (buf == NULL)
+    return;
+
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+
+  struct mtrace_binary_record *r = &buf->records[buf->used];
+  r->timestamp = ts.tv_sec * UINT64_C (1000000000) + ts.tv_nsec;
+  r->ptr = (uintptr_t) ptr;
+  r->size = size;
+  r->caller = (uintptr_t) caller;
+  r->tid = buf->tid;
+  r->op = op;
+  r->align = align;
+
+  if (++buf->used == MTRACE_BUFFER_RECORDS)
+    mtrace_flush (buf);
+}
+
+/* Write out whatever is still buffered when the library is unloaded,
+   which happens after all atexit handlers have run.  */
+static void
+__attribute__ ((destructor))
+mtrace_binary_fini (void)
+{
+  if (mtrace_fd != -1)
+    mtrace_flush_all ();
+}
+
+static bool
+mtrace_binary_start (const char *mallfile)
+{
+  static bool initialized;
+
+  mtrace_fd = open (mallfile, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND
+				| O_CLOEXEC, 0666);
+  if (mtrace_fd == -1)
+    return false;
+
+  struct mtrace_binary_header header =
+    {
+      .magic = MTRACE_BINARY_MAGIC,
+      .version = MTRACE_BINARY_VERSION,
+      .record_size = sizeof (struct mtrace_binary_record)
+    };
+  if (write (mtrace_fd, &header, sizeof (header)) != sizeof (header))
+    {
+      close (mtrace_fd);
+      mtrace_fd = -1;
+      return false;
+    }
+
+  if (!initialized)
+    {
+      initialized = true;
+      pthread_key_create (&mtrace_key, mtrace_thread_exit);
+      __register_atfork (NULL, NULL, mtrace_fork_child, __dso_handle);
+    }
+  return true;
+}
 
 static void
 tr_where (const void *caller, Dl_info *info)
@@ -91,6 +306,12 @@ free_mtrace (void *ptr, const void *caller)
   if (ptr == NULL)
     return;
 
+  if (mtrace_fd != -1)
+    {
+      mtrace_record ('-', ptr, 0, 0, caller);
+      return;
+    }
+
   Dl_info mem;
   Dl_info *info = lock_and_info (caller, &mem);
   tr_where (caller, info);
@@ -102,6 +323,12 @@ free_mtrace (void *ptr, const void *caller)
 static void
 malloc_mtrace_after (void *block, size_t size, const void *caller)
 {
+  if (mtrace_fd != -1)
+    {
+      mtrace_record ('+', block, size, 0, caller);
+      return;
+    }
+
   Dl_info mem;
   Dl_info *info = lock_and_info (caller, &mem);
 
@@ -116,6 +343,20 @@ static void
 realloc_mtrace_after (void *block, const void *oldptr, size_t size,
 		      const void *caller)
 {
+  if (mtrace_fd != -1)
+    {
+      if (block == NULL)
+	mtrace_record (size != 0 ? '!' : '-', oldptr, size, 0, caller);
+      else if (oldptr == NULL)
+	mtrace_record ('+', block, size, 0, caller);
+      else
+	{
+	  mtrace_record ('<', oldptr, 0, 0, caller);
+	  mtrace_record ('>', block, size, 0, caller);
+	}
+      return;
+    }
+
   Dl_info mem;
   Dl_info *info = lock_and_info (caller, &mem);
 
@@ -141,8 +382,15 @@ realloc_mtrace_after (void *block, const void *oldptr, size_t size,
 }
 
 static void
-memalign_mtrace_after (void *block, size_t size, const void *caller)
+memalign_mtrace_after (void *block, size_t alignment, size_t size,
+		       const void *caller)
 {
+  if (mtrace_fd != -1)
+    {
+      mtrace_record ('+', block, size, alignment, caller);
+      return;
+    }
+
   Dl_info mem;
   Dl_info *info = lock_and_info (caller, &mem);
 
@@ -160,7 +408,7 @@ static void
 release_libc_mem (void)
 {
   /* Only call the free function if we still are running in mtrace mode.  */
-  if (mallstream != NULL)
+  if (mallstream != NULL || mtrace_fd != -1)
     __libc_freeres ();
 }
 
@@ -173,20 +421,32 @@ do_mtrace (void)
   char *mallfile;
 
   /* Don't panic if we're called more than once.  */
-  if (mallstream != NULL)
+  if (mallstream != NULL || mtrace_fd != -1)
     return;
 
   mallfile = secure_getenv (mallenv);
   if (mallfile != NULL)
     {
-      mallstream = fopen (mallfile != NULL ? mallfile : "/dev/null", "wce");
-      if (mallstream != NULL)
-        {
-          /* Be sure it doesn't malloc its buffer!  */
-	  static char tracebuf [512];
+      const char *format = secure_getenv (mallformatenv);
+      bool started;
 
-	  setvbuf (mallstream, tracebuf, _IOFBF, sizeof (tracebuf));
-          fprintf (mallstream, "= Start\n");
+      if (format != NULL && strcmp (format, "binary") == 0)
+	started = mtrace_binary_start (mallfile);
+      else
+	{
+	  mallstream = fopen (mallfile, "wce");
+	  started = mallstream != NULL;
+	}
+      if (started)
+        {
+	  if (mallstream != NULL)
+	    {
+	      /* Be sure it doesn't malloc its buffer!  */
+	      static char tracebuf [512];
+
+	      setvbuf (mallstream, tracebuf, _IOFBF, sizeof (tracebuf));
+	      fprintf (mallstream, "= Start\n");
+	    }
           if (!added_atexit_handler)
             {
               added_atexit_handler = 1;
@@ -202,6 +462,19 @@ static void
 do_muntrace (void)
 {
   __malloc_debug_disable (MALLOC_MTRACE_HOOK);
+
+  if (mtrace_fd != -1)
+    {
+      /* Threads still running may be appending to their buffers while
+	 they are written out; as in text mode, muntrace should only be
+	 called once the other threads are done allocating.  */
+      int fd = mtrace_fd;
+      mtrace_flush_all ();
+      mtrace_fd = -1;
+      close (fd);
+      return;
+    }
+
   if (mallstream == NULL)
     return;
 
@@ -26,6 +26,7 @@ $progname = $0;
 
 sub usage {
     print "Usage: mtrace [OPTION]... [Binary] MtraceData\n";
+    print "  --dump       print MtraceData in text form, then exit\n";
     print "  --help       print this help, then exit\n";
     print "  --version    print version number, then exit\n";
     print "\n";
@@ -53,6 +54,10 @@ arglist: while (@ARGV) {
     } elsif ($ARGV[0] eq "--h" || $ARGV[0] eq "--he" || $ARGV[0] eq "--hel" ||
 	     $ARGV[0] eq "--help") {
 	&usage;
+    } elsif ($ARGV[0] eq "--d" || $ARGV[0] eq "--du" || $ARGV[0] eq "--dum" ||
+	     $ARGV[0] eq "--dump") {
+	$dump=1;
+	shift @ARGV;
     } elsif ($ARGV[0] =~ /^-/) {
 	print "$progname: unrecognized option `$ARGV[0]'\n";
 	print "Try `$progname --help' for more information.\n";
@@ -91,6 +96,112 @@ if ($#ARGV == 0) {
     die "Wrong number of arguments, run $progname --help for help.";
 }
 
+# Read a trace written with MALLOC_TRACE_FORMAT=binary and pass it to
+# the function EMIT one line in the text format at a time.  Every thread
+# writes its records in blocks, so the file consists of runs of records
+# in chronological order, which are merged by timestamp; records with
+# equal timestamps keep their order in the file.  Only the position of
+# each run and a few records of it are kept in memory.
+sub binary_trace {
+    my ($file, $emit) = @_;
+    my ($header, $chunk, $rec);
+
+    open(BIN, "<$file") || die "Cannot open mtrace data file";
+    binmode(BIN);
+    read(BIN, $header, 16);
+    my ($magic, $version, $size) = unpack("a8 L L", $header);
+    if ($version != 2 || $size < 48) {
+	die "$file: unsupported binary trace version";
+    }
+
+    # Find the runs: a run ends where the thread changes or time goes
+    # backwards.
+    my (@start, @left);
+    my ($nrecs, $last_time, $last_tid) = (0, 0, 0);
+    while (read(BIN, $chunk, $size * 1024) >= $size) {
+	for (my $off = 0; $off + $size <= length($chunk); $off += $size) {
+	    my ($time, $tid) = unpack("Q x24 L", substr($chunk, $off, $size));
+	    if ($nrecs == 0 || $tid != $last_tid || $time < $last_time) {
+		push(@start, $nrecs);
+		push(@left, 0);
+	    }
+	    $left[-1]++;
+	    ($last_time, $last_tid) = ($time, $tid);
+	    $nrecs++;
+	}
+    }
+
+    # Read up to 64 records of run R into its buffer.
+    my (@buf, @next);
+    my $fill = sub {
+	my $r = shift;
+	my $n = $left[$r] < 64 ? $left[$r] : 64;
+	seek(BIN, 16 + $next[$r] * $size, 0);
+	read(BIN, $buf[$r], $n * $size);
+	$next[$r] += $n;
+	$left[$r] -= $n;
+    };
+
+    # A binary heap of [timestamp, record number, run], ordered by
+    # timestamp and then record number.
+    my @heap;
+    my $less = sub {
+	my ($x, $y) = @_;
+	return $x->[0] < $y->[0] || ($x->[0] == $y->[0] && $x->[1] < $y->[1]);
+    };
+    my $push = sub {
+	my $e = shift;
+	my $i = scalar(@heap);
+	push(@heap, $e);
+	while ($i > 0) {
+	    my $p = ($i - 1) >> 1;
+	    last if (!&$less($heap[$i], $heap[$p]));
+	    @heap[$i, $p] = @heap[$p, $i];
+	    $i = $p;
+	}
+    };
+    my $pop = sub {
+	my $top = $heap[0];
+	my $last = pop(@heap);
+	if (@heap) {
+	    $heap[0] = $last;
+	    my $i = 0;
+	    while (1) {
+		my ($l, $r, $m) = (2 * $i + 1, 2 * $i + 2, $i);
+		$m = $l if ($l < @heap && &$less($heap[$l], $heap[$m]));
+		$m = $r if ($r < @heap && &$less($heap[$r], $heap[$m]));
+		last if ($m == $i);
+		@heap[$i, $m] = @heap[$m, $i];
+		$i = $m;
+	    }
+	}
+	return $top;
+    };
+
+    for (my $r = 0; $r <= $#start; $r++) {
+	$next[$r] = $start[$r];
+	&$fill($r);
+	&$push([unpack("Q", $buf[$r]), $start[$r], $r]);
+    }
+
+    &$emit("= Start\n");
+    while (@heap) {
+	my ($time, $seq, $r) = @{&$pop()};
+	$rec = substr($buf[$r], 0, $size, "");
+	my ($ptr, $len, $caller, $tid, $op) = unpack("x8 Q Q Q L L", $rec);
+	$op = chr($op);
+	my $line = "";
+	$line = sprintf("@ [0x%x] ", $caller) if ($caller != 0);
+	$line .= "$op " . ($ptr != 0 ? sprintf("0x%x", $ptr) : "(nil)");
+	$line .= sprintf(" %#x", $len) if ($op eq "+" || $op eq ">" || $op eq "!");
+	&$emit("$line\n");
+
+	&$fill($r) if ($buf[$r] eq "" && $left[$r] > 0);
+	&$push([unpack("Q", $buf[$r]), $seq + 1, $r]) if ($buf[$r] ne "");
+    }
+    close(BIN);
+}
+
 sub location {
     my $str = pop(@_);
     return $str if ($str eq "");
@@ -142,8 +253,14 @@ sub location {
 }
 
 $nr=0;
-open(DATA, "<$data") || die "Cannot open mtrace data file";
-while (<DATA>) {
+sub process_line {
+    local $_ = shift;
+
+    if ($dump) {
+	print;
+	return;
+    }
+
     my @cols = split (' ');
     my $n, $where;
     if ($cols[0] eq "@") {
@@ -212,7 +329,23 @@ while (<DATA>) {
 	}
     }
 }
-close (DATA);
+
+open(DATA, "<$data") || die "Cannot open mtrace data file";
+binmode(DATA);
+read(DATA, $magic, 8);
+if ($magic eq "\177MTRACEB") {
+    close (DATA);
+    &binary_trace($data, \&process_line);
+} else {
+    # Traces can be large, so they are processed line by line.
+    seek(DATA, 0, 0);
+    while (<DATA>) {
+	&process_line($_);
+    }
+    close (DATA);
+}
+
+exit 0 if ($dump);
 
 # Now print all remaining entries.
 @addrs= keys %allocated;
@@ -0,0 +1,139 @@
+/* Test free_sized and free_aligned_sized.
+   Copyright (C) 2021 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <support/capture_subprocess.h>
+#include <support/check.h>
+
+/* The test runs with glibc.malloc.check_free_size=1, so every call with
+   a correct size also passes through the header check.  */
+
+static const size_t sizes[] = { 1, 24, 100, 1000, 5000, 200000, 1 << 20 };
+
+static void
+test_malloc (void)
+{
+  for (int i = 0; i < sizeof (sizes) / sizeof (sizes[0]); i++)
+    {
+      void *p = malloc (sizes[i]);
+      TEST_VERIFY_EXIT (p != NULL);
+      memset (p, 0xa5, sizes[i]);
+      free_sized (p, sizes[i]);
+
+      /* A block freed into the thread cache is handed out again.  */
+      if (sizes[i] <= 1000)
+	{
+	  void *q = malloc (sizes[i]);
+	  TEST_VERIFY (q == p);
+	  free_sized (q, sizes[i]);
+	}
+    }
+
+  free_sized (NULL, 0);
+  free_sized (NULL, 100);
+}
+
+static void
+test_calloc_realloc (void)
+{
+  void *p = calloc (10, 10);
+  TEST_VERIFY_EXIT (p != NULL);
+  free_sized (p, 100);
+
+  /* Shrinking may leave a remainder too small to be split off.  */
+  for (size_t size = 8; size < 256; size += 8)
+    {
+      p = malloc (size + 24);
+      TEST_VERIFY_EXIT (p != NULL);
+      p = realloc (p, size);
+      TEST_VERIFY_EXIT (p != NULL);
+      free_sized (p, size);
+    }
+
+  p = malloc (10);
+  TEST_VERIFY_EXIT (p != NULL);
+  p = realloc (p, 300000);
+  TEST_VERIFY_EXIT (p != NULL);
+  free_sized (p, 300000);
+}
+
+static void
+test_aligned (void)
+{
+  static const size_t alignments[] = { 8, 16, 64, 256, 4096, 65536 };
+
+  for (int i = 0; i < sizeof (alignments) / sizeof (alignments[0]); i++)
+    for (int j = 0; j < sizeof (sizes) / sizeof (sizes[0]); j++)
+      {
+	void *p = aligned_alloc (alignments[i], sizes[j]);
+	TEST_VERIFY_EXIT (p != NULL);
+	free_aligned_sized (p, alignments[i], sizes[j]);
+      }
+}
+
+static void
+free_too_large (void *closure)
+{
+  void *p = malloc (32);
+  free_sized (p, 4096);
+}
+
+static void
+free_too_small (void *closure)
+{
+  void *p = malloc (4096);
+  free_sized (p, 16);
+}
+
+static void
+free_misaligned (void *closure)
+{
+  void *p = aligned_alloc (64, 64);
+  free_aligned_sized ((char *) p + 16, 64, 48);
+}
+
+static void
+check_abort (void (*callback) (void *), const char *expected)
+{
+  struct support_capture_subprocess result
+    = support_capture_subprocess (callback, NULL);
+
+  TEST_COMPARE_STRING (result.err.buffer, expected);
+  TEST_VERIFY (WIFSIGNALED (result.status)
+	       && WTERMSIG (result.status) == SIGABRT);
+  support_capture_subprocess_free (&result);
+}
+
+static int
+do_test (void)
+{
+  test_malloc ();
+  test_calloc_realloc ();
+  test_aligned ();
+
+  check_abort (free_too_large, "free_sized(): invalid size\n");
+  check_abort (free_too_small, "free_sized(): invalid size\n");
+  check_abort (free_misaligned, "free_aligned_sized(): invalid pointer\n");
+
+  return 0;
+}
+
+#include <support/test-driver.c>
@@ -0,0 +1,178 @@
+/* Test NUMA-aware arena selection (glibc.malloc.arena_numa).
+   Copyright (C) 2021 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+/* Start one thread per CPU the process may run on, pinned to that CPU,
+   and check that the arena of each thread belongs to the NUMA node the
+   thread runs on: the node is listed by malloc_info, and the memory
+   policy of the blocks of the thread prefers that node.  Then move
+   every thread to the next CPU, so that threads cross node boundaries,
+   and check that memory allocated before the move can be freed and
+   reallocated afterwards.  On a single-node machine (or without fake
+   NUMA) this only checks that the tunable does not break allocation.  */
+
+#include <sched.h>
+#include <stdio.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "tst-malloc-arena-shared.h"
+
+enum
+  {
+    /* Upper bound on the number of threads started.  */
+    max_threads = 64,
+
+    /* Size of the node mask passed to get_mempolicy, in bits.  */
+    max_nodes = 1024,
+  };
+
+static int cpus[max_threads];
+static int ncpus;
+
+/* Node each thread ran on before it was moved, or -1.  */
+static int nodes[max_threads];
+
+/* Node preferred by the memory policy of the first block each thread
+   allocated, see preferred_node.  */
+static int preferred[max_threads];
+
+static void
+pin_to_cpu (int cpu)
+{
+  cpu_set_t set;
+  CPU_ZERO (&set);
+  CPU_SET (cpu, &set);
+  if (sched_setaffinity (0, sizeof (set), &set) != 0)
+    FAIL_EXIT1 ("sched_setaffinity (%d): %m", cpu);
+}
+
+/* Return the node preferred by the memory policy of the page containing
+   ADDR, -1 if the policy does not prefer a single node, or -2 if the
+   policy cannot be queried.  */
+static int
+preferred_node (void *addr)
+{
+#ifdef SYS_get_mempolicy
+  /* MPOL_PREFERRED and MPOL_F_ADDR from <linux/mempolicy.h>.  */
+  enum { mpol_preferred = 1, mpol_f_addr = 2 };
+  unsigned long int mask[max_nodes / (8 * sizeof (unsigned long int))]
+    = { 0 };
+  int mode;
+  if (syscall (SYS_get_mempolicy, &mode, mask, max_nodes, addr,
+	       mpol_f_addr) != 0)
+    return -2;
+  if (mode != mpol_preferred)
+    return -1;
+  for (int node = 0; node < max_nodes; ++node)
+    if (mask[node / (8 * sizeof (unsigned long int))]
+	& (1UL << (node % (8 * sizeof (unsigned long int)))))
+      return node;
+  return -1;
+#else
+  return -2;
+#endif
+}
+
+static void *
+allocation_thread_function (void *closure)
+{
+  int index = (intptr_t) closure;
+  void *ptrs[allocation_count];
+
+  pin_to_cpu (cpus[index]);
+  unsigned int cpu, node;
+  nodes[index] = getcpu (&cpu, &node) == 0 ? node : -1;
+
+  allocate_blocks (ptrs, index);
+  preferred[index] = preferred_node (ptrs[0]);
+
+  /* Keep the allocations alive until all threads have run, so that
+     no arena is released to the free list and reused.  */
+  xpthread_barrier_wait (&barrier);
+  xpthread_barrier_wait (&barrier);
+
+  /* Move to another CPU, possibly on another node, and free the blocks
+     allocated before the move, interleaved with new allocations.  */
+  pin_to_cpu (cpus[(index + 1) % ncpus]);
+  for (int i = 0; i < allocation_count; ++i)
+    {
+      for (int j = 0; j < 16; ++j)
+	TEST_COMPARE (((unsigned char *) ptrs[i])[j], index);
+      free (ptrs[i]);
+      ptrs[i] = xmalloc (16 + (i % 32) * 96);
+      memset (ptrs[i], index, 16);
+    }
+  for (int i = 0; i < allocation_count; ++i)
+    free (ptrs[i]);
+
+  return NULL;
+}
+
+static int
+do_test (void)
+{
+  cpu_set_t set;
+  if (sched_getaffinity (0, sizeof (set), &set) != 0)
+    FAIL_EXIT1 ("sched_getaffinity: %m");
+  for (int cpu = 0; cpu < CPU_SETSIZE && ncpus < max_threads; ++cpu)
+    if (CPU_ISSET (cpu, &set))
+      cpus[ncpus++] = cpu;
+  TEST_VERIFY_EXIT (ncpus >= 1);
+
+  pthread_t *threads = start_threads (ncpus, allocation_thread_function);
+
+  xpthread_barrier_wait (&barrier);
+
+  int narenas = count_arenas ();
+  int nnuma = count_malloc_info ("<numa node=");
+  printf ("info: %d threads, %d arenas, %d with a node\n",
+	  ncpus, narenas, nnuma);
+
+  /* The arenas only have nodes on a machine with several nodes.  */
+  if (nnuma > 0)
+    {
+      TEST_COMPARE (nnuma, narenas);
+      for (int i = 0; i < ncpus; ++i)
+	{
+	  if (nodes[i] < 0)
+	    continue;
+	  char needle[32];
+	  snprintf (needle, sizeof (needle), "<numa node=\"%d\"/>", nodes[i]);
+	  if (count_malloc_info (needle) == 0)
+	    {
+	      support_record_failure ();
+	      printf ("error: no arena on node %d of CPU %d\n",
+		      nodes[i], cpus[i]);
+	    }
+	  if (preferred[i] != -2 && preferred[i] != nodes[i])
+	    {
+	      support_record_failure ();
+	      printf ("error: memory of the thread on CPU %d prefers node %d,"
+		      " not %d\n", cpus[i], preferred[i], nodes[i]);
+	    }
+	}
+    }
+
+  xpthread_barrier_wait (&barrier);
+
+  join_threads (threads, ncpus);
+
+  return 0;
+}
+
+#include <support/test-driver.c>
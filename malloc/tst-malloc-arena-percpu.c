@@ -0,0 +1,69 @@
+/* Test per-CPU arena selection (glibc.malloc.arena_percpu).
+   Copyright (C) 2021 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+/* Run many more threads than there are CPUs and check that the number
+   of arenas reported by malloc_info stays bounded by the CPU count
+   instead of growing with the number of threads.  */
+
+#include <stdio.h>
+#include <sys/sysinfo.h>
+
+#include "tst-malloc-arena-shared.h"
+
+static void *
+allocation_thread_function (void *closure)
+{
+  void *ptrs[allocation_count];
+
+  allocate_blocks (ptrs, 0xa5);
+
+  /* Keep the allocations alive until all threads have run, so that
+     no arena is released to the free list and reused.  */
+  xpthread_barrier_wait (&barrier);
+
+  free_blocks (ptrs, 0xa5);
+  return NULL;
+}
+
+static int
+do_test (void)
+{
+  int ncpus = get_nprocs_conf ();
+  int thread_count = 4 * ncpus;
+  if (thread_count < 16)
+    thread_count = 16;
+  if (thread_count > 256)
+    thread_count = 256;
+
+  pthread_t *threads = start_threads (thread_count,
+				      allocation_thread_function);
+
+  xpthread_barrier_wait (&barrier);
+
+  int narenas = count_arenas ();
+  printf ("info: %d threads, %d CPUs, %d arenas\n",
+	  thread_count, ncpus, narenas);
+  TEST_VERIFY (narenas >= 1);
+  TEST_VERIFY (narenas <= ncpus);
+
+  join_threads (threads, thread_count);
+
+  return 0;
+}
+
+#include <support/test-driver.c>
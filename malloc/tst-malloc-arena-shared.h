@@ -0,0 +1,115 @@
+/* Shared definitions for the arena selection tests.
+   Copyright (C) 2021 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+#include <malloc.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <support/check.h>
+#include <support/support.h>
+#include <support/xmemstream.h>
+#include <support/xthread.h>
+
+/* The threads of a test and the main thread wait on this barrier.  */
+static pthread_barrier_t barrier;
+
+enum
+  {
+    /* Number of allocations performed by each thread per phase.  */
+    allocation_count = 500,
+  };
+
+/* Allocate allocation_count blocks of varying sizes into PTRS, and fill
+   the first 16 bytes of each with BYTE.  */
+static void
+allocate_blocks (void **ptrs, int byte)
+{
+  for (int i = 0; i < allocation_count; ++i)
+    {
+      ptrs[i] = xmalloc (16 + (i % 64) * 48);
+      memset (ptrs[i], byte, 16);
+    }
+}
+
+/* Check that the blocks in PTRS still start with BYTE and free them.  */
+static void
+free_blocks (void **ptrs, int byte)
+{
+  for (int i = 0; i < allocation_count; ++i)
+    {
+      for (int j = 0; j < 16; ++j)
+	TEST_COMPARE (((unsigned char *) ptrs[i])[j], byte);
+      free (ptrs[i]);
+    }
+}
+
+/* Return the malloc_info output.  The caller frees it.  */
+static char *
+malloc_info_string (void)
+{
+  struct xmemstream stream;
+  xopen_memstream (&stream);
+  TEST_COMPARE (malloc_info (0, stream.out), 0);
+  xfclose_memstream (&stream);
+  return stream.buffer;
+}
+
+/* Return the number of times NEEDLE occurs in the malloc_info
+   output.  */
+static int
+count_malloc_info (const char *needle)
+{
+  char *info = malloc_info_string ();
+  int count = 0;
+  for (const char *p = info; (p = strstr (p, needle)) != NULL; ++p)
+    ++count;
+  free (info);
+  return count;
+}
+
+/* Return the number of arenas described in the malloc_info output.  */
+static int
+count_arenas (void)
+{
+  return count_malloc_info ("<heap nr=");
+}
+
+/* Start COUNT threads running FUNCTION with the arguments 0 to
+   COUNT - 1, and set up the barrier for them and the main thread.  The
+   caller frees the returned array with join_threads.  */
+static pthread_t *
+start_threads (int count, void *(*function) (void *))
+{
+  xpthread_barrier_init (&barrier, NULL, count + 1);
+
+  pthread_t *threads = xcalloc (count, sizeof (*threads));
+  for (int i = 0; i < count; ++i)
+    threads[i] = xpthread_create (NULL, function, (void *) (intptr_t) i);
+  return threads;
+}
+
+/* Wait for the COUNT THREADS started by start_threads.  */
+static void
+join_threads (pthread_t *threads, int count)
+{
+  for (int i = 0; i < count; ++i)
+    xpthread_join (threads[i]);
+  free (threads);
+
+  xpthread_barrier_destroy (&barrier);
+}
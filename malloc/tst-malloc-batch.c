@@ -0,0 +1,131 @@
+/* Test malloc_batch and free_batch.
+   Copyright (C) 2021 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+#include <errno.h>
+#include <malloc.h>
+#include <malloc-size.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <support/check.h>
+#include <support/xthread.h>
+
+#define NPTRS 1000
+
+static const size_t sizes[] = { 0, 1, 24, 100, 1000, 5000, 200000 };
+
+/* Allocate a batch of N blocks of SIZE bytes, check that they are
+   usable and do not overlap, and free them again.  */
+static void
+check_batch (size_t size, size_t n)
+{
+  void *ptrs[NPTRS];
+
+  size_t got = malloc_batch (size, n, ptrs);
+  TEST_COMPARE (got, n);
+
+  for (size_t i = 0; i < got; i++)
+    {
+      TEST_VERIFY_EXIT (ptrs[i] != NULL);
+      TEST_VERIFY (((uintptr_t) ptrs[i] & MALLOC_ALIGN_MASK) == 0);
+      TEST_VERIFY (malloc_usable_size (ptrs[i]) >= size);
+      memset (ptrs[i], i & 0xff, size);
+    }
+  for (size_t i = 0; i < got; i++)
+    {
+      unsigned char *p = ptrs[i];
+      for (size_t j = 0; j < size; j++)
+	if (p[j] != (i & 0xff))
+	  {
+	    support_record_failure ();
+	    printf ("error: block %zu of size %zu overwritten at offset %zu\n",
+		    i, size, j);
+	    break;
+	  }
+    }
+
+  errno = 1234;
+  free_batch (ptrs, got);
+  TEST_COMPARE (errno, 1234);
+}
+
+static void
+check_all_sizes (void)
+{
+  for (int i = 0; i < sizeof (sizes) / sizeof (sizes[0]); i++)
+    {
+      size_t n = sizes[i] > 100000 ? 10 : NPTRS;
+      check_batch (sizes[i], 0);
+      check_batch (sizes[i], 1);
+      check_batch (sizes[i], n);
+    }
+}
+
+static void *
+thread_func (void *closure)
+{
+  void **ptrs = closure;
+
+  check_all_sizes ();
+
+  /* Blocks from this thread's arena are freed by the main thread,
+     mixed with blocks from the main arena.  */
+  TEST_COMPARE (malloc_batch (48, NPTRS / 2, ptrs), NPTRS / 2);
+  return NULL;
+}
+
+static int
+do_test (void)
+{
+  check_all_sizes ();
+
+  /* Blocks from either function can be freed by the other.  */
+  void *ptrs[NPTRS];
+  TEST_COMPARE (malloc_batch (64, 10, ptrs), 10);
+  for (int i = 0; i < 10; i += 2)
+    {
+      free (ptrs[i]);
+      ptrs[i] = malloc (64);
+      TEST_VERIFY_EXIT (ptrs[i] != NULL);
+    }
+  free_batch (ptrs, 10);
+
+  /* Null entries are skipped.  */
+  for (int i = 0; i < 10; i++)
+    ptrs[i] = i & 1 ? malloc (32) : NULL;
+  free_batch (ptrs, 10);
+
+  /* Blocks from several arenas and mmapped blocks in one batch.  */
+  pthread_t thr = xpthread_create (NULL, thread_func, ptrs);
+  xpthread_join (thr);
+  TEST_COMPARE (malloc_batch (48, NPTRS / 2 - 2, ptrs + NPTRS / 2),
+		NPTRS / 2 - 2);
+  ptrs[NPTRS - 2] = malloc (1 << 20);
+  ptrs[NPTRS - 1] = malloc (300);
+  TEST_VERIFY_EXIT (ptrs[NPTRS - 2] != NULL && ptrs[NPTRS - 1] != NULL);
+  free_batch (ptrs, NPTRS);
+
+  /* A request that cannot be satisfied allocates nothing.  */
+  errno = 0;
+  TEST_COMPARE (malloc_batch (SIZE_MAX - 4096, 4, ptrs), 0);
+  TEST_COMPARE (errno, ENOMEM);
+
+  return 0;
+}
+
+#include <support/test-driver.c>
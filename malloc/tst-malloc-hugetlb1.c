@@ -0,0 +1,78 @@
+/* Test malloc with the glibc.malloc.hugetlb tunable set to 1.
+   Copyright (C) 2021 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+/* Exercise the sbrk, heap and mmap paths of malloc, including growing
+   and trimming, and check that the memory is usable.  Whether huge
+   pages are actually used depends on the system configuration.  */
+
+#include <malloc.h>
+#include <stdlib.h>
+#include <string.h>
+#include <support/check.h>
+#include <support/support.h>
+#include <support/xthread.h>
+
+static const size_t sizes[] =
+  {
+    16, 1000, 64 * 1024, 200 * 1024, 2 * 1024 * 1024, 4 * 1024 * 1024
+  };
+
+enum { nptrs = 16 };
+
+static void
+do_allocations (void)
+{
+  void *ptrs[nptrs];
+
+  for (size_t s = 0; s < sizeof (sizes) / sizeof (sizes[0]); ++s)
+    {
+      for (int i = 0; i < nptrs; ++i)
+	{
+	  ptrs[i] = xmalloc (sizes[s]);
+	  memset (ptrs[i], i, sizes[s]);
+	}
+      for (int i = 0; i < nptrs; ++i)
+	{
+	  TEST_COMPARE (((unsigned char *) ptrs[i])[sizes[s] - 1], i);
+	  ptrs[i] = xrealloc (ptrs[i], sizes[s] * 2);
+	  TEST_COMPARE (((unsigned char *) ptrs[i])[0], i);
+	}
+      for (int i = 0; i < nptrs; ++i)
+	free (ptrs[i]);
+      malloc_trim (0);
+    }
+}
+
+static void *
+thread_function (void *closure)
+{
+  do_allocations ();
+  return NULL;
+}
+
+static int
+do_test (void)
+{
+  /* The main thread uses the sbrk heap, the second thread a heap
+     created with mmap.  */
+  do_allocations ();
+  xpthread_join (xpthread_create (NULL, thread_function, NULL));
+  return 0;
+}
+
+#include <support/test-driver.c>
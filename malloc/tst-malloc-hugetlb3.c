@@ -0,0 +1,171 @@
+/* Check that malloc heaps use huge pages with glibc.malloc.hugetlb=1.
+   Copyright (C) 2021 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+/* Fill the heap of a thread arena and look up the mapping which holds
+   it in /proc/self/smaps.  With transparent huge pages, part of it has
+   to be backed by them (AnonHugePages); with explicit huge pages, the
+   whole mapping has to use them (KernelPageSize and Private_Hugetlb).  */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <support/check.h>
+#include <support/support.h>
+#include <support/xstdio.h>
+#include <support/xthread.h>
+
+#ifndef TEST_HUGETLB
+# define TEST_HUGETLB 1
+#endif
+
+/* Stay below the mmap threshold, so that the chunks come from the heap
+   of the arena.  */
+enum { chunk_size = 64 * 1024, nchunks = 64 };
+
+static void *chunks[nchunks];
+
+/* Return the value in kilobytes of the line starting with KEY in FILE,
+   or -1 if there is none.  */
+static long int
+read_meminfo (const char *file, const char *key)
+{
+  FILE *fp = fopen (file, "r");
+  if (fp == NULL)
+    return -1;
+  char *line = NULL;
+  size_t len = 0;
+  long int result = -1;
+  size_t keylen = strlen (key);
+  while (xgetline (&line, &len, fp) > 0)
+    if (strncmp (line, key, keylen) == 0)
+      {
+	result = strtol (line + keylen, NULL, 10);
+	break;
+      }
+  free (line);
+  xfclose (fp);
+  return result;
+}
+
+struct vma_info
+{
+  long int kernel_page_size;
+  long int anon_huge_pages;
+  long int private_hugetlb;
+};
+
+/* Fill *INFO with the fields of the mapping containing ADDR in
+   /proc/self/smaps.  */
+static void
+read_smaps (void *addr, struct vma_info *info)
+{
+  FILE *fp = xfopen ("/proc/self/smaps", "r");
+  char *line = NULL;
+  size_t len = 0;
+  bool found = false;
+  bool in_vma = false;
+  unsigned long int start, end;
+  while (xgetline (&line, &len, fp) > 0)
+    {
+      char key[64];
+      long int value;
+      if (sscanf (line, "%lx-%lx ", &start, &end) == 2)
+	{
+	  if (found)
+	    break;
+	  in_vma = start <= (uintptr_t) addr && (uintptr_t) addr < end;
+	  found = in_vma;
+	}
+      else if (in_vma && sscanf (line, "%63[^:]: %ld kB", key, &value) == 2)
+	{
+	  if (strcmp (key, "KernelPageSize") == 0)
+	    info->kernel_page_size = value;
+	  else if (strcmp (key, "AnonHugePages") == 0)
+	    info->anon_huge_pages = value;
+	  else if (strcmp (key, "Private_Hugetlb") == 0)
+	    info->private_hugetlb = value;
+	}
+    }
+  free (line);
+  xfclose (fp);
+  TEST_VERIFY_EXIT (found);
+}
+
+static void *
+thread_function (void *closure)
+{
+  for (int i = 0; i < nchunks; ++i)
+    {
+      chunks[i] = xmalloc (chunk_size);
+      memset (chunks[i], i, chunk_size);
+    }
+  return NULL;
+}
+
+static int
+do_test (void)
+{
+  long int hugepagesize = read_meminfo ("/proc/meminfo", "Hugepagesize:");
+  if (hugepagesize <= 0)
+    FAIL_UNSUPPORTED ("no huge page size in /proc/meminfo");
+
+#if TEST_HUGETLB == 1
+  char *mode = NULL;
+  FILE *fp = fopen ("/sys/kernel/mm/transparent_hugepage/enabled", "r");
+  if (fp == NULL)
+    FAIL_UNSUPPORTED ("transparent huge pages are not supported");
+  size_t len = 0;
+  xgetline (&mode, &len, fp);
+  xfclose (fp);
+  if (strstr (mode, "[never]") != NULL)
+    FAIL_UNSUPPORTED ("transparent huge pages are disabled");
+  free (mode);
+#else
+  /* The heap of a thread arena needs at least a few pages.  */
+  if (read_meminfo ("/proc/meminfo", "HugePages_Free:") < 4)
+    FAIL_UNSUPPORTED ("not enough huge pages reserved");
+#endif
+
+  /* The main thread uses the sbrk heap, which never uses explicit huge
+     pages, so look at the heap of a second thread.  */
+  xpthread_join (xpthread_create (NULL, thread_function, NULL));
+
+  struct vma_info info = { -1, -1, -1 };
+  read_smaps (chunks[nchunks - 1], &info);
+  printf ("info: KernelPageSize: %ld kB, AnonHugePages: %ld kB,"
+	  " Private_Hugetlb: %ld kB\n", info.kernel_page_size,
+	  info.anon_huge_pages, info.private_hugetlb);
+
+#if TEST_HUGETLB == 1
+  TEST_VERIFY (info.anon_huge_pages >= hugepagesize);
+#else
+  TEST_COMPARE (info.kernel_page_size, hugepagesize);
+  TEST_VERIFY (info.private_hugetlb >= nchunks * chunk_size / 1024);
+#endif
+
+  for (int i = 0; i < nchunks; ++i)
+    {
+      TEST_COMPARE (((unsigned char *) chunks[i])[chunk_size - 1], i);
+      free (chunks[i]);
+    }
+  return 0;
+}
+
+#include <support/test-driver.c>
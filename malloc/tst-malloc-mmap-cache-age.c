@@ -0,0 +1,80 @@
+/* Test that cached mmapped chunks age out on unrelated frees.
+   Copyright (C) 2021 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+#include <malloc.h>
+#include <stdlib.h>
+#include <string.h>
+#include <support/check.h>
+#include <support/support.h>
+#include <time.h>
+
+/* The test runs with a fixed mmap threshold of 128 KiB, a cache of
+   4 MiB per arena, and an age limit of age_ms milliseconds.  */
+
+enum { block_size = 1024 * 1024, small_size = 2000, age_ms = 50 };
+
+static struct malloc_global_stats
+query (void)
+{
+  struct malloc_global_stats s;
+  TEST_VERIFY_EXIT (malloc_stats_query (MALLOC_STATS_VERSION, &s, NULL, 0)
+		    >= 0);
+  return s;
+}
+
+/* Allocate and free a block which is too large for the tcache and too
+   small for mmap, so that the free takes the arena lock.  */
+static void
+free_small_block (void)
+{
+  void *volatile p = xmalloc (small_size);
+  free (p);
+}
+
+static int
+do_test (void)
+{
+  char *p = xmalloc (block_size);
+  memset (p, 0xa5, block_size);
+
+  struct malloc_global_stats before = query ();
+  free (p);
+
+  /* A young cached block survives other frees.  */
+  free_small_block ();
+  struct malloc_global_stats after = query ();
+  TEST_COMPARE (after.nmmap_cached - before.nmmap_cached, 1);
+  TEST_COMPARE (after.nmunmap, before.nmunmap);
+
+  /* Once it is older than the limit, the next free which takes the
+     arena lock unmaps it, although no large block is requested.  */
+  struct timespec ts = { 0, 4 * age_ms * 1000 * 1000 };
+  TEST_COMPARE (nanosleep (&ts, NULL), 0);
+  free_small_block ();
+  after = query ();
+  TEST_COMPARE (after.nmunmap - before.nmunmap, 1);
+
+  /* The block is gone from the cache.  */
+  p = xmalloc (block_size);
+  TEST_COMPARE (query ().nmmap_reused, after.nmmap_reused);
+  free (p);
+
+  return 0;
+}
+
+#include <support/test-driver.c>
@@ -0,0 +1,135 @@
+/* Test the cache of freed mmapped chunks.
+   Copyright (C) 2021 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+#include <malloc.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <support/check.h>
+
+/* The test runs with a fixed mmap threshold of 128 KiB, so that freeing
+   a large block does not raise it, a cache of 4 MiB per arena, and no
+   age limit.  */
+
+enum { block_size = 1024 * 1024, cache_size = 4 * block_size };
+
+static struct malloc_global_stats
+query (void)
+{
+  struct malloc_global_stats s;
+  TEST_VERIFY_EXIT (malloc_stats_query (MALLOC_STATS_VERSION, &s, NULL, 0)
+		    >= 0);
+  return s;
+}
+
+static int
+do_test (void)
+{
+  /* The cache is kept per arena.  Stay on one CPU, so that the same
+     arena is used throughout if glibc.malloc.arena_percpu is set.  */
+  int cpu = sched_getcpu ();
+  if (cpu >= 0)
+    {
+      cpu_set_t set;
+      CPU_ZERO (&set);
+      CPU_SET (cpu, &set);
+      TEST_COMPARE (sched_setaffinity (0, sizeof (set), &set), 0);
+    }
+
+  struct malloc_global_stats before = query ();
+
+  /* A freed block is handed out again for a request of the same size.  */
+  char *p = malloc (block_size);
+  TEST_VERIFY_EXIT (p != NULL);
+  memset (p, 0xa5, block_size);
+  free (p);
+  char *q = malloc (block_size);
+  TEST_VERIFY (q == p);
+
+  struct malloc_global_stats after = query ();
+  TEST_COMPARE (after.nmmap_cached - before.nmmap_cached, 1);
+  TEST_COMPARE (after.nmmap_reused - before.nmmap_reused, 1);
+  TEST_COMPARE (after.nmunmap, before.nmunmap);
+
+  /* calloc clears a reused block.  */
+  free (q);
+  q = calloc (1, block_size);
+  TEST_VERIFY_EXIT (q != NULL);
+  for (size_t i = 0; i < block_size; i++)
+    if (q[i] != 0)
+      {
+	support_record_failure ();
+	printf ("error: calloc block not cleared at offset %zu\n", i);
+	break;
+      }
+
+  /* A request of a different size resizes a cached block.  */
+  free (q);
+  before = query ();
+  p = malloc (3 * block_size);
+  TEST_VERIFY_EXIT (p != NULL);
+  memset (p, 0x5a, 3 * block_size);
+  after = query ();
+  TEST_COMPARE (after.nmmap_reused - before.nmmap_reused, 1);
+  TEST_COMPARE (after.nmmap, before.nmmap);
+  TEST_VERIFY (malloc_usable_size (p) >= 3 * block_size);
+  free (p);
+
+  /* Blocks beyond the size limit of the cache are unmapped, oldest
+     first.  */
+  enum { nblocks = 6 };
+  void *blocks[nblocks];
+  for (int i = 0; i < nblocks; i++)
+    {
+      blocks[i] = malloc (block_size);
+      TEST_VERIFY_EXIT (blocks[i] != NULL);
+    }
+  before = query ();
+  for (int i = 0; i < nblocks; i++)
+    free (blocks[i]);
+  after = query ();
+  TEST_COMPARE (after.nmmap_cached - before.nmmap_cached, nblocks);
+  TEST_VERIFY (after.nmunmap - before.nmunmap
+	       >= nblocks - cache_size / block_size);
+
+  /* malloc_trim releases the cache.  */
+  before = after;
+  TEST_COMPARE (malloc_trim (0), 1);
+  after = query ();
+  TEST_VERIFY (after.nmunmap > before.nmunmap);
+  p = malloc (block_size);
+  TEST_VERIFY_EXIT (p != NULL);
+  TEST_COMPARE (query ().nmmap_reused, after.nmmap_reused);
+  free (p);
+
+  /* Blocks larger than the whole cache are unmapped right away.  The
+     block is used, so that the compiler keeps the allocation.  */
+  before = query ();
+  p = malloc (2 * cache_size);
+  TEST_VERIFY_EXIT (p != NULL);
+  TEST_VERIFY (malloc_usable_size (p) >= 2 * cache_size);
+  free (p);
+  after = query ();
+  TEST_COMPARE (after.nmmap_cached, before.nmmap_cached);
+  TEST_COMPARE (after.nmunmap - before.nmunmap, 1);
+
+  return 0;
+}
+
+#include <support/test-driver.c>
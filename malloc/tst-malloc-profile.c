@@ -0,0 +1,153 @@
+/* Test the sampling heap profiler of malloc.
+   Copyright (C) 2021 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+/* The test is run with glibc.malloc.profile_interval set to 4096 and
+   MALLOC_PROFILE set.  A subprocess allocates memory, keeps some of it,
+   resizes the blocks it keeps and exits, which writes a profile, which
+   is then checked.  The subprocess inherits the samples of the
+   allocations the test driver made before the fork, so only the
+   samples of the block sizes used here are checked individually.
+
+   A new thread also makes a single allocation larger than one and a
+   half intervals, which is always sampled because the countdown of
+   each thread is started when the thread starts.  */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <support/check.h>
+#include <support/support.h>
+#include <support/xstdio.h>
+#include <support/xthread.h>
+#include <support/xunistd.h>
+#include <sys/wait.h>
+
+/* Unusual sizes, so that the samples of the blocks allocated here can
+   be told apart from the others.  */
+enum { nptrs = 10000, block_size = 123, resized_size = 2 * block_size,
+       keep_every = 10, thread_size = 2 * 4096 + 17 };
+
+static void *kept[nptrs / keep_every];
+static void *thread_block;
+
+/* Keep the compiler from eliding the allocations.  */
+static void *volatile sink;
+
+static void *
+thread_function (void *closure)
+{
+  thread_block = malloc (thread_size);
+  TEST_VERIFY_EXIT (thread_block != NULL);
+  return NULL;
+}
+
+static void
+allocate (void)
+{
+  xpthread_join (xpthread_create (NULL, thread_function, NULL));
+
+  for (int i = 0; i < nptrs; i++)
+    {
+      void *p = malloc (block_size);
+      TEST_VERIFY_EXIT (p != NULL);
+      sink = p;
+      if (i % keep_every == 0)
+	kept[i / keep_every] = p;
+      else
+	free (p);
+    }
+
+  /* Sampled blocks stay sampled when they are resized.  */
+  for (int i = 0; i < nptrs / keep_every; i++)
+    {
+      kept[i] = realloc (kept[i], resized_size);
+      TEST_VERIFY_EXIT (kept[i] != NULL);
+    }
+}
+
+static int
+do_test (void)
+{
+  const char *prefix = getenv ("MALLOC_PROFILE");
+  TEST_VERIFY_EXIT (prefix != NULL);
+
+  pid_t pid = xfork ();
+  if (pid == 0)
+    {
+      allocate ();
+      /* The profile is written by exit.  */
+      exit (0);
+    }
+  int status;
+  xwaitpid (pid, &status, 0);
+  TEST_VERIFY_EXIT (WIFEXITED (status) && WEXITSTATUS (status) == 0);
+
+  char *name = xasprintf ("%s.%d.0.heap", prefix, (int) pid);
+  FILE *fp = xfopen (name, "r");
+
+  char *line = NULL;
+  size_t len = 0;
+  TEST_VERIFY_EXIT (getline (&line, &len, fp) > 0);
+  unsigned long live, live_bytes, total, total_bytes, interval;
+  TEST_COMPARE (sscanf (line, "heap profile: %lu: %lu [%lu: %lu] @ heap_v2/%lu",
+			&live, &live_bytes, &total, &total_bytes, &interval),
+		5);
+  TEST_COMPARE (interval, 4096);
+  TEST_VERIFY (live <= total);
+  TEST_VERIFY (live_bytes <= total_bytes);
+
+  unsigned long samples = 0, sample_bytes = 0;
+  unsigned long block_samples = 0, resized_samples = 0, thread_samples = 0;
+  bool maps = false;
+  while (getline (&line, &len, fp) > 0)
+    if (strncmp (line, "1: ", 3) == 0)
+      {
+	unsigned long size;
+	TEST_COMPARE (sscanf (line, "1: %lu [1: ", &size), 1);
+	TEST_VERIFY (strstr (line, "] @ 0x") != NULL);
+	++samples;
+	sample_bytes += size;
+	if (size == block_size)
+	  ++block_samples;
+	else if (size == resized_size)
+	  ++resized_samples;
+	else if (size == thread_size)
+	  ++thread_samples;
+      }
+    else if (strcmp (line, "MAPPED_LIBRARIES:\n") == 0)
+      maps = true;
+  TEST_COMPARE (samples, live);
+  TEST_COMPARE (sample_bytes, live_bytes);
+  TEST_VERIFY (maps);
+
+  /* About one in 4096 / block_size of the kept blocks is sampled, and
+     none of them is still live at its original size.  */
+  TEST_COMPARE (block_samples, 0);
+  TEST_VERIFY (resized_samples > 0);
+  TEST_VERIFY (resized_samples <= nptrs / keep_every);
+  TEST_COMPARE (thread_samples, 1);
+
+  free (line);
+  xfclose (fp);
+  xunlink (name);
+  free (name);
+  return 0;
+}
+
+#include <support/test-driver.c>
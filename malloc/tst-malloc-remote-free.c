@@ -0,0 +1,146 @@
+/* Test that chunks freed by another thread are reused.
+   Copyright (C) 2021 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+/* A producer thread allocates blocks and passes them to a consumer
+   thread, which frees them while the producer keeps allocating from the
+   same arena.  Frees which find the arena lock busy are queued on the
+   arena and released by the next lock holder.  None of them may be
+   lost: once all blocks are freed, the bytes in use have to be back to
+   what they were before, and allocating the same blocks again must not
+   grow the heap.  */
+
+#include <malloc.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <support/check.h>
+#include <support/xthread.h>
+
+/* Above the tcache and fastbin range, so that every free needs the lock
+   of the arena owning the block.  */
+enum { block_size = 2000, nblocks = 256, nrounds = 200, ring_size = 64 };
+
+static void *ring[ring_size];
+static _Atomic size_t head;
+static _Atomic size_t tail;
+
+static pthread_barrier_t barrier;
+
+/* Allocate and free a block of SIZE bytes.  On the arena of the calling
+   thread, this releases the frees queued on it.  */
+static void
+allocate_and_free (size_t size)
+{
+  void *volatile p = malloc (size);
+  free (p);
+}
+
+static void *
+consumer_thread (void *closure)
+{
+  /* Set up the tcache of this thread before the producer starts
+     counting.  */
+  allocate_and_free (1);
+  xpthread_barrier_wait (&barrier);
+
+  for (size_t i = 0; i < (size_t) nblocks * nrounds; i++)
+    {
+      size_t t = atomic_load_explicit (&tail, memory_order_relaxed);
+      while (atomic_load_explicit (&head, memory_order_acquire) == t)
+	sched_yield ();
+      free (ring[t % ring_size]);
+      atomic_store_explicit (&tail, t + 1, memory_order_release);
+    }
+
+  /* Exiting frees the tcache of this thread, so wait for the producer
+     to finish its checks.  */
+  xpthread_barrier_wait (&barrier);
+  return NULL;
+}
+
+/* Wait until the consumer has freed all blocks passed to it.  */
+static void
+wait_for_consumer (void)
+{
+  while (atomic_load_explicit (&tail, memory_order_acquire)
+	 != atomic_load_explicit (&head, memory_order_relaxed))
+    sched_yield ();
+}
+
+static void *
+producer_thread (void *closure)
+{
+  /* Create the arena and the tcache of this thread.  */
+  allocate_and_free (block_size);
+  xpthread_barrier_wait (&barrier);
+
+  size_t in_use = 0;
+  size_t heap_size = 0;
+
+  for (int round = 0; round < nrounds; round++)
+    {
+      for (int i = 0; i < nblocks; i++)
+	{
+	  void *block = malloc (block_size);
+	  TEST_VERIFY_EXIT (block != NULL);
+	  memset (block, round, block_size);
+
+	  size_t h = atomic_load_explicit (&head, memory_order_relaxed);
+	  while (h - atomic_load_explicit (&tail, memory_order_acquire)
+		 == ring_size)
+	    sched_yield ();
+	  ring[h % ring_size] = block;
+	  atomic_store_explicit (&head, h + 1, memory_order_release);
+	}
+      wait_for_consumer ();
+      allocate_and_free (block_size);
+
+      /* The first round sets up the heap and whatever else the threads
+	 allocate lazily.  */
+      struct mallinfo2 mi = mallinfo2 ();
+      if (round == 0)
+	{
+	  in_use = mi.uordblks;
+	  heap_size = mi.arena;
+	}
+      else
+	{
+	  TEST_COMPARE (mi.uordblks, in_use);
+	  TEST_VERIFY (mi.arena <= heap_size);
+	}
+    }
+
+  xpthread_barrier_wait (&barrier);
+  return NULL;
+}
+
+static int
+do_test (void)
+{
+  xpthread_barrier_init (&barrier, NULL, 2);
+  pthread_t consumer = xpthread_create (NULL, consumer_thread, NULL);
+  pthread_t producer = xpthread_create (NULL, producer_thread, NULL);
+  xpthread_join (producer);
+  xpthread_join (consumer);
+  xpthread_barrier_destroy (&barrier);
+  return 0;
+}
+
+#include <support/test-driver.c>
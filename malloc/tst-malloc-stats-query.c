@@ -0,0 +1,147 @@
+/* Test malloc_stats_query with the glibc.malloc.stats tunable.
+   Copyright (C) 2021 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+#include <array_length.h>
+#include <errno.h>
+#include <malloc.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <support/check.h>
+#include <support/xmemstream.h>
+#include <support/xthread.h>
+
+enum { nptrs = 100, small_size = 100, large_size = 1024 * 1024 };
+
+static struct malloc_size_class_stats classes[256];
+static int nclasses;
+
+/* Return the size class which SIZE falls into.  */
+static struct malloc_size_class_stats *
+find_class (size_t size)
+{
+  for (int i = 0; i < nclasses; i++)
+    if (size <= classes[i].size)
+      return &classes[i];
+  FAIL_EXIT1 ("no size class for %zu bytes", size);
+}
+
+static void
+query (struct malloc_global_stats *totals)
+{
+  nclasses = malloc_stats_query (MALLOC_STATS_VERSION, totals, classes,
+				 array_length (classes));
+  TEST_VERIFY_EXIT (nclasses > 0 && nclasses <= array_length (classes));
+}
+
+static void
+do_allocations (void)
+{
+  void *ptrs[nptrs];
+
+  for (int round = 0; round < 2; round++)
+    {
+      for (int i = 0; i < nptrs; i++)
+	{
+	  ptrs[i] = malloc (small_size);
+	  TEST_VERIFY_EXIT (ptrs[i] != NULL);
+	}
+      for (int i = 0; i < nptrs; i++)
+	free (ptrs[i]);
+    }
+
+  void *p = malloc (large_size);
+  TEST_VERIFY_EXIT (p != NULL);
+  free (p);
+
+  p = malloc (small_size);
+  TEST_VERIFY_EXIT (p != NULL);
+  p = realloc (p, 2 * small_size);
+  TEST_VERIFY_EXIT (p != NULL);
+  free (p);
+}
+
+static void *
+thread_func (void *closure)
+{
+  do_allocations ();
+  return NULL;
+}
+
+static int
+do_test (void)
+{
+  struct malloc_global_stats before, after;
+
+  query (&before);
+  size_t small_before = find_class (small_size)->nmalloc;
+  size_t small_free_before = find_class (small_size)->nfree;
+  TEST_COMPARE (classes[nclasses - 1].size, SIZE_MAX);
+
+  /* The counters of a thread are kept after it exits.  */
+  do_allocations ();
+  xpthread_join (xpthread_create (NULL, thread_func, NULL));
+
+  query (&after);
+  struct malloc_size_class_stats *c = find_class (small_size);
+  TEST_VERIFY (c->nmalloc - small_before >= 4 * nptrs);
+  TEST_VERIFY (c->nfree - small_free_before >= 4 * nptrs);
+  /* The second round of each thread is served from its tcache.  */
+  TEST_VERIFY (c->ntcache > 0);
+  TEST_VERIFY (after.nmalloc - before.nmalloc >= 4 * nptrs + 4);
+  TEST_VERIFY (after.nfree - before.nfree >= 4 * nptrs + 4);
+  TEST_VERIFY (after.nrealloc - before.nrealloc >= 2);
+  /* Freeing the first large block raises the mmap threshold, so only
+     the first one is guaranteed to be allocated with mmap.  */
+  TEST_VERIFY (after.nmmap - before.nmmap >= 1);
+  TEST_VERIFY (after.nmunmap - before.nmunmap >= 1);
+
+  /* The counters are also part of the malloc_info output.  */
+  struct xmemstream mem;
+  xopen_memstream (&mem);
+  TEST_COMPARE (malloc_info (0, mem.out), 0);
+  xfclose_memstream (&mem);
+  TEST_VERIFY (strstr (mem.buffer, "<stats>") != NULL);
+  TEST_VERIFY (strstr (mem.buffer, "<count type=\"mmap\"") != NULL);
+  TEST_VERIFY (strstr (mem.buffer, "<count type=\"realloc\"") != NULL);
+  free (mem.buffer);
+
+  /* A null array is accepted.  */
+  TEST_COMPARE (malloc_stats_query (MALLOC_STATS_VERSION, NULL, NULL, 0),
+		nclasses);
+
+  /* The reserved members are cleared.  */
+  memset (&after, 0xff, sizeof (after));
+  memset (classes, 0xff, sizeof (classes));
+  query (&after);
+  for (size_t i = 0; i < array_length (after.__reserved); i++)
+    TEST_COMPARE (after.__reserved[i], 0);
+  for (size_t i = 0; i < array_length (classes[0].__reserved); i++)
+    TEST_COMPARE (classes[0].__reserved[i], 0);
+
+  /* Unknown versions of the structures are rejected.  */
+  errno = 0;
+  TEST_COMPARE (malloc_stats_query (MALLOC_STATS_VERSION + 1, &after,
+				    classes, array_length (classes)), -1);
+  TEST_COMPARE (errno, EINVAL);
+
+  return 0;
+}
+
+#include <support/test-driver.c>
@@ -0,0 +1,88 @@
+/* Test malloc with the glibc.malloc.trim_budget tunable.
+   Copyright (C) 2021 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+/* Free enough memory to trigger several slices of incremental trimming
+   and check that neither the chunks still in use nor the chunks
+   allocated again from the released free memory are corrupted.  */
+
+#include <stdlib.h>
+#include <string.h>
+#include <support/check.h>
+
+enum { nptrs = 64, block_size = 96 * 1024 };
+
+static void
+check_block (const unsigned char *p, unsigned char c)
+{
+  for (size_t i = 0; i < block_size; i++)
+    if (p[i] != c)
+      FAIL_EXIT1 ("block %p corrupted at offset %zu", p, i);
+}
+
+static int
+do_test (void)
+{
+  unsigned char *ptrs[nptrs];
+  void *guards[nptrs];
+
+  for (int round = 0; round < 4; round++)
+    {
+      for (int i = 0; i < nptrs; i++)
+	{
+	  ptrs[i] = malloc (block_size);
+	  TEST_VERIFY_EXIT (ptrs[i] != NULL);
+	  memset (ptrs[i], i, block_size);
+	  /* Keep the blocks from coalescing into one another or into
+	     the top chunk.  */
+	  guards[i] = malloc (16);
+	  TEST_VERIFY_EXIT (guards[i] != NULL);
+	}
+
+      /* Free every other block, which releases their pages.  */
+      for (int i = round & 1; i < nptrs; i += 2)
+	{
+	  free (ptrs[i]);
+	  ptrs[i] = NULL;
+	}
+
+      for (int i = 0; i < nptrs; i++)
+	if (ptrs[i] != NULL)
+	  check_block (ptrs[i], i);
+
+      /* Reuse the released memory.  */
+      for (int i = 0; i < nptrs; i++)
+	if (ptrs[i] == NULL)
+	  {
+	    ptrs[i] = calloc (1, block_size);
+	    TEST_VERIFY_EXIT (ptrs[i] != NULL);
+	    check_block (ptrs[i], 0);
+	    memset (ptrs[i], i, block_size);
+	  }
+
+      for (int i = 0; i < nptrs; i++)
+	{
+	  check_block (ptrs[i], i);
+	  free (ptrs[i]);
+	  free (guards[i]);
+	}
+    }
+
+  return 0;
+}
+
+#include <support/test-driver.c>
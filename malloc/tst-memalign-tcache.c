@@ -0,0 +1,138 @@
+/* Test that aligned allocations reuse suitably aligned cached chunks.
+   Copyright (C) 2021 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+#include <malloc.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <support/check.h>
+
+/* No more blocks than the default tcache bin holds, so that all of them
+   are cached when they are freed.  */
+enum { nblocks = 7, size = 200 };
+
+static int
+aligned (void *p, size_t alignment)
+{
+  return ((uintptr_t) p & (alignment - 1)) == 0;
+}
+
+/* Blocks which were allocated to get different ones from malloc, and
+   are freed after the test of each function.  */
+static void *kept[64];
+static int nkept;
+
+/* Allocate NBLOCKS blocks with malloc until at least one of them is
+   aligned to ALIGNMENT, then free them, so that they all end up in the
+   tcache.  Store the first such block in *EXPECTED.  */
+static void
+fill_tcache (size_t alignment, void **expected)
+{
+  void *blocks[nblocks];
+
+  while (true)
+    {
+      int found = -1;
+      for (int i = 0; i < nblocks; i++)
+	{
+	  blocks[i] = malloc (size);
+	  TEST_VERIFY_EXIT (blocks[i] != NULL);
+	  if (found < 0 && aligned (blocks[i], alignment))
+	    found = i;
+	}
+      if (found >= 0)
+	{
+	  *expected = blocks[found];
+	  break;
+	}
+      TEST_VERIFY_EXIT (nkept + nblocks <= 64);
+      memcpy (&kept[nkept], blocks, sizeof (blocks));
+      nkept += nblocks;
+    }
+
+  /* The bin is a stack, so free the expected block first to put it at
+     the bottom, behind all the unaligned ones.  Other aligned blocks
+     would be found before it, so keep them out of the bin.  */
+  free (*expected);
+  for (int i = 0; i < nblocks; i++)
+    if (blocks[i] != *expected)
+      {
+	if (aligned (blocks[i], alignment))
+	  {
+	    TEST_VERIFY_EXIT (nkept < 64);
+	    kept[nkept++] = blocks[i];
+	  }
+	else
+	  free (blocks[i]);
+      }
+}
+
+static void
+free_kept (void)
+{
+  for (int i = 0; i < nkept; i++)
+    free (kept[i]);
+  nkept = 0;
+}
+
+static int
+do_test (void)
+{
+  void *expected, *p;
+
+  fill_tcache (32, &expected);
+  p = aligned_alloc (32, size);
+  TEST_VERIFY (p == expected);
+  free (p);
+  free_kept ();
+
+  fill_tcache (64, &expected);
+  TEST_COMPARE (posix_memalign (&p, 64, size), 0);
+  TEST_VERIFY (p == expected);
+  free_aligned_sized (p, 64, size);
+  free_kept ();
+
+  fill_tcache (64, &expected);
+  p = memalign (64, size);
+  TEST_VERIFY (p == expected);
+  free (p);
+  free_kept ();
+
+  /* A chunk of another size is not used even if it is aligned.  */
+  fill_tcache (64, &expected);
+  p = aligned_alloc (64, 2 * size);
+  TEST_VERIFY_EXIT (p != NULL);
+  TEST_VERIFY (p != expected);
+  TEST_VERIFY (aligned (p, 64));
+  free (p);
+  free_kept ();
+
+  /* Large alignments still work when no cached chunk qualifies.  */
+  for (size_t alignment = 128; alignment <= 65536; alignment *= 2)
+    {
+      p = aligned_alloc (alignment, size);
+      TEST_VERIFY_EXIT (p != NULL);
+      TEST_VERIFY (aligned (p, alignment));
+      free (p);
+    }
+
+  return 0;
+}
+
+#include <support/test-driver.c>
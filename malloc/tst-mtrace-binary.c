@@ -0,0 +1,64 @@
+/* Test the binary trace format of mtrace with several threads.
+   Copyright (C) 2021 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+#include <mcheck.h>
+#include <stdlib.h>
+#include <support/check.h>
+#include <support/xthread.h>
+
+/* tst-mtrace-binary.sh counts the allocations of ALLOC_SIZE bytes in
+   the converted trace.  Every thread writes many more records than fit
+   into its trace buffer.  */
+enum { nthreads = 4, nallocs = 5000, alloc_size = 4321 };
+
+static void *
+thread_func (void *closure)
+{
+  void *ptrs[10];
+
+  for (int i = 0; i < nallocs / 10; i++)
+    {
+      for (int j = 0; j < 10; j++)
+	{
+	  ptrs[j] = malloc (alloc_size);
+	  TEST_VERIFY_EXIT (ptrs[j] != NULL);
+	}
+      for (int j = 0; j < 10; j++)
+	free (ptrs[j]);
+    }
+  return NULL;
+}
+
+static int
+do_test (void)
+{
+  pthread_t threads[nthreads];
+
+  mtrace ();
+
+  for (int i = 0; i < nthreads; i++)
+    threads[i] = xpthread_create (NULL, thread_func, NULL);
+  for (int i = 0; i < nthreads; i++)
+    xpthread_join (threads[i]);
+
+  muntrace ();
+
+  return 0;
+}
+
+#include <support/test-driver.c>
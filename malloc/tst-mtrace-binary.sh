@@ -0,0 +1,67 @@
+#!/bin/sh
+# Testing the binary trace format of mtrace.
+# Copyright (C) 2021 Free Software Foundation, Inc.
+# This file is part of the GNU C Library.
+
+# The GNU C Library is free software; you can redistribute it and/or
+# modify it under the terms of the GNU Lesser General Public
+# License as published by the Free Software Foundation; either
+# version 2.1 of the License, or (at your option) any later version.
+
+# The GNU C Library is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# Lesser General Public License for more details.
+
+# You should have received a copy of the GNU Lesser General Public
+# License along with the GNU C Library; if not, see
+# <https://www.gnu.org/licenses/>.
+
+set -e
+
+common_objpfx=$1; shift
+test_program_prefix_before_env=$1; shift
+run_program_env=$1; shift
+test_program_prefix_after_env=$1; shift
+
+trace=${common_objpfx}malloc/tst-mtrace-binary.trace
+text=${common_objpfx}malloc/tst-mtrace-binary.text
+status=0
+trap "rm -f $trace $text; exit 1" 1 2 15
+
+${test_program_prefix_before_env} \
+${run_program_env} \
+MALLOC_TRACE=$trace \
+MALLOC_TRACE_FORMAT=binary \
+LD_PRELOAD=${common_objpfx}malloc/libc_malloc_debug.so \
+${test_program_prefix_after_env} \
+  ${common_objpfx}malloc/tst-mtrace-binary || status=1
+
+if test $status -eq 0; then
+  ${common_objpfx}malloc/mtrace --dump $trace > $text || status=1
+fi
+
+# Every one of the 4 threads allocates 5000 blocks of 0x10e1 bytes.
+if test $status -eq 0; then
+  pattern='^\(@ \[0x[0-9a-f]*\] \)\{0,1\}+ 0x[0-9a-f]* 0x10e1$'
+  count=$(grep -c "$pattern" $text) || true
+  if test "$count" != 20000; then
+    echo "expected 20000 allocations in the trace, found $count"
+    status=1
+  fi
+fi
+
+# Thread creation itself may leave blocks behind, but none of the blocks
+# allocated by the threads must be reported as not freed.
+if test $status -eq 0; then
+  ${common_objpfx}malloc/mtrace $trace \
+    > ${common_objpfx}malloc/tst-mtrace-binary.out || true
+  if grep -q ' 0x10e1  at ' ${common_objpfx}malloc/tst-mtrace-binary.out; then
+    cat ${common_objpfx}malloc/tst-mtrace-binary.out
+    status=1
+  fi
+fi
+
+rm -f $trace $text
+
+exit $status
@@ -60,6 +60,12 @@ get_cached_stack (size_t *sizep, void **memp)
   struct pthread *result = NULL;
   list_t *entry;
 
+  /* Blocks more than four times as large as needed are not used (see
+     below), so there is no need to look at the lists beyond that.  */
+  unsigned int first = __nptl_stack_cache_bucket (size);
+  unsigned int last = (size > SIZE_MAX / 4 ? DL_STACK_CACHE_BUCKETS - 1
+		       : __nptl_stack_cache_bucket (4 * size));
+
   lll_lock (GL (dl_stack_cache_lock), LLL_PRIVATE);
 
   /* Search the cache for a matching entry.  We search for the
@@ -67,25 +73,28 @@ get_cached_stack (size_t *sizep, void **memp)
      in normal situations the size of all allocated stacks is the
      same.  As the very least there are only a few different sizes.
      Therefore this loop will exit early most of the time with an
-     exact match.  */
-  list_for_each (entry, &GL (dl_stack_cache))
-    {
-      struct pthread *curr;
-
-      curr = list_entry (entry, struct pthread, list);
-      if (__nptl_stack_in_use (curr) && curr->stackblock_size >= size)
-	{
-	  if (curr->stackblock_size == size)
-	    {
+     exact match.  All stacks in a list are larger than those in the
+     lists before it, so we can stop after the first list with a
+     suitable entry.  */
+  for (unsigned int i = first; result == NULL && i <= last; ++i)
+    list_for_each (entry, &GL (dl_stack_cache)[i])
+      {
+	struct pthread *curr;
+
+	curr = list_entry (entry, struct pthread, list);
+	if (__nptl_stack_in_use (curr) && curr->stackblock_size >= size)
+	  {
+	    if (curr->stackblock_size == size)
+	      {
+		result = curr;
+		break;
+	      }
+
+	    if (result == NULL
+		|| result->stackblock_size > curr->stackblock_size)
 	      result = curr;
-	      break;
-	    }
-
-	  if (result == NULL
-	      || result->stackblock_size > curr->stackblock_size)
-	    result = curr;
-	}
-    }
+	  }
+      }
 
   if (__builtin_expect (result == NULL, 0)
       /* Make sure the size difference is not too excessive.  In that
@@ -181,6 +190,68 @@ setup_stack_prot (char *mem, size_t size, char *guard, size_t guardsize,
   return 0;
 }
 
+/* Map SIZE bytes of anonymous memory for a new stack, with protection
+   PROT.  If transparent huge pages are enabled for stacks and the stack
+   is large enough, align the end of the mapping, where the thread
+   descriptor and the used part of the stack are, to the huge page size,
+   so that the kernel can back it with huge pages.  In madvise mode the
+   kernel is asked to do so with MADV_HUGEPAGE.  */
+static void *
+map_stack (size_t size, int prot, size_t pagesize_m1)
+{
+  size_t thp_pagesize = __nptl_stack_thp_pagesize;
+  size_t extra = thp_pagesize - (pagesize_m1 + 1);
+  if (thp_pagesize == 0 || size < thp_pagesize || size > SIZE_MAX - extra)
+    return __mmap (NULL, size, prot, MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK,
+		   -1, 0);
+
+  /* Map enough so that an aligned end can be cut out, and unmap the
+     rest.  */
+  char *mem = __mmap (NULL, size + extra, prot,
+		      MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+  if (mem == MAP_FAILED)
+    return mem;
+  uintptr_t end = ((uintptr_t) mem + size + extra) & ~(thp_pagesize - 1);
+  size_t head = end - size - (uintptr_t) mem;
+  if (head != 0)
+    __munmap (mem, head);
+  if (head != extra)
+    __munmap (mem + head + size, extra - head);
+  mem += head;
+
+#ifdef MADV_HUGEPAGE
+  if (__nptl_stack_thp_madvise)
+    __madvise (mem, size, MADV_HUGEPAGE);
+#endif
+  return mem;
+}
+
+/* Populate the top __nptl_stack_prefault_size bytes of the new stack MEM
+   of SIZE bytes, which has a guard area of GUARDSIZE bytes, so that the
+   new thread does not take page faults there.  */
+static void
+prefault_stack (char *mem, size_t size, size_t guardsize, size_t pagesize_m1)
+{
+#if _STACK_GROWS_DOWN && !defined(NEED_SEPARATE_REGISTER_STACK)
+  size_t len = (__nptl_stack_prefault_size + pagesize_m1) & ~pagesize_m1;
+  if (len > size - guardsize || len < __nptl_stack_prefault_size)
+    len = size - guardsize;
+  char *start = mem + size - len;
+
+# ifdef MADV_POPULATE_WRITE
+  int res = INTERNAL_SYSCALL_CALL (madvise, start, len, MADV_POPULATE_WRITE);
+  if (!INTERNAL_SYSCALL_ERROR_P (res)
+      || INTERNAL_SYSCALL_ERRNO (res) != EINVAL)
+    return;
+# endif
+
+  /* The kernel does not support MADV_POPULATE_WRITE.  Touch the pages
+     instead; they are still zero, so writing zero does not change them.  */
+  for (char *p = start; p < mem + size; p += pagesize_m1 + 1)
+    *(volatile char *) p = 0;
+#endif
+}
+
 /* Mark the memory of the stack as usable to the kernel.  It frees everything
    except for the space used for the TCB itself.  */
 static __always_inline void
@@ -367,8 +438,8 @@ allocate_stack (const struct pthread_attr *attr, struct pthread **pdp,
 	  /* If a guard page is required, avoid committing memory by first
 	     allocate with PROT_NONE and then reserve with required permission
 	     excluding the guard page.  */
-	  mem = __mmap (NULL, size, (guardsize == 0) ? prot : PROT_NONE,
-			MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+	  mem = map_stack (size, (guardsize == 0) ? prot : PROT_NONE,
+			   pagesize_m1);
 
 	  if (__glibc_unlikely (mem == MAP_FAILED))
 	    return errno;
@@ -401,6 +472,9 @@ allocate_stack (const struct pthread_attr *attr, struct pthread **pdp,
 		}
 	    }
 
+	  if (__nptl_stack_prefault_size != 0)
+	    prefault_stack (mem, size, guardsize, pagesize_m1);
+
 	  /* Remember the stack-related values.  */
 	  pd->stackblock = mem;
 	  pd->stackblock_size = size;
@@ -34,6 +34,7 @@
 #include <bits/types/res_state.h>
 #include <kernel-features.h>
 #include <tls-internal-struct.h>
+#include <sys/rseq.h>
 
 #ifndef TCB_ALIGNMENT
 # define TCB_ALIGNMENT	sizeof (double)
@@ -115,6 +116,40 @@ struct robust_list_head
 };
 
 
+/* Queue node of a thread waiting for a PTHREAD_MUTEX_QUEUED_NP mutex,
+   see lll_mutex_lock_queued.  */
+struct pthread_mutex_qnode
+{
+  struct pthread_mutex_qnode *next;
+  /* 1 while the thread waits for its turn, 2 if it sleeps on this
+     word, and 0 once it is the head of the queue.  */
+  unsigned int wait;
+};
+
+
+/* Read lock of a PTHREAD_RWLOCK_DISTRIBUTED_READERS_NP rwlock held by
+   a thread without registering in the rwlock itself, see
+   pthread_rwlock_common.c.  COUNT is the number of such read locks.  */
+struct pthread_rwlock_rslot
+{
+  pthread_rwlock_t *rwlock;
+  unsigned int count;
+};
+
+/* Number of reader slots per thread.  Must be a power of two.  */
+#define PTHREAD_RWLOCK_RSLOTS 8
+
+
+/* Kinds of waits with their own adaptive spin budget, see nptl-spin.h.  */
+enum
+{
+  NPTL_SPIN_SEM,
+  NPTL_SPIN_RWLOCK,
+  NPTL_SPIN_COND,
+  NPTL_SPIN_KINDS
+};
+
+
 /* Data strcture used to handle thread priority protection.  */
 struct priority_protection_data
 {
@@ -376,6 +411,28 @@ struct pthread
   /* Thread Priority Protection data.  */
   struct priority_protection_data *tpp;
 
+  /* Node used while queued for a PTHREAD_MUTEX_QUEUED_NP mutex.  */
+  struct pthread_mutex_qnode mutex_qnode;
+
+  /* Reader slots for PTHREAD_RWLOCK_DISTRIBUTED_READERS_NP rwlocks,
+     indexed by __pthread_rwlock_rslot_index.  Written only by this
+     thread and read by writers of these rwlocks.  */
+  struct pthread_rwlock_rslot rwlock_rslots[PTHREAD_RWLOCK_RSLOTS];
+
+  /* Number of spins after which this thread recently saw semaphores,
+     rwlocks and condition variables become available, indexed by
+     NPTL_SPIN_*.  Only accessed by this thread.  */
+  unsigned int spin_budget[NPTL_SPIN_KINDS];
+
+  /* Lock profiler state (see nptl-lock-profile.h): the buffer of
+     samples, allocated on the first one, the number of locks whose
+     sampled acquisitions this thread holds, and the number of contended
+     acquisitions until the next sample.  Only the buffer is accessed by
+     other threads.  */
+  struct nptl_lock_profile_buffer *lock_profile;
+  unsigned int lock_profile_nheld;
+  unsigned int lock_profile_countdown;
+
   /* Resolver state.  */
   struct __res_state res;
 
@@ -404,6 +461,9 @@ struct pthread
   /* Used on strsignal.  */
   struct tls_internal_t tls_state;
 
+  /* rseq area registered with the kernel.  */
+  struct rseq rseq_area;
+
   /* This member must be last.  */
   char end_padding[];
 
@@ -0,0 +1,609 @@
+/* Lock contention profiler for NPTL.
+   Copyright (C) 2021 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+/* See nptl-lock-profile.h for how samples are taken.  Each thread
+   appends its samples to a ring buffer that it allocates on its first
+   sample.  The buffers are drained into a hash table keyed by lock
+   address when they are full, when their thread exits, and when the
+   table is read, so that a thread only takes profile_lock once every
+   LOCK_PROFILE_BUFFER_SIZE samples.
+
+   If the table is not empty at exit, it is written out, sorted by the
+   total time waited, to the file PREFIX.PID.locks if the
+   PTHREAD_LOCK_PROFILE environment variable names PREFIX, and to
+   standard error otherwise.  */
+
+#include <_itoa.h>
+#include <dso_handle.h>
+#include <fcntl.h>
+#include <ldsodefs.h>
+#include <libc-lock.h>
+#include <libc-pointer-arith.h>
+#include <limits.h>
+#include <list.h>
+#include <not-cancel.h>
+#include <nptl-lock-profile.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+unsigned int __nptl_lock_profile_interval;
+
+/* Number of samples buffered per thread.  */
+#define LOCK_PROFILE_BUFFER_SIZE 64
+
+/* Number of buckets of the table.  */
+#define LOCK_PROFILE_NBUCKETS 4096
+
+/* Size of the blocks the table entries are carved from.  */
+#define LOCK_PROFILE_ENTRY_BLOCK (64 * 1024)
+
+/* Number of sampled acquisitions per thread whose hold time is tracked
+   at the same time.  */
+#define LOCK_PROFILE_HELD 4
+
+struct lock_profile_sample
+{
+  const void *lock;
+  const void *caller;
+  uint64_t wait_ns;
+  uint64_t hold_ns;
+  int type;
+  bool has_hold;
+  /* Set if the hold time was tracked but could not be recorded.  */
+  bool hold_dropped;
+};
+
+struct nptl_lock_profile_buffer
+{
+  /* Number of samples ever appended, written by the owning thread
+     only.  */
+  unsigned int head;
+  /* Number of samples ever moved to the table, written with
+     profile_lock held only.  */
+  unsigned int tail;
+  /* The pd->lock_profile_nheld sampled acquisitions of locks the
+     thread holds, oldest first, which are appended once they are
+     released, and the times they were acquired.  */
+  struct lock_profile_sample held[LOCK_PROFILE_HELD];
+  uint64_t held_since[LOCK_PROFILE_HELD];
+  struct lock_profile_sample samples[LOCK_PROFILE_BUFFER_SIZE];
+};
+
+struct lock_profile_entry
+{
+  struct lock_profile_entry *next;
+  struct pthread_lock_profile_np stats;
+};
+
+/* The table, allocated on first use, its unused entries, and the
+   number of locks in it.  Protected by profile_lock.  */
+static struct lock_profile_entry **profile_table;
+static struct lock_profile_entry *profile_unused;
+static size_t profile_count;
+__libc_lock_define_initialized (static, profile_lock);
+
+/* Nonzero once the table is scheduled to be written at exit.  */
+static int profile_atexit_registered;
+
+static uint64_t
+lock_profile_now (void)
+{
+  struct __timespec64 ts;
+  __clock_gettime64 (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * (uint64_t) 1000000000 + ts.tv_nsec;
+}
+
+static inline size_t
+lock_profile_hash (const void *lock)
+{
+  uintptr_t h = (uintptr_t) lock / sizeof (int);
+  h ^= h >> 16;
+  h *= 0x45d9f3b;
+  h ^= h >> 16;
+  return h & (LOCK_PROFILE_NBUCKETS - 1);
+}
+
+/* Return the table entry of LOCK, creating it if needed, or NULL if
+   no memory could be allocated.  Called with profile_lock held.  */
+static struct pthread_lock_profile_np *
+lock_profile_lookup (const void *lock, int type)
+{
+  if (profile_table == NULL)
+    {
+      void *table = __mmap (NULL,
+			    LOCK_PROFILE_NBUCKETS * sizeof (*profile_table),
+			    PROT_READ | PROT_WRITE,
+			    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (table == MAP_FAILED)
+	return NULL;
+      profile_table = table;
+    }
+
+  size_t h = lock_profile_hash (lock);
+  for (struct lock_profile_entry *e = profile_table[h]; e != NULL;
+       e = e->next)
+    if (e->stats.lock == lock)
+      return &e->stats;
+
+  if (profile_unused == NULL)
+    {
+      char *block = __mmap (NULL, LOCK_PROFILE_ENTRY_BLOCK,
+			    PROT_READ | PROT_WRITE,
+			    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (block == MAP_FAILED)
+	return NULL;
+      for (size_t i = 0;
+	   i + sizeof (struct lock_profile_entry) <= LOCK_PROFILE_ENTRY_BLOCK;
+	   i += sizeof (struct lock_profile_entry))
+	{
+	  struct lock_profile_entry *e
+	    = (struct lock_profile_entry *) (block + i);
+	  e->next = profile_unused;
+	  profile_unused = e;
+	}
+    }
+
+  struct lock_profile_entry *e = profile_unused;
+  profile_unused = e->next;
+  memset (&e->stats, 0, sizeof (e->stats));
+  e->stats.lock = lock;
+  e->stats.type = type;
+  e->next = profile_table[h];
+  profile_table[h] = e;
+  ++profile_count;
+  return &e->stats;
+}
+
+/* Move the samples in B to the table.  Called with profile_lock held,
+   possibly by another thread than the one owning B.  */
+static void
+lock_profile_drain (struct nptl_lock_profile_buffer *b)
+{
+  /* Acquire MO so that we see the samples the owner appended.  */
+  unsigned int head = atomic_load_acquire (&b->head);
+  unsigned int tail = b->tail;
+  for (; tail != head; ++tail)
+    {
+      struct lock_profile_sample *s
+	= &b->samples[tail % LOCK_PROFILE_BUFFER_SIZE];
+      struct pthread_lock_profile_np *stats
+	= lock_profile_lookup (s->lock, s->type);
+      if (stats == NULL)
+	continue;
+      ++stats->samples;
+      stats->wait_ns += s->wait_ns;
+      if (s->wait_ns >= stats->max_wait_ns)
+	{
+	  stats->max_wait_ns = s->wait_ns;
+	  stats->max_wait_caller = s->caller;
+	}
+      if (s->has_hold)
+	{
+	  ++stats->hold_samples;
+	  stats->hold_ns += s->hold_ns;
+	}
+      else if (s->hold_dropped)
+	++stats->hold_dropped;
+    }
+  /* Release MO so that the owner reuses the slots only after we have
+     read them.  */
+  atomic_store_release (&b->tail, tail);
+}
+
+/* Move the samples buffered by all threads to the table.  Called with
+   profile_lock held.  */
+static void
+lock_profile_drain_all (void)
+{
+  list_t *runp;
+  list_for_each (runp, &GL (dl_stack_used))
+    {
+      struct pthread *t = list_entry (runp, struct pthread, list);
+      struct nptl_lock_profile_buffer *b
+	= atomic_load_acquire (&t->lock_profile);
+      if (b != NULL)
+	lock_profile_drain (b);
+    }
+  list_for_each (runp, &GL (dl_stack_user))
+    {
+      struct pthread *t = list_entry (runp, struct pthread, list);
+      struct nptl_lock_profile_buffer *b
+	= atomic_load_acquire (&t->lock_profile);
+      if (b != NULL)
+	lock_profile_drain (b);
+    }
+}
+
+/* Append *S to the buffer B of the current thread.  */
+static void
+lock_profile_append (struct nptl_lock_profile_buffer *b,
+		     const struct lock_profile_sample *s)
+{
+  unsigned int head = b->head;
+  if (head - atomic_load_acquire (&b->tail) == LOCK_PROFILE_BUFFER_SIZE)
+    {
+      __libc_lock_lock (profile_lock);
+      lock_profile_drain (b);
+      __libc_lock_unlock (profile_lock);
+    }
+  b->samples[head % LOCK_PROFILE_BUFFER_SIZE] = *s;
+  /* Release MO so that a thread draining B sees the sample.  */
+  atomic_store_release (&b->head, head + 1);
+}
+
+/* Store the statistics of the N locks with the longest total wait in
+   BUF, ordered by it.  Return the number of locks in the table.  Called
+   with profile_lock held.  */
+static size_t
+lock_profile_collect (struct pthread_lock_profile_np *buf, size_t n)
+{
+  size_t filled = 0;
+  if (profile_table == NULL)
+    return 0;
+  for (size_t i = 0; i < LOCK_PROFILE_NBUCKETS; i++)
+    for (struct lock_profile_entry *e = profile_table[i]; e != NULL;
+	 e = e->next)
+      {
+	/* Insertion into the sorted prefix of BUF.  */
+	size_t j = filled;
+	while (j > 0 && buf[j - 1].wait_ns < e->stats.wait_ns)
+	  {
+	    if (j < n)
+	      buf[j] = buf[j - 1];
+	    --j;
+	  }
+	if (j < n)
+	  buf[j] = e->stats;
+	if (filled < n)
+	  ++filled;
+      }
+  return profile_count;
+}
+
+int
+pthread_lock_profile_np (struct pthread_lock_profile_np *buf, size_t n)
+{
+  if (__nptl_lock_profile_interval == 0)
+    return -1;
+
+  lll_lock (GL (dl_stack_cache_lock), LLL_PRIVATE);
+  __libc_lock_lock (profile_lock);
+  lock_profile_drain_all ();
+  size_t count = lock_profile_collect (buf, n);
+  __libc_lock_unlock (profile_lock);
+  lll_unlock (GL (dl_stack_cache_lock), LLL_PRIVATE);
+
+  return count > INT_MAX ? INT_MAX : count;
+}
+
+/* Buffered output of the report.  */
+struct profile_writer
+{
+  int fd;
+  size_t len;
+  char buf[1024];
+};
+
+static void
+profile_flush (struct profile_writer *w)
+{
+  char *p = w->buf;
+  while (w->len > 0)
+    {
+      ssize_t n = __write_nocancel (w->fd, p, w->len);
+      if (n <= 0)
+	break;
+      p += n;
+      w->len -= n;
+    }
+  w->len = 0;
+}
+
+static void
+profile_puts (struct profile_writer *w, const char *s)
+{
+  for (; *s != '\0'; s++)
+    {
+      if (w->len == sizeof (w->buf))
+	profile_flush (w);
+      w->buf[w->len++] = *s;
+    }
+}
+
+static void
+profile_putnum (struct profile_writer *w, uint64_t value, unsigned int base)
+{
+  char buf[3 * sizeof (uint64_t) + 3];
+  char *end = buf + sizeof (buf) - 1;
+  *end = '\0';
+  char *s = _itoa (value, end, base, 0);
+  if (base == 16)
+    {
+      *--s = 'x';
+      *--s = '0';
+    }
+  profile_puts (w, s);
+}
+
+static const char *const profile_type_names[] =
+{
+  [PTHREAD_LOCK_PROFILE_MUTEX_NP] = "mutex",
+  [PTHREAD_LOCK_PROFILE_RWLOCK_NP] = "rwlock",
+  [PTHREAD_LOCK_PROFILE_COND_NP] = "cond",
+};
+
+/* Write the table, with one line per lock.  */
+static void
+profile_at_exit (void *closure)
+{
+  lll_lock (GL (dl_stack_cache_lock), LLL_PRIVATE);
+  __libc_lock_lock (profile_lock);
+  lock_profile_drain_all ();
+  lll_unlock (GL (dl_stack_cache_lock), LLL_PRIVATE);
+
+  size_t count = profile_count;
+  size_t size = ALIGN_UP (count * sizeof (struct pthread_lock_profile_np),
+			  GLRO (dl_pagesize));
+  struct pthread_lock_profile_np *stats = NULL;
+  if (count > 0)
+    {
+      stats = __mmap (NULL, size, PROT_READ | PROT_WRITE,
+		      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (stats == MAP_FAILED)
+	stats = NULL;
+    }
+  if (stats != NULL)
+    lock_profile_collect (stats, count);
+  __libc_lock_unlock (profile_lock);
+  if (stats == NULL)
+    return;
+
+  struct profile_writer w;
+  w.fd = STDERR_FILENO;
+  w.len = 0;
+  const char *prefix = __libc_secure_getenv ("PTHREAD_LOCK_PROFILE");
+  if (prefix != NULL && *prefix != '\0' && strlen (prefix) <= 512)
+    {
+      profile_puts (&w, prefix);
+      profile_puts (&w, ".");
+      profile_putnum (&w, __getpid (), 10);
+      profile_puts (&w, ".locks");
+      w.buf[w.len] = '\0';
+      w.fd = __open_nocancel (w.buf,
+			      O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+      w.len = 0;
+    }
+
+  if (w.fd >= 0)
+    {
+      profile_puts (&w, "lock profile: 1 in ");
+      profile_putnum (&w, __nptl_lock_profile_interval, 10);
+      profile_puts (&w, " contended acquisitions sampled\n"
+		    "lock type samples wait_ns max_wait_ns max_wait_caller"
+		    " hold_samples hold_ns hold_dropped\n");
+      for (size_t i = 0; i < count; i++)
+	{
+	  profile_putnum (&w, (uintptr_t) stats[i].lock, 16);
+	  profile_puts (&w, " ");
+	  profile_puts (&w, profile_type_names[stats[i].type]);
+	  profile_puts (&w, " ");
+	  profile_putnum (&w, stats[i].samples, 10);
+	  profile_puts (&w, " ");
+	  profile_putnum (&w, stats[i].wait_ns, 10);
+	  profile_puts (&w, " ");
+	  profile_putnum (&w, stats[i].max_wait_ns, 10);
+	  profile_puts (&w, " ");
+	  profile_putnum (&w, (uintptr_t) stats[i].max_wait_caller, 16);
+	  profile_puts (&w, " ");
+	  profile_putnum (&w, stats[i].hold_samples, 10);
+	  profile_puts (&w, " ");
+	  profile_putnum (&w, stats[i].hold_ns, 10);
+	  profile_puts (&w, " ");
+	  profile_putnum (&w, stats[i].hold_dropped, 10);
+	  profile_puts (&w, "\n");
+	}
+      profile_flush (&w);
+      if (w.fd != STDERR_FILENO)
+	__close_nocancel_nostatus (w.fd);
+    }
+
+  __munmap (stats, size);
+}
+
+/* Return the index of the sampled acquisition of LOCK among the N ones
+   in B->held, or N if there is none.  */
+static unsigned int
+lock_profile_find_held (struct nptl_lock_profile_buffer *b, unsigned int n,
+			const void *lock)
+{
+  unsigned int i = n;
+  while (i > 0)
+    if (b->held[--i].lock == lock)
+      return i;
+  return n;
+}
+
+/* Remove the entry I of the N ones in B->held.  */
+static void
+lock_profile_remove_held (struct nptl_lock_profile_buffer *b, unsigned int n,
+			  unsigned int i)
+{
+  for (; i + 1 < n; i++)
+    {
+      b->held[i] = b->held[i + 1];
+      b->held_since[i] = b->held_since[i + 1];
+    }
+}
+
+uint64_t
+__nptl_lock_profile_sample (void)
+{
+  struct pthread *self = THREAD_SELF;
+  if (self->lock_profile_countdown > 1)
+    {
+      --self->lock_profile_countdown;
+      return 0;
+    }
+  self->lock_profile_countdown = __nptl_lock_profile_interval;
+  return lock_profile_now ();
+}
+
+void
+__nptl_lock_profile_record (const void *lock, int type, const void *caller,
+			    uint64_t start, bool held)
+{
+  struct pthread *self = THREAD_SELF;
+  struct nptl_lock_profile_buffer *b = self->lock_profile;
+  if (b == NULL)
+    {
+      b = __mmap (NULL, sizeof (*b), PROT_READ | PROT_WRITE,
+		  MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (b == MAP_FAILED)
+	return;
+      /* Release MO so that threads draining B see it initialized.  */
+      atomic_store_release (&self->lock_profile, b);
+      if (atomic_exchange_relaxed (&profile_atexit_registered, 1) == 0)
+	__cxa_atexit (profile_at_exit, NULL, __dso_handle);
+    }
+
+  uint64_t now = lock_profile_now ();
+  struct lock_profile_sample s =
+    {
+      .lock = lock,
+      .caller = caller,
+      .wait_ns = now - start,
+      .type = type,
+    };
+
+  if (!held)
+    {
+      lock_profile_append (b, &s);
+      return;
+    }
+
+  /* A sampled lock still in the list was released without
+     __nptl_lock_profile_release being called (for example, by a thread
+     which did not own it), and if the list is full, the hold time of
+     its oldest lock is given up.  Keep their wait time at least.  */
+  unsigned int n = self->lock_profile_nheld;
+  unsigned int i = lock_profile_find_held (b, n, lock);
+  if (i == n && n == LOCK_PROFILE_HELD)
+    i = 0;
+  if (i < n)
+    {
+      b->held[i].hold_dropped = true;
+      lock_profile_append (b, &b->held[i]);
+      lock_profile_remove_held (b, n--, i);
+    }
+  b->held[n] = s;
+  b->held_since[n] = now;
+  self->lock_profile_nheld = n + 1;
+}
+
+void
+__nptl_lock_profile_release_held (const void *lock)
+{
+  struct pthread *self = THREAD_SELF;
+  struct nptl_lock_profile_buffer *b = self->lock_profile;
+  unsigned int n = self->lock_profile_nheld;
+  unsigned int i = lock_profile_find_held (b, n, lock);
+  if (i == n)
+    return;
+  b->held[i].hold_ns = lock_profile_now () - b->held_since[i];
+  b->held[i].has_hold = true;
+  lock_profile_append (b, &b->held[i]);
+  lock_profile_remove_held (b, n, i);
+  self->lock_profile_nheld = n - 1;
+}
+
+/* Free the buffer of PD, after moving its samples to the table if
+   DRAIN.  */
+static void
+lock_profile_free (struct pthread *pd, bool drain)
+{
+  struct nptl_lock_profile_buffer *b = pd->lock_profile;
+  if (b != NULL)
+    {
+      if (drain)
+	{
+	  for (unsigned int i = 0; i < pd->lock_profile_nheld; i++)
+	    {
+	      b->held[i].hold_dropped = true;
+	      lock_profile_append (b, &b->held[i]);
+	    }
+
+	  __libc_lock_lock (profile_lock);
+	  lock_profile_drain (b);
+	  /* Threads draining all buffers do so with profile_lock
+	     held.  */
+	  pd->lock_profile = NULL;
+	  __libc_lock_unlock (profile_lock);
+	}
+      else
+	pd->lock_profile = NULL;
+      __munmap (b, sizeof (*b));
+    }
+
+  /* The descriptor may be reused for a new thread.  */
+  pd->lock_profile_nheld = 0;
+  pd->lock_profile_countdown = 0;
+}
+
+void
+__nptl_lock_profile_thread_exit (struct pthread *pd)
+{
+  lock_profile_free (pd, true);
+}
+
+void
+__nptl_lock_profile_reclaim (struct pthread *pd)
+{
+  lock_profile_free (pd, false);
+}
+
+void
+__nptl_lock_profile_fork_subprocess (void)
+{
+  __libc_lock_init (profile_lock);
+
+  /* The samples were taken by the parent, which reports them itself.
+     Keep the memory of the table for the samples of the child.  The
+     exit handler has been inherited along with the table, so
+     profile_atexit_registered stays set; it writes nothing unless the
+     child takes samples.  */
+  if (profile_table != NULL)
+    for (size_t i = 0; i < LOCK_PROFILE_NBUCKETS; i++)
+      while (profile_table[i] != NULL)
+	{
+	  struct lock_profile_entry *e = profile_table[i];
+	  profile_table[i] = e->next;
+	  e->next = profile_unused;
+	  profile_unused = e;
+	}
+  profile_count = 0;
+
+  /* Drop the samples the current thread buffered in the parent.  Its
+     sampled locks are still held in the child, so their hold time is
+     still recorded.  */
+  struct nptl_lock_profile_buffer *b = THREAD_SELF->lock_profile;
+  if (b != NULL)
+    b->tail = b->head;
+}
@@ -0,0 +1,106 @@
+/* Adaptive spinning before blocking for NPTL.
+   Copyright (C) 2021 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+#ifndef _NPTL_SPIN_H
+#define _NPTL_SPIN_H
+
+#include <atomic.h>
+#include <pthreadP.h>
+#include <stdbool.h>
+
+/* Semaphores, rwlocks and condition variables spin for a while before
+   they block in futex_wait, because the resource is often handed over
+   within less time than the system calls to block and to wake up
+   take.  This follows PTHREAD_MUTEX_ADAPTIVE_NP (see
+   pthread_mutex_lock.c): the spin limit is twice a budget plus a
+   constant, and the budget moves towards the number of spins that were
+   needed, or towards the limit if spinning was not successful.  Unlike
+   for adaptive mutexes the budget is kept per thread and kind of wait
+   rather than per object, because these objects have no room for it.
+   Both the limit and the budget are bounded by the
+   glibc.pthread.wait_spin_count tunable; zero, the default, disables
+   spinning.
+
+   The time between two polls of the resource doubles up to
+   NPTL_SPIN_MAX_BACKOFF calls of atomic_spin_nop, so that the cache
+   line holding the resource is not contended by the spinning waiters.
+
+   A spinning wait looks like this:
+
+     struct nptl_spin spin;
+     __nptl_spin_begin (&spin, NPTL_SPIN_SEM);
+     while (!available && __nptl_spin_next (&spin))
+       poll;
+     __nptl_spin_end (&spin, available);
+     if (!available)
+       block;  */
+
+#define NPTL_SPIN_MAX_BACKOFF 16
+
+struct nptl_spin
+{
+  /* atomic_spin_nop calls so far.  */
+  unsigned int count;
+  /* Number of calls after which to give up.  */
+  unsigned int limit;
+  /* Number of calls before the next poll.  */
+  unsigned int backoff;
+  /* One of NPTL_SPIN_*.  */
+  int kind;
+};
+
+static __always_inline void
+__nptl_spin_begin (struct nptl_spin *spin, int kind)
+{
+  unsigned int max = max_wait_spin_count ();
+  unsigned int budget = THREAD_SELF->spin_budget[kind];
+  spin->count = 0;
+  spin->limit = MIN (max, budget * 2 + 10);
+  spin->backoff = 1;
+  spin->kind = kind;
+}
+
+/* Wait before the next poll.  Return false if the caller should block
+   instead.  */
+static __always_inline bool
+__nptl_spin_next (struct nptl_spin *spin)
+{
+  if (spin->count >= spin->limit)
+    return false;
+  for (unsigned int i = 0; i < spin->backoff; i++)
+    atomic_spin_nop ();
+  spin->count += spin->backoff;
+  if (spin->backoff < NPTL_SPIN_MAX_BACKOFF)
+    spin->backoff *= 2;
+  return true;
+}
+
+/* Update the budget of the calling thread.  SUCCESS says whether the
+   resource became available while spinning.  Waits that did not spin
+   at all leave the budget alone.  */
+static __always_inline void
+__nptl_spin_end (struct nptl_spin *spin, bool success)
+{
+  if (spin->count == 0)
+    return;
+  unsigned int *budget = &THREAD_SELF->spin_budget[spin->kind];
+  int count = success ? spin->count : spin->limit;
+  *budget += (count - (int) *budget) / 8;
+}
+
+#endif /* nptl-spin.h */
@@ -21,6 +21,9 @@
 #include <pthreadP.h>
 
 size_t __nptl_stack_cache_maxsize = 40 * 1024 * 1024;
+size_t __nptl_stack_prefault_size;
+size_t __nptl_stack_thp_pagesize;
+bool __nptl_stack_thp_madvise;
 
 void
 __nptl_stack_list_del (list_t *elem)
@@ -56,37 +59,38 @@ void
 __nptl_free_stacks (size_t limit)
 {
   /* We reduce the size of the cache.  Remove the last entries until
-     the size is below the limit.  */
+     the size is below the limit, starting with the largest stacks.  */
   list_t *entry;
   list_t *prev;
 
-  /* Search from the end of the list.  */
-  list_for_each_prev_safe (entry, prev, &GL (dl_stack_cache))
-    {
-      struct pthread *curr;
-
-      curr = list_entry (entry, struct pthread, list);
-      if (__nptl_stack_in_use (curr))
-	{
-	  /* Unlink the block.  */
-	  __nptl_stack_list_del (entry);
-
-	  /* Account for the freed memory.  */
-	  GL (dl_stack_cache_actsize) -= curr->stackblock_size;
-
-	  /* Free the memory associated with the ELF TLS.  */
-	  _dl_deallocate_tls (TLS_TPADJ (curr), false);
-
-	  /* Remove this block.  This should never fail.  If it does
-	     something is really wrong.  */
-	  if (__munmap (curr->stackblock, curr->stackblock_size) != 0)
-	    abort ();
-
-	  /* Maybe we have freed enough.  */
-	  if (GL (dl_stack_cache_actsize) <= limit)
-	    break;
-	}
-    }
+  for (int i = DL_STACK_CACHE_BUCKETS - 1; i >= 0; --i)
+    /* Search from the end of the list.  */
+    list_for_each_prev_safe (entry, prev, &GL (dl_stack_cache)[i])
+      {
+	struct pthread *curr;
+
+	curr = list_entry (entry, struct pthread, list);
+	if (__nptl_stack_in_use (curr))
+	  {
+	    /* Unlink the block.  */
+	    __nptl_stack_list_del (entry);
+
+	    /* Account for the freed memory.  */
+	    GL (dl_stack_cache_actsize) -= curr->stackblock_size;
+
+	    /* Free the memory associated with the ELF TLS.  */
+	    _dl_deallocate_tls (TLS_TPADJ (curr), false);
+
+	    /* Remove this block.  This should never fail.  If it does
+	       something is really wrong.  */
+	    if (__munmap (curr->stackblock, curr->stackblock_size) != 0)
+	      abort ();
+
+	    /* Maybe we have freed enough.  */
+	    if (GL (dl_stack_cache_actsize) <= limit)
+	      return;
+	  }
+      }
 }
 
 /* Add a stack frame which is not used anymore to the stack.  Must be
@@ -98,7 +102,8 @@ queue_stack (struct pthread *stack)
   /* We unconditionally add the stack to the list.  The memory may
      still be in use but it will not be reused until the kernel marks
      the stack as not used anymore.  */
-  __nptl_stack_list_add (&stack->list, &GL (dl_stack_cache));
+  unsigned int bucket = __nptl_stack_cache_bucket (stack->stackblock_size);
+  __nptl_stack_list_add (&stack->list, &GL (dl_stack_cache)[bucket]);
 
   GL (dl_stack_cache_actsize) += stack->stackblock_size;
   if (__glibc_unlikely (GL (dl_stack_cache_actsize)
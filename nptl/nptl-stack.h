@@ -27,6 +27,35 @@
 /* Maximum size of the cache, in bytes.  40 MiB by default.  */
 extern size_t __nptl_stack_cache_maxsize attribute_hidden;
 
+/* Number of bytes at the top of newly allocated stacks that are
+   populated right away (glibc.pthread.stack_prefault).  */
+extern size_t __nptl_stack_prefault_size attribute_hidden;
+
+/* If not zero, newly allocated stacks that are at least this large are
+   aligned to this size, so that they can use transparent huge pages
+   (glibc.pthread.stack_hugetlb).  */
+extern size_t __nptl_stack_thp_pagesize attribute_hidden;
+
+/* True if the kernel only uses transparent huge pages for memory advised
+   with MADV_HUGEPAGE, which is then applied to the aligned stacks.  */
+extern bool __nptl_stack_thp_madvise attribute_hidden;
+
+/* Return the index of the GL (dl_stack_cache) list for stacks of SIZE
+   bytes.  List 0 holds stacks smaller than 64 KiB, list N for N > 0
+   stacks of at least 64 KiB << (N - 1) and less than 64 KiB << N bytes,
+   and the last list all larger stacks.  */
+static inline unsigned int
+__nptl_stack_cache_bucket (size_t size)
+{
+  unsigned long int units = size >> 16;
+  if (units == 0)
+    return 0;
+  unsigned int bucket = sizeof (units) * 8 - __builtin_clzl (units);
+  if (bucket >= DL_STACK_CACHE_BUCKETS)
+    bucket = DL_STACK_CACHE_BUCKETS - 1;
+  return bucket;
+}
+
 /* Check whether the stack is still used or not.  */
 static inline bool
 __nptl_stack_in_use (struct pthread *pd)
@@ -39,7 +68,7 @@ void __nptl_stack_list_del (list_t *elem);
 libc_hidden_proto (__nptl_stack_list_del)
 
 /* Add ELEM to a stack list.  LIST can be either &GL (dl_stack_used)
-   or &GL (dl_stack_cache).  */
+   or one of the GL (dl_stack_cache) lists.  */
 void __nptl_stack_list_add (list_t *elem, list_t *list);
 libc_hidden_proto (__nptl_stack_list_add)
 
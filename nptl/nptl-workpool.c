@@ -0,0 +1,225 @@
+/* Internal worker thread pool of libc.
+   Copyright (C) 2021 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+/* Functions are never queued: __nptl_workpool_submit hands each one
+   directly to a parked worker, which sleeps on a futex word on its own
+   stack, or to a new thread.  Parked workers are kept in LIFO
+   order, so that work goes to the worker that parked last and the
+   workers which have been parked longest time out if there is less
+   work than workers.  */
+
+#include <errno.h>
+#include <futex-internal.h>
+#include <libc-lock.h>
+#include <list.h>
+#include <nptl-workpool.h>
+#include <pthreadP.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <sys/prctl.h>
+#include <sysdep.h>
+#include <time.h>
+
+/* A worker.  Lives on the stack of its thread.  */
+struct workpool_worker
+{
+  /* Element of idle_workers while the worker is parked.  */
+  list_t list;
+
+  /* The function to run next.  */
+  void *(*fn) (void *);
+  void *arg;
+
+  /* Futex word the worker parks on.  Set to 1 when the worker is
+     unparked.  */
+  unsigned int unparked;
+};
+
+/* Parked workers, the most recently parked first.  */
+static LIST_HEAD (idle_workers);
+
+/* Number of elements of idle_workers.  */
+static unsigned int idle_count;
+
+/* Protects idle_workers, idle_count and the workers on the list.  */
+__libc_lock_define_initialized (static, workpool_lock);
+
+/* Passed to a new worker.  */
+struct workpool_start
+{
+  void *(*fn) (void *);
+  void *arg;
+};
+
+/* Block all signals but SIGSETXID, like the helper thread of
+   SIGEV_THREAD timers does.  */
+static void
+workpool_sigmask (sigset_t *ss)
+{
+  __sigfillset (ss);
+  __sigdelset (ss, SIGSETXID);
+}
+
+/* Park SELF until a function is handed to it.  Return false if this
+   does not happen before the idle time expires or if enough workers
+   are parked already.  */
+static bool
+workpool_park (struct workpool_worker *self)
+{
+  struct __timespec64 abstime;
+  __clock_gettime64 (CLOCK_MONOTONIC, &abstime);
+  abstime.tv_sec += __nptl_workpool_idle_time / 1000;
+  abstime.tv_nsec += (__nptl_workpool_idle_time % 1000) * 1000000;
+  if (abstime.tv_nsec >= 1000000000)
+    {
+      abstime.tv_nsec -= 1000000000;
+      ++abstime.tv_sec;
+    }
+
+  __libc_lock_lock (workpool_lock);
+
+  if (idle_count >= __nptl_workpool_max_idle)
+    {
+      __libc_lock_unlock (workpool_lock);
+      return false;
+    }
+
+  self->unparked = 0;
+  list_add (&self->list, &idle_workers);
+  ++idle_count;
+
+  while (self->unparked == 0)
+    {
+      __libc_lock_unlock (workpool_lock);
+      int err = __futex_abstimed_wait64 (&self->unparked, 0,
+					 CLOCK_MONOTONIC, &abstime,
+					 FUTEX_PRIVATE);
+      __libc_lock_lock (workpool_lock);
+
+      if (err == ETIMEDOUT && self->unparked == 0)
+	{
+	  list_del (&self->list);
+	  --idle_count;
+	  break;
+	}
+    }
+
+  bool unparked = self->unparked != 0;
+  __libc_lock_unlock (workpool_lock);
+  return unparked;
+}
+
+static void *
+workpool_thread (void *closure)
+{
+  struct workpool_start *start = closure;
+  struct workpool_worker self;
+  self.fn = start->fn;
+  self.arg = start->arg;
+  free (start);
+
+  sigset_t ss;
+  workpool_sigmask (&ss);
+
+  /* The name inherited from the thread that created the worker.  */
+  char name[16];
+  bool has_name = INTERNAL_SYSCALL_CALL (prctl, PR_GET_NAME, name) == 0;
+
+  struct pthread *pd = THREAD_SELF;
+  do
+    {
+      self.fn (self.arg);
+
+      /* The next function starts in the state the worker was created
+	 in: with its signal mask, with deferred cancellation enabled
+	 and no cancellation request pending, without thread-specific
+	 data, and with its name.  */
+      INTERNAL_SYSCALL_CALL (rt_sigprocmask, SIG_SETMASK, &ss, NULL,
+			     __NSIG_BYTES);
+      THREAD_SETMEM (pd, cancelstate, PTHREAD_CANCEL_ENABLE);
+      THREAD_SETMEM (pd, canceltype, PTHREAD_CANCEL_DEFERRED);
+      atomic_fetch_and_relaxed (&pd->cancelhandling, ~CANCELED_BITMASK);
+      __nptl_deallocate_tsd ();
+      if (has_name)
+	INTERNAL_SYSCALL_CALL (prctl, PR_SET_NAME, name);
+    }
+  while (workpool_park (&self));
+
+  return NULL;
+}
+
+int
+__nptl_workpool_submit (void *(*fn) (void *), void *arg)
+{
+  __libc_lock_lock (workpool_lock);
+
+  if (idle_count > 0)
+    {
+      struct workpool_worker *w = list_entry (idle_workers.next,
+					      struct workpool_worker, list);
+      list_del (&w->list);
+      --idle_count;
+
+      w->fn = fn;
+      w->arg = arg;
+      w->unparked = 1;
+      /* The worker cannot return from workpool_park, and its stack
+	 cannot go away, before the lock is released.  */
+      futex_wake (&w->unparked, 1, FUTEX_PRIVATE);
+
+      __libc_lock_unlock (workpool_lock);
+      return 0;
+    }
+
+  __libc_lock_unlock (workpool_lock);
+
+  struct workpool_start *start = malloc (sizeof (*start));
+  if (start == NULL)
+    return EAGAIN;
+  start->fn = fn;
+  start->arg = arg;
+
+  pthread_attr_t attr;
+  __pthread_attr_init (&attr);
+  __pthread_attr_setdetachstate (&attr, PTHREAD_CREATE_DETACHED);
+
+  sigset_t ss;
+  workpool_sigmask (&ss);
+  int ret = __pthread_attr_setsigmask_internal (&attr, &ss);
+  if (ret == 0)
+    {
+      pthread_t th;
+      ret = __pthread_create (&th, &attr, workpool_thread, start);
+    }
+
+  __pthread_attr_destroy (&attr);
+
+  if (ret != 0)
+    free (start);
+  return ret;
+}
+
+void
+__nptl_workpool_fork_subprocess (void)
+{
+  /* The parked workers of the parent do not exist in the child.  */
+  INIT_LIST_HEAD (&idle_workers);
+  idle_count = 0;
+  __libc_lock_init (workpool_lock);
+}
@@ -16,7 +16,9 @@
    <https://www.gnu.org/licenses/>.  */
 
 #include <errno.h>
+#include <stdint.h>
 #include <sysdep.h>
+#include <sys/sysinfo.h>
 #include <futex-internal.h>
 #include <pthreadP.h>
 #include <shlib-compat.h>
@@ -87,10 +89,155 @@
      pthread_barrier_destroy will of course wait for the signal handler thread
      to confirm that it left the barrier.
 
-   TODO We should add spinning with back-off.  Once we do that, we could also
-   try to avoid the futex_wake syscall when a round is detected as finished.
-   If we do not spin, it is quite likely that at least some other threads will
-   have called futex_wait already.  */
+   Wake-up tree: With many threads, having all of them block on
+   CURRENT_ROUND does not scale.  The thread finishing a round has to wake
+   all COUNT-1 other threads with a single futex_wake, which the kernel
+   processes serially, and all of them then wake up at the same time and
+   access the barrier.  Therefore, private barriers with at least
+   BARRIER_TREE_THRESHOLD threads use a tree instead.  A thread's position
+   in its round, (I - 1) % COUNT, is its node in a tree with fan-out
+   BARRIER_TREE_FANOUT rooted at position 0.  Each node has a wake word,
+   and threads spin on CURRENT_ROUND for a while and then block on the
+   wake word of their node.  The thread finishing a round wakes the root,
+   and every thread that leaves the barrier wakes its children (whether it
+   blocked or not).  Thus, the wake-ups are spread over all threads and
+   proceed in parallel, and the last thread in the tree is woken after a
+   logarithmic number of steps.  The tree still uses IN, OUT, and
+   CURRENT_ROUND exactly as described above, so reset and
+   pthread_barrier_destroy are unchanged.
+
+   The wake words are not part of the barrier (there is no space for them
+   in pthread_barrier_t) but are taken from a global table, indexed by a
+   hash of the barrier's address and the position.  Different barriers and
+   different rounds of the same barrier can thus share a wake word;
+   threads always wake all waiters on a word and recheck CURRENT_ROUND
+   after a wake-up, so this only causes spurious wake-ups.  Because
+   waking does not access the barrier, the table also does not have to be
+   considered for pthread_barrier_destroy.  Bit 0 of a wake word is set
+   when threads are blocked on it, so that futex_wake can be skipped
+   otherwise; the other bits are a sequence number that is incremented on
+   every wake-up, which prevents lost wake-ups.
+
+   A thread in the tree only gets to wake its children once it runs, so if
+   there are more threads than CPUs, a preempted thread delays its whole
+   subtree.  Process-shared barriers and barriers with fewer threads keep
+   blocking on CURRENT_ROUND.
+
+   TODO We should add spinning with back-off for barriers that do not use
+   the tree too.  Once we do that, we could also try to avoid the
+   futex_wake syscall when a round is detected as finished.  If we do not
+   spin, it is quite likely that at least some other threads will have
+   called futex_wait already.  */
+
+/* Number of wake words shared by all barriers using the wake-up tree.  */
+#define BARRIER_TREE_SLOTS 256
+
+/* Number of times a thread in the wake-up tree checks whether its round has
+   finished before it blocks.  Spinning only helps if the other threads of
+   the round can run at the same time, so threads do not spin if the
+   barrier is for more threads than there are CPUs.  */
+#define BARRIER_TREE_SPIN 1000
+
+/* The number of CPUs the first thread using the wake-up tree could run
+   on, or 0 if not yet determined.  */
+static int barrier_tree_nprocs;
+
+/* Each wake word is on its own cache line so that waking a node does not
+   disturb threads spinning or blocking on its siblings.  */
+static struct
+{
+  unsigned int word;
+} __attribute__ ((aligned (64))) barrier_tree_slots[BARRIER_TREE_SLOTS];
+
+static inline bool
+barrier_uses_tree (unsigned int count, int shared)
+{
+  return count >= BARRIER_TREE_THRESHOLD && shared == FUTEX_PRIVATE;
+}
+
+/* Return the wake word of position POS of BAR.  Consecutive positions use
+   consecutive wake words, so the threads of one round do not share wake
+   words unless there are more than BARRIER_TREE_SLOTS of them.  */
+static inline unsigned int *
+barrier_tree_slot (struct pthread_barrier *bar, unsigned int pos)
+{
+  unsigned int h = ((uintptr_t) bar >> 4) * 0x9e3779b1u;
+  return &barrier_tree_slots[(h + pos) % BARRIER_TREE_SLOTS].word;
+}
+
+/* Wake all threads blocked on SLOT.  The caller must have observed that
+   the round of the threads it wants to wake has finished.  */
+static void
+barrier_tree_wake (unsigned int *slot)
+{
+  /* Release MO so that woken threads that observe our modification also
+     observe the finished round.  */
+  unsigned int w = atomic_load_relaxed (slot);
+  while (!atomic_compare_exchange_weak_release (slot, &w, (w + 2) & ~1U))
+    ;
+  if ((w & 1) != 0)
+    futex_wake (slot, INT_MAX, FUTEX_PRIVATE);
+}
+
+/* Wake the children of position POS in the wake-up tree of a barrier with
+   COUNT threads.  */
+static void
+barrier_tree_wake_children (struct pthread_barrier *bar, unsigned int pos,
+			    unsigned int count)
+{
+  for (unsigned int c = 1; c <= BARRIER_TREE_FANOUT; c++)
+    {
+      uint64_t child = (uint64_t) pos * BARRIER_TREE_FANOUT + c;
+      if (child >= count)
+	break;
+      barrier_tree_wake (barrier_tree_slot (bar, child));
+    }
+}
+
+/* Wait until CURRENT_ROUND of BAR is at least I, given that it was CR
+   when last loaded.  POS is the position of the calling thread.  Returns
+   the new value of CURRENT_ROUND.  */
+static unsigned int
+barrier_tree_wait (struct pthread_barrier *bar, unsigned int i,
+		   unsigned int cr, unsigned int pos)
+{
+  int nprocs = atomic_load_relaxed (&barrier_tree_nprocs);
+  if (nprocs == 0)
+    {
+      nprocs = __get_nprocs_sched ();
+      atomic_store_relaxed (&barrier_tree_nprocs, nprocs);
+    }
+  if (bar->count <= (unsigned int) nprocs)
+    for (int spin = 0; i > cr && spin < BARRIER_TREE_SPIN; spin++)
+      {
+	atomic_spin_nop ();
+	cr = atomic_load_relaxed (&bar->current_round);
+      }
+
+  unsigned int *slot = barrier_tree_slot (bar, pos);
+  while (i > cr)
+    {
+      /* Acquire MO so that if we observe the modification by the thread
+	 waking us, or a later one, we also observe the finished round
+	 (see barrier_tree_wake).  Otherwise, the waker has not yet
+	 modified the wake word, so either our futex_wait below will return
+	 immediately or the waker will see that bit 0 is set and wake us.  */
+      unsigned int w = atomic_load_acquire (slot);
+      if ((w & 1) == 0)
+	{
+	  if (!atomic_compare_exchange_weak_acquire (slot, &w, w | 1))
+	    continue;
+	  w |= 1;
+	}
+      cr = atomic_load_relaxed (&bar->current_round);
+      if (i <= cr)
+	break;
+      futex_wait_simple (slot, w, FUTEX_PRIVATE);
+      cr = atomic_load_relaxed (&bar->current_round);
+    }
+  return cr;
+}
+
 int
 ___pthread_barrier_wait (pthread_barrier_t *barrier)
 {
@@ -164,7 +311,10 @@ ___pthread_barrier_wait (pthread_barrier_t *barrier)
 	     use of barriers.
 	     Note that we can still access SHARED because we haven't yet
 	     confirmed to have left the barrier.  */
-	  futex_wake (&bar->current_round, INT_MAX, bar->shared);
+	  if (barrier_uses_tree (count, bar->shared))
+	    barrier_tree_wake (barrier_tree_slot (bar, 0));
+	  else
+	    futex_wake (&bar->current_round, INT_MAX, bar->shared);
 	  /* We did as much as we could based on our position.  If we advanced
 	     the current round to a round sufficient for us, do not wait for
 	     that to happen and skip the acquire fence (we already
@@ -178,13 +328,17 @@ ___pthread_barrier_wait (pthread_barrier_t *barrier)
     }
 
   /* Wait until the current round is more recent than the round we are in.  */
-  while (i > cr)
-    {
-      /* Wait for the current round to finish.  */
-      futex_wait_simple (&bar->current_round, cr, bar->shared);
-      /* See the fence below.  */
-      cr = atomic_load_relaxed (&bar->current_round);
-    }
+  if (barrier_uses_tree (count, bar->shared))
+    /* See the fence below.  */
+    cr = barrier_tree_wait (bar, i, cr, (i - 1) % count);
+  else
+    while (i > cr)
+      {
+	/* Wait for the current round to finish.  */
+	futex_wait_simple (&bar->current_round, cr, bar->shared);
+	/* See the fence below.  */
+	cr = atomic_load_relaxed (&bar->current_round);
+      }
 
   /* Our round finished.  Use the acquire MO fence to synchronize-with the
      thread that finished the round, either through the initial load of
@@ -194,6 +348,12 @@ ___pthread_barrier_wait (pthread_barrier_t *barrier)
   /* Now signal that we left.  */
   unsigned int o;
  ready_to_leave:
+  /* Pass on the wake-up.  This does not access the barrier except for
+     reading COUNT and SHARED, which we can still do because we have not
+     yet confirmed to have left the barrier.  */
+  if (barrier_uses_tree (count, bar->shared))
+    barrier_tree_wake_children (bar, (i - 1) % count, count);
+
   /* We need release MO here so that our use of the barrier happens before
      reset or memory reuse after pthread_barrier_destroy.  */
   o = atomic_fetch_add_release (&bar->out, 1) + 1;
@@ -33,7 +33,9 @@
    section: (1) signal all waiters in G1, (2) close G1 so that it can become
    the new G2 and make G2 the new G1, and (3) signal all waiters in the new
    G1.  We don't need to do all these steps if there are no waiters in G1
-   and/or G2.  See __pthread_cond_signal for further details.  */
+   and/or G2.  See __pthread_cond_signal for further details.
+   We wake only one waiter per group; the waiters then wake each other as
+   they acquire the mutex (see __pthread_cond_wait_common).  */
 int
 ___pthread_cond_broadcast (pthread_cond_t *cond)
 {
@@ -60,11 +62,12 @@ ___pthread_cond_broadcast (pthread_cond_t *cond)
 				cond->__data.__g_size[g1] << 1);
       cond->__data.__g_size[g1] = 0;
 
-      /* We need to wake G1 waiters before we quiesce G1 below.  */
+      /* Start the hand-off of wake-ups.  If we quiesce G1 below, this
+	 will wake all remaining G1 waiters.  */
       /* TODO Only set it if there are indeed futex waiters.  We could
 	 also try to move this out of the critical section in cases when
 	 G2 is empty (and we don't need to quiesce).  */
-      futex_wake (cond->__data.__g_signals + g1, INT_MAX, private);
+      futex_wake (cond->__data.__g_signals + g1, 1, private);
     }
 
   /* G1 is complete.  Step (2) is next unless there are no waiters in G2, in
@@ -82,7 +85,7 @@ ___pthread_cond_broadcast (pthread_cond_t *cond)
   __condvar_release_lock (cond, private);
 
   if (do_futex_wake)
-    futex_wake (cond->__data.__g_signals + g1, INT_MAX, private);
+    futex_wake (cond->__data.__g_signals + g1, 1, private);
 
   return 0;
 }
@@ -35,8 +35,10 @@
    effectively ensure that destruction happens after the execution of those
    signal or broadcast calls.
    Thus, we can assume that all waiters that are still accessing the condvar
-   have been woken.  We wait until they have confirmed to have woken up by
-   decrementing __wrefs.  */
+   have been signaled.  Some of them may still be blocked, waiting for their
+   turn in the hand-off of a broadcast's wake-ups (see
+   __pthread_cond_wait_common), so we wake all futex waiters.  Then we wait
+   until they have confirmed to have woken up by decrementing __wrefs.  */
 int
 __pthread_cond_destroy (pthread_cond_t *cond)
 {
@@ -48,6 +50,11 @@ __pthread_cond_destroy (pthread_cond_t *cond)
      that they finished.  */
   unsigned int wrefs = atomic_fetch_or_acquire (&cond->__data.__wrefs, 4);
   int private = __condvar_get_private (wrefs);
+  if (wrefs >> 3 != 0)
+    {
+      futex_wake (cond->__data.__g_signals, INT_MAX, private);
+      futex_wake (cond->__data.__g_signals + 1, INT_MAX, private);
+    }
   while (wrefs >> 3 != 0)
     {
       futex_wait_simple (&cond->__data.__wrefs, wrefs, private);
@@ -21,6 +21,8 @@
 #include <futex-internal.h>
 #include <pthread.h>
 #include <pthreadP.h>
+#include <nptl-spin.h>
+#include <nptl-lock-profile.h>
 #include <sys/time.h>
 #include <atomic.h>
 #include <stdint.h>
@@ -340,6 +342,22 @@ __condvar_cleanup_waiting (void *arg)
    G1 they stole from must have been already closed and they do not need to
    fix anything.
 
+   A broadcast does not wake all waiters of a group at once because they
+   would then all contend for the mutex.  Instead, it wakes just one of them,
+   and every waiter that consumes a signal while more signals are left in
+   its group wakes another waiter after it has re-acquired the mutex.  Thus,
+   waiters are woken one at a time as the mutex is handed from one to the
+   next, which has the same effect as requeueing them to the mutex's futex.
+   We cannot actually requeue using FUTEX_CMP_REQUEUE because the condvar
+   does not know the mutex, and because the requeued waiters would still
+   hold their group reference while blocked on the mutex, so that a
+   signaler holding the mutex would deadlock when quiescing their group.
+   Waiting for the hand-off does not keep a group from being quiesced or
+   the condvar from being destroyed: __condvar_quiesce_and_switch_g1 and
+   pthread_cond_destroy wake all remaining futex waiters before waiting for
+   them.  The futex_wake for the next waiter can target a condvar that has
+   been destroyed in the meantime, which is fine (see futex_wake).
+
    It is essential that the last field in pthread_cond_t is __g_signals[1]:
    The previous condvar used a pointer-sized field in pthread_cond_t, so a
    PTHREAD_COND_INITIALIZER from that condvar implementation might only
@@ -379,9 +397,11 @@ static __always_inline int
 __pthread_cond_wait_common (pthread_cond_t *cond, pthread_mutex_t *mutex,
     clockid_t clockid, const struct __timespec64 *abstime)
 {
-  const int maxspin = 0;
   int err;
   int result = 0;
+  bool wake_next = false;
+  struct nptl_lock_profile_wait pw;
+  __nptl_lock_profile_wait_init (&pw);
 
   LIBC_PROBE (cond_wait, 2, cond, mutex);
 
@@ -435,7 +455,7 @@ __pthread_cond_wait_common (pthread_cond_t *cond, pthread_mutex_t *mutex,
     {
       while (1)
 	{
-	  /* Spin-wait first.
+	  /* Spin-wait first (see nptl-spin.h).
 	     Note that spinning first without checking whether a timeout
 	     passed might lead to what looks like a spurious wake-up even
 	     though we should return ETIMEDOUT (e.g., if the caller provides
@@ -445,20 +465,22 @@ __pthread_cond_wait_common (pthread_cond_t *cond, pthread_mutex_t *mutex,
 	     point in time is in the past, and (3) spinning first without
 	     having to compare against the current time seems to be the right
 	     choice from a performance perspective for most use cases.  */
-	  unsigned int spin = maxspin;
-	  while (signals == 0 && spin > 0)
+	  struct nptl_spin spin;
+	  __nptl_spin_begin (&spin, NPTL_SPIN_COND);
+	  while (signals == 0 && __nptl_spin_next (&spin))
 	    {
 	      /* Check that we are not spinning on a group that's already
 		 closed.  */
 	      if (seq < (__condvar_load_g1_start_relaxed (cond) >> 1))
-		goto done;
-
-	      /* TODO Back off.  */
+		{
+		  __nptl_spin_end (&spin, true);
+		  goto done;
+		}
 
 	      /* Reload signals.  See above for MO.  */
 	      signals = atomic_load_acquire (cond->__data.__g_signals + g);
-	      spin--;
 	    }
+	  __nptl_spin_end (&spin, signals != 0);
 
 	  /* If our group will be closed as indicated by the flag on signals,
 	     don't bother grabbing a signal.  */
@@ -491,7 +513,9 @@ __pthread_cond_wait_common (pthread_cond_t *cond, pthread_mutex_t *mutex,
 	      goto done;
 	    }
 
-	  // Now block.
+	  // Now block.  The wait counts as contended for the lock profiler,
+	  // up to re-acquiring the mutex.
+	  __nptl_lock_profile_contended (&pw);
 	  struct _pthread_cleanup_buffer buffer;
 	  struct _condvar_cleanup_buffer cbuffer;
 	  cbuffer.wseq = wseq;
@@ -532,6 +556,10 @@ __pthread_cond_wait_common (pthread_cond_t *cond, pthread_mutex_t *mutex,
   while (!atomic_compare_exchange_weak_acquire (cond->__data.__g_signals + g,
 						&signals, signals - 2));
 
+  /* If there are signals left, there may be waiters blocked that still need
+     to be woken; hand the wake-up on once we hold the mutex (see above).  */
+  wake_next = signals > 2;
+
   /* We consumed a signal but we could have consumed from a more recent group
      that aliased with ours due to being in the same group slot.  If this
      might be the case our group must be closed as visible through
@@ -555,6 +583,7 @@ __pthread_cond_wait_common (pthread_cond_t *cond, pthread_mutex_t *mutex,
 	 if the current G1 does not have the same slot index as we do, we did
 	 not steal from it and do not need to undo that.  This is the reason
 	 for putting a bit with G2's index into__g1_start as well.  */
+      wake_next = false;
       if (((g1_start & 1) ^ 1) == g)
 	{
 	  /* We have to conservatively undo our potential mistake of stealing
@@ -605,6 +634,16 @@ __pthread_cond_wait_common (pthread_cond_t *cond, pthread_mutex_t *mutex,
   /* Woken up; now re-acquire the mutex.  If this doesn't fail, return RESULT,
      which is set to ETIMEDOUT if a timeout occured, or zero otherwise.  */
   err = __pthread_mutex_cond_lock (mutex);
+  if (err == 0)
+    __nptl_lock_profile_acquired (&pw, cond, PTHREAD_LOCK_PROFILE_COND_NP,
+				  __builtin_return_address (0), false);
+
+  /* Pass on the wake-up of a broadcast.  The condvar may have been
+     destroyed by now, so we must not access it other than through
+     futex_wake.  */
+  if (wake_next)
+    futex_wake (cond->__data.__g_signals + g, 1, private);
+
   /* XXX Abort on errors that are disallowed by POSIX?  */
   return (err != 0) ? err : result;
 }
@@ -4,6 +4,10 @@
   lll_cond_lock ((mutex)->__data.__lock, PTHREAD_MUTEX_PSHARED (mutex))
 #define LLL_MUTEX_LOCK_OPTIMIZED(mutex) LLL_MUTEX_LOCK (mutex)
 
+/* The waits of condition variables are profiled as a whole.  */
+#define LLL_MUTEX_PROFILE_CONTENDED(pw) ((void) (pw))
+#define LLL_MUTEX_PROFILE_ACQUIRED(mutex, pw) ((void) (pw))
+
 /* Not actually elided so far. Needed? */
 #define LLL_MUTEX_LOCK_ELISION(mutex)  \
   ({ lll_cond_lock ((mutex)->__data.__lock, PTHREAD_MUTEX_PSHARED (mutex)); 0; })
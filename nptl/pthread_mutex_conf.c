@@ -23,34 +23,98 @@
 #include <stdbool.h>
 #include <unistd.h>  /* Get STDOUT_FILENO for _dl_printf.  */
 #include <elf/dl-tunables.h>
+#include <malloc-hugepages.h>
+#include <nptl-lock-profile.h>
 #include <nptl-stack.h>
+#include <nptl-workpool.h>
 
 struct mutex_config __mutex_aconf =
 {
   /* The maximum number of times a thread should spin on the lock before
   calling into kernel to block.  */
   .spin_count = DEFAULT_ADAPTIVE_COUNT,
+  /* The same for semaphores, rwlocks and condition variables.  */
+  .wait_spin_count = DEFAULT_WAIT_SPIN_COUNT,
 };
 libc_hidden_data_def (__mutex_aconf)
 
+unsigned int __nptl_workpool_max_idle = WORKPOOL_DEFAULT_MAX_IDLE;
+unsigned int __nptl_workpool_idle_time = WORKPOOL_DEFAULT_IDLE_TIME;
+
 static void
 TUNABLE_CALLBACK (set_mutex_spin_count) (tunable_val_t *valp)
 {
   __mutex_aconf.spin_count = (int32_t) (valp)->numval;
 }
 
+static void
+TUNABLE_CALLBACK (set_wait_spin_count) (tunable_val_t *valp)
+{
+  __mutex_aconf.wait_spin_count = (int32_t) (valp)->numval;
+}
+
 static void
 TUNABLE_CALLBACK (set_stack_cache_size) (tunable_val_t *valp)
 {
   __nptl_stack_cache_maxsize = valp->numval;
 }
 
+static void
+TUNABLE_CALLBACK (set_stack_prefault) (tunable_val_t *valp)
+{
+  __nptl_stack_prefault_size = valp->numval;
+}
+
+static void
+TUNABLE_CALLBACK (set_stack_hugetlb) (tunable_val_t *valp)
+{
+  if (valp->numval == 1)
+    {
+      /* Huge pages can only be used for aligned stacks, also if the
+	 kernel uses them for all anonymous memory.  */
+      enum malloc_thp_mode_t mode = __malloc_thp_mode ();
+      if (mode == malloc_thp_mode_madvise || mode == malloc_thp_mode_always)
+	__nptl_stack_thp_pagesize = __malloc_default_thp_pagesize ();
+      __nptl_stack_thp_madvise = mode == malloc_thp_mode_madvise;
+    }
+}
+
+static void
+TUNABLE_CALLBACK (set_lock_profile) (tunable_val_t *valp)
+{
+  __nptl_lock_profile_interval = valp->numval;
+}
+
+static void
+TUNABLE_CALLBACK (set_workpool_max_idle) (tunable_val_t *valp)
+{
+  __nptl_workpool_max_idle = valp->numval;
+}
+
+static void
+TUNABLE_CALLBACK (set_workpool_idle_time) (tunable_val_t *valp)
+{
+  __nptl_workpool_idle_time = valp->numval;
+}
+
 void
 __pthread_tunables_init (void)
 {
   TUNABLE_GET (mutex_spin_count, int32_t,
                TUNABLE_CALLBACK (set_mutex_spin_count));
+  TUNABLE_GET (wait_spin_count, int32_t,
+               TUNABLE_CALLBACK (set_wait_spin_count));
   TUNABLE_GET (stack_cache_size, size_t,
                TUNABLE_CALLBACK (set_stack_cache_size));
+  TUNABLE_GET (stack_prefault, size_t,
+               TUNABLE_CALLBACK (set_stack_prefault));
+  TUNABLE_GET (stack_hugetlb, int32_t,
+               TUNABLE_CALLBACK (set_stack_hugetlb));
+  TUNABLE_GET (lock_profile, int32_t,
+               TUNABLE_CALLBACK (set_lock_profile));
+  TUNABLE_GET (workpool_max_idle, int32_t,
+               TUNABLE_CALLBACK (set_workpool_max_idle));
+  TUNABLE_GET (workpool_idle_time, int32_t,
+               TUNABLE_CALLBACK (set_workpool_idle_time));
 }
 #endif
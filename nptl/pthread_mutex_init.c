@@ -85,6 +85,14 @@ ___pthread_mutex_init (pthread_mutex_t *mutex,
       break;
     }
 
+  /* Queued mutexes keep their queue tail in __list, so they cannot be
+     robust, and they have no priority protocol.  */
+  if ((imutexattr->mutexkind & ~PTHREAD_MUTEXATTR_FLAG_BITS)
+      == PTHREAD_MUTEX_QUEUED_NP
+      && (imutexattr->mutexkind & (PTHREAD_MUTEXATTR_FLAG_ROBUST
+				   | PTHREAD_MUTEXATTR_PROTOCOL_MASK)) != 0)
+    return ENOTSUP;
+
   /* Clear the whole variable.  */
   memset (mutex, '\0', __SIZEOF_PTHREAD_MUTEX_T);
 
@@ -24,15 +24,39 @@
 #include "pthreadP.h"
 #include <atomic.h>
 #include <futex-internal.h>
+#include <nptl-lock-profile.h>
 #include <stap-probe.h>
 #include <shlib-compat.h>
 
 /* Some of the following definitions differ when pthread_mutex_cond_lock.c
    includes this file.  */
 #ifndef LLL_MUTEX_LOCK
+/* Record the contended acquisition of MUTEX described by PW with the
+   lock profiler.  pthread_mutex_unlock records the hold time.  */
+static inline void
+lll_mutex_profile_acquired (pthread_mutex_t *mutex,
+			    struct nptl_lock_profile_wait *pw,
+			    const void *caller)
+{
+  __nptl_lock_profile_acquired (pw, mutex, PTHREAD_LOCK_PROFILE_MUTEX_NP,
+				caller, true);
+}
+
+/* The contended part of lll_lock, with the lock profiler.  */
+static void
+lll_mutex_lock_wait (pthread_mutex_t *mutex, int private, const void *caller)
+{
+  struct nptl_lock_profile_wait pw;
+  __nptl_lock_profile_wait_init (&pw);
+  __nptl_lock_profile_contended (&pw);
+  __lll_lock_wait (&mutex->__data.__lock, private);
+  __nptl_lock_profile_acquired (&pw, mutex, PTHREAD_LOCK_PROFILE_MUTEX_NP,
+				caller, true);
+}
+
 /* lll_lock with single-thread optimization.  */
 static inline void
-lll_mutex_lock_optimized (pthread_mutex_t *mutex)
+lll_mutex_lock_optimized (pthread_mutex_t *mutex, const void *caller)
 {
   /* The single-threaded optimization is only valid for private
      mutexes.  For process-shared mutexes, the mutex could be in a
@@ -44,13 +68,19 @@ lll_mutex_lock_optimized (pthread_mutex_t *mutex)
   int private = PTHREAD_MUTEX_PSHARED (mutex);
   if (private == LLL_PRIVATE && SINGLE_THREAD_P && mutex->__data.__lock == 0)
     mutex->__data.__lock = 1;
-  else
-    lll_lock (mutex->__data.__lock, private);
+  else if (lll_trylock (mutex->__data.__lock) != 0)
+    lll_mutex_lock_wait (mutex, private, caller);
 }
 
 # define LLL_MUTEX_LOCK(mutex)						\
   lll_lock ((mutex)->__data.__lock, PTHREAD_MUTEX_PSHARED (mutex))
-# define LLL_MUTEX_LOCK_OPTIMIZED(mutex) lll_mutex_lock_optimized (mutex)
+/* These are expanded in PTHREAD_MUTEX_LOCK, so the return address is
+   that of its caller.  */
+# define LLL_MUTEX_LOCK_OPTIMIZED(mutex) \
+  lll_mutex_lock_optimized (mutex, __builtin_return_address (0))
+# define LLL_MUTEX_PROFILE_CONTENDED(pw) __nptl_lock_profile_contended (pw)
+# define LLL_MUTEX_PROFILE_ACQUIRED(mutex, pw) \
+  lll_mutex_profile_acquired (mutex, pw, __builtin_return_address (0))
 # define LLL_MUTEX_TRYLOCK(mutex) \
   lll_trylock ((mutex)->__data.__lock)
 # define LLL_ROBUST_MUTEX_LOCK_MODIFIER 0
@@ -64,6 +94,94 @@ lll_mutex_lock_optimized (pthread_mutex_t *mutex)
 # define PTHREAD_MUTEX_VERSIONS 1
 #endif
 
+/* Acquire the lock word of a PTHREAD_MUTEX_QUEUED_NP mutex.  Contending
+   threads form an MCS queue whose tail is kept in the __list.__next
+   member of the mutex, which only robust mutexes use otherwise, and
+   whose nodes are in the thread descriptors.  Only the head of the
+   queue polls the lock word; the other threads spin on, and after
+   max_adaptive_count iterations sleep on, their own node, so the cache
+   line of the mutex does not bounce between all of them and they get
+   the lock in FIFO order.  The node is released once the lock word is
+   acquired, so a thread can hold any number of queued mutexes.
+   Process-shared mutexes cannot refer to thread descriptors, so they
+   use the lock word directly.  */
+static void
+lll_mutex_lock_queued (pthread_mutex_t *mutex)
+{
+  if (PTHREAD_MUTEX_PSHARED (mutex) != LLL_PRIVATE)
+    {
+      LLL_MUTEX_LOCK (mutex);
+      return;
+    }
+
+  struct pthread_mutex_qnode **tailp
+    = (struct pthread_mutex_qnode **) &mutex->__data.__list.__next;
+
+  /* Only take the lock directly if nobody is queued, so that waiters
+     are not overtaken.  */
+  if (atomic_load_relaxed (tailp) == NULL && LLL_MUTEX_TRYLOCK (mutex) == 0)
+    return;
+
+  struct pthread_mutex_qnode *node = &THREAD_SELF->mutex_qnode;
+  int max_cnt = max_adaptive_count ();
+  int cnt = 0;
+
+  atomic_store_relaxed (&node->next, NULL);
+  atomic_store_relaxed (&node->wait, 1);
+  /* The predecessor writes to node->next, so the initialization must
+     happen before the node is published.  */
+  atomic_thread_fence_release ();
+  struct pthread_mutex_qnode *prev = atomic_exchange_acquire (tailp, node);
+  if (prev != NULL)
+    {
+      atomic_store_release (&prev->next, node);
+      while (atomic_load_acquire (&node->wait) != 0)
+	{
+	  if (cnt < max_cnt)
+	    {
+	      ++cnt;
+	      atomic_spin_nop ();
+	      continue;
+	    }
+	  unsigned int wait = 1;
+	  if (atomic_compare_exchange_weak_relaxed (&node->wait, &wait, 2)
+	      || wait == 2)
+	    futex_wait_simple (&node->wait, 2, FUTEX_PRIVATE);
+	}
+    }
+
+  /* This thread is the head of the queue.  Wait for the owner to
+     release the lock word without writing to it.  */
+  cnt = 0;
+  while (atomic_load_relaxed (&mutex->__data.__lock) != 0
+	 || LLL_MUTEX_TRYLOCK (mutex) != 0)
+    {
+      if (cnt++ >= max_cnt)
+	{
+	  LLL_MUTEX_LOCK (mutex);
+	  break;
+	}
+      atomic_spin_nop ();
+    }
+
+  /* Leave the queue and make the successor, if any, its head.  */
+  struct pthread_mutex_qnode *next = atomic_load_acquire (&node->next);
+  if (next == NULL)
+    {
+      struct pthread_mutex_qnode *expected = node;
+      do
+	if (atomic_compare_exchange_weak_release (tailp, &expected, NULL))
+	  return;
+      while (expected == node);
+
+      /* A successor has swapped the tail but not linked itself yet.  */
+      while ((next = atomic_load_acquire (&node->next)) == NULL)
+	atomic_spin_nop ();
+    }
+  if (atomic_exchange_release (&next->wait, 0) == 2)
+    futex_wake (&next->wait, 1, FUTEX_PRIVATE);
+}
+
 static int __pthread_mutex_lock_full (pthread_mutex_t *mutex)
      __attribute_noinline__;
 
@@ -130,6 +248,9 @@ PTHREAD_MUTEX_LOCK (pthread_mutex_t *mutex)
     {
       if (LLL_MUTEX_TRYLOCK (mutex) != 0)
 	{
+	  struct nptl_lock_profile_wait pw;
+	  __nptl_lock_profile_wait_init (&pw);
+	  LLL_MUTEX_PROFILE_CONTENDED (&pw);
 	  int cnt = 0;
 	  int max_cnt = MIN (max_adaptive_count (),
 			     mutex->__data.__spins * 2 + 10);
@@ -145,6 +266,7 @@ PTHREAD_MUTEX_LOCK (pthread_mutex_t *mutex)
 	  while (LLL_MUTEX_TRYLOCK (mutex) != 0);
 
 	  mutex->__data.__spins += (cnt - mutex->__data.__spins) / 8;
+	  LLL_MUTEX_PROFILE_ACQUIRED (mutex, &pw);
 	}
       assert (mutex->__data.__owner == 0);
     }
@@ -592,6 +714,11 @@ __pthread_mutex_lock_full (pthread_mutex_t *mutex)
       }
       break;
 
+    case PTHREAD_MUTEX_QUEUED_NP:
+      lll_mutex_lock_queued (mutex);
+      assert (mutex->__data.__owner == 0);
+      break;
+
     default:
       /* Correct code cannot set any other type.  */
       return EINVAL;
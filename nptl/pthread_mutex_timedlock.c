@@ -89,6 +89,11 @@ __pthread_mutex_clocklock_common (pthread_mutex_t *mutex,
                                     PTHREAD_MUTEX_PSHARED (mutex));
       break;
 
+    case PTHREAD_MUTEX_QUEUED_NP:
+      /* A thread which times out would have to unlink its node from
+	 the middle of the queue, so timed waits do not queue.  */
+      goto simple;
+
     case PTHREAD_MUTEX_TIMED_ELISION_NP:
     elision: __attribute__((unused))
       /* Don't record ownership */
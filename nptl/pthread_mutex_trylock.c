@@ -71,6 +71,7 @@ ___pthread_mutex_trylock (pthread_mutex_t *mutex)
       /*FALL THROUGH*/
     case PTHREAD_MUTEX_ADAPTIVE_NP:
     case PTHREAD_MUTEX_ERRORCHECK_NP:
+    case PTHREAD_MUTEX_QUEUED_NP:
       if (lll_trylock (mutex->__data.__lock) != 0)
 	break;
 
@@ -20,6 +20,7 @@
 #include <stdlib.h>
 #include "pthreadP.h"
 #include <lowlevellock.h>
+#include <nptl-lock-profile.h>
 #include <stap-probe.h>
 #include <futex-internal.h>
 #include <shlib-compat.h>
@@ -64,6 +65,8 @@ __pthread_mutex_unlock_usercnt (pthread_mutex_t *mutex, int decr)
 	/* One less user.  */
 	--mutex->__data.__nusers;
 
+      __nptl_lock_profile_release (mutex);
+
       /* Unlock.  */
       lll_mutex_unlock_optimized (mutex);
 
@@ -352,6 +355,16 @@ __pthread_mutex_unlock_full (pthread_mutex_t *mutex, int decr)
 
       return __pthread_tpp_change_priority (oldprio, -1);
 
+    case PTHREAD_MUTEX_QUEUED_NP:
+      /* The queue is in front of the lock word, see
+	 lll_mutex_lock_queued, so this is a normal unlock.  */
+      mutex->__data.__owner = 0;
+      if (decr)
+	/* One less user.  */
+	--mutex->__data.__nusers;
+      lll_mutex_unlock_optimized (mutex);
+      break;
+
     default:
       /* Correct code cannot set any other type.  */
       return EINVAL;
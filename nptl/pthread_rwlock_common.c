@@ -20,6 +20,8 @@
 #include <sysdep.h>
 #include <pthread.h>
 #include <pthreadP.h>
+#include <nptl-spin.h>
+#include <nptl-lock-profile.h>
 #include <sys/time.h>
 #include <stap-probe.h>
 #include <atomic.h>
@@ -215,6 +217,26 @@
    better performance.  */
 
 
+/* PTHREAD_RWLOCK_DISTRIBUTED_READERS_NP uses the algorithm above with
+   the same properties as PTHREAD_RWLOCK_PREFER_WRITER_NP, plus a reader
+   bias that lets readers avoid the __readers cache line: While the bias
+   is enabled, a reader acquires the lock by storing the address of the
+   rwlock in one of its thread's reader slots (see
+   __pthread_rwlock_rslot_index) and then checking that the bias is still
+   enabled.  A writer that acquired the lock and finds the bias enabled
+   disables it and then waits until no thread's slot refers to the rwlock
+   anymore, sleeping on the bias as a futex that readers releasing their
+   slot wake (see pthread_rwlock_distributed.c).  Readers and the writer
+   each store their flag, issue a seq_cst fence and then load the other's
+   flag, so at least one of them sees the other.  The bias is enabled
+   again by a reader that acquired the lock through __readers, but only
+   after a delay that is proportional to the time the last writer spent
+   waiting for readers, so that writers are not slowed down by having to
+   check all threads if writes are frequent.  The bias is never enabled
+   for process-shared rwlocks because a writer cannot check the threads
+   of other processes.  */
+
+
 static int
 __pthread_rwlock_get_private (pthread_rwlock_t *rwlock)
 {
@@ -277,9 +299,89 @@ __pthread_rwlock_rdunlock (pthread_rwlock_t *rwlock)
 }
 
 
+/* Release the reader SLOT of the calling thread, which refers to RWLOCK,
+   and wake the writer if it waits for reader slots to be released.  */
+static __always_inline void
+__pthread_rwlock_rslot_release (pthread_rwlock_t *rwlock,
+				struct pthread_rwlock_rslot *slot)
+{
+  /* Release MO so that a writer waiting for the slot synchronizes with
+     the end of our critical section.  */
+  atomic_store_release (&slot->rwlock, NULL);
+  /* Pairs with the fence in __pthread_rwlock_revoke_bias.  Either the
+     writer sees our slot released, or we see that it waits.  Resetting
+     the bias makes the writer's futex wait return if it has not started
+     yet.  */
+  atomic_thread_fence_seq_cst ();
+  if (__glibc_unlikely (atomic_load_relaxed (PTHREAD_RWLOCK_RBIAS (rwlock))
+			== 2)
+      && atomic_exchange_relaxed (PTHREAD_RWLOCK_RBIAS (rwlock), 0) == 2)
+    futex_wake (PTHREAD_RWLOCK_RBIAS (rwlock), 1, FUTEX_PRIVATE);
+}
+
+/* Try to acquire a read lock on a PTHREAD_RWLOCK_DISTRIBUTED_READERS_NP
+   RWLOCK through the calling thread's reader slot.  */
+static __always_inline bool
+__pthread_rwlock_rslot_lock (pthread_rwlock_t *rwlock)
+{
+  struct pthread_rwlock_rslot *slot
+    = &THREAD_SELF->rwlock_rslots[__pthread_rwlock_rslot_index (rwlock)];
+  /* If we already hold a read lock through the slot, we can acquire it
+     again even if a writer is waiting for the slot to be released;
+     blocking would deadlock.  */
+  if (slot->rwlock == rwlock)
+    {
+      ++slot->count;
+      return true;
+    }
+  if (slot->rwlock != NULL
+      || atomic_load_relaxed (PTHREAD_RWLOCK_RBIAS (rwlock)) != 1)
+    return false;
+  slot->count = 1;
+  atomic_store_relaxed (&slot->rwlock, rwlock);
+  /* Pairs with the fence in __pthread_rwlock_revoke_bias.  Either the
+     writer sees our slot, or we see that the bias has been revoked.
+     Acquire MO so that we synchronize with the writer that last released
+     the lock and then enabled the bias again.  */
+  atomic_thread_fence_seq_cst ();
+  if (atomic_load_acquire (PTHREAD_RWLOCK_RBIAS (rwlock)) == 1)
+    return true;
+  /* A writer is revoking the bias; release the slot so that it does not
+     wait for us, and acquire through __readers instead.  */
+  __pthread_rwlock_rslot_release (rwlock, slot);
+  return false;
+}
+
+/* Release a read lock that the calling thread holds on RWLOCK through its
+   reader slot.  Return false if it holds no such lock.  */
+static __always_inline bool
+__pthread_rwlock_rslot_unlock (pthread_rwlock_t *rwlock)
+{
+  struct pthread_rwlock_rslot *slot
+    = &THREAD_SELF->rwlock_rslots[__pthread_rwlock_rslot_index (rwlock)];
+  if (slot->rwlock != rwlock)
+    return false;
+  if (--slot->count == 0)
+    __pthread_rwlock_rslot_release (rwlock, slot);
+  return true;
+}
+
+/* Return true if a reader of a rwlock that prefers writers and does not
+   allow recursive read locks must not add itself to the current read
+   phase, given the value R of __readers.  */
+static __always_inline bool
+__pthread_rwlock_rdlock_must_defer (unsigned int r)
+{
+  return ((r & PTHREAD_RWLOCK_WRPHASE) == 0
+	  && (r & PTHREAD_RWLOCK_WRLOCKED) != 0
+	  && (r >> PTHREAD_RWLOCK_READER_SHIFT) > 0);
+}
+
 static __always_inline int
-__pthread_rwlock_rdlock_full64 (pthread_rwlock_t *rwlock, clockid_t clockid,
-                                const struct __timespec64 *abstime)
+__pthread_rwlock_rdlock_central64 (pthread_rwlock_t *rwlock,
+				   clockid_t clockid,
+				   const struct __timespec64 *abstime,
+				   struct nptl_lock_profile_wait *pw)
 {
   unsigned int r;
 
@@ -309,12 +411,17 @@ __pthread_rwlock_rdlock_full64 (pthread_rwlock_t *rwlock, clockid_t clockid,
      will likely not make a big difference.  */
   if (rwlock->__data.__flags == PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP)
     {
-      r = atomic_load_relaxed (&rwlock->__data.__readers);
-      while ((r & PTHREAD_RWLOCK_WRPHASE) == 0
-	     && (r & PTHREAD_RWLOCK_WRLOCKED) != 0
-	     && (r >> PTHREAD_RWLOCK_READER_SHIFT) > 0)
+      /* Spin first (see nptl-spin.h).  */
+      struct nptl_spin spin;
+      __nptl_spin_begin (&spin, NPTL_SPIN_RWLOCK);
+      while (__pthread_rwlock_rdlock_must_defer
+	     (r = atomic_load_relaxed (&rwlock->__data.__readers))
+	     && __nptl_spin_next (&spin))
+	__nptl_lock_profile_contended (pw);
+      __nptl_spin_end (&spin, !__pthread_rwlock_rdlock_must_defer (r));
+      while (__pthread_rwlock_rdlock_must_defer (r))
 	{
-	  /* TODO Spin first.  */
+	  __nptl_lock_profile_contended (pw);
 	  /* Try setting the flag signaling that we are waiting without having
 	     incremented the number of readers.  Relaxed MO is fine because
 	     this is just about waiting for a state change in __readers.  */
@@ -443,9 +550,20 @@ __pthread_rwlock_rdlock_full64 (pthread_rwlock_t *rwlock, clockid_t clockid,
      Relaxed MO is sufficient for the load from __wrphase_futex because
      we just use it as an indicator for when we can proceed; we use
      __readers and the acquire MO accesses to it to eventually read from
-     the proper stores to __wrphase_futex.  */
+     the proper stores to __wrphase_futex.
+     The hand-over often follows shortly, so spin before blocking (see
+     nptl-spin.h).  */
+  __nptl_lock_profile_contended (pw);
   unsigned int wpf;
   bool ready = false;
+  struct nptl_spin spin;
+  __nptl_spin_begin (&spin, NPTL_SPIN_RWLOCK);
+  while (((wpf = atomic_load_relaxed (&rwlock->__data.__wrphase_futex))
+	  | PTHREAD_RWLOCK_FUTEX_USED) == (1 | PTHREAD_RWLOCK_FUTEX_USED)
+	 && __nptl_spin_next (&spin))
+    continue;
+  __nptl_spin_end (&spin, (wpf | PTHREAD_RWLOCK_FUTEX_USED)
+			  != (1 | PTHREAD_RWLOCK_FUTEX_USED));
   for (;;)
     {
       while (((wpf = atomic_load_relaxed (&rwlock->__data.__wrphase_futex))
@@ -523,11 +641,36 @@ __pthread_rwlock_rdlock_full64 (pthread_rwlock_t *rwlock, clockid_t clockid,
 }
 
 
+static __always_inline int
+__pthread_rwlock_rdlock_full64 (pthread_rwlock_t *rwlock, clockid_t clockid,
+                                const struct __timespec64 *abstime)
+{
+  bool distributed = (rwlock->__data.__flags
+		      == PTHREAD_RWLOCK_DISTRIBUTED_READERS_NP);
+  if (distributed && __pthread_rwlock_rslot_lock (rwlock))
+    return 0;
+
+  struct nptl_lock_profile_wait pw;
+  __nptl_lock_profile_wait_init (&pw);
+  int result = __pthread_rwlock_rdlock_central64 (rwlock, clockid, abstime,
+						  &pw);
+  if (result == 0)
+    __nptl_lock_profile_acquired (&pw, rwlock, PTHREAD_LOCK_PROFILE_RWLOCK_NP,
+				  __builtin_return_address (0), false);
+  if (distributed && result == 0
+      && atomic_load_relaxed (PTHREAD_RWLOCK_RBIAS (rwlock)) == 0)
+    __pthread_rwlock_enable_bias (rwlock);
+  return result;
+}
+
+
 static __always_inline void
 __pthread_rwlock_wrunlock (pthread_rwlock_t *rwlock)
 {
   int private = __pthread_rwlock_get_private (rwlock);
 
+  __nptl_lock_profile_release (rwlock);
+
   atomic_store_relaxed (&rwlock->__data.__cur_writer, 0);
   /* Disable waiting by writers.  We will wake up after we decided how to
      proceed.  */
@@ -619,10 +762,13 @@ __pthread_rwlock_wrlock_full64 (pthread_rwlock_t *rwlock, clockid_t clockid,
      We could try to CAS from a state with no readers to a write phase, but
      this could be less scalable if readers arrive and leave frequently.  */
   bool may_share_futex_used_flag = false;
+  struct nptl_lock_profile_wait pw;
+  __nptl_lock_profile_wait_init (&pw);
   unsigned int r = atomic_fetch_or_acquire (&rwlock->__data.__readers,
 					    PTHREAD_RWLOCK_WRLOCKED);
   if (__glibc_unlikely ((r & PTHREAD_RWLOCK_WRLOCKED) != 0))
     {
+      __nptl_lock_profile_contended (&pw);
       /* There is another primary writer.  */
       bool prefer_writer
 	= (rwlock->__data.__flags != PTHREAD_RWLOCK_PREFER_READER_NP);
@@ -636,9 +782,6 @@ __pthread_rwlock_wrlock_full64 (pthread_rwlock_t *rwlock, clockid_t clockid,
 	}
       for (;;)
 	{
-	  /* TODO Spin until WRLOCKED is 0 before trying the CAS below.
-	     But pay attention to not delay trying writer--writer hand-over
-	     for too long (which we must try eventually anyway).  */
 	  if ((r & PTHREAD_RWLOCK_WRLOCKED) == 0)
 	    {
 	      /* Try to become the primary writer or retry.  Acquire MO as in
@@ -699,7 +842,24 @@ __pthread_rwlock_wrlock_full64 (pthread_rwlock_t *rwlock, clockid_t clockid,
 		}
 	    }
 	  /* We did not acquire WRLOCKED nor were able to use writer--writer
-	     hand-over, so we block on __writers_futex.  */
+	     hand-over.  Spin until either becomes possible (see
+	     nptl-spin.h), and retry if it does.  */
+	  struct nptl_spin spin;
+	  bool available = false;
+	  __nptl_spin_begin (&spin, NPTL_SPIN_RWLOCK);
+	  while (!available && __nptl_spin_next (&spin))
+	    {
+	      r = atomic_load_relaxed (&rwlock->__data.__readers);
+	      available = ((r & PTHREAD_RWLOCK_WRLOCKED) == 0
+			   || (prefer_writer
+			       && (atomic_load_relaxed (&rwlock->__data.__writers)
+				   & PTHREAD_RWLOCK_WRHANDOVER) != 0));
+	    }
+	  __nptl_spin_end (&spin, available);
+	  if (available)
+	    continue;
+
+	  /* Otherwise, we block on __writers_futex.  */
 	  int private = __pthread_rwlock_get_private (rwlock);
 	  unsigned int wf
 	    = atomic_load_relaxed (&rwlock->__data.__writers_futex);
@@ -812,9 +972,19 @@ __pthread_rwlock_wrlock_full64 (pthread_rwlock_t *rwlock, clockid_t clockid,
      We basically do the same steps as for the similar case in
      __pthread_rwlock_rdlock_full, except that we additionally might try
      to directly hand over to another writer and need to wake up
-     other writers or waiting readers (i.e., PTHREAD_RWLOCK_RWAITING).  */
+     other writers or waiting readers (i.e., PTHREAD_RWLOCK_RWAITING).
+     As there, spin before blocking.  */
+  __nptl_lock_profile_contended (&pw);
   unsigned int wpf;
   bool ready = false;
+  struct nptl_spin spin;
+  __nptl_spin_begin (&spin, NPTL_SPIN_RWLOCK);
+  while (((wpf = atomic_load_relaxed (&rwlock->__data.__wrphase_futex))
+	  | PTHREAD_RWLOCK_FUTEX_USED) == PTHREAD_RWLOCK_FUTEX_USED
+	 && __nptl_spin_next (&spin))
+    continue;
+  __nptl_spin_end (&spin, (wpf | PTHREAD_RWLOCK_FUTEX_USED)
+			  != PTHREAD_RWLOCK_FUTEX_USED);
   for (;;)
     {
       while (((wpf = atomic_load_relaxed (&rwlock->__data.__wrphase_futex))
@@ -946,5 +1116,24 @@ __pthread_rwlock_wrlock_full64 (pthread_rwlock_t *rwlock, clockid_t clockid,
  done:
   atomic_store_relaxed (&rwlock->__data.__cur_writer,
 			THREAD_GETMEM (THREAD_SELF, tid));
+
+  /* Readers may hold the lock through their reader slots.  The bias is
+     only ever set for PTHREAD_RWLOCK_DISTRIBUTED_READERS_NP, and by a
+     reader that released the lock before we acquired it, so relaxed MO
+     is sufficient.  */
+  if (__glibc_unlikely (atomic_load_relaxed (PTHREAD_RWLOCK_RBIAS (rwlock))
+			!= 0))
+    {
+      int err = __pthread_rwlock_revoke_bias (rwlock, clockid, abstime,
+					      false);
+      if (err != 0)
+	{
+	  __pthread_rwlock_wrunlock (rwlock);
+	  return err;
+	}
+    }
+
+  __nptl_lock_profile_acquired (&pw, rwlock, PTHREAD_LOCK_PROFILE_RWLOCK_NP,
+				__builtin_return_address (0), true);
   return 0;
 }
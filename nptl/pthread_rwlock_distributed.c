@@ -0,0 +1,161 @@
+/* Reader bias of PTHREAD_RWLOCK_DISTRIBUTED_READERS_NP rwlocks.
+   Copyright (C) 2021 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+#include <errno.h>
+#include <futex-internal.h>
+#include <ldsodefs.h>
+#include <list.h>
+#include <lowlevellock.h>
+#include <pthreadP.h>
+#include <time.h>
+
+/* See pthread_rwlock_common.c for an overview.  */
+
+/* After a writer revoked the reader bias, readers keep using __readers
+   for this many times the duration of the revocation, but at least
+   PTHREAD_RWLOCK_RBIAS_MIN_INHIBIT and at most
+   PTHREAD_RWLOCK_RBIAS_MAX_INHIBIT microseconds.  This bounds the time
+   writers spend checking reader slots to about a tenth of the total.
+   The upper bound also keeps the wrapping time comparison meaningful.  */
+#define PTHREAD_RWLOCK_RBIAS_INHIBIT_FACTOR 9
+#define PTHREAD_RWLOCK_RBIAS_MIN_INHIBIT 100
+#define PTHREAD_RWLOCK_RBIAS_MAX_INHIBIT 1000000
+
+/* Return the CLOCK_MONOTONIC time in microseconds, modulo 2^32.  */
+static unsigned int
+rbias_now (void)
+{
+  struct __timespec64 ts;
+  __clock_gettime64 (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* Return true if reader slot INDEX of some thread refers to RWLOCK.  */
+static bool
+rslots_busy (pthread_rwlock_t *rwlock, unsigned int index)
+{
+  bool busy = false;
+  lll_lock (GL (dl_stack_cache_lock), LLL_PRIVATE);
+
+  list_t *runp;
+  list_for_each (runp, &GL (dl_stack_used))
+    {
+      struct pthread *t = list_entry (runp, struct pthread, list);
+      /* Acquire MO so that we synchronize with the release of the slot,
+	 and thus with the end of the reader's critical section.  */
+      if (atomic_load_acquire (&t->rwlock_rslots[index].rwlock) == rwlock)
+	{
+	  busy = true;
+	  goto out;
+	}
+    }
+
+  list_for_each (runp, &GL (dl_stack_user))
+    {
+      struct pthread *t = list_entry (runp, struct pthread, list);
+      if (atomic_load_acquire (&t->rwlock_rslots[index].rwlock) == rwlock)
+	{
+	  busy = true;
+	  goto out;
+	}
+    }
+
+ out:
+  lll_unlock (GL (dl_stack_cache_lock), LLL_PRIVATE);
+  return busy;
+}
+
+/* Called by the writer owning RWLOCK if it found the reader bias enabled.
+   Disable the bias and wait until no reader holds RWLOCK through its
+   reader slot.  If TRY, fail with EBUSY instead of waiting; if ABSTIME is
+   not NULL, fail with ETIMEDOUT once ABSTIME (measured against CLOCKID)
+   has passed.  On failure the bias is enabled again, and the caller must
+   release RWLOCK.  */
+int
+__pthread_rwlock_revoke_bias (pthread_rwlock_t *rwlock, clockid_t clockid,
+			      const struct __timespec64 *abstime, bool try)
+{
+  unsigned int start = rbias_now ();
+  unsigned int index = __pthread_rwlock_rslot_index (rwlock);
+
+  atomic_store_relaxed (PTHREAD_RWLOCK_RBIAS (rwlock), 0);
+  /* Pairs with the fence in __pthread_rwlock_rslot_lock.  */
+  atomic_thread_fence_seq_cst ();
+
+  while (rslots_busy (rwlock, index))
+    {
+      int err = EBUSY;
+      if (!try)
+	{
+	  /* Tell readers that we wait, and check the slots again.  Pairs
+	     with the fence in __pthread_rwlock_rslot_release: a reader that
+	     releases its slot after the check sees the 2 and resets it to
+	     0, which either wakes us or makes the wait return at once.  */
+	  atomic_store_relaxed (PTHREAD_RWLOCK_RBIAS (rwlock), 2);
+	  atomic_thread_fence_seq_cst ();
+	  if (!rslots_busy (rwlock, index))
+	    break;
+	  err = __futex_abstimed_wait64 (PTHREAD_RWLOCK_RBIAS (rwlock), 2,
+					 clockid, abstime, FUTEX_PRIVATE);
+	  if (err != ETIMEDOUT && err != EOVERFLOW)
+	    continue;
+	}
+      /* Readers that saw the bias disabled are blocked on __readers and
+	 will see it enabled once the caller releases RWLOCK; the readers
+	 still in their slots have to be waited for by the next writer.
+	 Release MO so that readers that acquire through their slot
+	 synchronize with the critical sections of earlier writers, as in
+	 __pthread_rwlock_enable_bias.  */
+      atomic_store_release (PTHREAD_RWLOCK_RBIAS (rwlock), 1);
+      return err;
+    }
+  atomic_store_relaxed (PTHREAD_RWLOCK_RBIAS (rwlock), 0);
+
+  unsigned int elapsed = rbias_now () - start;
+  unsigned int delay = elapsed * PTHREAD_RWLOCK_RBIAS_INHIBIT_FACTOR;
+  if (delay < PTHREAD_RWLOCK_RBIAS_MIN_INHIBIT)
+    delay = PTHREAD_RWLOCK_RBIAS_MIN_INHIBIT;
+  else if (elapsed > PTHREAD_RWLOCK_RBIAS_MAX_INHIBIT
+	   || delay > PTHREAD_RWLOCK_RBIAS_MAX_INHIBIT)
+    delay = PTHREAD_RWLOCK_RBIAS_MAX_INHIBIT;
+  atomic_store_relaxed (PTHREAD_RWLOCK_RBIAS_INHIBIT (rwlock),
+			start + elapsed + delay);
+  return 0;
+}
+
+/* Called by a reader that acquired RWLOCK through __readers while the
+   bias was disabled.  Enable the bias unless RWLOCK is process-shared or
+   a writer revoked it recently.  The reader holds RWLOCK, so there is no
+   writer that could miss the bias being enabled.  */
+void
+__pthread_rwlock_enable_bias (pthread_rwlock_t *rwlock)
+{
+  if (rwlock->__data.__shared != 0)
+    return;
+  /* The end of the delay is at most PTHREAD_RWLOCK_RBIAS_MAX_INHIBIT
+     microseconds in the future; anything else has already passed (or is
+     the initial value).  */
+  unsigned int inhibit
+    = atomic_load_relaxed (PTHREAD_RWLOCK_RBIAS_INHIBIT (rwlock));
+  if (inhibit - rbias_now () <= PTHREAD_RWLOCK_RBIAS_MAX_INHIBIT)
+    return;
+  /* Release MO so that readers that acquire through their slot
+     synchronize with the writer that last released RWLOCK, which
+     happens before us.  */
+  atomic_store_release (PTHREAD_RWLOCK_RBIAS (rwlock), 1);
+}
@@ -23,8 +23,8 @@
 
 
 /* See pthread_rwlock_common.c for an overview.  */
-int
-___pthread_rwlock_tryrdlock (pthread_rwlock_t *rwlock)
+static int
+__pthread_rwlock_tryrdlock_central (pthread_rwlock_t *rwlock)
 {
   /* For tryrdlock, we could speculate that we will succeed and go ahead and
      register as a reader.  However, if we misspeculate, we have to do the
@@ -115,6 +115,21 @@ ___pthread_rwlock_tryrdlock (pthread_rwlock_t *rwlock)
 
 
 }
+
+int
+___pthread_rwlock_tryrdlock (pthread_rwlock_t *rwlock)
+{
+  bool distributed = (rwlock->__data.__flags
+		      == PTHREAD_RWLOCK_DISTRIBUTED_READERS_NP);
+  if (distributed && __pthread_rwlock_rslot_lock (rwlock))
+    return 0;
+
+  int result = __pthread_rwlock_tryrdlock_central (rwlock);
+  if (distributed && result == 0
+      && atomic_load_relaxed (PTHREAD_RWLOCK_RBIAS (rwlock)) == 0)
+    __pthread_rwlock_enable_bias (rwlock);
+  return result;
+}
 versioned_symbol (libc, ___pthread_rwlock_tryrdlock,
 		  pthread_rwlock_tryrdlock, GLIBC_2_34);
 libc_hidden_ver (___pthread_rwlock_tryrdlock, __pthread_rwlock_tryrdlock)
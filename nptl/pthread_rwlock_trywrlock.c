@@ -57,6 +57,15 @@ ___pthread_rwlock_trywrlock (pthread_rwlock_t *rwlock)
 	    atomic_store_relaxed (&rwlock->__data.__wrphase_futex, 1);
 	  atomic_store_relaxed (&rwlock->__data.__cur_writer,
 	      THREAD_GETMEM (THREAD_SELF, tid));
+	  /* Fail instead of waiting for readers holding the lock through
+	     their reader slots (see pthread_rwlock_common.c).  */
+	  if (__glibc_unlikely (atomic_load_relaxed (
+	      PTHREAD_RWLOCK_RBIAS (rwlock)) != 0)
+	      && __pthread_rwlock_revoke_bias (rwlock, 0, NULL, true) != 0)
+	    {
+	      __pthread_rwlock_unlock (rwlock);
+	      return EBUSY;
+	    }
 	  return 0;
 	}
       /* TODO Back-off.  */
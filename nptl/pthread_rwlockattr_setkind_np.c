@@ -26,6 +26,7 @@ __pthread_rwlockattr_setkind_np (pthread_rwlockattr_t *attr, int pref)
 
   if (pref != PTHREAD_RWLOCK_PREFER_READER_NP
       && pref != PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP
+      && pref != PTHREAD_RWLOCK_DISTRIBUTED_READERS_NP
       && __builtin_expect  (pref != PTHREAD_RWLOCK_PREFER_WRITER_NP, 0))
     return EINVAL;
 
@@ -27,6 +27,7 @@
 #include <pthreadP.h>
 #include <shlib-compat.h>
 #include <atomic.h>
+#include <nptl-spin.h>
 
 
 /* The semaphore provides two main operations: sem_post adds a token to the
@@ -166,6 +167,18 @@ __new_sem_wait_slow64 (struct new_sem *sem, clockid_t clockid,
 {
   int err = 0;
 
+  /* Spin for a while before registering as a waiter, so that a token
+     posted shortly does not cost a futex_wake and a futex_wait.  See
+     nptl-spin.h.  */
+  struct nptl_spin spin;
+  bool acquired = false;
+  __nptl_spin_begin (&spin, NPTL_SPIN_SEM);
+  while (!acquired && __nptl_spin_next (&spin))
+    acquired = __new_sem_wait_fast (sem, 0) == 0;
+  __nptl_spin_end (&spin, acquired);
+  if (acquired)
+    return 0;
+
 #if __HAVE_64B_ATOMICS
   /* Add a waiter.  Relaxed MO is sufficient because we can rely on the
      ordering provided by the RMW operations we use.  */
@@ -0,0 +1,107 @@
+/* Test barriers for many threads.
+   Copyright (C) 2021 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+/* Private barriers for at least BARRIER_TREE_THRESHOLD threads wake their
+   waiters through a tree.  Check that no thread leaves a round before all
+   threads have entered it, for barriers just below and above the
+   threshold, and for more threads than there are wake words so that
+   threads of the same round share them.  */
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <array_length.h>
+#include <internaltypes.h>
+#include <support/check.h>
+#include <support/support.h>
+#include <support/xthread.h>
+
+#define ROUNDS 100
+
+static pthread_barrier_t barrier;
+static unsigned int nthreads;
+static atomic_uint *entered;
+static atomic_uint serial;
+
+static void *
+tf (void *closure)
+{
+  unsigned int self = (uintptr_t) closure;
+  for (unsigned int round = 1; round <= ROUNDS; ++round)
+    {
+      atomic_store (&entered[self], round);
+      if (xpthread_barrier_wait (&barrier))
+	atomic_fetch_add (&serial, 1);
+      for (unsigned int i = 0; i < nthreads; ++i)
+	if (atomic_load (&entered[i]) < round)
+	  FAIL_EXIT1 ("thread %u left round %u before thread %u entered it",
+		      self, round, i);
+    }
+  return NULL;
+}
+
+static void
+do_one (unsigned int count, int pshared)
+{
+  pthread_barrierattr_t attr;
+  xpthread_barrierattr_init (&attr);
+  xpthread_barrierattr_setpshared (&attr, pshared);
+  xpthread_barrier_init (&barrier, &attr, count);
+  xpthread_barrierattr_destroy (&attr);
+
+  nthreads = count;
+  entered = xcalloc (count, sizeof (*entered));
+  atomic_store (&serial, 0);
+
+  pthread_attr_t tattr;
+  xpthread_attr_init (&tattr);
+  xpthread_attr_setstacksize (&tattr, 128 * 1024);
+  pthread_t *threads = xmalloc (count * sizeof (*threads));
+  for (unsigned int i = 0; i < count; ++i)
+    threads[i] = xpthread_create (&tattr, tf, (void *) (uintptr_t) i);
+  xpthread_attr_destroy (&tattr);
+  for (unsigned int i = 0; i < count; ++i)
+    xpthread_join (threads[i]);
+
+  TEST_COMPARE (atomic_load (&serial), ROUNDS);
+  xpthread_barrier_destroy (&barrier);
+  free (threads);
+  free (entered);
+}
+
+static int
+do_test (void)
+{
+  static const unsigned int counts[] =
+    {
+      BARRIER_TREE_THRESHOLD - 1,
+      BARRIER_TREE_THRESHOLD,
+      BARRIER_TREE_THRESHOLD * BARRIER_TREE_FANOUT + 1,
+      300,
+    };
+
+  for (int i = 0; i < array_length (counts); ++i)
+    {
+      do_one (counts[i], PTHREAD_PROCESS_PRIVATE);
+      do_one (counts[i], PTHREAD_PROCESS_SHARED);
+    }
+  return 0;
+}
+
+#include <support/test-driver.c>
@@ -0,0 +1,268 @@
+/* Test the lock contention profiler (glibc.pthread.lock_profile).
+   Copyright (C) 2021 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <support/check.h>
+#include <support/xthread.h>
+#include <support/xunistd.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/* The test runs with glibc.pthread.lock_profile=1, so every contended
+   acquisition is sampled.  */
+
+#define HOLD_US 20000
+#define NLOCKS 16
+
+/* More than the number of sampled locks whose hold time is tracked per
+   thread at the same time.  */
+#define NDEEP 5
+
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t adaptive = PTHREAD_ADAPTIVE_MUTEX_INITIALIZER_NP;
+static pthread_mutex_t uncontended = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t outer = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t inner = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t deep[NDEEP];
+static pthread_rwlock_t rwlock = PTHREAD_RWLOCK_INITIALIZER;
+static pthread_mutex_t cond_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+static atomic_int waiting;
+static int signaled;
+
+static void *
+mutex_thread (void *closure)
+{
+  pthread_mutex_t *m = closure;
+  atomic_store (&waiting, 1);
+  xpthread_mutex_lock (m);
+  usleep (HOLD_US);
+  xpthread_mutex_unlock (m);
+  return NULL;
+}
+
+/* Hold two sampled locks at the same time.  */
+static void *
+nested_thread (void *closure)
+{
+  atomic_store (&waiting, 1);
+  xpthread_mutex_lock (&outer);
+  xpthread_mutex_lock (&inner);
+  usleep (HOLD_US);
+  xpthread_mutex_unlock (&inner);
+  xpthread_mutex_unlock (&outer);
+  return NULL;
+}
+
+/* Hold NDEEP sampled locks at the same time, so that the hold time of
+   the first one is dropped.  */
+static void *
+deep_thread (void *closure)
+{
+  atomic_store (&waiting, 1);
+  for (int i = 0; i < NDEEP; i++)
+    xpthread_mutex_lock (&deep[i]);
+  for (int i = NDEEP - 1; i >= 0; i--)
+    xpthread_mutex_unlock (&deep[i]);
+  return NULL;
+}
+
+static void *
+rwlock_thread (void *closure)
+{
+  atomic_store (&waiting, 1);
+  xpthread_rwlock_wrlock (&rwlock);
+  usleep (HOLD_US);
+  xpthread_rwlock_unlock (&rwlock);
+  return NULL;
+}
+
+static void *
+cond_thread (void *closure)
+{
+  xpthread_mutex_lock (&cond_mutex);
+  atomic_store (&waiting, 1);
+  while (!signaled)
+    xpthread_cond_wait (&cond, &cond_mutex);
+  xpthread_mutex_unlock (&cond_mutex);
+  return NULL;
+}
+
+/* Let a thread running FN wait for a lock held by the caller, which
+   releases it with RELEASE.  */
+static void
+contend (void *(*fn) (void *), void *closure, void (*release) (void))
+{
+  atomic_store (&waiting, 0);
+  pthread_t thr = xpthread_create (NULL, fn, closure);
+  while (atomic_load (&waiting) == 0)
+    usleep (1000);
+  usleep (HOLD_US);
+  release ();
+  xpthread_join (thr);
+}
+
+static void
+release_mutex (void)
+{
+  xpthread_mutex_unlock (&mutex);
+}
+
+static void
+release_adaptive (void)
+{
+  xpthread_mutex_unlock (&adaptive);
+}
+
+static void
+release_nested (void)
+{
+  xpthread_mutex_unlock (&outer);
+  usleep (HOLD_US);
+  xpthread_mutex_unlock (&inner);
+}
+
+static void
+release_deep (void)
+{
+  for (int i = 0; i < NDEEP; i++)
+    {
+      xpthread_mutex_unlock (&deep[i]);
+      usleep (HOLD_US);
+    }
+}
+
+static void
+release_rwlock (void)
+{
+  xpthread_rwlock_unlock (&rwlock);
+}
+
+static void
+release_cond (void)
+{
+  xpthread_mutex_lock (&cond_mutex);
+  signaled = 1;
+  pthread_cond_signal (&cond);
+  xpthread_mutex_unlock (&cond_mutex);
+}
+
+static const struct pthread_lock_profile_np *
+find (const struct pthread_lock_profile_np *stats, int n, const void *lock)
+{
+  for (int i = 0; i < n; i++)
+    if (stats[i].lock == lock)
+      return &stats[i];
+  return NULL;
+}
+
+static void
+check_lock (const struct pthread_lock_profile_np *stats, int n,
+	    const void *lock, int type, bool hold)
+{
+  const struct pthread_lock_profile_np *s = find (stats, n, lock);
+  if (s == NULL)
+    FAIL_EXIT1 ("no statistics for lock %p", lock);
+  TEST_COMPARE (s->type, type);
+  TEST_COMPARE (s->samples, 1);
+  TEST_VERIFY (s->wait_ns >= HOLD_US * 1000ULL / 2);
+  TEST_COMPARE (s->max_wait_ns, s->wait_ns);
+  TEST_VERIFY (s->max_wait_caller != NULL);
+  if (hold)
+    {
+      TEST_COMPARE (s->hold_samples, 1);
+      TEST_VERIFY (s->hold_ns >= HOLD_US * 1000ULL / 2);
+    }
+  else
+    TEST_COMPARE (s->hold_samples, 0);
+  TEST_COMPARE (s->hold_dropped, 0);
+}
+
+static int
+do_test (void)
+{
+  TEST_COMPARE (pthread_lock_profile_np (NULL, 0), 0);
+
+  xpthread_mutex_lock (&uncontended);
+  xpthread_mutex_unlock (&uncontended);
+
+  xpthread_mutex_lock (&mutex);
+  contend (mutex_thread, &mutex, release_mutex);
+  xpthread_mutex_lock (&adaptive);
+  contend (mutex_thread, &adaptive, release_adaptive);
+  xpthread_mutex_lock (&outer);
+  xpthread_mutex_lock (&inner);
+  contend (nested_thread, NULL, release_nested);
+  for (int i = 0; i < NDEEP; i++)
+    {
+      xpthread_mutex_init (&deep[i], NULL);
+      xpthread_mutex_lock (&deep[i]);
+    }
+  contend (deep_thread, NULL, release_deep);
+  xpthread_rwlock_wrlock (&rwlock);
+  contend (rwlock_thread, NULL, release_rwlock);
+  contend (cond_thread, NULL, release_cond);
+
+  struct pthread_lock_profile_np stats[NLOCKS];
+  int total = pthread_lock_profile_np (stats, NLOCKS);
+  TEST_VERIFY (total >= 6 + NDEEP);
+  int n = total < NLOCKS ? total : NLOCKS;
+  for (int i = 0; i < n; i++)
+    printf ("info: lock %p type %d samples %lu wait %llu hold %llu"
+	    " dropped %lu\n", stats[i].lock, stats[i].type,
+	    stats[i].samples, stats[i].wait_ns, stats[i].hold_ns,
+	    stats[i].hold_dropped);
+  for (int i = 1; i < n; i++)
+    TEST_VERIFY (stats[i - 1].wait_ns >= stats[i].wait_ns);
+
+  check_lock (stats, n, &mutex, PTHREAD_LOCK_PROFILE_MUTEX_NP, true);
+  check_lock (stats, n, &adaptive, PTHREAD_LOCK_PROFILE_MUTEX_NP, true);
+  check_lock (stats, n, &outer, PTHREAD_LOCK_PROFILE_MUTEX_NP, true);
+  check_lock (stats, n, &inner, PTHREAD_LOCK_PROFILE_MUTEX_NP, true);
+  check_lock (stats, n, &rwlock, PTHREAD_LOCK_PROFILE_RWLOCK_NP, true);
+  check_lock (stats, n, &cond, PTHREAD_LOCK_PROFILE_COND_NP, false);
+  for (int i = 0; i < NDEEP; i++)
+    {
+      const struct pthread_lock_profile_np *s = find (stats, n, &deep[i]);
+      if (s == NULL)
+	FAIL_EXIT1 ("no statistics for lock %p", &deep[i]);
+      TEST_COMPARE (s->samples, 1);
+      TEST_COMPARE (s->hold_samples, i == 0 ? 0 : 1);
+      TEST_COMPARE (s->hold_dropped, i == 0 ? 1 : 0);
+    }
+  TEST_VERIFY (find (stats, n, &uncontended) == NULL);
+
+  /* Fewer entries than locks are filled with the longest waits.  */
+  struct pthread_lock_profile_np top;
+  TEST_COMPARE (pthread_lock_profile_np (&top, 1), total);
+  TEST_VERIFY (top.lock == stats[0].lock);
+
+  /* A child does not inherit the samples of its parent.  */
+  pid_t pid = xfork ();
+  if (pid == 0)
+    _exit (pthread_lock_profile_np (NULL, 0) != 0);
+  int status;
+  xwaitpid (pid, &status, 0);
+  TEST_VERIFY (WIFEXITED (status) && WEXITSTATUS (status) == 0);
+
+  return 0;
+}
+
+#include <support/test-driver.c>
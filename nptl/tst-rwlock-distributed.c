@@ -0,0 +1,181 @@
+/* Test PTHREAD_RWLOCK_DISTRIBUTED_READERS_NP rwlocks.
+   Copyright (C) 2021 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <support/check.h>
+#include <support/xthread.h>
+#include <support/xtime.h>
+#include <time.h>
+#include <unistd.h>
+
+#define NREADERS 8
+#define NWRITERS 2
+#define READTRIES 20000
+#define WRITETRIES 2000
+
+static pthread_rwlock_t lock;
+
+/* Protected by LOCK.  Writers make it odd and then even again, so
+   readers must never see an odd value.  */
+static unsigned int value;
+
+static atomic_int writer_done;
+
+static void *
+blocked_writer (void *closure)
+{
+  xpthread_rwlock_wrlock (&lock);
+  ++value;
+  atomic_store (&writer_done, 1);
+  xpthread_rwlock_unlock (&lock);
+  return NULL;
+}
+
+/* A thread holding a read lock must be able to acquire it again while
+   a writer is waiting, and the writer must not get in before all read
+   locks have been released.  */
+static void
+test_recursion (void)
+{
+  value = 0;
+  /* The first read lock enables the reader bias, so that the following
+     ones are acquired through the reader slot and the writer has to wait
+     for the slot rather than for __readers.  */
+  xpthread_rwlock_rdlock (&lock);
+  xpthread_rwlock_unlock (&lock);
+  xpthread_rwlock_rdlock (&lock);
+  xpthread_rwlock_rdlock (&lock);
+
+  pthread_t thr = xpthread_create (NULL, blocked_writer, NULL);
+  usleep (10000);
+  TEST_COMPARE (pthread_rwlock_tryrdlock (&lock), 0);
+  xpthread_rwlock_rdlock (&lock);
+  TEST_COMPARE (atomic_load (&writer_done), 0);
+
+  for (int i = 0; i < 4; ++i)
+    {
+      TEST_COMPARE (value, 0);
+      usleep (1000);
+      xpthread_rwlock_unlock (&lock);
+    }
+  xpthread_join (thr);
+  TEST_COMPARE (atomic_load (&writer_done), 1);
+  TEST_COMPARE (value, 1);
+}
+
+/* trywrlock and timed wrlock must fail while a reader holds the lock,
+   and the lock must remain usable afterwards.  */
+static void
+test_try (void)
+{
+  xpthread_rwlock_rdlock (&lock);
+  xpthread_rwlock_rdlock (&lock);
+  TEST_COMPARE (pthread_rwlock_trywrlock (&lock), EBUSY);
+  struct timespec ts = xclock_now (CLOCK_MONOTONIC);
+  ts.tv_nsec += 1000000;
+  if (ts.tv_nsec >= 1000000000)
+    {
+      ts.tv_nsec -= 1000000000;
+      ++ts.tv_sec;
+    }
+  TEST_COMPARE (pthread_rwlock_clockwrlock (&lock, CLOCK_MONOTONIC, &ts),
+		ETIMEDOUT);
+  xpthread_rwlock_unlock (&lock);
+  xpthread_rwlock_unlock (&lock);
+
+  TEST_COMPARE (pthread_rwlock_trywrlock (&lock), 0);
+  TEST_COMPARE (pthread_rwlock_tryrdlock (&lock), EBUSY);
+  xpthread_rwlock_unlock (&lock);
+}
+
+static void *
+reader (void *closure)
+{
+  for (int i = 0; i < READTRIES; ++i)
+    {
+      if (i % 16 == 0)
+	{
+	  if (pthread_rwlock_tryrdlock (&lock) != 0)
+	    continue;
+	}
+      else
+	xpthread_rwlock_rdlock (&lock);
+      TEST_VERIFY (value % 2 == 0);
+      xpthread_rwlock_unlock (&lock);
+    }
+  return NULL;
+}
+
+static void *
+writer (void *closure)
+{
+  for (int i = 0; i < WRITETRIES; ++i)
+    {
+      xpthread_rwlock_wrlock (&lock);
+      ++value;
+      TEST_VERIFY (value % 2 == 1);
+      ++value;
+      xpthread_rwlock_unlock (&lock);
+      if (i % 64 == 0)
+	usleep (100);
+    }
+  return NULL;
+}
+
+/* Concurrent readers and writers must exclude each other.  */
+static void
+test_stress (void)
+{
+  value = 0;
+  pthread_t readers[NREADERS];
+  pthread_t writers[NWRITERS];
+  for (int i = 0; i < NREADERS; ++i)
+    readers[i] = xpthread_create (NULL, reader, NULL);
+  for (int i = 0; i < NWRITERS; ++i)
+    writers[i] = xpthread_create (NULL, writer, NULL);
+  for (int i = 0; i < NREADERS; ++i)
+    xpthread_join (readers[i]);
+  for (int i = 0; i < NWRITERS; ++i)
+    xpthread_join (writers[i]);
+  TEST_COMPARE (value, 2 * NWRITERS * WRITETRIES);
+}
+
+static int
+do_test (void)
+{
+  pthread_rwlockattr_t attr;
+  xpthread_rwlockattr_init (&attr);
+  xpthread_rwlockattr_setkind_np (&attr,
+				  PTHREAD_RWLOCK_DISTRIBUTED_READERS_NP);
+  int kind;
+  TEST_COMPARE (pthread_rwlockattr_getkind_np (&attr, &kind), 0);
+  TEST_COMPARE (kind, PTHREAD_RWLOCK_DISTRIBUTED_READERS_NP);
+  xpthread_rwlock_init (&lock, &attr);
+  TEST_COMPARE (pthread_rwlockattr_destroy (&attr), 0);
+
+  test_recursion ();
+  test_try ();
+  test_stress ();
+
+  xpthread_rwlock_destroy (&lock);
+  return 0;
+}
+
+#include <support/test-driver.c>
@@ -0,0 +1,2 @@
+#define TYPE PTHREAD_RWLOCK_DISTRIBUTED_READERS_NP
+#include "tst-rwlock2.c"
@@ -0,0 +1,115 @@
+/* Test reuse of cached thread stacks with glibc.pthread.stack_hugetlb.
+   Copyright (C) 2021 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <support/check.h>
+#include <support/xstdio.h>
+#include <support/xthread.h>
+
+/* Transparent huge page size, or 0 if they are not used.  */
+static size_t thp_pagesize;
+
+/* True if the kernel uses huge pages only after MADV_HUGEPAGE.  */
+static bool thp_madvise;
+
+static void
+read_thp_config (void)
+{
+  FILE *fp = fopen ("/sys/kernel/mm/transparent_hugepage/enabled", "r");
+  if (fp == NULL)
+    return;
+  char mode[64] = "";
+  if (fgets (mode, sizeof (mode), fp) == NULL)
+    mode[0] = '\0';
+  xfclose (fp);
+  if (strstr (mode, "[always]") == NULL && strstr (mode, "[madvise]") == NULL)
+    return;
+  thp_madvise = strstr (mode, "[madvise]") != NULL;
+
+  fp = fopen ("/sys/kernel/mm/transparent_hugepage/hpage_pmd_size", "r");
+  if (fp == NULL)
+    return;
+  if (fscanf (fp, "%zu", &thp_pagesize) != 1)
+    thp_pagesize = 0;
+  xfclose (fp);
+}
+
+/* Check that the mapping of the stack of the calling thread ends on a
+   huge page boundary, and that it was advised to use huge pages if the
+   kernel requires that.  */
+static void *
+hugetlb_thread (void *closure)
+{
+  pthread_attr_t attr;
+  TEST_COMPARE (pthread_getattr_np (pthread_self (), &attr), 0);
+  void *addr;
+  size_t size;
+  TEST_COMPARE (pthread_attr_getstack (&attr, &addr, &size), 0);
+  xpthread_attr_destroy (&attr);
+  uintptr_t sp = (uintptr_t) addr + size - 1;
+
+  FILE *fp = xfopen ("/proc/self/smaps", "r");
+  char *line = NULL;
+  size_t linelen = 0;
+  bool found = false;
+  while (getline (&line, &linelen, fp) > 0)
+    {
+      uintptr_t start, end;
+      if (sscanf (line, "%" SCNxPTR "-%" SCNxPTR " ", &start, &end) == 2)
+	{
+	  found = start <= sp && sp < end;
+	  if (found)
+	    TEST_COMPARE (end % thp_pagesize, 0);
+	}
+      else if (found && strncmp (line, "VmFlags:", 8) == 0)
+	{
+	  TEST_COMPARE (strstr (line, " hg") != NULL, thp_madvise);
+	  break;
+	}
+    }
+  TEST_VERIFY (found);
+  free (line);
+  xfclose (fp);
+  return NULL;
+}
+
+static void
+check_new_stack (void)
+{
+  read_thp_config ();
+  if (thp_pagesize == 0)
+    {
+      puts ("info: transparent huge pages not enabled");
+      return;
+    }
+
+  pthread_attr_t attr;
+  xpthread_attr_init (&attr);
+  xpthread_attr_setstacksize (&attr, 2 * thp_pagesize);
+  xpthread_join (xpthread_create (&attr, hugetlb_thread, NULL));
+  xpthread_attr_destroy (&attr);
+}
+
+#define CHECK_NEW_STACK check_new_stack
+#include "tst-stack-cache.c"
@@ -0,0 +1,75 @@
+/* Test reuse of cached thread stacks with glibc.pthread.stack_prefault.
+   Copyright (C) 2021 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <support/check.h>
+#include <support/xthread.h>
+
+/* The value of glibc.pthread.stack_prefault set in the Makefile.  */
+enum { prefault_size = 65536 };
+
+/* Check that the top of the stack of the calling thread is resident.
+   The thread descriptor and static TLS are above the stack and also in
+   the populated area, so only the upper half of it is checked.  */
+static void *
+prefault_thread (void *closure)
+{
+  pthread_attr_t attr;
+  TEST_COMPARE (pthread_getattr_np (pthread_self (), &attr), 0);
+  void *addr;
+  size_t size;
+  TEST_COMPARE (pthread_attr_getstack (&attr, &addr, &size), 0);
+  xpthread_attr_destroy (&attr);
+
+  size_t pagesize = sysconf (_SC_PAGESIZE);
+  size_t len = prefault_size / 2;
+  if (len < 2 * pagesize)
+    {
+      printf ("info: page size %zu too large to check residency\n",
+	      pagesize);
+      return NULL;
+    }
+  uintptr_t top = ((uintptr_t) addr + size) & -pagesize;
+  unsigned char vec[len / pagesize];
+  TEST_COMPARE (mincore ((void *) (top - len), len, vec), 0);
+  for (size_t i = 0; i < len / pagesize; ++i)
+    if ((vec[i] & 1) == 0)
+      {
+	support_record_failure ();
+	printf ("error: stack page at %#zx not resident\n",
+		(size_t) (top - len + i * pagesize));
+      }
+  return NULL;
+}
+
+static void
+check_new_stack (void)
+{
+  pthread_attr_t attr;
+  xpthread_attr_init (&attr);
+  xpthread_attr_setstacksize (&attr, 1024 * 1024);
+  xpthread_join (xpthread_create (&attr, prefault_thread, NULL));
+  xpthread_attr_destroy (&attr);
+}
+
+#define CHECK_NEW_STACK check_new_stack
+#include "tst-stack-cache.c"
@@ -0,0 +1,145 @@
+/* Test reuse of cached thread stacks of different sizes.
+   Copyright (C) 2021 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+/* The stack cache keeps stacks in lists by size.  Create threads with
+   stack sizes from several of these lists, in the parent and in a forked
+   child (which moves the stacks of the parent's threads into the cache),
+   and check that every thread gets a stack of at least the requested
+   size and can use it.  */
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <array_length.h>
+#include <support/check.h>
+#include <support/xthread.h>
+#include <support/xunistd.h>
+#include <sys/wait.h>
+
+static const size_t sizes[] =
+  {
+    64 * 1024,
+    96 * 1024,
+    256 * 1024,
+    300 * 1024,
+    1024 * 1024,
+    4 * 1024 * 1024,
+    9 * 1024 * 1024,
+  };
+
+static pthread_barrier_t barrier;
+
+static void *
+tf (void *closure)
+{
+  size_t size = (uintptr_t) closure;
+
+  pthread_attr_t attr;
+  TEST_COMPARE (pthread_getattr_np (pthread_self (), &attr), 0);
+  size_t actual;
+  TEST_COMPARE (pthread_attr_getstacksize (&attr, &actual), 0);
+  xpthread_attr_destroy (&attr);
+  TEST_VERIFY (actual >= size);
+
+  /* Use half of the stack.  */
+  char buf[size / 2];
+  memset (buf, 0xa5, sizeof (buf));
+  asm volatile ("" : : "r" (buf) : "memory");
+
+  if (closure == NULL)
+    return NULL;
+  xpthread_barrier_wait (&barrier);
+  return NULL;
+}
+
+/* Start one thread for each size, concurrently if WAIT.  */
+static void
+run_threads (bool wait)
+{
+  pthread_t threads[array_length (sizes)];
+  pthread_attr_t attr;
+  xpthread_attr_init (&attr);
+  if (wait)
+    xpthread_barrier_init (&barrier, NULL, array_length (sizes) + 1);
+  for (int i = 0; i < array_length (sizes); ++i)
+    {
+      /* Iterate in different orders, so that stacks get reused for
+	 threads with other sizes.  */
+      size_t size = sizes[wait ? i : array_length (sizes) - 1 - i];
+      xpthread_attr_setstacksize (&attr, size);
+      threads[i] = xpthread_create (&attr, tf,
+				    (void *) (uintptr_t) (wait ? size : 0));
+    }
+  xpthread_attr_destroy (&attr);
+  if (wait)
+    xpthread_barrier_wait (&barrier);
+  for (int i = 0; i < array_length (sizes); ++i)
+    xpthread_join (threads[i]);
+  if (wait)
+    xpthread_barrier_destroy (&barrier);
+}
+
+static int
+do_test (void)
+{
+#ifdef CHECK_NEW_STACK
+  /* Before any stack is cached, so that the thread gets a new one.  */
+  CHECK_NEW_STACK ();
+#endif
+
+  for (int i = 0; i < 10; ++i)
+    {
+      run_threads (true);
+      run_threads (false);
+    }
+
+  /* Fork while the threads are running.  */
+  pthread_t threads[array_length (sizes)];
+  pthread_attr_t attr;
+  xpthread_attr_init (&attr);
+  xpthread_barrier_init (&barrier, NULL, array_length (sizes) + 1);
+  for (int i = 0; i < array_length (sizes); ++i)
+    {
+      xpthread_attr_setstacksize (&attr, sizes[i]);
+      threads[i] = xpthread_create (&attr, tf, (void *) (uintptr_t) sizes[i]);
+    }
+  xpthread_attr_destroy (&attr);
+
+  pid_t pid = xfork ();
+  if (pid == 0)
+    {
+      for (int i = 0; i < 10; ++i)
+	{
+	  run_threads (true);
+	  run_threads (false);
+	}
+      _exit (0);
+    }
+  int status;
+  xwaitpid (pid, &status, 0);
+  TEST_COMPARE (status, 0);
+
+  xpthread_barrier_wait (&barrier);
+  for (int i = 0; i < array_length (sizes); ++i)
+    xpthread_join (threads[i]);
+  xpthread_barrier_destroy (&barrier);
+  return 0;
+}
+
+#include <support/test-driver.c>
@@ -31,23 +31,22 @@
 #define __pthread_cond_signal pthread_cond_signal
 #define __pthread_cond_timedwait pthread_cond_timedwait
 #define __pthread_create pthread_create
-#define __pthread_exit pthread_exit
 #endif
 
 #ifndef gai_create_helper_thread
 # define gai_create_helper_thread __gai_create_helper_thread
 
 extern inline int
-__gai_create_helper_thread (pthread_t *threadp, void *(*tf) (void *),
-			    void *arg)
+__gai_create_helper_thread (void *(*tf) (void *), void *arg)
 {
+  pthread_t thid;
   pthread_attr_t attr;
 
   /* Make sure the thread is created detached.  */
   __pthread_attr_init (&attr);
   __pthread_attr_setdetachstate (&attr, PTHREAD_CREATE_DETACHED);
 
-  int ret = __pthread_create (threadp, &attr, tf, arg);
+  int ret = __pthread_create (&thid, &attr, tf, arg);
 
   (void) __pthread_attr_destroy (&attr);
   return ret;
@@ -253,12 +252,11 @@ __gai_enqueue_request (struct gaicb *gaicbp)
   /* See if we need to and are able to create a thread.  */
   if (nthreads < optim.gai_threads && idle_thread_count == 0)
     {
-      pthread_t thid;
 
       newp->running = 1;
 
       /* Now try to start a thread.  */
-      if (gai_create_helper_thread (&thid, handle_requests, newp) == 0)
+      if (gai_create_helper_thread (handle_requests, newp) == 0)
 	/* We managed to enqueue the request.  All errors which can
 	   happen now can be recognized by calls to `gai_error'.  */
 	++nthreads;
@@ -304,7 +302,6 @@ __gai_enqueue_request (struct gaicb *gaicbp)
 
 
 static void *
-__attribute__ ((noreturn))
 handle_requests (void *arg)
 {
   struct requestlist *runp = (struct requestlist *) arg;
@@ -406,19 +403,11 @@ handle_requests (void *arg)
 		__pthread_cond_signal (&__gai_new_request_notification);
 	      else if (nthreads < optim.gai_threads)
 		{
-		  pthread_t thid;
-		  pthread_attr_t attr;
-
-		  /* Make sure the thread is created detached.  */
-		  __pthread_attr_init (&attr);
-		  __pthread_attr_setdetachstate (&attr,
-						 PTHREAD_CREATE_DETACHED);
 
 		  /* Now try to start a thread. If we fail, no big deal,
 		     because we know that there is at least one thread (us)
 		     that is working on lookup operations. */
-		  if (__pthread_create (&thid, &attr, handle_requests, NULL)
-		      == 0)
+		  if (gai_create_helper_thread (handle_requests, NULL) == 0)
 		    ++nthreads;
 		}
 	    }
@@ -429,7 +418,7 @@ handle_requests (void *arg)
     }
   while (runp != NULL);
 
-  __pthread_exit (NULL);
+  return NULL;
 }
 
 
@@ -46,15 +46,16 @@
 # define aio_create_helper_thread __aio_create_helper_thread
 
 extern inline int
-__aio_create_helper_thread (pthread_t *threadp, void *(*tf) (void *), void *arg)
+__aio_create_helper_thread (void *(*tf) (void *), void *arg)
 {
+  pthread_t thid;
   pthread_attr_t attr;
 
   /* Make sure the thread is created detached.  */
   __pthread_attr_init (&attr);
   __pthread_attr_setdetachstate (&attr, PTHREAD_CREATE_DETACHED);
 
-  int ret = __pthread_create (threadp, &attr, tf, arg);
+  int ret = __pthread_create (&thid, &attr, tf, arg);
 
   __pthread_attr_destroy (&attr);
   return ret;
@@ -429,12 +430,11 @@ __aio_enqueue_request (aiocb_union *aiocbp, int operation)
       /* See if we need to and are able to create a thread.  */
       if (nthreads < optim.aio_threads && idle_thread_count == 0)
 	{
-	  pthread_t thid;
 
 	  running = newp->running = allocated;
 
 	  /* Now try to start a thread.  */
-	  result = aio_create_helper_thread (&thid, handle_fildes_io, newp);
+	  result = aio_create_helper_thread (handle_fildes_io, newp);
 	  if (result == 0)
 	    /* We managed to enqueue the request.  All errors which can
 	       happen now can be recognized by calls to `aio_return' and
@@ -492,12 +492,16 @@ handle_fildes_io (void *arg)
 {
   pthread_t self = __pthread_self ();
   struct sched_param param;
+  struct sched_param orig_param;
   struct requestlist *runp = (struct requestlist *) arg;
   aiocb_union *aiocbp;
   int policy;
+  int orig_policy;
   int fildes;
 
   __pthread_getschedparam (self, &policy, &param);
+  orig_policy = policy;
+  orig_param = param;
 
   do
     {
@@ -666,19 +670,11 @@ handle_fildes_io (void *arg)
 		__pthread_cond_signal (&__aio_new_request_notification);
 	      else if (nthreads < optim.aio_threads)
 		{
-		  pthread_t thid;
-		  pthread_attr_t attr;
-
-		  /* Make sure the thread is created detached.  */
-		  __pthread_attr_init (&attr);
-		  __pthread_attr_setdetachstate (&attr,
-						 PTHREAD_CREATE_DETACHED);
 
 		  /* Now try to start a thread. If we fail, no big deal,
 		     because we know that there is at least one thread (us)
 		     that is working on AIO operations. */
-		  if (__pthread_create (&thid, &attr, handle_fildes_io, NULL)
-		      == 0)
+		  if (aio_create_helper_thread (handle_fildes_io, NULL) == 0)
 		    ++nthreads;
 		}
 	    }
@@ -689,6 +685,12 @@ handle_fildes_io (void *arg)
     }
   while (runp != NULL);
 
+  /* The thread may be reused for other work, so undo the priority
+     changes of the requests.  */
+  if (policy != orig_policy
+      || param.sched_priority != orig_param.sched_priority)
+    __pthread_setschedparam (self, orig_policy, &orig_param);
+
   return NULL;
 }
 
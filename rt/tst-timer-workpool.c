@@ -0,0 +1,143 @@
+/* Check that SIGEV_THREAD notifications reuse worker pool threads.
+   Copyright (C) 2021 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+#include <limits.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <support/check.h>
+#include <support/xthread.h>
+#include <support/xunistd.h>
+
+#define NEXPIRATIONS 16
+
+static sem_t done;
+static pid_t tids[NEXPIRATIONS];
+static int expirations;
+static pthread_key_t key;
+static char name[16];
+
+static void
+thread_handler (union sigval sv)
+{
+  /* A worker does not keep the state the previous notification left
+     behind.  */
+  pthread_t self = pthread_self ();
+  char current[16];
+  TEST_COMPARE (pthread_getname_np (self, current, sizeof (current)), 0);
+  TEST_COMPARE_STRING (current, name);
+  TEST_VERIFY (pthread_getspecific (key) == NULL);
+  pthread_testcancel ();
+  int old;
+  TEST_COMPARE (pthread_setcancelstate (PTHREAD_CANCEL_DISABLE, &old), 0);
+  TEST_COMPARE (old, PTHREAD_CANCEL_ENABLE);
+  TEST_COMPARE (pthread_setcanceltype (PTHREAD_CANCEL_ASYNCHRONOUS, &old),
+		0);
+  TEST_COMPARE (old, PTHREAD_CANCEL_DEFERRED);
+  TEST_COMPARE (pthread_cancel (self), 0);
+  TEST_COMPARE (pthread_setname_np (self, "notification"), 0);
+  TEST_COMPARE (pthread_setspecific (key, &key), 0);
+
+  tids[expirations++] = gettid ();
+  TEST_VERIFY (sem_post (&done) == 0);
+}
+
+/* Let a one-shot timer with notification attributes ATTR expire
+   NEXPIRATIONS times, one at a time, and return the number of
+   different threads the notifications ran on.  */
+static int
+run_timer (pthread_attr_t *attr)
+{
+  struct sigevent sev = { 0 };
+  sev.sigev_notify = SIGEV_THREAD;
+  sev.sigev_notify_function = thread_handler;
+  sev.sigev_notify_attributes = attr;
+
+  timer_t timerid;
+  TEST_COMPARE (timer_create (CLOCK_MONOTONIC, &sev, &timerid), 0);
+
+  expirations = 0;
+  for (int i = 0; i < NEXPIRATIONS; i++)
+    {
+      /* Give the previous notification time to return, so that its
+	 thread can be reused.  */
+      usleep (10000);
+
+      struct itimerspec trigger = { 0 };
+      trigger.it_value.tv_nsec = 1000000;
+      TEST_COMPARE (timer_settime (timerid, 0, &trigger, NULL), 0);
+      while (sem_wait (&done) != 0)
+	;
+    }
+
+  TEST_COMPARE (timer_delete (timerid), 0);
+  TEST_COMPARE (expirations, NEXPIRATIONS);
+
+  int distinct = 0;
+  for (int i = 0; i < NEXPIRATIONS; i++)
+    {
+      int j;
+      for (j = 0; j < i; j++)
+	if (tids[j] == tids[i])
+	  break;
+      if (j == i)
+	distinct++;
+    }
+  printf ("info: %d notifications ran on %d threads\n",
+	  NEXPIRATIONS, distinct);
+  return distinct;
+}
+
+static int
+do_test (void)
+{
+  TEST_COMPARE (sem_init (&done, 0, 0), 0);
+  TEST_COMPARE (pthread_key_create (&key, NULL), 0);
+  TEST_COMPARE (pthread_getname_np (pthread_self (), name, sizeof (name)),
+		0);
+
+  /* Without attributes the notifications run on the worker pool.  */
+  TEST_VERIFY (run_timer (NULL) <= NEXPIRATIONS / 4);
+
+  /* With attributes every notification gets a new thread.  */
+  pthread_attr_t attr;
+  xpthread_attr_init (&attr);
+  xpthread_attr_setstacksize (&attr, 4 * PTHREAD_STACK_MIN);
+  TEST_VERIFY (run_timer (&attr) > NEXPIRATIONS / 2);
+  xpthread_attr_destroy (&attr);
+
+  /* The parked workers of the parent must not be used in a child.  */
+  pid_t pid = xfork ();
+  if (pid == 0)
+    {
+      TEST_VERIFY (run_timer (NULL) <= NEXPIRATIONS / 4);
+      exit (0);
+    }
+  int status;
+  xwaitpid (pid, &status, 0);
+  TEST_COMPARE (status, 0);
+
+  return 0;
+}
+
+#include <support/test-driver.c>
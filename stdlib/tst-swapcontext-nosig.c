@@ -0,0 +1,132 @@
+/* Test setcontext_nosig and swapcontext_nosig.
+   Copyright (C) 2021 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+#include <errno.h>
+#include <fenv.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <ucontext.h>
+#include <support/check.h>
+
+static ucontext_t main_uc;
+static ucontext_t fiber_uc;
+static ucontext_t link_uc;
+static char fiber_stack[64 * 1024];
+static int switches;
+
+/* Whether the fiber expects SIGUSR1 to be blocked when it resumes.  */
+static bool fiber_blocked;
+
+/* Return true if SIGUSR1 is blocked in the calling thread.  */
+static bool
+sigusr1_blocked (void)
+{
+  sigset_t ss;
+  TEST_COMPARE (sigprocmask (SIG_BLOCK, NULL, &ss), 0);
+  return sigismember (&ss, SIGUSR1);
+}
+
+static void
+fiber (int a, int b)
+{
+  TEST_COMPARE (a, 1);
+  TEST_COMPARE (b, 2);
+
+#ifdef FE_UPWARD
+  /* The rounding mode is part of the context.  */
+  TEST_COMPARE (fesetround (FE_UPWARD), 0);
+#endif
+
+  while (true)
+    {
+      TEST_COMPARE (sigusr1_blocked (), fiber_blocked);
+#ifdef FE_UPWARD
+      TEST_COMPARE (fegetround (), FE_UPWARD);
+#endif
+      if (++switches == 3)
+	break;
+      TEST_COMPARE (swapcontext_nosig (&fiber_uc, &main_uc), 0);
+    }
+
+  /* Return to link_uc.  */
+}
+
+static int
+do_test (void)
+{
+  TEST_COMPARE (getcontext (&fiber_uc), 0);
+  fiber_uc.uc_stack.ss_sp = fiber_stack;
+  fiber_uc.uc_stack.ss_size = sizeof (fiber_stack);
+  fiber_uc.uc_link = &link_uc;
+  makecontext (&fiber_uc, (void (*) (void)) fiber, 2, 1, 2);
+
+  sigset_t ss;
+  sigemptyset (&ss);
+  sigaddset (&ss, SIGUSR1);
+  TEST_COMPARE (sigprocmask (SIG_SETMASK, &ss, NULL), 0);
+
+  /* fiber_uc was saved with an empty signal mask, which must not be
+     installed.  */
+  fiber_blocked = true;
+  if (swapcontext_nosig (&main_uc, &fiber_uc) != 0)
+    {
+      if (errno == ENOSYS)
+	FAIL_UNSUPPORTED ("swapcontext_nosig is not supported");
+      FAIL_EXIT1 ("swapcontext_nosig: %m");
+    }
+  TEST_COMPARE (switches, 1);
+  TEST_VERIFY (sigusr1_blocked ());
+#ifdef FE_UPWARD
+  TEST_COMPARE (fegetround (), FE_TONEAREST);
+#endif
+
+  /* Contexts saved by swapcontext_nosig can be resumed by swapcontext,
+     and the other way round.  swapcontext installs the signal mask
+     fiber_uc was created with, since swapcontext_nosig did not update
+     it.  */
+  fiber_blocked = false;
+  TEST_COMPARE (swapcontext (&main_uc, &fiber_uc), 0);
+  TEST_COMPARE (switches, 2);
+  TEST_VERIFY (!sigusr1_blocked ());
+#ifdef FE_UPWARD
+  TEST_COMPARE (fegetround (), FE_TONEAREST);
+#endif
+
+  /* Resume the fiber with setcontext_nosig.  It returns to link_uc
+     when it finishes, which unblocks SIGUSR1 with the signal mask
+     saved by getcontext below.  */
+  volatile bool resumed = false;
+  TEST_COMPARE (getcontext (&link_uc), 0);
+  if (!resumed)
+    {
+      resumed = true;
+      TEST_COMPARE (sigprocmask (SIG_SETMASK, &ss, NULL), 0);
+      fiber_blocked = true;
+      setcontext_nosig (&fiber_uc);
+      FAIL_EXIT1 ("setcontext_nosig: %m");
+    }
+  TEST_COMPARE (switches, 3);
+  TEST_VERIFY (!sigusr1_blocked ());
+#ifdef FE_UPWARD
+  TEST_COMPARE (fegetround (), FE_TONEAREST);
+#endif
+
+  return 0;
+}
+
+#include <support/test-driver.c>
@@ -51,6 +51,18 @@ extern int swapcontext (ucontext_t *__restrict __oucp,
 extern void makecontext (ucontext_t *__ucp, void (*__func) (void),
 			 int __argc, ...) __THROW;
 
+#ifdef __USE_GNU
+/* Like `setcontext', but leave the signal mask of the calling thread
+   unchanged.  */
+extern int setcontext_nosig (const ucontext_t *__ucp) __THROWNL;
+
+/* Like `swapcontext', but leave the signal mask of the calling thread
+   unchanged, and do not store it in OUCP.  */
+extern int swapcontext_nosig (ucontext_t *__restrict __oucp,
+			      const ucontext_t *__restrict __ucp)
+  __THROWNL __INDIRECT_RETURN;
+#endif
+
 __END_DECLS
 
 #endif /* ucontext.h */
@@ -477,8 +477,10 @@ struct rtld_global
   /* List of thread stacks that were allocated by the application.  */
   EXTERN list_t _dl_stack_user;
 
-  /* List of queued thread stacks.  */
-  EXTERN list_t _dl_stack_cache;
+  /* Lists of queued thread stacks, by size.  See
+     __nptl_stack_cache_bucket.  */
+#define DL_STACK_CACHE_BUCKETS 10
+  EXTERN list_t _dl_stack_cache[DL_STACK_CACHE_BUCKETS];
 
   /* Total size of all stacks in the cache (sum over stackblock_size).  */
   EXTERN size_t _dl_stack_cache_actsize;
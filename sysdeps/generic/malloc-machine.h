@@ -38,4 +38,11 @@
 # define DEFAULT_TOP_PAD 131072
 #endif
 
+/* Milliseconds after which a freed mmapped chunk is dropped from the
+   cache enabled by glibc.malloc.mmap_cache_size.  Also the default of
+   the glibc.malloc.mmap_cache_age tunable.  */
+#ifndef DEFAULT_MMAP_CACHE_AGE
+# define DEFAULT_MMAP_CACHE_AGE 1000
+#endif
+
 #endif /* !defined(_GENERIC_MALLOC_MACHINE_H) */
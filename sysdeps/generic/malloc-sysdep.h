@@ -26,3 +26,41 @@ check_may_shrink_heap (void)
 {
   return __libc_enable_secure;
 }
+
+/* Return the number of the CPU the calling thread runs on, or -1 if
+   it cannot be determined cheaply.  Used to select per-CPU arenas.  */
+static inline int
+malloc_getcpu (void)
+{
+  return -1;
+}
+
+/* Return the NUMA node of the CPU the calling thread runs on, or -1 if
+   it cannot be determined.  Used to group arenas by node.  */
+static inline int
+malloc_getnode (void)
+{
+  return -1;
+}
+
+/* Set NODES[CPU] to the NUMA node of each CPU below NCPUS, for the
+   nodes below NNODES.  Entries of other CPUs are left alone.  */
+static inline void
+malloc_cpu_nodes (short *nodes, int ncpus, int nnodes)
+{
+}
+
+/* Return the number of NUMA nodes.  A value of 1 disables the
+   glibc.malloc.arena_numa tunable.  */
+static inline int
+malloc_numa_nodes (void)
+{
+  return 1;
+}
+
+/* Prefer NODE for the pages of [ADDR, ADDR + LEN) faulted in later.
+   Without a placement interface the pages are placed by first touch.  */
+static inline void
+malloc_bind_node (void *addr, size_t len, int node)
+{
+}
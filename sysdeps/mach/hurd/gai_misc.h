@@ -33,9 +33,9 @@ __gai_start_notify_thread (void)
 }
 
 extern inline int
-__gai_create_helper_thread (pthread_t *threadp, void *(*tf) (void *),
-			    void *arg)
+__gai_create_helper_thread (void *(*tf) (void *), void *arg)
 {
+  pthread_t thid;
   pthread_attr_t attr;
 
   /* Make sure the thread is created detached.  */
@@ -54,7 +54,7 @@ __gai_create_helper_thread (pthread_t *threadp, void *(*tf) (void *),
   sigerr = pthread_sigmask (SIG_SETMASK, &ss, &oss);
   assert_perror (sigerr);
 
-  int ret = pthread_create (threadp, &attr, tf, arg);
+  int ret = pthread_create (&thid, &attr, tf, arg);
 
   /* Restore the signal mask.  */
   sigerr = pthread_sigmask (SIG_SETMASK, &oss, NULL);
@@ -21,6 +21,13 @@
 #include <list.h>
 #include <pthreadP.h>
 #include <tls.h>
+#include <rseq-internal.h>
+#ifdef RSEQ_SIG
+# include <thread_pointer.h>
+#endif
+
+#define TUNABLE_NAMESPACE pthread
+#include <dl-tunables.h>
 
 #ifndef __ASSUME_SET_ROBUST_LIST
 bool __nptl_set_robust_list_avail;
@@ -30,6 +37,10 @@ rtld_hidden_data_def (__nptl_set_robust_list_avail)
 bool __nptl_initial_report_events;
 rtld_hidden_def (__nptl_initial_report_events)
 
+const unsigned int __rseq_flags;
+const unsigned int __rseq_size attribute_relro;
+const ptrdiff_t __rseq_offset attribute_relro;
+
 #ifdef SHARED
 /* Dummy implementation.  See __rtld_mutex_init.  */
 static int
@@ -46,7 +57,8 @@ __tls_pre_init_tp (void)
      initialized.  */
   INIT_LIST_HEAD (&GL (dl_stack_used));
   INIT_LIST_HEAD (&GL (dl_stack_user));
-  INIT_LIST_HEAD (&GL (dl_stack_cache));
+  for (int i = 0; i < DL_STACK_CACHE_BUCKETS; ++i)
+    INIT_LIST_HEAD (&GL (dl_stack_cache)[i]);
 
 #ifdef SHARED
   ___rtld_mutex_lock = rtld_mutex_dummy;
@@ -90,6 +102,31 @@ __tls_init_tp (void)
       }
   }
 
+  /* Register the rseq area.  New threads inherit the setting through
+     ATTR_FLAG_DO_RSEQ.  */
+  {
+    bool do_rseq = true;
+#if HAVE_TUNABLES
+    do_rseq = TUNABLE_GET (rseq, int, NULL);
+#endif
+    if (rseq_register_current_thread (pd, do_rseq))
+      {
+        /* We need a writable view of the variables.  They are in
+           .data.relro and are not yet write-protected.  */
+        extern unsigned int size __asm__ ("__rseq_size");
+        size = sizeof (pd->rseq_area);
+        THREAD_SETMEM (pd, flags, THREAD_GETMEM (pd, flags)
+                                  | ATTR_FLAG_DO_RSEQ);
+      }
+
+#ifdef RSEQ_SIG
+    /* The offset is meaningful even if registration failed, so that
+       applications can find the area and see that cpu_id is negative.  */
+    extern ptrdiff_t offset __asm__ ("__rseq_offset");
+    offset = (char *) &pd->rseq_area - (char *) __thread_pointer ();
+#endif
+  }
+
   /* Set initial thread's stack block from 0 up to __libc_stack_end.
      It will be bigger than it actually is, but for unwind.c/pt-longjmp.c
      purposes this is good enough.  */
@@ -24,6 +24,9 @@
 #include <ldsodefs.h>
 #include <list.h>
 #include <mqueue.h>
+#include <nptl-lock-profile.h>
+#include <nptl/nptl-stack.h>
+#include <nptl-workpool.h>
 #include <pthreadP.h>
 #include <sysdep.h>
 
@@ -46,6 +49,7 @@ fork_system_setup_after_fork (void)
 
   call_function_static_weak (__mq_notify_fork_subprocess);
   call_function_static_weak (__timer_fork_subprocess);
+  __nptl_workpool_fork_subprocess ();
 }
 
 /* In case of a fork() call the memory allocation in the child will be
@@ -75,8 +79,14 @@ reclaim_stacks (void)
 
 	  if (GL (dl_stack_used).next->prev != &GL (dl_stack_used))
 	    l = &GL (dl_stack_used);
-	  else if (GL (dl_stack_cache).next->prev != &GL (dl_stack_cache))
-	    l = &GL (dl_stack_cache);
+	  else
+	    for (int i = 0; i < DL_STACK_CACHE_BUCKETS; ++i)
+	      if (GL (dl_stack_cache)[i].next->prev
+		  != &GL (dl_stack_cache)[i])
+		{
+		  l = &GL (dl_stack_cache)[i];
+		  break;
+		}
 
 	  if (l != NULL)
 	    {
@@ -106,6 +116,8 @@ reclaim_stacks (void)
 	  /* This marks the stack as free.  */
 	  curp->tid = 0;
 
+	  __nptl_lock_profile_reclaim (curp);
+
 	  /* Account for the size of the stack.  */
 	  GL (dl_stack_cache_actsize) += curp->stackblock_size;
 
@@ -131,13 +143,29 @@ reclaim_stacks (void)
 	}
     }
 
-  /* Add the stack of all running threads to the cache.  */
-  list_splice (&GL (dl_stack_used), &GL (dl_stack_cache));
+  /* Add the stack of all running threads except the current one to the
+     cache.  The current thread is added to the list of running threads
+     below.  */
+  list_t *prev;
+  list_for_each_prev_safe (runp, prev, &GL (dl_stack_used))
+    {
+      struct pthread *curp = list_entry (runp, struct pthread, list);
+      if (curp != self)
+	{
+	  unsigned int bucket
+	    = __nptl_stack_cache_bucket (curp->stackblock_size);
+	  list_add (runp, &GL (dl_stack_cache)[bucket]);
+	}
+    }
 
-  /* Remove the entry for the current thread to from the cache list
-     and add it to the list of running threads.  Which of the two
-     lists is decided by the user_stack flag.  */
-  list_del (&self->list);
+  /* The descriptors of threads on user stacks are not reused, but free
+     their lock profiler buffers.  */
+  list_for_each (runp, &GL (dl_stack_user))
+    {
+      struct pthread *curp = list_entry (runp, struct pthread, list);
+      if (curp != self)
+	__nptl_lock_profile_reclaim (curp);
+    }
 
   /* Re-initialize the lists for all the threads.  */
   INIT_LIST_HEAD (&GL (dl_stack_used));
@@ -147,6 +175,8 @@ reclaim_stacks (void)
     list_add (&self->list, &GL (dl_stack_user));
   else
     list_add (&self->list, &GL (dl_stack_used));
+
+  __nptl_lock_profile_fork_subprocess ();
 }
 
 
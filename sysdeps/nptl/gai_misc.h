@@ -24,6 +24,7 @@
 #include <signal.h>
 #include <pthreadP.h>
 #include <futex-internal.h>
+#include <nptl-workpool.h>
 
 #define DONT_NEED_GAI_MISC_COND	1
 
@@ -87,37 +88,11 @@ __gai_start_notify_thread (void)
 }
 
 extern inline int
-__gai_create_helper_thread (pthread_t *threadp, void *(*tf) (void *),
-			    void *arg)
+__gai_create_helper_thread (void *(*tf) (void *), void *arg)
 {
-  pthread_attr_t attr;
-
-  /* Make sure the thread is created detached.  */
-  __pthread_attr_init (&attr);
-  __pthread_attr_setdetachstate (&attr, PTHREAD_CREATE_DETACHED);
-
-  /* The helper thread needs only very little resources.  */
-  (void) __pthread_attr_setstacksize (&attr,
-				      __pthread_get_minstack (&attr)
-				      + 4 * PTHREAD_STACK_MIN);
-
-  /* Block all signals in the helper thread.  To do this thoroughly we
-     temporarily have to block all signals here.  */
-  sigset_t ss;
-  sigset_t oss;
-  sigfillset (&ss);
-  int sigerr __attribute__ ((unused));
-  sigerr = __pthread_sigmask (SIG_SETMASK, &ss, &oss);
-  assert_perror (sigerr);
-
-  int ret = __pthread_create (threadp, &attr, tf, arg);
-
-  /* Restore the signal mask.  */
-  sigerr = __pthread_sigmask (SIG_SETMASK, &oss, NULL);
-  assert_perror (sigerr);
-
-  (void) __pthread_attr_destroy (&attr);
-  return ret;
+  /* The helper runs on a thread of the internal worker pool, which
+     blocks all signals.  */
+  return __nptl_workpool_submit (tf, arg);
 }
 
 #include_next <gai_misc.h>
@@ -48,6 +48,7 @@ struct pthread_attr
 #define ATTR_FLAG_OLDATTR		0x0010
 #define ATTR_FLAG_SCHED_SET		0x0020
 #define ATTR_FLAG_POLICY_SET		0x0040
+#define ATTR_FLAG_DO_RSEQ		0x0080
 
 /* Used to allocate a pthread_attr_t object which is also accessed
    internally.  */
@@ -116,6 +117,10 @@ struct pthread_barrier
 };
 /* See pthread_barrier_wait for a description.  */
 #define BARRIER_IN_THRESHOLD (UINT_MAX/2)
+/* Private barriers for at least this many threads wake their waiters
+   through a tree with the given fan-out.  See pthread_barrier_wait.  */
+#define BARRIER_TREE_THRESHOLD 16
+#define BARRIER_TREE_FANOUT 4
 
 
 /* Barrier variable attribute data structure.  */
@@ -0,0 +1,133 @@
+/* Lock contention profiler for NPTL.
+   Copyright (C) 2021 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+#ifndef _NPTL_LOCK_PROFILE_H
+#define _NPTL_LOCK_PROFILE_H
+
+#include <pthreadP.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/* If the glibc.pthread.lock_profile tunable is set to N, one in every N
+   contended acquisitions of mutexes, rwlocks and condition variables
+   of each thread is sampled.  An acquisition is contended once it has
+   to wait; acquisitions that succeed right away never reach the code
+   below.  For sampled acquisitions the time spent waiting and the
+   caller are recorded, and for mutexes and write locks of rwlocks also
+   the time the lock is held afterwards.  To get the latter, the unlock
+   functions call __nptl_lock_profile_release, which only checks whether
+   the thread holds a sampled lock.
+
+   The samples are buffered per thread and aggregated per lock address
+   in nptl-lock-profile.c, from where pthread_lock_profile_np reads
+   them and where they are written out at exit.
+
+   A contended acquisition looks like this:
+
+     struct nptl_lock_profile_wait pw;
+     __nptl_lock_profile_wait_init (&pw);
+     ...
+     __nptl_lock_profile_contended (&pw);
+     wait;
+     ...
+     __nptl_lock_profile_acquired (&pw, lock, type, caller, held);  */
+
+/* One in this many contended acquisitions of each thread is sampled.
+   Zero if the profiler is disabled.  */
+extern unsigned int __nptl_lock_profile_interval attribute_hidden;
+
+struct nptl_lock_profile_wait
+{
+  /* Set once the acquisition had to wait.  */
+  bool contended;
+  /* CLOCK_MONOTONIC time in nanoseconds at which a sampled acquisition
+     started to wait, or zero if the acquisition is not sampled.  */
+  uint64_t start;
+};
+
+/* Count a contended acquisition of the current thread.  Return the
+   current time if it is sampled, or zero.  */
+extern uint64_t __nptl_lock_profile_sample (void) attribute_hidden;
+
+/* Record a sampled acquisition of LOCK of TYPE (one of
+   PTHREAD_LOCK_PROFILE_*_NP) by CALLER that started to wait at START.
+   If HELD, the hold time is recorded once __nptl_lock_profile_release
+   is called for LOCK.  The hold time is tracked for a few locks per
+   thread at a time; if more are held, the oldest one's is dropped and
+   counted in hold_dropped.  */
+extern void __nptl_lock_profile_record (const void *lock, int type,
+					const void *caller, uint64_t start,
+					bool held) attribute_hidden;
+
+/* Record the hold time of the sampled acquisition of LOCK by the
+   current thread, if there is one, as LOCK is being released.  */
+extern void __nptl_lock_profile_release_held (const void *lock)
+  attribute_hidden;
+
+/* Move the samples buffered by PD into the table.  Called when PD
+   exits.  */
+extern void __nptl_lock_profile_thread_exit (struct pthread *pd)
+  attribute_hidden;
+
+/* Free the buffer of PD, a thread that does not exist in the child
+   after fork, without reporting its samples.  */
+extern void __nptl_lock_profile_reclaim (struct pthread *pd)
+  attribute_hidden;
+
+/* Reinitialize the profiler after fork, dropping the samples taken in
+   the parent.  */
+extern void __nptl_lock_profile_fork_subprocess (void) attribute_hidden;
+
+static __always_inline void
+__nptl_lock_profile_wait_init (struct nptl_lock_profile_wait *pw)
+{
+  pw->contended = false;
+  pw->start = 0;
+}
+
+/* Called before the acquisition waits.  Only the first call for an
+   acquisition counts.  */
+static __always_inline void
+__nptl_lock_profile_contended (struct nptl_lock_profile_wait *pw)
+{
+  if (__glibc_likely (__nptl_lock_profile_interval == 0) || pw->contended)
+    return;
+  pw->contended = true;
+  pw->start = __nptl_lock_profile_sample ();
+}
+
+/* Called once LOCK has been acquired.  */
+static __always_inline void
+__nptl_lock_profile_acquired (struct nptl_lock_profile_wait *pw,
+			      const void *lock, int type, const void *caller,
+			      bool held)
+{
+  if (__glibc_unlikely (pw->start != 0))
+    __nptl_lock_profile_record (lock, type, caller, pw->start, held);
+}
+
+/* Called before LOCK is released by its owner.  */
+static __always_inline void
+__nptl_lock_profile_release (const void *lock)
+{
+  if (__glibc_unlikely (THREAD_GETMEM (THREAD_SELF, lock_profile_nheld)
+			!= 0))
+    __nptl_lock_profile_release_held (lock);
+}
+
+#endif /* nptl-lock-profile.h */
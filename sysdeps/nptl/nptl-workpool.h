@@ -0,0 +1,62 @@
+/* Internal worker thread pool of libc.
+   Copyright (C) 2021 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+#ifndef _NPTL_WORKPOOL_H
+#define _NPTL_WORKPOOL_H
+
+/* The worker pool runs the helper threads of the POSIX AIO and
+   getaddrinfo_a implementations and the notification functions of
+   SIGEV_THREAD timers.  A submitted function is handed to a parked
+   worker if there is one and gets a new worker otherwise, so it never
+   waits for other submitted functions to finish.  A worker parks once
+   its function returns, unless glibc.pthread.workpool_max_idle workers
+   are parked already, and exits if it is not unparked within
+   glibc.pthread.workpool_idle_time milliseconds.
+
+   Workers are detached threads with default attributes.  They keep the
+   default stack size because they run the notification functions of
+   timers, which are application code and used to get a thread of their
+   own with that size.  Workers run with all signals but SIGSETXID
+   blocked.  After each function their signal mask, cancellation state
+   and type, and thread name are restored, and their thread-specific
+   data is destroyed, so a function can change them as it needs.  */
+
+/* Maximum number of parked workers, and time in milliseconds a parked
+   worker waits for work before it exits.  The variables are defined
+   with the other pthread tunables in pthread_mutex_conf.c, so that
+   reading the tunables does not link the pool into static
+   programs.  */
+#define WORKPOOL_DEFAULT_MAX_IDLE 8
+#define WORKPOOL_DEFAULT_IDLE_TIME 5000
+#if HAVE_TUNABLES
+extern unsigned int __nptl_workpool_max_idle attribute_hidden;
+extern unsigned int __nptl_workpool_idle_time attribute_hidden;
+#else
+# define __nptl_workpool_max_idle WORKPOOL_DEFAULT_MAX_IDLE
+# define __nptl_workpool_idle_time WORKPOOL_DEFAULT_IDLE_TIME
+#endif
+
+/* Run FN (ARG) on a worker.  Return 0 on success, or an error number
+   if no worker is parked and none can be created.  */
+extern int __nptl_workpool_submit (void *(*fn) (void *), void *arg)
+  attribute_hidden;
+
+/* Forget the workers of the parent after fork.  */
+extern void __nptl_workpool_fork_subprocess (void) attribute_hidden;
+
+#endif /* nptl-workpool.h */
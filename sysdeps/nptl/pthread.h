@@ -60,6 +60,9 @@ enum
 #ifdef __USE_GNU
   /* For compatibility.  */
   , PTHREAD_MUTEX_FAST_NP = PTHREAD_MUTEX_TIMED_NP
+  /* Waiters queue up and spin on their own node rather than on the
+     mutex, and acquire it in FIFO order.  */
+  , PTHREAD_MUTEX_QUEUED_NP = PTHREAD_MUTEX_ADAPTIVE_NP + 1
 #endif
 };
 
@@ -96,6 +99,8 @@ enum
  { {  __PTHREAD_MUTEX_INITIALIZER (PTHREAD_MUTEX_ERRORCHECK_NP) } }
 # define PTHREAD_ADAPTIVE_MUTEX_INITIALIZER_NP \
  { {  __PTHREAD_MUTEX_INITIALIZER (PTHREAD_MUTEX_ADAPTIVE_NP) } }
+# define PTHREAD_QUEUED_MUTEX_INITIALIZER_NP \
+ { {  __PTHREAD_MUTEX_INITIALIZER (PTHREAD_MUTEX_QUEUED_NP) } }
 #endif
 
 
@@ -106,6 +111,11 @@ enum
   PTHREAD_RWLOCK_PREFER_READER_NP,
   PTHREAD_RWLOCK_PREFER_WRITER_NP,
   PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP,
+  /* Like PTHREAD_RWLOCK_PREFER_WRITER_NP, but while there are no
+     writers, readers acquire the lock through a slot of their own rather
+     than a counter in the lock.  Writers then have to check the slots
+     of all threads.  */
+  PTHREAD_RWLOCK_DISTRIBUTED_READERS_NP,
   PTHREAD_RWLOCK_DEFAULT_NP = PTHREAD_RWLOCK_PREFER_READER_NP
 };
 
@@ -1318,6 +1328,38 @@ extern int pthread_getcpuclockid (pthread_t __thread_id,
 #endif
 
 
+#ifdef __USE_GNU
+/* Kinds of locks in struct pthread_lock_profile_np.  */
+enum
+{
+  PTHREAD_LOCK_PROFILE_MUTEX_NP,
+  PTHREAD_LOCK_PROFILE_RWLOCK_NP,
+  PTHREAD_LOCK_PROFILE_COND_NP
+};
+
+/* Contention statistics of one lock, gathered if the
+   glibc.pthread.lock_profile tunable is set.  */
+struct pthread_lock_profile_np
+{
+  const void *lock;			/* Address of the lock.  */
+  int type;				/* PTHREAD_LOCK_PROFILE_*_NP.  */
+  unsigned long int samples;		/* Sampled contended acquisitions.  */
+  unsigned long long int wait_ns;	/* Total time they waited.  */
+  unsigned long long int max_wait_ns;	/* Longest of these waits.  */
+  const void *max_wait_caller;		/* Caller that waited longest.  */
+  unsigned long int hold_samples;	/* Samples with a hold time.  */
+  unsigned long long int hold_ns;	/* Total time these held the lock.  */
+  unsigned long int hold_dropped;	/* Samples whose hold time was lost.  */
+};
+
+/* Store the statistics of the N locks whose sampled acquisitions waited
+   longest in total in BUF, longest first.  Return the number of locks
+   with samples, or -1 if the profiler is disabled.  */
+extern int pthread_lock_profile_np (struct pthread_lock_profile_np *__buf,
+				    size_t __n) __THROW;
+#endif
+
+
 /* Install handlers to be called when a new process is created with FORK.
    The PREPARE handler is called in the parent process just before performing
    FORK. The PARENT handler is called in the parent process just after FORK.
@@ -57,6 +57,16 @@ static inline short max_adaptive_count (void)
 #endif
 }
 
+/* Upper bound for the spin budgets in nptl-spin.h.  */
+static inline int max_wait_spin_count (void)
+{
+#if HAVE_TUNABLES
+  return __mutex_aconf.wait_spin_count;
+#else
+  return DEFAULT_WAIT_SPIN_COUNT;
+#endif
+}
+
 
 /* Magic cookie representing robust mutex with dead owner.  */
 #define PTHREAD_MUTEX_INCONSISTENT	INT_MAX
@@ -170,6 +180,32 @@ enum
 					 << (sizeof (unsigned int) * 8 - 1))
 #define PTHREAD_RWLOCK_FUTEX_USED	2
 
+/* State of PTHREAD_RWLOCK_DISTRIBUTED_READERS_NP rwlocks, kept in
+   padding the other kinds do not use.  The reader bias is 1 while
+   readers may acquire the lock through their reader slot, and 0 once a
+   writer has revoked it.  It is 2 while that writer waits on it as a
+   futex for readers to release their slots.  The bias is not enabled
+   again before the
+   CLOCK_MONOTONIC time in microseconds (modulo 2^32) stored in
+   PTHREAD_RWLOCK_RBIAS_INHIBIT.  */
+#define PTHREAD_RWLOCK_RBIAS(rwlock) (&(rwlock)->__data.__pad3)
+#define PTHREAD_RWLOCK_RBIAS_INHIBIT(rwlock) (&(rwlock)->__data.__pad4)
+
+/* Return the index of the reader slot used for RWLOCK in every thread.  */
+static inline unsigned int
+__pthread_rwlock_rslot_index (pthread_rwlock_t *rwlock)
+{
+  return ((uintptr_t) rwlock / sizeof (pthread_rwlock_t))
+	 & (PTHREAD_RWLOCK_RSLOTS - 1);
+}
+
+extern int __pthread_rwlock_revoke_bias (pthread_rwlock_t *rwlock,
+					 clockid_t clockid,
+					 const struct __timespec64 *abstime,
+					 bool try) attribute_hidden;
+extern void __pthread_rwlock_enable_bias (pthread_rwlock_t *rwlock)
+     attribute_hidden;
+
 
 /* Bits used in robust mutex implementation.  */
 #define FUTEX_WAITERS		0x80000000
@@ -411,6 +447,7 @@ extern int __pthread_rwlock_wrlock (pthread_rwlock_t *__rwlock);
 libc_hidden_proto (__pthread_rwlock_wrlock)
 extern int __pthread_rwlock_trywrlock (pthread_rwlock_t *__rwlock);
 extern int __pthread_rwlock_unlock (pthread_rwlock_t *__rwlock);
+libc_hidden_proto (__pthread_rwlock_unlock)
 extern int __pthread_cond_broadcast (pthread_cond_t *cond);
 libc_hidden_proto (__pthread_cond_broadcast)
 extern int __pthread_cond_destroy (pthread_cond_t *cond);
@@ -20,10 +20,16 @@
 
 #include <adaptive_spin_count.h>
 
+/* Spinning before blocking in sem_wait, the rwlocks and
+   pthread_cond_wait (see nptl-spin.h) has to be enabled with the
+   glibc.pthread.wait_spin_count tunable.  */
+#define DEFAULT_WAIT_SPIN_COUNT 0
+
 #if HAVE_TUNABLES
 struct mutex_config
 {
   int spin_count;
+  int wait_spin_count;
 };
 
 extern struct mutex_config __mutex_aconf;
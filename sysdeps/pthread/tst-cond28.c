@@ -0,0 +1,170 @@
+/* Test that all waiters woken by pthread_cond_broadcast return.
+   Copyright (C) 2021 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+/* A broadcast wakes the waiters one at a time, as each of them
+   re-acquires the mutex.  Check that this completes, also if the
+   broadcast is followed by further signals or broadcasts, or by the
+   destruction of the condvar, while the broadcaster still holds the
+   mutex.  */
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <support/check.h>
+#include <support/support.h>
+#include <support/xthread.h>
+
+#define NWAITERS 100
+#define ROUNDS 100
+
+static pthread_mutex_t mut = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t *cond;
+
+/* All protected by MUT.  */
+static unsigned int generation;
+static unsigned int seen;
+static bool stop;
+
+static void *
+waiter (void *closure)
+{
+  unsigned int last = 0;
+  xpthread_mutex_lock (&mut);
+  while (true)
+    {
+      while (generation == last && !stop)
+	xpthread_cond_wait (cond, &mut);
+      if (stop)
+	break;
+      last = generation;
+      ++seen;
+    }
+  xpthread_mutex_unlock (&mut);
+  return NULL;
+}
+
+static void
+start_waiters (pthread_t *threads, int n)
+{
+  generation = 0;
+  seen = 0;
+  stop = false;
+  for (int i = 0; i < n; ++i)
+    threads[i] = xpthread_create (NULL, waiter, NULL);
+}
+
+static void
+join_waiters (pthread_t *threads, int n)
+{
+  xpthread_mutex_lock (&mut);
+  stop = true;
+  pthread_cond_broadcast (cond);
+  xpthread_mutex_unlock (&mut);
+  for (int i = 0; i < n; ++i)
+    xpthread_join (threads[i]);
+}
+
+/* Every waiter must see every generation.  */
+static void
+test_all_woken (void)
+{
+  pthread_t threads[NWAITERS];
+  start_waiters (threads, NWAITERS);
+  for (unsigned int round = 1; round <= ROUNDS; ++round)
+    {
+      xpthread_mutex_lock (&mut);
+      generation = round;
+      pthread_cond_broadcast (cond);
+      xpthread_mutex_unlock (&mut);
+      while (true)
+	{
+	  xpthread_mutex_lock (&mut);
+	  unsigned int s = seen;
+	  xpthread_mutex_unlock (&mut);
+	  if (s == round * NWAITERS)
+	    break;
+	  usleep (100);
+	}
+    }
+  join_waiters (threads, NWAITERS);
+}
+
+/* Signal or broadcast again before the waiters have been woken, so that
+   the group switch has to wait for them while we hold the mutex.  */
+static void
+test_switch (bool broadcast)
+{
+  pthread_t threads[NWAITERS];
+  start_waiters (threads, NWAITERS);
+  for (unsigned int round = 1; round <= ROUNDS; ++round)
+    {
+      xpthread_mutex_lock (&mut);
+      generation = round;
+      pthread_cond_broadcast (cond);
+      xpthread_mutex_unlock (&mut);
+      xpthread_mutex_lock (&mut);
+      if (broadcast)
+	pthread_cond_broadcast (cond);
+      else
+	pthread_cond_signal (cond);
+      xpthread_mutex_unlock (&mut);
+    }
+  join_waiters (threads, NWAITERS);
+}
+
+/* Destroy the condvar right after the broadcast, while holding the
+   mutex, and reuse its memory.  */
+static void
+test_destroy (void)
+{
+  pthread_t threads[NWAITERS / 4];
+  for (int round = 0; round < ROUNDS / 4; ++round)
+    {
+      start_waiters (threads, NWAITERS / 4);
+      usleep (1000);
+      xpthread_mutex_lock (&mut);
+      stop = true;
+      pthread_cond_broadcast (cond);
+      TEST_COMPARE (pthread_cond_destroy (cond), 0);
+      memset (cond, 0xff, sizeof (*cond));
+      memset (cond, 0, sizeof (*cond));
+      xpthread_mutex_unlock (&mut);
+      for (int i = 0; i < NWAITERS / 4; ++i)
+	xpthread_join (threads[i]);
+    }
+}
+
+static int
+do_test (void)
+{
+  cond = xmalloc (sizeof (*cond));
+  TEST_COMPARE (pthread_cond_init (cond, NULL), 0);
+
+  test_all_woken ();
+  test_switch (false);
+  test_switch (true);
+  test_destroy ();
+
+  TEST_COMPARE (pthread_cond_destroy (cond), 0);
+  free (cond);
+  return 0;
+}
+
+#include <support/test-driver.c>
@@ -18,6 +18,7 @@
 #ifndef _AIO_MISC_H
 # include_next <aio_misc.h>
 # include <limits.h>
+# include <nptl-workpool.h>
 # include <pthread.h>
 # include <signal.h>
 # include <sysdep.h>
@@ -35,33 +36,10 @@ __aio_start_notify_thread (void)
 }
 
 extern inline int
-__aio_create_helper_thread (pthread_t *threadp, void *(*tf) (void *),
-			    void *arg)
+__aio_create_helper_thread (void *(*tf) (void *), void *arg)
 {
-  pthread_attr_t attr;
-
-  /* Make sure the thread is created detached.  */
-  __pthread_attr_init (&attr);
-  __pthread_attr_setdetachstate (&attr, PTHREAD_CREATE_DETACHED);
-
-  /* The helper thread needs only very little resources.  */
-  __pthread_attr_setstacksize (&attr, __pthread_get_minstack (&attr));
-
-  /* Block all signals in the helper thread.  To do this thoroughly we
-     temporarily have to block all signals here.  */
-  sigset_t ss;
-  sigset_t oss;
-  sigfillset (&ss);
-  INTERNAL_SYSCALL_CALL (rt_sigprocmask, SIG_SETMASK, &ss, &oss,
-			 __NSIG_BYTES);
-
-  int ret = __pthread_create (threadp, &attr, tf, arg);
-
-  /* Restore the signal mask.  */
-  INTERNAL_SYSCALL_CALL (rt_sigprocmask, SIG_SETMASK, &oss, NULL,
-			 __NSIG_BYTES);
-
-  __pthread_attr_destroy (&attr);
-  return ret;
+  /* The helper runs on a thread of the internal worker pool, which
+     blocks all signals.  */
+  return __nptl_workpool_submit (tf, arg);
 }
 #endif
@@ -18,6 +18,7 @@
 #include <pthread.h>
 #include <setjmp.h>
 #include <signal.h>
+#include <stdbool.h>
 #include <sys/types.h>
 
 
@@ -62,6 +63,10 @@ struct timer
   sigval_t sival;
   pthread_attr_t attr;
 
+  /* True if the user did not provide thread attributes, so that the
+     notifications run on the internal worker pool.  */
+  bool use_workpool;
+
   /* Next element in list of active SIGEV_THREAD timers.  */
   struct timer *next;
 };
@@ -0,0 +1,110 @@
+/* Malloc huge page support.  Linux implementation.
+   Copyright (C) 2021 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public License as
+   published by the Free Software Foundation; either version 2.1 of the
+   License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; see the file COPYING.LIB.  If
+   not, see <https://www.gnu.org/licenses/>.  */
+
+#include <fcntl.h>
+#include <intprops.h>
+#include <malloc-hugepages.h>
+#include <not-cancel.h>
+#include <string.h>
+#include <sys/mman.h>
+
+/* Read at most SIZE - 1 bytes of file PATH into BUF and terminate them.
+   Return the number of bytes read, or -1 on failure.  */
+static ssize_t
+read_file (const char *path, char *buf, size_t size)
+{
+  int fd = __open_nocancel (path, O_RDONLY | O_CLOEXEC);
+  if (fd == -1)
+    return -1;
+  ssize_t r = __read_nocancel (fd, buf, size - 1);
+  __close_nocancel_nostatus (fd);
+  if (r < 0)
+    return -1;
+  buf[r] = '\0';
+  return r;
+}
+
+static unsigned long int
+parse_ulong (const char *s)
+{
+  unsigned long int r = 0;
+  for (; *s >= '0' && *s <= '9'; s++)
+    {
+      if (INT_MULTIPLY_WRAPV (r, 10, &r) || INT_ADD_WRAPV (r, *s - '0', &r))
+	return 0;
+    }
+  return r;
+}
+
+unsigned long int
+__malloc_default_thp_pagesize (void)
+{
+  char buf[INT_BUFSIZE_BOUND (unsigned long int) + 1];
+  if (read_file ("/sys/kernel/mm/transparent_hugepage/hpage_pmd_size",
+		 buf, sizeof (buf)) <= 0)
+    return 0;
+  return parse_ulong (buf);
+}
+
+enum malloc_thp_mode_t
+__malloc_thp_mode (void)
+{
+  /* The file lists all modes with the selected one in brackets, e.g.
+     "always [madvise] never".  */
+  char buf[64];
+  if (read_file ("/sys/kernel/mm/transparent_hugepage/enabled",
+		 buf, sizeof (buf)) <= 0)
+    return malloc_thp_mode_not_supported;
+
+  if (strstr (buf, "[always]") != NULL)
+    return malloc_thp_mode_always;
+  if (strstr (buf, "[madvise]") != NULL)
+    return malloc_thp_mode_madvise;
+  if (strstr (buf, "[never]") != NULL)
+    return malloc_thp_mode_never;
+  return malloc_thp_mode_not_supported;
+}
+
+void
+__malloc_hugepage_config (size_t *pagesize, int *flags)
+{
+  *pagesize = 0;
+  *flags = 0;
+
+  /* The default size of the pages in the hugetlbfs pool is reported
+     in kilobytes by the "Hugepagesize:" line of /proc/meminfo, which
+     is well within the first few kilobytes of the file.  */
+  char buf[4096];
+  if (read_file ("/proc/meminfo", buf, sizeof (buf)) <= 0)
+    return;
+
+  static const char key[] = "\nHugepagesize:";
+  const char *s = strstr (buf, key);
+  if (s == NULL)
+    return;
+  s += sizeof (key) - 1;
+  while (*s == ' ' || *s == '\t')
+    s++;
+
+  unsigned long int kb = parse_ulong (s);
+  if (kb == 0 || kb > SIZE_MAX / 1024)
+    return;
+
+  *pagesize = kb * 1024;
+  *flags = MAP_HUGETLB;
+}
@@ -17,7 +17,14 @@
    <https://www.gnu.org/licenses/>.  */
 
 #include <fcntl.h>
+#include <limits.h>
+#include <sched.h>
 #include <not-cancel.h>
+#include <string.h>
+#include <_itoa.h>
+#include <sysdep.h>
+#include <tls.h>
+#include <sys/rseq.h>
 
 /* The Linux kernel overcommits address space by default and if there is not
    enough memory available, it uses various parameters to decide the process to
@@ -56,4 +63,132 @@ check_may_shrink_heap (void)
   return may_shrink_heap;
 }
 
+/* Return the number of the CPU the calling thread runs on, or -1 if
+   it cannot be determined.  As in sched_getcpu, the cpu_id the kernel
+   keeps up to date in the rseq area of the thread is used if the area
+   is registered; otherwise getcpu, which is serviced by the vDSO on most
+   architectures.  */
+static inline int
+malloc_getcpu (void)
+{
+#ifdef RSEQ_SIG
+  int cpu_id = atomic_load_relaxed (&THREAD_SELF->rseq_area.cpu_id);
+  if (__glibc_likely (cpu_id >= 0))
+    return cpu_id;
+#endif
+  unsigned int cpu;
+  if (__getcpu (&cpu, NULL) != 0)
+    return -1;
+  return cpu;
+}
+
+/* Return the NUMA node of the CPU the calling thread runs on, or -1 if
+   it cannot be determined.  The rseq area has no node number, so this
+   always uses getcpu.  */
+static inline int
+malloc_getnode (void)
+{
+  unsigned int cpu, node;
+  if (__getcpu (&cpu, &node) != 0)
+    return -1;
+  return node;
+}
+
+/* Return the number of NUMA nodes, that is the highest node number
+   listed in /sys/devices/system/node/online plus one, or 1 if the list
+   cannot be read (for example on kernels without NUMA support).  */
+static inline int
+malloc_numa_nodes (void)
+{
+  int fd = __open_nocancel ("/sys/devices/system/node/online",
+			    O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return 1;
+
+  /* The list has the form "0-1,4".  Only the last number matters.  */
+  char buf[128];
+  ssize_t n = __read_nocancel (fd, buf, sizeof (buf));
+  __close_nocancel_nostatus (fd);
+
+  int max = 0;
+  int cur = 0;
+  for (ssize_t i = 0; i < n; i++)
+    if (buf[i] >= '0' && buf[i] <= '9')
+      {
+	cur = cur * 10 + (buf[i] - '0');
+	if (cur > max)
+	  max = cur;
+      }
+    else
+      cur = 0;
+  return max + 1;
+}
+
+/* Set NODES[CPU] to the NUMA node of each CPU below NCPUS listed in
+   /sys/devices/system/node/nodeN/cpulist, for N below NNODES.  Entries
+   of CPUs which are not listed are left alone.  */
+static inline void
+malloc_cpu_nodes (short *nodes, int ncpus, int nnodes)
+{
+  for (int node = 0; node < nnodes; node++)
+    {
+      char path[sizeof ("/sys/devices/system/node/node/cpulist") + 11];
+      char num[11];
+      char *n = _itoa_word (node, num + sizeof (num), 10, 0);
+      __stpcpy (__mempcpy (__stpcpy (path, "/sys/devices/system/node/node"),
+			   n, num + sizeof (num) - n), "/cpulist");
+      int fd = __open_nocancel (path, O_RDONLY | O_CLOEXEC);
+      if (fd < 0)
+	continue;
+      char buf[4096];
+      ssize_t len = __read_nocancel (fd, buf, sizeof (buf));
+      __close_nocancel_nostatus (fd);
+
+      /* The list has the form "0-3,8-11".  */
+      int first = -1;
+      int cur = -1;
+      for (ssize_t i = 0; i <= len; i++)
+	{
+	  char c = i < len ? buf[i] : ',';
+	  if (c >= '0' && c <= '9')
+	    cur = (cur < 0 ? 0 : cur * 10) + (c - '0');
+	  else if (c == '-')
+	    {
+	      first = cur;
+	      cur = -1;
+	    }
+	  else
+	    {
+	      if (cur >= 0)
+		for (int cpu = first >= 0 ? first : cur;
+		     cpu <= cur && cpu < ncpus; cpu++)
+		  nodes[cpu] = node;
+	      first = -1;
+	      cur = -1;
+	    }
+	}
+    }
+}
+
+/* Largest node number malloc_bind_node can express.  */
+#define MALLOC_NUMA_MAX_NODES 1024
+
+/* Ask the kernel to back the pages of [ADDR, ADDR + LEN) that are faulted
+   in later from NODE if possible (MPOL_PREFERRED).  Failure is ignored:
+   the pages are then placed by first touch, as usual.  */
+static inline void
+malloc_bind_node (void *addr, size_t len, int node)
+{
+#ifdef __NR_mbind
+  if (node < 0 || node >= MALLOC_NUMA_MAX_NODES)
+    return;
+  unsigned long int mask[MALLOC_NUMA_MAX_NODES / ULONG_WIDTH] = { 0 };
+  mask[node / ULONG_WIDTH] = 1UL << (node % ULONG_WIDTH);
+  /* MPOL_PREFERRED from <linux/mempolicy.h>.  The kernel drops the last
+     bit of the mask length.  */
+  INTERNAL_SYSCALL_CALL (mbind, addr, len, 1, mask,
+			 MALLOC_NUMA_MAX_NODES + 1, 0);
+#endif
+}
+
 #define HAVE_MREMAP 1
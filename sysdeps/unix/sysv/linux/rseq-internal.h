@@ -0,0 +1,61 @@
+/* Restartable Sequences internal API.  Linux implementation.
+   Copyright (C) 2021 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+#ifndef RSEQ_INTERNAL_H
+#define RSEQ_INTERNAL_H
+
+#include <sysdep.h>
+#include <errno.h>
+#include <kernel-features.h>
+#include <stdbool.h>
+#include <sys/rseq.h>
+
+/* Register the rseq area of SELF, the current thread, with the kernel
+   if DO_RSEQ.  Return true on success.  On failure, or if registration
+   is disabled, mark the area as unregistered so that readers of cpu_id
+   fall back to other means.  */
+#if defined RSEQ_SIG && defined __NR_rseq
+static inline bool
+rseq_register_current_thread (struct pthread *self, int do_rseq)
+{
+  if (do_rseq)
+    {
+      /* The area may be left over from a previous thread on a reused
+         stack.  The kernel fills in the CPU fields on registration,
+         but a stale rseq_cs pointer would be followed on the next
+         preemption.  */
+      self->rseq_area = (struct rseq) { .cpu_id = RSEQ_CPU_ID_UNINITIALIZED };
+      int ret = INTERNAL_SYSCALL_CALL (rseq, &self->rseq_area,
+                                       sizeof (self->rseq_area),
+                                       0, RSEQ_SIG);
+      if (!INTERNAL_SYSCALL_ERROR_P (ret))
+        return true;
+    }
+  THREAD_SETMEM (self, rseq_area.cpu_id, RSEQ_CPU_ID_REGISTRATION_FAILED);
+  return false;
+}
+#else /* RSEQ_SIG */
+static inline bool
+rseq_register_current_thread (struct pthread *self, int do_rseq)
+{
+  THREAD_SETMEM (self, rseq_area.cpu_id, RSEQ_CPU_ID_REGISTRATION_FAILED);
+  return false;
+}
+#endif /* RSEQ_SIG */
+
+#endif /* rseq-internal.h */
@@ -15,13 +15,16 @@
    License along with the GNU C Library; if not, see
    <https://www.gnu.org/licenses/>.  */
 
+#include <atomic.h>
 #include <errno.h>
 #include <sched.h>
 #include <sysdep.h>
 #include <sysdep-vdso.h>
+#include <tls.h>
+#include <rseq-internal.h>
 
-int
-sched_getcpu (void)
+static int
+vsyscall_sched_getcpu (void)
 {
   unsigned int cpu;
   int r = -1;
@@ -32,3 +35,21 @@ sched_getcpu (void)
 #endif
   return r == -1 ? r : cpu;
 }
+
+#ifdef RSEQ_SIG
+/* The kernel updates cpu_id in the registered rseq area of the current
+   thread whenever it is scheduled, so reading it needs no system call.
+   A negative value means that registration was disabled or failed.  */
+int
+sched_getcpu (void)
+{
+  int cpu_id = atomic_load_relaxed (&THREAD_SELF->rseq_area.cpu_id);
+  return __glibc_likely (cpu_id >= 0) ? cpu_id : vsyscall_sched_getcpu ();
+}
+#else /* RSEQ_SIG */
+int
+sched_getcpu (void)
+{
+  return vsyscall_sched_getcpu ();
+}
+#endif /* RSEQ_SIG */
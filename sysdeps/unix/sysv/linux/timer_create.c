@@ -87,6 +87,7 @@ ___timer_create (clockid_t clock_id, struct sigevent *evp, timer_t *timerid)
 	   implementation might keep internal information for
 	   each instance.  */
 	__pthread_attr_init (&newp->attr);
+	newp->use_workpool = evp->sigev_notify_attributes == NULL;
 	if (evp->sigev_notify_attributes != NULL)
 	  {
 	    struct pthread_attr *nattr;
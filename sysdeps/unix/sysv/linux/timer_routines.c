@@ -21,6 +21,7 @@
 #include <stdbool.h>
 #include <sysdep-cancel.h>
 #include <pthreadP.h>
+#include <nptl-workpool.h>
 #include "kernel-posix-timers.h"
 
 
@@ -94,8 +95,20 @@ timer_helper_thread (void *arg)
 		  td->thrfunc = tk->thrfunc;
 		  td->sival = tk->sival;
 
-		  pthread_t th;
-		  __pthread_create (&th, &tk->attr, timer_sigev_thread, td);
+		  /* Without user-provided thread attributes a thread of
+		     the worker pool will do, which saves creating a new
+		     thread for every expiration.  */
+		  int res;
+		  if (tk->use_workpool)
+		    res = __nptl_workpool_submit (timer_sigev_thread, td);
+		  else
+		    {
+		      pthread_t th;
+		      res = __pthread_create (&th, &tk->attr,
+					      timer_sigev_thread, td);
+		    }
+		  if (res != 0)
+		    free (td);
 		}
 	    }
 
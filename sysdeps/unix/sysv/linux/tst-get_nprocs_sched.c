@@ -0,0 +1,76 @@
+/* Test that __get_nprocs_sched counts the CPUs of the affinity mask.
+   Copyright (C) 2021 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+#include <sched.h>
+#include <string.h>
+#include <sys/sysinfo.h>
+#include <support/check.h>
+
+/* The size of the buffer __get_nprocs_sched passes to the kernel.  */
+enum { max_cpus = 32768 };
+
+/* Fill the stack below the caller with set bits, so that the buffer of
+   __get_nprocs_sched starts out with garbage beyond the part the kernel
+   fills in.  */
+static void __attribute__ ((noinline, noclone))
+dirty_stack (void)
+{
+  unsigned char buf[CPU_ALLOC_SIZE (max_cpus) + 4096];
+  memset (buf, 0xff, sizeof (buf));
+  __asm__ volatile ("" : : "r" (buf) : "memory");
+}
+
+static int
+count_affinity (void)
+{
+  cpu_set_t *set = CPU_ALLOC (max_cpus);
+  TEST_VERIFY_EXIT (set != NULL);
+  size_t size = CPU_ALLOC_SIZE (max_cpus);
+  if (sched_getaffinity (0, size, set) != 0)
+    FAIL_EXIT1 ("sched_getaffinity: %m");
+  int count = CPU_COUNT_S (size, set);
+  CPU_FREE (set);
+  return count;
+}
+
+static int
+do_test (void)
+{
+  dirty_stack ();
+  TEST_COMPARE (__get_nprocs_sched (), count_affinity ());
+
+  /* Restrict the thread to the CPU it runs on.  */
+  int cpu = sched_getcpu ();
+  if (cpu < 0)
+    FAIL_UNSUPPORTED ("sched_getcpu: %m");
+  cpu_set_t *set = CPU_ALLOC (cpu + 1);
+  TEST_VERIFY_EXIT (set != NULL);
+  size_t size = CPU_ALLOC_SIZE (cpu + 1);
+  CPU_ZERO_S (size, set);
+  CPU_SET_S (cpu, size, set);
+  if (sched_setaffinity (0, size, set) != 0)
+    FAIL_UNSUPPORTED ("sched_setaffinity: %m");
+  CPU_FREE (set);
+
+  dirty_stack ();
+  TEST_COMPARE (__get_nprocs_sched (), 1);
+
+  return 0;
+}
+
+#include <support/test-driver.c>
@@ -0,0 +1,77 @@
+/* Restartable Sequences disabled through the glibc.pthread.rseq tunable.
+   Copyright (C) 2021 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+/* This test is run with GLIBC_TUNABLES=glibc.pthread.rseq=0.  glibc
+   must then leave rseq alone, so that the application can register its
+   own area, and sched_getcpu must still work.  */
+
+#include <sched.h>
+#include <support/check.h>
+#include <support/xthread.h>
+#include <sys/rseq.h>
+#include "tst-rseq.h"
+
+#ifdef RSEQ_SIG
+static void
+check_rseq_disabled (void)
+{
+  struct rseq *area = rseq_area ();
+  TEST_COMPARE ((int32_t) area->cpu_id, RSEQ_CPU_ID_REGISTRATION_FAILED);
+  TEST_VERIFY (sched_getcpu () >= 0);
+
+  /* The thread is not registered, so an area of our own is accepted.  */
+  static __thread struct rseq own_area
+    = { .cpu_id = RSEQ_CPU_ID_UNINITIALIZED };
+  TEST_COMPARE (syscall (__NR_rseq, &own_area, sizeof (own_area), 0,
+                         RSEQ_SIG), 0);
+  TEST_VERIFY ((int32_t) own_area.cpu_id >= 0);
+  TEST_COMPARE (syscall (__NR_rseq, &own_area, sizeof (own_area),
+                         RSEQ_FLAG_UNREGISTER, RSEQ_SIG), 0);
+
+  /* glibc's area is still unused.  */
+  TEST_COMPARE ((int32_t) area->cpu_id, RSEQ_CPU_ID_REGISTRATION_FAILED);
+}
+
+static void *
+thread_func (void *closure)
+{
+  check_rseq_disabled ();
+  return NULL;
+}
+
+static int
+do_test (void)
+{
+  if (!rseq_available ())
+    FAIL_UNSUPPORTED ("kernel does not support rseq");
+
+  TEST_COMPARE (__rseq_size, 0);
+  TEST_COMPARE (__rseq_flags, 0);
+  check_rseq_disabled ();
+  xpthread_join (xpthread_create (NULL, thread_func, NULL));
+  return 0;
+}
+#else /* RSEQ_SIG */
+static int
+do_test (void)
+{
+  FAIL_UNSUPPORTED ("rseq not supported on this architecture");
+}
+#endif /* RSEQ_SIG */
+
+#include <support/test-driver.c>
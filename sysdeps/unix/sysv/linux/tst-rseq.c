@@ -0,0 +1,102 @@
+/* Restartable Sequences registration tests.
+   Copyright (C) 2021 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+/* Check that the main thread and new threads get an rseq area that is
+   registered with the kernel, and that sched_getcpu agrees with the
+   cpu_id the kernel stores in it.  */
+
+#include <sched.h>
+#include <support/check.h>
+#include <support/xthread.h>
+#include <sys/rseq.h>
+#include "tst-rseq.h"
+
+#ifdef RSEQ_SIG
+/* Pin the calling thread to each CPU it may run on in turn, and check
+   that both sched_getcpu and the rseq area report that CPU.  */
+static void
+check_rseq_thread (void)
+{
+  TEST_VERIFY (rseq_thread_registered ());
+  struct rseq *area = rseq_area ();
+  TEST_VERIFY (area->cpu_id_start == area->cpu_id);
+
+  /* A second registration of the same thread is rejected.  */
+  TEST_COMPARE (syscall (__NR_rseq, area, sizeof (*area), 0, RSEQ_SIG), -1);
+  TEST_COMPARE (errno, EBUSY);
+
+  cpu_set_t saved;
+  TEST_COMPARE (sched_getaffinity (0, sizeof (saved), &saved), 0);
+  for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+    {
+      if (!CPU_ISSET (cpu, &saved))
+        continue;
+      cpu_set_t set;
+      CPU_ZERO (&set);
+      CPU_SET (cpu, &set);
+      if (sched_setaffinity (0, sizeof (set), &set) != 0)
+        /* The CPU may have gone offline.  */
+        continue;
+      TEST_COMPARE (sched_getcpu (), cpu);
+      TEST_COMPARE (area->cpu_id, cpu);
+      TEST_COMPARE (area->cpu_id_start, cpu);
+    }
+  TEST_COMPARE (sched_setaffinity (0, sizeof (saved), &saved), 0);
+}
+
+static void *
+thread_func (void *closure)
+{
+  TEST_VERIFY (rseq_area () != closure);
+  check_rseq_thread ();
+  return rseq_area ();
+}
+
+static int
+do_test (void)
+{
+  if (!rseq_available ())
+    FAIL_UNSUPPORTED ("kernel does not support rseq");
+
+  TEST_COMPARE (__rseq_size, sizeof (struct rseq));
+  TEST_COMPARE (__rseq_flags, 0);
+  check_rseq_thread ();
+
+  struct rseq *areas[4];
+  for (int i = 0; i < 4; ++i)
+    {
+      pthread_t thr = xpthread_create (NULL, thread_func, rseq_area ());
+      areas[i] = xpthread_join (thr);
+    }
+  /* Threads created after the main thread inherit the registration,
+     and every one has its own area.  */
+  for (int i = 0; i < 4; ++i)
+    TEST_VERIFY (areas[i] != rseq_area ());
+  return 0;
+}
+#else /* RSEQ_SIG */
+static int
+do_test (void)
+{
+  TEST_COMPARE (__rseq_size, 0);
+  TEST_VERIFY (sched_getcpu () >= 0);
+  FAIL_UNSUPPORTED ("rseq not supported on this architecture");
+}
+#endif /* RSEQ_SIG */
+
+#include <support/test-driver.c>
@@ -0,0 +1,65 @@
+/* Restartable Sequences tests header.
+   Copyright (C) 2021 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <support/check.h>
+#include <syscall.h>
+#include <sys/rseq.h>
+#include <unistd.h>
+
+#ifdef RSEQ_SIG
+# include <thread_pointer.h>
+
+/* Return true if the kernel implements the rseq system call.  */
+static inline bool
+rseq_available (void)
+{
+  int rc = syscall (__NR_rseq, NULL, 0, 0, 0);
+  if (rc != -1)
+    FAIL_EXIT1 ("Unexpected rseq return value %d", rc);
+  switch (errno)
+    {
+    case ENOSYS:
+      return false;
+    case EINVAL:
+      /* rseq is implemented, but detected an invalid rseq_len
+         parameter.  */
+      return true;
+    default:
+      FAIL_EXIT1 ("Unexpected rseq error %m");
+    }
+}
+
+/* Return the rseq area of the calling thread.  */
+static inline struct rseq *
+rseq_area (void)
+{
+  return (struct rseq *) ((char *) __thread_pointer () + __rseq_offset);
+}
+
+/* Return true if the calling thread has an rseq area registered by
+   glibc.  */
+static inline bool
+rseq_thread_registered (void)
+{
+  return (int32_t) __atomic_load_n (&rseq_area ()->cpu_id, __ATOMIC_RELAXED)
+    >= 0;
+}
+#endif /* RSEQ_SIG */